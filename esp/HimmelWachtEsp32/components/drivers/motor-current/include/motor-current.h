@@ -0,0 +1,90 @@
+/**
+ * @file motor-current.h
+ * @brief Motor current of the Pololu G2 High-Power Motor Driver (CS pin) on ADC1 in continuous mode
+ *
+ * The CS outputs of both drivers are converted by the ADC DMA at sample_rate_hz in turn, without any
+ * CPU load between two updates. motor_current_update() takes everything converted since the previous
+ * call without waiting, averages it per channel and low-pass filters the mean (first order IIR,
+ * time constant 2^filter_shift update periods). The CS pin of the G2 only measures while the bridge
+ * drives, the RC-filtered voltage is the average current drawn from the battery:
+ *
+ *   current_ma = (cs_mv - offset_mv) * 1000 / mv_per_a
+ *
+ * Reference:
+ *  - https://docs.espressif.com/projects/esp-idf/en/stable/esp32/api-reference/peripherals/adc_continuous.html
+ *  - https://www.pololu.com/product/2992 (current sense: about 20 mV/A plus about 50 mV offset)
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_adc/adc_continuous.h"
+#include "esp_adc/adc_cali.h"
+
+#define MOTOR_CURRENT_CHANNELS 2
+#define MOTOR_CURRENT_LEFT 0
+#define MOTOR_CURRENT_RIGHT 1
+
+// DMA conversion frame and ring of the driver, the ring holds more than one drive loop period
+#define MOTOR_CURRENT_FRAME_BYTES 256
+#define MOTOR_CURRENT_POOL_BYTES 1024
+
+typedef struct
+{
+    adc_channel_t channels[MOTOR_CURRENT_CHANNELS]; // ADC1 channels of the CS pins (left, right)
+    adc_atten_t atten;                              // ADC_ATTEN_DB_12 covers the CS range up to ~120 A
+    uint32_t sample_rate_hz;                        // Conversions per second of all channels (min. 20000)
+    uint16_t mv_per_a;                              // CS gain of the driver
+    uint16_t offset_mv;                             // CS voltage at 0 A
+    uint8_t filter_shift;                           // IIR time constant in update periods as power of 2, 0 = no filter
+} motor_current_config_t;
+
+typedef struct
+{
+    adc_continuous_handle_t adc;
+    adc_cali_handle_t cali; // NULL: nominal conversion without eFuse calibration
+    motor_current_config_t config;
+    int32_t filtered_ma[MOTOR_CURRENT_CHANNELS];
+    bool has_sample[MOTOR_CURRENT_CHANNELS];
+    uint8_t frame[MOTOR_CURRENT_FRAME_BYTES];
+    bool initialized;
+} motor_current_handle_t;
+
+/**
+ * @brief Configure ADC1 for the CS channels and start the conversions
+ *
+ * @param config Pointer to the current sense configuration
+ * @return motor_current_handle_t* Pointer to the handle, or NULL on failure
+ */
+motor_current_handle_t *motor_current_init(const motor_current_config_t *config);
+
+/**
+ * @brief Read the conversions since the previous call and update the filtered currents
+ *
+ * Does not block, called once per drive loop iteration.
+ *
+ * @param sense Pointer to the handle
+ * @return esp_err_t ESP_OK on success, ESP_ERR_TIMEOUT if nothing was converted since the previous call,
+ *         ESP_ERR_INVALID_ARG if sense is NULL or not initialized
+ */
+esp_err_t motor_current_update(motor_current_handle_t *sense);
+
+/**
+ * @brief Filtered current of one channel
+ *
+ * @param sense Pointer to the handle
+ * @param channel MOTOR_CURRENT_LEFT or MOTOR_CURRENT_RIGHT
+ * @param current_ma Receives the current in mA, 0 before the first conversion
+ * @return esp_err_t ESP_OK on success, ESP_ERR_INVALID_ARG for an invalid handle, channel or NULL pointer
+ */
+esp_err_t motor_current_get(motor_current_handle_t *sense, int channel, int32_t *current_ma);
+
+/**
+ * @brief Stop the conversions and free the ADC
+ *
+ * @param sense Pointer to the handle
+ * @return esp_err_t ESP_OK on success, ESP_ERR_INVALID_ARG if sense is NULL or not initialized
+ */
+esp_err_t motor_current_deinit(motor_current_handle_t *sense);
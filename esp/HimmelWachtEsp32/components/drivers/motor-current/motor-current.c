@@ -0,0 +1,239 @@
+#include "motor-current.h"
+#include "esp_log.h"
+#include "esp_adc/adc_cali_scheme.h"
+#include "soc/soc_caps.h"
+#include <stdlib.h>
+#include <string.h>
+#include "log_wrapper.h"
+
+#define TAG "MOTOR_CURRENT"
+
+#define MOTOR_CURRENT_MAX_RAW 4095 // 12 bit
+
+motor_current_handle_t *motor_current_init(const motor_current_config_t *config);
+static esp_err_t init_adc(motor_current_handle_t *sense);
+static void release_adc(motor_current_handle_t *sense);
+static int raw_to_mv(motor_current_handle_t *sense, int raw);
+esp_err_t motor_current_update(motor_current_handle_t *sense);
+esp_err_t motor_current_get(motor_current_handle_t *sense, int channel, int32_t *current_ma);
+esp_err_t motor_current_deinit(motor_current_handle_t *sense);
+
+motor_current_handle_t *motor_current_init(const motor_current_config_t *config)
+{
+    // Input validation
+    if (config == NULL)
+    {
+        ESP_LOGE(TAG, "Current sense config is NULL");
+        return NULL;
+    }
+
+    if (config->channels[MOTOR_CURRENT_LEFT] == config->channels[MOTOR_CURRENT_RIGHT] || config->mv_per_a == 0 ||
+        config->sample_rate_hz < SOC_ADC_SAMPLE_FREQ_THRES_LOW || config->sample_rate_hz > SOC_ADC_SAMPLE_FREQ_THRES_HIGH ||
+        config->filter_shift > 8)
+    {
+        ESP_LOGE(TAG, "Invalid current sense config (channels %d / %d, %u mV/A, %lu Hz)", config->channels[MOTOR_CURRENT_LEFT],
+                 config->channels[MOTOR_CURRENT_RIGHT], config->mv_per_a, (unsigned long)config->sample_rate_hz);
+        return NULL;
+    }
+
+    // Create handle
+    motor_current_handle_t *sense = (motor_current_handle_t *)calloc(1, sizeof(motor_current_handle_t));
+    if (!sense)
+    {
+        ESP_LOGE(TAG, "Failed to allocate memory for current sense handle");
+        return NULL;
+    }
+    memcpy(&sense->config, config, sizeof(motor_current_config_t));
+
+    esp_err_t ret = init_adc(sense);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to initialize ADC: %s", esp_err_to_name(ret));
+        release_adc(sense);
+        free(sense);
+        return NULL;
+    }
+
+    sense->initialized = true;
+    LOGI(TAG, "Current sense on ADC1 channel %d / %d initialized (%s)", config->channels[MOTOR_CURRENT_LEFT],
+         config->channels[MOTOR_CURRENT_RIGHT], sense->cali ? "calibrated" : "nominal");
+
+    return sense;
+}
+
+static esp_err_t init_adc(motor_current_handle_t *sense)
+{
+    const motor_current_config_t *config = &sense->config;
+
+    adc_continuous_handle_cfg_t handle_config = {
+        .max_store_buf_size = MOTOR_CURRENT_POOL_BYTES,
+        .conv_frame_size = MOTOR_CURRENT_FRAME_BYTES,
+    };
+    esp_err_t ret = adc_continuous_new_handle(&handle_config, &sense->adc);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    // Both CS pins in turn
+    adc_digi_pattern_config_t pattern[MOTOR_CURRENT_CHANNELS];
+    for (int i = 0; i < MOTOR_CURRENT_CHANNELS; i++)
+    {
+        pattern[i] = (adc_digi_pattern_config_t){
+            .atten = config->atten,
+            .channel = config->channels[i],
+            .unit = ADC_UNIT_1,
+            .bit_width = SOC_ADC_DIGI_MAX_BITWIDTH,
+        };
+    }
+
+    adc_continuous_config_t adc_config = {
+        .pattern_num = MOTOR_CURRENT_CHANNELS,
+        .adc_pattern = pattern,
+        .sample_freq_hz = config->sample_rate_hz,
+        .conv_mode = ADC_CONV_SINGLE_UNIT_1,
+        .format = ADC_DIGI_OUTPUT_FORMAT_TYPE1,
+    };
+    ret = adc_continuous_config(sense->adc, &adc_config);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    // Without eFuse values the nominal range is used, a few percent off
+    adc_cali_line_fitting_config_t cali_config = {
+        .unit_id = ADC_UNIT_1,
+        .atten = config->atten,
+        .bitwidth = ADC_BITWIDTH_12,
+    };
+    if (adc_cali_create_scheme_line_fitting(&cali_config, &sense->cali) != ESP_OK)
+    {
+        LOGW(TAG, "No ADC calibration, using the nominal range");
+        sense->cali = NULL;
+    }
+
+    return adc_continuous_start(sense->adc);
+}
+
+static void release_adc(motor_current_handle_t *sense)
+{
+    // Also used for a partially initialized ADC, every step checks what exists
+    if (sense->adc != NULL)
+    {
+        adc_continuous_stop(sense->adc);
+        adc_continuous_deinit(sense->adc);
+        sense->adc = NULL;
+    }
+    if (sense->cali != NULL)
+    {
+        adc_cali_delete_scheme_line_fitting(sense->cali);
+        sense->cali = NULL;
+    }
+}
+
+static int raw_to_mv(motor_current_handle_t *sense, int raw)
+{
+    int mv = 0;
+    if (sense->cali != NULL && adc_cali_raw_to_voltage(sense->cali, raw, &mv) == ESP_OK)
+    {
+        return mv;
+    }
+
+    // Nominal full scale per attenuation (ESP32 datasheet)
+    static const int full_scale_mv[] = {950, 1250, 1750, 2450};
+    return raw * full_scale_mv[sense->config.atten & 3] / MOTOR_CURRENT_MAX_RAW;
+}
+
+esp_err_t motor_current_update(motor_current_handle_t *sense)
+{
+    if (sense == NULL || !sense->initialized)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    const motor_current_config_t *config = &sense->config;
+    uint32_t sum[MOTOR_CURRENT_CHANNELS] = {0};
+    uint32_t count[MOTOR_CURRENT_CHANNELS] = {0};
+
+    // Drain the DMA ring without waiting, it holds at most this many frames
+    for (int frame = 0; frame <= MOTOR_CURRENT_POOL_BYTES / MOTOR_CURRENT_FRAME_BYTES; frame++)
+    {
+        uint32_t length = 0;
+        if (adc_continuous_read(sense->adc, sense->frame, sizeof(sense->frame), &length, 0) != ESP_OK || length == 0)
+        {
+            break;
+        }
+
+        const adc_digi_output_data_t *data = (const adc_digi_output_data_t *)sense->frame;
+        for (uint32_t i = 0; i < length / SOC_ADC_DIGI_DATA_BYTES_PER_CONV; i++)
+        {
+            for (int c = 0; c < MOTOR_CURRENT_CHANNELS; c++)
+            {
+                if (data[i].type1.channel == config->channels[c])
+                {
+                    sum[c] += data[i].type1.data;
+                    count[c]++;
+                }
+            }
+        }
+    }
+
+    if (count[MOTOR_CURRENT_LEFT] == 0 && count[MOTOR_CURRENT_RIGHT] == 0)
+    {
+        return ESP_ERR_TIMEOUT;
+    }
+
+    for (int c = 0; c < MOTOR_CURRENT_CHANNELS; c++)
+    {
+        if (count[c] == 0)
+        {
+            continue;
+        }
+
+        // Mean before the calibration, one conversion per channel and update
+        int mv = raw_to_mv(sense, (int)((sum[c] + count[c] / 2) / count[c]));
+        int32_t current_ma = ((int32_t)mv - config->offset_mv) * 1000 / config->mv_per_a;
+        if (current_ma < 0)
+        {
+            current_ma = 0;
+        }
+
+        if (!sense->has_sample[c])
+        {
+            sense->filtered_ma[c] = current_ma;
+            sense->has_sample[c] = true;
+        }
+        else
+        {
+            sense->filtered_ma[c] += (current_ma - sense->filtered_ma[c]) >> config->filter_shift;
+        }
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t motor_current_get(motor_current_handle_t *sense, int channel, int32_t *current_ma)
+{
+    if (sense == NULL || current_ma == NULL || !sense->initialized || channel < 0 || channel >= MOTOR_CURRENT_CHANNELS)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    *current_ma = sense->filtered_ma[channel];
+    return ESP_OK;
+}
+
+esp_err_t motor_current_deinit(motor_current_handle_t *sense)
+{
+    if (sense == NULL || !sense->initialized)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    release_adc(sense);
+    sense->initialized = false;
+    free(sense);
+
+    LOGI(TAG, "Current sense deinitialized");
+    return ESP_OK;
+}
@@ -5,6 +5,31 @@
  * This driver provides an interface to control motors using the MCPWM peripheral of the ESP32.
  * It supports setting speed, direction, and ramping up/down the motor speed.
  * It also includes emergency stop functionality and parameter printing for debugging.
+ *
+ * The ramp is a fixed-point profile generator on a signed duty cycle (positive = forward). Every ramp
+ * interval it changes the acceleration by at most the jerk limit and the duty cycle by at most
+ * ramp_rate, so a reversal passes through zero without a separate state and the direction pin flips
+ * at the zero crossing. With ramp_jerk_time_ms set the acceleration builds up and decays along an
+ * S-curve, otherwise the duty cycle follows a linear ramp.
+ *
+ * Active braking: in sign-magnitude mode the G2 shorts the motor (brake) while the PWM is low. With
+ * brake_time_ms set, a stop or a reversal of a moving motor (and MOTOR_DIRECTION_BRAKE always) runs a
+ * brake profile instead of the ramp: the duty cycle falls linearly without jerk limit, from
+ * pwm_duty_limit to 0 within brake_time_ms, so the short-brake share of every period grows; at
+ * standstill the PWM stays low for brake_hold_ms (short-brake pulse) before the ramp continues to the
+ * target. The driver therefore shorts the motor fully after at most brake_time_ms and drives the other
+ * way after brake_time_ms + brake_hold_ms, however fast the ramp is. A command in the direction of the
+ * motion ends the profile early.
+ *
+ * With current_limit_ma set, the measured motor current (motor_driver_set_current()) limits the ramp:
+ * below the limit minus a band of limit / 2^MOTOR_CURRENT_TAPER_SHIFT the duty cycle rises at the full
+ * ramp_rate, towards the limit ever slower, and above it the duty cycle is reduced until the current
+ * is back at the limit. Slowing down is never limited.
+ *
+ * All motors of an MCPWM group run on one shared timer, each with its own operator, comparator and
+ * generator. The comparators take a new duty cycle from their shadow register at the next timer empty
+ * event, so the motors of a group switch on the same period boundary and an update never cuts a
+ * period short. Motors in one group need the same PWM frequency.
  * 
  * Reference:
  *  - https://docs.espressif.com/projects/esp-idf/en/stable/esp32/api-reference/peripherals/mcpwm.html
@@ -15,39 +40,77 @@
 #pragma once
 
 #include "esp_err.h"
-#include "driver/mcpwm.h"
+#include "driver/mcpwm_prelude.h"
+
+// Fixed-point format of the ramp: duty cycle in percent with 16 fractional bits
+#define MOTOR_RAMP_SHIFT 16
+#define MOTOR_RAMP_ONE (1 << MOTOR_RAMP_SHIFT)
+
+// Tick rate of the PWM timer, 500 steps of 0.2 % duty cycle at 20 kHz
+#define MOTOR_PWM_RESOLUTION_HZ 10000000
+
+// Width of the current limit band as shift of the limit (limit / 4)
+#define MOTOR_CURRENT_TAPER_SHIFT 2
+
+// Missed ramp intervals that motor_driver_update() still calculates, a longer gap restarts the ramp timing
+#define MOTOR_RAMP_MAX_CATCH_UP 4
 
 typedef enum
 {
     MOTOR_DIRECTION_FORWARD,
     MOTOR_DIRECTION_BACKWARD,
-    MOTOR_DIRECTION_STOP
+    MOTOR_DIRECTION_STOP,
+    MOTOR_DIRECTION_BRAKE // Brake profile to standstill, then the PWM stays low (short brake)
 } motor_direction_t;
 
 typedef struct
 {
-    mcpwm_unit_t mcpwm_unit;
-    mcpwm_timer_t timer_num;
-    mcpwm_operator_t generator;
-    mcpwm_io_signals_t pwm_signal;
+    int mcpwm_group_id;         // MCPWM group, its timer is shared by all motors of the group
     uint8_t pwm_gpio_num;
     uint8_t dir_gpio_num;
     uint16_t pwm_frequency_hz;
-    uint8_t ramp_rate;
-    uint8_t ramp_intervall_ms;
+    uint8_t ramp_rate;          // Acceleration limit, duty cycle change in percent per ramp interval
+    uint8_t ramp_intervall_ms;  // Time step of the ramp
+    uint16_t ramp_jerk_time_ms; // Time to build up the full acceleration, 0 for a linear ramp
+    uint16_t brake_time_ms;     // Stop / reversal from pwm_duty_limit to 0 within this time, 0 = ramp (MOTOR_DIRECTION_BRAKE: at once)
+    uint16_t brake_hold_ms;     // Short brake at standstill before the motor drives again
     uint8_t direction_hysteresis;
     float pwm_duty_limit;
+    uint16_t current_limit_ma;  // Motor current the ramp regulates to, 0 = no limit
     uint8_t mynr;
 } motor_config_t;
 
 
+// State of the ramp, all values in MOTOR_RAMP_ONE units per ramp interval
+typedef struct
+{
+    int32_t velocity;          // Signed duty cycle, positive = forward
+    int32_t accel;             // Duty cycle change in the last interval
+    int32_t target;            // Signed target duty cycle, limited to pwm_duty_limit
+    int32_t accel_limit;       // ramp_rate
+    int32_t jerk_limit;        // Acceleration change per interval, 0 = unlimited
+    int32_t drive_limit;       // Change away from zero allowed by the current limit, negative = back towards zero
+    int32_t brake_rate;        // Duty cycle decrease of the brake profile
+    uint32_t brake_hold_steps; // Intervals of brake_hold_ms
+    uint32_t brake_hold;       // Remaining intervals of the short brake at standstill
+    bool braking;              // Brake profile running, the ramp to the target follows
+} motor_ramp_t;
+
 typedef struct
 {
     float current_pwm;                   // current speed(0-100)
     float target_pwm;                    // target speed
     motor_direction_t current_direction; 
     motor_direction_t target_direction;
-    uint32_t last_update_ms;
+    int64_t last_update_us;              // esp_timer time of the last ramp step
+    motor_ramp_t ramp;
+    mcpwm_timer_handle_t timer;          // Shared by the motors of the MCPWM group
+    mcpwm_oper_handle_t oper;
+    mcpwm_cmpr_handle_t comparator;
+    mcpwm_gen_handle_t generator;
+    uint32_t period_ticks;
+    uint32_t compare_ticks;              // Last value written to the comparator
+    uint32_t current_ma;                 // Last measured motor current
     motor_config_t config;
     bool initialized;
 } motor_handle_t;
@@ -63,6 +126,10 @@ motor_handle_t *motor_driver_init(const motor_config_t *config);
 /**
  * @brief Set the speed and direction of the motor.
  *
+ * A change of at most direction_hysteresis in the same direction is ignored, so the motor does not
+ * follow small input noise. Stopping is always exact. MOTOR_DIRECTION_BRAKE ignores duty_cycle, brakes
+ * the motor to standstill and keeps it shorted until the next command.
+ *
  * @param motor Pointer to the motor handle.
  * @param duty_cycle The desired duty cycle (0.0 to 100.0).
  * @param direction The desired direction of the motor.
@@ -70,8 +137,36 @@ motor_handle_t *motor_driver_init(const motor_config_t *config);
  */
 esp_err_t motor_driver_set_speed(motor_handle_t *motor, float duty_cycle, motor_direction_t direction);
 
+/**
+ * @brief Set the signed target duty cycle of the ramp directly, for a speed controller.
+ *
+ * Unlike motor_driver_set_speed() there is no hysteresis: a controller corrects in small steps every
+ * period. The target is limited to pwm_duty_limit, the ramp still limits acceleration and jerk. There
+ * is no brake profile either, a running one ends.
+ *
+ * @param motor Pointer to the motor handle.
+ * @param duty Signed duty cycle in MOTOR_RAMP_ONE units, positive = forward, 0 = stop.
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if motor is NULL.
+ */
+esp_err_t motor_driver_set_target(motor_handle_t *motor, int32_t duty);
+
+/**
+ * @brief Hand the measured motor current to the ramp.
+ *
+ * Called once per control period with the filtered current of the motor driver's current sense. Without
+ * current_limit_ma the value is only stored (telemetry).
+ *
+ * @param motor Pointer to the motor handle.
+ * @param current_ma Motor current in mA.
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if motor is NULL.
+ */
+esp_err_t motor_driver_set_current(motor_handle_t *motor, uint32_t current_ma);
+
 /**
  * @brief Update the motor state based on the current configuration and target values.
+ *
+ * Calculates every ramp interval that elapsed since the last call (up to MOTOR_RAMP_MAX_CATCH_UP) and
+ * writes the result once, so the ramp is a function of time and not of the call rate.
  * 
  * @param motor Pointer to the motor handle.
  * @return ESP_OK on success, or an error code on failure.
@@ -102,7 +197,7 @@ esp_err_t motor_driver_deinit(motor_handle_t *motor);
 void motor_driver_print_all_parameters(motor_handle_t *motor);
 
 /**
- * @brief Check if an update to the motor is necessary based on the target and current values.
+ * @brief Check if the ramp has not reached the target yet.
  *
  * @param motor Pointer to the motor handle.
  * @return true if an update is necessary, false otherwise.
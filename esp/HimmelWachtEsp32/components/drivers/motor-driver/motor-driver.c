@@ -2,10 +2,14 @@
 #include "freertos/task.h"
 #include "driver/gpio.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "motor-driver.h"
+#include "soc/soc_caps.h"
 #include <string.h>
+#include <stdlib.h>
 #include <math.h>
 #include "log_wrapper.h"
+#include "trace_log.h"
 
 #define TAG "MOTOR_DRIVER"
 
@@ -13,11 +17,22 @@
 
 motor_handle_t *motor_driver_init(const motor_config_t *config);
 static esp_err_t init_motor(motor_handle_t *motor, const motor_config_t *config);
+static esp_err_t acquire_timer(motor_handle_t *motor);
+static void release_timer(motor_handle_t *motor);
+static esp_err_t init_pwm(motor_handle_t *motor);
+static void release_pwm(motor_handle_t *motor);
 esp_err_t motor_driver_emergency_stop(motor_handle_t *motor);
 inline bool motor_driver_is_update_necessary(motor_handle_t *motor);
 esp_err_t motor_driver_set_speed(motor_handle_t *motor, float duty_cycle, motor_direction_t direction);
+esp_err_t motor_driver_set_target(motor_handle_t *motor, int32_t duty);
+esp_err_t motor_driver_set_current(motor_handle_t *motor, uint32_t current_ma);
 static esp_err_t set_pwm(motor_handle_t *motor, float duty_cycle);
 static esp_err_t set_dir(motor_handle_t *motor, motor_direction_t direction);
+static int32_t duty_to_ramp(const motor_handle_t *motor, float duty_cycle);
+static void update_brake(motor_handle_t *motor, bool brake);
+static bool brake_step(motor_ramp_t *ramp);
+static void ramp_step(motor_ramp_t *ramp);
+static void apply_ramp(motor_handle_t *motor);
 esp_err_t motor_driver_update(motor_handle_t *motor);
 void motor_driver_print_all_parameters(motor_handle_t *motor);
 esp_err_t motor_driver_deinit(motor_handle_t *motor);
@@ -25,6 +40,16 @@ esp_err_t motor_driver_deinit(motor_handle_t *motor);
 static uint8_t instance_cntr = 0;
 uint8_t instance_nr = 0;
 
+// One timer per MCPWM group, shared by its motors so that their periods start together
+typedef struct
+{
+    mcpwm_timer_handle_t timer;
+    uint16_t frequency_hz;
+    uint8_t users;
+} group_timer_t;
+
+static group_timer_t group_timers[SOC_MCPWM_GROUPS];
+
 motor_handle_t *motor_driver_init(const motor_config_t *config)
 {
     // Input validation
@@ -47,7 +72,7 @@ motor_handle_t *motor_driver_init(const motor_config_t *config)
         motor->current_pwm = 0;
         motor->target_direction = MOTOR_DIRECTION_STOP;
         motor->target_pwm = 0;
-        motor->last_update_ms = 0;
+        motor->last_update_us = 0;
         LOGI(TAG, "Motor instance %d created", instance_cntr);
     }
 
@@ -56,6 +81,7 @@ motor_handle_t *motor_driver_init(const motor_config_t *config)
     if (ret != ESP_OK)
     {
         ESP_LOGE(TAG, "Failed to initialize motor");
+        release_pwm(motor);
         free(motor);
         return NULL;
     }
@@ -73,6 +99,42 @@ static esp_err_t init_motor(motor_handle_t *motor, const motor_config_t *config)
     // Store configuration
     memcpy(&motor->config, config, sizeof(motor_config_t));
 
+    if (config->ramp_intervall_ms == 0)
+    {
+        ESP_LOGE(TAG, "Ramp interval not configured");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Ramp limits per interval, the jerk limit reaches the full acceleration after ramp_jerk_time_ms
+    motor->ramp.accel_limit = (int32_t)config->ramp_rate << MOTOR_RAMP_SHIFT;
+    motor->ramp.jerk_limit = 0;
+    motor->ramp.drive_limit = motor->ramp.accel_limit;
+    if (config->ramp_jerk_time_ms > config->ramp_intervall_ms)
+    {
+        motor->ramp.jerk_limit = (int32_t)((int64_t)motor->ramp.accel_limit * config->ramp_intervall_ms / config->ramp_jerk_time_ms);
+        if (motor->ramp.jerk_limit == 0)
+        {
+            motor->ramp.jerk_limit = 1;
+        }
+    }
+
+    // Brake profile: from the duty limit to standstill within brake_time_ms, never slower than the ramp
+    int32_t duty_limit = duty_to_ramp(motor, config->pwm_duty_limit);
+    motor->ramp.brake_rate = duty_limit;
+    if (config->brake_time_ms > config->ramp_intervall_ms)
+    {
+        motor->ramp.brake_rate = (int32_t)((int64_t)duty_limit * config->ramp_intervall_ms / config->brake_time_ms);
+    }
+    if (motor->ramp.brake_rate < motor->ramp.accel_limit)
+    {
+        motor->ramp.brake_rate = motor->ramp.accel_limit;
+    }
+    if (motor->ramp.brake_rate == 0)
+    {
+        motor->ramp.brake_rate = 1;
+    }
+    motor->ramp.brake_hold_steps = (config->brake_hold_ms + config->ramp_intervall_ms - 1) / config->ramp_intervall_ms;
+
     esp_err_t ret;
     // Configure + Init direction GPIO
     if (config->dir_gpio_num != GPIO_NUM_NC)
@@ -97,13 +159,13 @@ static esp_err_t init_motor(motor_handle_t *motor, const motor_config_t *config)
         return ESP_ERR_INVALID_ARG;
     }
 
-    // Initialize MCPWM GPIO
+    // Initialize MCPWM timer, operator, comparator and generator
     if (config->pwm_gpio_num != GPIO_NUM_NC)
     {
-        ret = mcpwm_gpio_init(config->mcpwm_unit, config->pwm_signal, config->pwm_gpio_num);
+        ret = init_pwm(motor);
         if (ret != ESP_OK)
         {
-            ESP_LOGE(TAG, "Failed to initialize MCPWM GPIO %d", config->pwm_gpio_num);
+            ESP_LOGE(TAG, "Failed to initialize MCPWM on GPIO %d", config->pwm_gpio_num);
             return ret;
         }
     }
@@ -113,39 +175,182 @@ static esp_err_t init_motor(motor_handle_t *motor, const motor_config_t *config)
         return ESP_ERR_INVALID_ARG;
     }
 
-    // Configure MCPWM timer
-    mcpwm_config_t pwm_config = {
-        .frequency = config->pwm_frequency_hz,
-        .cmpr_a = 0,
-        .cmpr_b = 0,
-        .duty_mode = MCPWM_DUTY_MODE_0,
-        .counter_mode = MCPWM_UP_COUNTER,
-    };
-
-    ret = mcpwm_init(config->mcpwm_unit, config->timer_num, &pwm_config);
-    if (ret != ESP_OK)
-    {
-        ESP_LOGE(TAG, "Failed to initialize MCPWM timer %d", config->timer_num);
-        return ret;
-    }
-
     if (instance_cntr == 0)
     {
+        // Still installed when all motors were deinitialized before
         ret = gpio_install_isr_service(0);
-        if (ret != ESP_OK)
+        if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE)
         {
             ESP_LOGE(TAG, "Failed to install ISR service");
             return ret;
         }
     }
 
-    // Set initial state
+    // Set initial state, the first comparator write always goes out
+    motor->compare_ticks = UINT32_MAX;
     set_dir(motor, motor->target_direction);
     set_pwm(motor, motor->target_pwm);
 
     return ESP_OK;
 }
 
+static esp_err_t acquire_timer(motor_handle_t *motor)
+{
+    const motor_config_t *config = &motor->config;
+    if (config->mcpwm_group_id < 0 || config->mcpwm_group_id >= SOC_MCPWM_GROUPS || config->pwm_frequency_hz == 0)
+    {
+        ESP_LOGE(TAG, "Invalid MCPWM group %d or frequency %d Hz", config->mcpwm_group_id, config->pwm_frequency_hz);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    group_timer_t *shared = &group_timers[config->mcpwm_group_id];
+    if (shared->users == 0)
+    {
+        // The first motor of the group starts the timer, it runs until the last one is deinitialized
+        mcpwm_timer_config_t timer_config = {
+            .group_id = config->mcpwm_group_id,
+            .clk_src = MCPWM_TIMER_CLK_SRC_DEFAULT,
+            .resolution_hz = MOTOR_PWM_RESOLUTION_HZ,
+            .count_mode = MCPWM_TIMER_COUNT_MODE_UP,
+            .period_ticks = MOTOR_PWM_RESOLUTION_HZ / config->pwm_frequency_hz,
+        };
+
+        esp_err_t ret = mcpwm_new_timer(&timer_config, &shared->timer);
+        if (ret == ESP_OK)
+        {
+            ret = mcpwm_timer_enable(shared->timer);
+            if (ret == ESP_OK)
+            {
+                ret = mcpwm_timer_start_stop(shared->timer, MCPWM_TIMER_START_NO_STOP);
+            }
+            if (ret != ESP_OK)
+            {
+                mcpwm_timer_disable(shared->timer);
+                mcpwm_del_timer(shared->timer);
+            }
+        }
+        if (ret != ESP_OK)
+        {
+            ESP_LOGE(TAG, "Failed to start the timer of MCPWM group %d", config->mcpwm_group_id);
+            shared->timer = NULL;
+            return ret;
+        }
+        shared->frequency_hz = config->pwm_frequency_hz;
+    }
+    else if (shared->frequency_hz != config->pwm_frequency_hz)
+    {
+        ESP_LOGE(TAG, "MCPWM group %d already runs at %d Hz", config->mcpwm_group_id, shared->frequency_hz);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    shared->users++;
+    motor->timer = shared->timer;
+    motor->period_ticks = MOTOR_PWM_RESOLUTION_HZ / config->pwm_frequency_hz;
+
+    return ESP_OK;
+}
+
+static void release_timer(motor_handle_t *motor)
+{
+    if (motor->timer == NULL)
+    {
+        return;
+    }
+
+    group_timer_t *shared = &group_timers[motor->config.mcpwm_group_id];
+    motor->timer = NULL;
+    shared->users--;
+    if (shared->users == 0)
+    {
+        mcpwm_timer_start_stop(shared->timer, MCPWM_TIMER_STOP_EMPTY);
+        mcpwm_timer_disable(shared->timer);
+        mcpwm_del_timer(shared->timer);
+        shared->timer = NULL;
+    }
+}
+
+static esp_err_t init_pwm(motor_handle_t *motor)
+{
+    esp_err_t ret = acquire_timer(motor);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    mcpwm_operator_config_t operator_config = {
+        .group_id = motor->config.mcpwm_group_id,
+    };
+    ret = mcpwm_new_operator(&operator_config, &motor->oper);
+    if (ret == ESP_OK)
+    {
+        ret = mcpwm_operator_connect_timer(motor->oper, motor->timer);
+    }
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to create MCPWM operator");
+        return ret;
+    }
+
+    // A new compare value waits in the shadow register until the timer is empty, so a period is never
+    // cut short and all motors of the group switch on the same boundary
+    mcpwm_comparator_config_t comparator_config = {
+        .flags.update_cmp_on_tez = true,
+    };
+    ret = mcpwm_new_comparator(motor->oper, &comparator_config, &motor->comparator);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to create MCPWM comparator");
+        return ret;
+    }
+
+    mcpwm_generator_config_t generator_config = {
+        .gen_gpio_num = motor->config.pwm_gpio_num,
+    };
+    ret = mcpwm_new_generator(motor->oper, &generator_config, &motor->generator);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to create MCPWM generator");
+        return ret;
+    }
+
+    // High from the start of the period until the compare value
+    ret = mcpwm_generator_set_action_on_timer_event(motor->generator,
+                                                    MCPWM_GEN_TIMER_EVENT_ACTION(MCPWM_TIMER_DIRECTION_UP, MCPWM_TIMER_EVENT_EMPTY, MCPWM_GEN_ACTION_HIGH));
+    if (ret == ESP_OK)
+    {
+        ret = mcpwm_generator_set_action_on_compare_event(motor->generator,
+                                                          MCPWM_GEN_COMPARE_EVENT_ACTION(MCPWM_TIMER_DIRECTION_UP, motor->comparator, MCPWM_GEN_ACTION_LOW));
+    }
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to set MCPWM generator actions");
+    }
+
+    return ret;
+}
+
+static void release_pwm(motor_handle_t *motor)
+{
+    if (motor->generator != NULL)
+    {
+        // Keep the pin low once the generator is gone
+        mcpwm_generator_set_force_level(motor->generator, 0, true);
+        mcpwm_del_generator(motor->generator);
+        motor->generator = NULL;
+    }
+    if (motor->comparator != NULL)
+    {
+        mcpwm_del_comparator(motor->comparator);
+        motor->comparator = NULL;
+    }
+    if (motor->oper != NULL)
+    {
+        mcpwm_del_operator(motor->oper);
+        motor->oper = NULL;
+    }
+    release_timer(motor);
+}
+
 esp_err_t motor_driver_emergency_stop(motor_handle_t *motor)
 {
     if (motor == NULL)
@@ -153,48 +358,155 @@ esp_err_t motor_driver_emergency_stop(motor_handle_t *motor)
         return ESP_ERR_INVALID_ARG;
     }
 
-    // Set PWM to 0 and direction to stop
+    // Set PWM to 0 and direction to stop, the ramp starts again from standstill
     set_pwm(motor, 0);
     set_dir(motor, MOTOR_DIRECTION_STOP);
+    motor->ramp.velocity = 0;
+    motor->ramp.accel = 0;
+    motor->ramp.target = 0;
+    motor->ramp.braking = false;
+    motor->ramp.brake_hold = 0;
+    motor->current_pwm = 0;
+    motor->target_pwm = 0;
+    motor->current_direction = MOTOR_DIRECTION_STOP;
+    motor->target_direction = MOTOR_DIRECTION_STOP;
 
     return ESP_OK;
 }
 
 inline bool motor_driver_is_update_necessary(motor_handle_t *motor)
 {
-    bool check;
-    
-    LOGI(TAG, "motor->target_pwm (%.2f) - motor->current_pwm (%.2f): %.2f", motor->target_pwm, motor->current_pwm, fabs(motor->target_pwm - motor->current_pwm));
-    LOGI(TAG, "motor->target_direction != motor->current_direction: %d", motor->target_direction != motor->current_direction);
+    return motor->ramp.velocity != motor->ramp.target || motor->ramp.accel != 0 || motor->ramp.braking ||
+           motor->current_direction != motor->target_direction;
+}
 
-    // check if change in dir or pwm is detected
-    if ((fabs(motor->target_pwm - motor->current_pwm) > motor->config.direction_hysteresis) || (motor->target_direction != motor->current_direction))
+esp_err_t motor_driver_set_speed(motor_handle_t *motor, float duty_cycle, motor_direction_t direction)
+{
+    if (motor == NULL || direction > MOTOR_DIRECTION_BRAKE)
     {
-        check = true;
+        return ESP_ERR_INVALID_ARG;
     }
-    else
+
+    // Small changes in the same direction are input noise, stopping is always exact
+    if (direction == motor->target_direction && duty_cycle != 0 &&
+        fabsf(duty_cycle - motor->target_pwm) <= motor->config.direction_hysteresis)
     {
-        check = false;
+        return ESP_OK;
     }
 
-    LOGI(TAG, "motor_driver_is_update_necessary: %d for instance: %d", check, motor->config.mynr);
+    motor->target_pwm = duty_cycle;
+    motor->target_direction = direction;
+
+    bool moves = direction == MOTOR_DIRECTION_FORWARD || direction == MOTOR_DIRECTION_BACKWARD;
+    int32_t target = moves ? duty_to_ramp(motor, duty_cycle) : 0;
+    motor->ramp.target = direction == MOTOR_DIRECTION_BACKWARD ? -target : target;
+    update_brake(motor, direction == MOTOR_DIRECTION_BRAKE);
 
-    return check;
+    return ESP_OK;
 }
 
-esp_err_t motor_driver_set_speed(motor_handle_t *motor, float duty_cycle, motor_direction_t direction)
+esp_err_t motor_driver_set_target(motor_handle_t *motor, int32_t duty)
 {
     if (motor == NULL)
     {
         return ESP_ERR_INVALID_ARG;
     }
 
-    motor->target_pwm = duty_cycle;
-    motor->target_direction = direction;
+    int32_t limit = duty_to_ramp(motor, motor->config.pwm_duty_limit);
+    if (duty > limit)
+    {
+        duty = limit;
+    }
+    else if (duty < -limit)
+    {
+        duty = -limit;
+    }
+
+    motor->ramp.target = duty;
+    motor->target_pwm = (float)abs(duty) / MOTOR_RAMP_ONE;
+    motor->target_direction = duty > 0 ? MOTOR_DIRECTION_FORWARD : duty < 0 ? MOTOR_DIRECTION_BACKWARD : MOTOR_DIRECTION_STOP;
+
+    // The controller decelerates through its own output, a sign change near standstill is no stop
+    motor->ramp.braking = false;
+    motor->ramp.brake_hold = 0;
 
     return ESP_OK;
 }
 
+esp_err_t motor_driver_set_current(motor_handle_t *motor, uint32_t current_ma)
+{
+    if (motor == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    motor->current_ma = current_ma;
+
+    uint32_t limit = motor->config.current_limit_ma;
+    if (limit == 0)
+    {
+        return ESP_OK;
+    }
+
+    // Full acceleration up to the band below the limit, linear to full deceleration at the band above it
+    int32_t band = (int32_t)(limit >> MOTOR_CURRENT_TAPER_SHIFT);
+    if (band == 0)
+    {
+        band = 1;
+    }
+    int64_t headroom = (int64_t)limit - current_ma;
+    int64_t drive_limit = (int64_t)motor->ramp.accel_limit * headroom / band;
+    if (drive_limit > motor->ramp.accel_limit)
+    {
+        drive_limit = motor->ramp.accel_limit;
+    }
+    else if (drive_limit < -motor->ramp.accel_limit)
+    {
+        drive_limit = -motor->ramp.accel_limit;
+    }
+    motor->ramp.drive_limit = (int32_t)drive_limit;
+
+    return ESP_OK;
+}
+
+static void update_brake(motor_handle_t *motor, bool brake)
+{
+    motor_ramp_t *ramp = &motor->ramp;
+    bool stops = ramp->target == 0 || (ramp->target > 0) != (ramp->velocity > 0);
+
+    // A stop or reversal of a moving motor brakes when configured, an explicit brake always
+    if (brake || (motor->config.brake_time_ms > 0 && ramp->velocity != 0 && stops))
+    {
+        // Repeated stop commands do not restart the profile
+        if (!ramp->braking)
+        {
+            ramp->braking = true;
+            ramp->accel = 0;
+            ramp->brake_hold = ramp->brake_hold_steps;
+        }
+    }
+    else if (ramp->braking && ramp->velocity != 0 && !stops)
+    {
+        // Back in the direction of the motion before the motor stood
+        ramp->braking = false;
+    }
+}
+
+static int32_t duty_to_ramp(const motor_handle_t *motor, float duty_cycle)
+{
+    // Accelerating beyond the duty limit would only delay the next deceleration
+    if (duty_cycle > motor->config.pwm_duty_limit)
+    {
+        duty_cycle = motor->config.pwm_duty_limit;
+    }
+    if (duty_cycle < 0)
+    {
+        duty_cycle = 0;
+    }
+
+    return (int32_t)(duty_cycle * MOTOR_RAMP_ONE + 0.5f);
+}
+
 static esp_err_t set_pwm(motor_handle_t *motor, float duty_cycle)
 {
     if (duty_cycle < 0)
@@ -206,10 +518,20 @@ static esp_err_t set_pwm(motor_handle_t *motor, float duty_cycle)
         duty_cycle = motor->config.pwm_duty_limit;
     }
 
-    mcpwm_set_duty(MCPWM_UNIT_0, motor->config.timer_num, motor->config.generator, duty_cycle);
-    mcpwm_set_duty_type(MCPWM_UNIT_0, motor->config.timer_num, motor->config.generator, MCPWM_DUTY_MODE_0);
+    // One register write, and none if the ramp did not change the compare value
+    uint32_t ticks = (uint32_t)(duty_cycle * motor->period_ticks / 100.0f + 0.5f);
+    if (ticks == motor->compare_ticks)
+    {
+        return ESP_OK;
+    }
 
-    return ESP_OK;
+    esp_err_t ret = mcpwm_comparator_set_compare_value(motor->comparator, ticks);
+    if (ret == ESP_OK)
+    {
+        motor->compare_ticks = ticks;
+    }
+
+    return ret;
 }
 
 static esp_err_t set_dir(motor_handle_t *motor, motor_direction_t direction)
@@ -225,6 +547,10 @@ static esp_err_t set_dir(motor_handle_t *motor, motor_direction_t direction)
     case MOTOR_DIRECTION_STOP:
         // For stop, direction doesn't matter as PWM will be zero
         break;
+    case MOTOR_DIRECTION_BRAKE:
+        // The pin keeps the direction of the motion, the brake profile only lowers the duty cycle and
+        // PWM low shorts the motor (G2: OUTA = OUTB = L)
+        break;
     default:
         ESP_LOGE(TAG, "Invalid direction: %d", direction);
         return ESP_ERR_INVALID_ARG;
@@ -233,62 +559,160 @@ static esp_err_t set_dir(motor_handle_t *motor, motor_direction_t direction)
     return ESP_OK;
 }
 
-esp_err_t motor_driver_update(motor_handle_t *motor)
+static bool brake_step(motor_ramp_t *ramp)
 {
-    if (motor == NULL)
+    // Straight down at brake_rate without jerk or current limit
+    if (ramp->velocity != 0)
     {
-        return ESP_ERR_INVALID_ARG;
+        int32_t step = abs(ramp->velocity) < ramp->brake_rate ? abs(ramp->velocity) : ramp->brake_rate;
+        ramp->velocity -= ramp->velocity > 0 ? step : -step;
+        ramp->accel = 0;
+        return true;
+    }
+
+    // Short brake at standstill
+    if (ramp->brake_hold > 0)
+    {
+        ramp->brake_hold--;
+        return true;
     }
 
-    uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    ramp->braking = false;
+    return false;
+}
 
-    if (now - motor->last_update_ms >= motor->config.ramp_intervall_ms)
+static void ramp_step(motor_ramp_t *ramp)
+{
+    // The ramp to the target continues in the interval the brake profile ends
+    if (ramp->braking && brake_step(ramp))
     {
-        motor->last_update_ms = now;
+        return;
+    }
 
-        if (motor->current_direction != motor->target_direction && motor->current_pwm > motor->config.direction_hysteresis)
-        {
-            LOGI(TAG, "update instance %d: motor->current_pwm (%.2f) -= motor->config.ramp_rate (%d) --> %.2f",
-                     motor->config.mynr, motor->current_pwm, motor->config.ramp_rate, motor->current_pwm - motor->config.ramp_rate);
-            motor->current_pwm -= motor->config.ramp_rate;
-        }
-        else if (motor->current_direction != motor->target_direction && motor->current_pwm < -motor->config.direction_hysteresis)
-        {
-            LOGI(TAG, "update instance %d: motor->current_pwm (%.2f) += motor->config.ramp_rate (%d) --> %.2f",
-                     motor->config.mynr, motor->current_pwm, motor->config.ramp_rate, motor->current_pwm + motor->config.ramp_rate);
-            motor->current_pwm += motor->config.ramp_rate;
-        }
-        else if (motor->current_direction != motor->target_direction)
-        {
-            LOGI(TAG, "update instance %d: motor->current_direction (%d) = motor->target_direction (%d)",
-                     motor->config.mynr, motor->current_direction, motor->target_direction);
-            motor->current_direction = motor->target_direction;
-        }
-        else if (motor->current_pwm < motor->target_pwm)
-        {
-            LOGI(TAG, "update instance %d: motor->current_pwm (%.2f) += motor->config.ramp_rate (%d) --> %.2f",
-                     motor->config.mynr, motor->current_pwm, motor->config.ramp_rate, motor->current_pwm + motor->config.ramp_rate);
-            motor->current_pwm += motor->config.ramp_rate;
-        }
-        else if (motor->current_pwm > motor->target_pwm)
+    int32_t error = ramp->target - ramp->velocity;
+    int32_t accel = error;
+
+    if (ramp->jerk_limit != 0)
+    {
+        // Build up the acceleration while the target is farther away than the velocity change that
+        // bringing the acceleration back to zero still causes: a + (a - j) + ... = a * (|a| + j) / 2j
+        int64_t remaining = 2 * (int64_t)ramp->jerk_limit * error;
+        int64_t braking = (int64_t)ramp->accel * (abs(ramp->accel) + ramp->jerk_limit);
+        if (remaining > braking)
         {
-            LOGI(TAG, "update instance %d: motor->current_pwm (%.2f) -= motor->config.ramp_rate (%d) --> %.2f",
-                     motor->config.mynr, motor->current_pwm, motor->config.ramp_rate, motor->current_pwm - motor->config.ramp_rate);
-            motor->current_pwm -= motor->config.ramp_rate;
+            accel = ramp->accel + ramp->jerk_limit;
+            if (error < 0 && accel > 0)
+            {
+                accel = 0;
+            }
         }
         else
         {
-            // stay in current state
-            LOGI(TAG, "stay");
+            accel = ramp->accel - ramp->jerk_limit;
+            if (error > 0 && accel < 0)
+            {
+                accel = 0;
+            }
         }
+    }
+
+    if (accel > ramp->accel_limit)
+    {
+        accel = ramp->accel_limit;
+    }
+    else if (accel < -ramp->accel_limit)
+    {
+        accel = -ramp->accel_limit;
+    }
+
+    // The last step ends exactly on the target, without overshoot
+    bool reached = (error >= 0 && accel >= error) || (error <= 0 && accel <= error);
+    if (reached)
+    {
+        accel = error;
+    }
+
+    // The current limit only restricts a change away from zero, at standstill it cannot push back
+    int32_t drive_limit = ramp->velocity == 0 && ramp->drive_limit < 0 ? 0 : ramp->drive_limit;
+    int32_t upper = ramp->velocity >= 0 ? drive_limit : ramp->accel_limit;
+    int32_t lower = ramp->velocity <= 0 ? -drive_limit : -ramp->accel_limit;
+    if (accel > upper)
+    {
+        accel = upper;
+        reached = false;
+    }
+    else if (accel < lower)
+    {
+        accel = lower;
+        reached = false;
+    }
 
-        LOGI(TAG, "Instance %d: Current PWM: %.2f, Target PWM: %.2f, Current Direction: %d, Target Direction: %d",
-                 motor->config.mynr, motor->current_pwm, motor->target_pwm, motor->current_direction, motor->target_direction);
+    ramp->velocity += accel;
+    ramp->accel = reached ? 0 : accel;
+}
 
-        set_dir(motor, motor->current_direction);
-        set_pwm(motor, motor->current_pwm);
+static void apply_ramp(motor_handle_t *motor)
+{
+    int32_t velocity = motor->ramp.velocity;
+
+    // The direction pin follows the sign, at standstill the motor takes the target direction
+    motor_direction_t direction = motor->ramp.braking ? MOTOR_DIRECTION_BRAKE
+                                  : velocity > 0      ? MOTOR_DIRECTION_FORWARD
+                                  : velocity < 0      ? MOTOR_DIRECTION_BACKWARD
+                                                      : motor->target_direction;
+    if (direction != motor->current_direction)
+    {
+        set_dir(motor, direction);
+        motor->current_direction = direction;
     }
 
+    motor->current_pwm = (float)abs(velocity) / MOTOR_RAMP_ONE;
+    set_pwm(motor, motor->current_pwm);
+}
+
+esp_err_t motor_driver_update(motor_handle_t *motor)
+{
+    if (motor == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Microsecond time base: the ramp steps follow ramp_intervall_ms, not the 10 ms tick
+    int64_t now = esp_timer_get_time();
+    int64_t interval_us = (int64_t)motor->config.ramp_intervall_ms * 1000;
+    int64_t elapsed_us = now - motor->last_update_us;
+
+    if (elapsed_us < interval_us)
+    {
+        return ESP_OK;
+    }
+
+    // Calculate every interval that passed since the last call, so a late call does not slow down the
+    // ramp. After an idle phase (no update necessary) the ramp timing restarts with the first step.
+    uint32_t steps = 1;
+    if (elapsed_us > interval_us * MOTOR_RAMP_MAX_CATCH_UP)
+    {
+        motor->last_update_us = now;
+    }
+    else
+    {
+        motor->last_update_us += interval_us;
+        while (now - motor->last_update_us >= interval_us)
+        {
+            motor->last_update_us += interval_us;
+            steps++;
+        }
+    }
+
+    for (uint32_t i = 0; i < steps; i++)
+    {
+        ramp_step(&motor->ramp);
+    }
+    apply_ramp(motor);
+
+    TRACE_LOG(TAG, "Instance %d: %lu step(s), velocity %ld, accel %ld, target %ld", motor->config.mynr,
+              (unsigned long)steps, (long)motor->ramp.velocity, (long)motor->ramp.accel, (long)motor->ramp.target);
+
     return ESP_OK;
 }
 
@@ -305,11 +729,17 @@ void motor_driver_print_all_parameters(motor_handle_t *motor)
     LOGI(TAG, "  Target PWM: %.2f", motor->target_pwm);
     LOGI(TAG, "  Current Direction: %d", motor->current_direction);
     LOGI(TAG, "  Target Direction: %d", motor->target_direction);
-    LOGI(TAG, "  Last Update Time: %ld ms", motor->last_update_ms);
+    LOGI(TAG, "  Last Update Time: %lld us", (long long)motor->last_update_us);
     LOGI(TAG, "  Ramp Rate: %d", motor->config.ramp_rate);
     LOGI(TAG, "  Ramp Interval: %d ms", motor->config.ramp_intervall_ms);
+    LOGI(TAG, "  Ramp Jerk Time: %d ms", motor->config.ramp_jerk_time_ms);
+    LOGI(TAG, "  Brake Time / Hold: %d / %d ms%s", motor->config.brake_time_ms, motor->config.brake_hold_ms,
+         motor->ramp.braking ? " (braking)" : "");
+    LOGI(TAG, "  Ramp Velocity / Accel / Target: %ld / %ld / %ld", (long)motor->ramp.velocity,
+         (long)motor->ramp.accel, (long)motor->ramp.target);
     LOGI(TAG, "  Direction Hysteresis: %d", motor->config.direction_hysteresis);
     LOGI(TAG, "  PWM Duty Limit: %.2f", motor->config.pwm_duty_limit);
+    LOGI(TAG, "  Current / Limit: %lu / %u mA", (unsigned long)motor->current_ma, motor->config.current_limit_ma);
     LOGI(TAG, "  Instance Number: %d", instance_nr);
     LOGI(TAG, "  Instance Counter: %d", instance_cntr);
     LOGI(TAG, "  Mynr: %d", motor->config.mynr);
@@ -328,7 +758,8 @@ esp_err_t motor_driver_deinit(motor_handle_t *motor)
     }
 
     motor_driver_emergency_stop(motor);
-    
+    release_pwm(motor);
+
     instance_cntr--;
 
     free(motor);
@@ -0,0 +1,76 @@
+/**
+ * @file wheel-encoder.h
+ * @brief Quadrature wheel encoder on the ESP32 pulse counter (PCNT)
+ *
+ * One PCNT unit per encoder with two channels, each counting the edges of one signal with the other as
+ * direction level, so every edge of A and B counts (4 counts per encoder line). The 16 bit hardware
+ * counter is extended in the driver (accum_count with watch points at the limits), the count does not
+ * wrap while driving. A glitch filter drops pulses shorter than glitch_filter_ns.
+ *
+ * Reference:
+ *  - https://docs.espressif.com/projects/esp-idf/en/stable/esp32/api-reference/peripherals/pcnt.html
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "driver/pulse_cnt.h"
+
+// Hardware counter range, the driver accumulates beyond it
+#define WHEEL_ENCODER_PCNT_LIMIT 32767
+
+typedef struct
+{
+    int a_gpio_num;            // Encoder signal A
+    int b_gpio_num;            // Encoder signal B
+    uint32_t glitch_filter_ns; // Shorter pulses are ignored, 0 disables the filter (max. ~1000 ns)
+    bool reverse;              // Count down when the wheel turns forward (mirrored mounting)
+} wheel_encoder_config_t;
+
+typedef struct
+{
+    pcnt_unit_handle_t unit;
+    pcnt_channel_handle_t channel_a;
+    pcnt_channel_handle_t channel_b;
+    wheel_encoder_config_t config;
+    int last_count; // Count of the last wheel_encoder_get_delta()
+    bool initialized;
+} wheel_encoder_handle_t;
+
+/**
+ * @brief Set up a PCNT unit for the encoder and start counting from 0
+ *
+ * @param config Pointer to the encoder configuration
+ * @return wheel_encoder_handle_t* Pointer to the encoder handle, or NULL on failure
+ */
+wheel_encoder_handle_t *wheel_encoder_init(const wheel_encoder_config_t *config);
+
+/**
+ * @brief Read the accumulated count, positive = forward
+ *
+ * @param encoder Pointer to the encoder handle
+ * @param count Receives the count since init
+ * @return esp_err_t ESP_OK on success, ESP_ERR_INVALID_ARG if encoder or count is NULL
+ */
+esp_err_t wheel_encoder_get_count(wheel_encoder_handle_t *encoder, int32_t *count);
+
+/**
+ * @brief Read the counts since the previous call (since init for the first call)
+ *
+ * Called once per control period, the delta is the wheel speed in counts per period.
+ *
+ * @param encoder Pointer to the encoder handle
+ * @param delta Receives the count difference, positive = forward
+ * @return esp_err_t ESP_OK on success, ESP_ERR_INVALID_ARG if encoder or delta is NULL
+ */
+esp_err_t wheel_encoder_get_delta(wheel_encoder_handle_t *encoder, int32_t *delta);
+
+/**
+ * @brief Stop counting and free the PCNT unit
+ *
+ * @param encoder Pointer to the encoder handle
+ * @return esp_err_t ESP_OK on success, ESP_ERR_INVALID_ARG if encoder is NULL or not initialized
+ */
+esp_err_t wheel_encoder_deinit(wheel_encoder_handle_t *encoder);
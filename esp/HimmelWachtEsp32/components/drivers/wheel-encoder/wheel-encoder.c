@@ -0,0 +1,226 @@
+#include "wheel-encoder.h"
+#include "esp_log.h"
+#include <stdlib.h>
+#include <string.h>
+#include "log_wrapper.h"
+
+#define TAG "WHEEL_ENCODER"
+
+wheel_encoder_handle_t *wheel_encoder_init(const wheel_encoder_config_t *config);
+static esp_err_t init_unit(wheel_encoder_handle_t *encoder);
+static void release_unit(wheel_encoder_handle_t *encoder);
+esp_err_t wheel_encoder_get_count(wheel_encoder_handle_t *encoder, int32_t *count);
+esp_err_t wheel_encoder_get_delta(wheel_encoder_handle_t *encoder, int32_t *delta);
+esp_err_t wheel_encoder_deinit(wheel_encoder_handle_t *encoder);
+
+wheel_encoder_handle_t *wheel_encoder_init(const wheel_encoder_config_t *config)
+{
+    // Input validation
+    if (config == NULL)
+    {
+        ESP_LOGE(TAG, "Encoder config is NULL");
+        return NULL;
+    }
+
+    if (config->a_gpio_num < 0 || config->b_gpio_num < 0 || config->a_gpio_num == config->b_gpio_num)
+    {
+        ESP_LOGE(TAG, "Encoder GPIOs %d / %d not configured", config->a_gpio_num, config->b_gpio_num);
+        return NULL;
+    }
+
+    // Create handle
+    wheel_encoder_handle_t *encoder = (wheel_encoder_handle_t *)calloc(1, sizeof(wheel_encoder_handle_t));
+    if (!encoder)
+    {
+        ESP_LOGE(TAG, "Failed to allocate memory for encoder handle");
+        return NULL;
+    }
+    memcpy(&encoder->config, config, sizeof(wheel_encoder_config_t));
+
+    esp_err_t ret = init_unit(encoder);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to initialize PCNT unit: %s", esp_err_to_name(ret));
+        release_unit(encoder);
+        free(encoder);
+        return NULL;
+    }
+
+    encoder->last_count = 0;
+    encoder->initialized = true;
+    LOGI(TAG, "Encoder on GPIO %d / %d initialized", config->a_gpio_num, config->b_gpio_num);
+
+    return encoder;
+}
+
+static esp_err_t init_unit(wheel_encoder_handle_t *encoder)
+{
+    const wheel_encoder_config_t *config = &encoder->config;
+
+    // Count beyond the 16 bit range: the driver adds the limit whenever a limit watch point is reached
+    pcnt_unit_config_t unit_config = {
+        .low_limit = -WHEEL_ENCODER_PCNT_LIMIT,
+        .high_limit = WHEEL_ENCODER_PCNT_LIMIT,
+        .flags.accum_count = true,
+    };
+    esp_err_t ret = pcnt_new_unit(&unit_config, &encoder->unit);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    if (config->glitch_filter_ns > 0)
+    {
+        pcnt_glitch_filter_config_t filter_config = {
+            .max_glitch_ns = config->glitch_filter_ns,
+        };
+        ret = pcnt_unit_set_glitch_filter(encoder->unit, &filter_config);
+        if (ret != ESP_OK)
+        {
+            return ret;
+        }
+    }
+
+    // Swapping the signals reverses the counting direction
+    int a_gpio = config->reverse ? config->b_gpio_num : config->a_gpio_num;
+    int b_gpio = config->reverse ? config->a_gpio_num : config->b_gpio_num;
+
+    // Both edges of both signals count, each channel takes the other signal as direction
+    pcnt_chan_config_t channel_a_config = {
+        .edge_gpio_num = a_gpio,
+        .level_gpio_num = b_gpio,
+    };
+    ret = pcnt_new_channel(encoder->unit, &channel_a_config, &encoder->channel_a);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    pcnt_chan_config_t channel_b_config = {
+        .edge_gpio_num = b_gpio,
+        .level_gpio_num = a_gpio,
+    };
+    ret = pcnt_new_channel(encoder->unit, &channel_b_config, &encoder->channel_b);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    // A leading B counts up
+    ret = pcnt_channel_set_edge_action(encoder->channel_a, PCNT_CHANNEL_EDGE_ACTION_DECREASE, PCNT_CHANNEL_EDGE_ACTION_INCREASE);
+    if (ret == ESP_OK)
+    {
+        ret = pcnt_channel_set_level_action(encoder->channel_a, PCNT_CHANNEL_LEVEL_ACTION_KEEP, PCNT_CHANNEL_LEVEL_ACTION_INVERSE);
+    }
+    if (ret == ESP_OK)
+    {
+        ret = pcnt_channel_set_edge_action(encoder->channel_b, PCNT_CHANNEL_EDGE_ACTION_INCREASE, PCNT_CHANNEL_EDGE_ACTION_DECREASE);
+    }
+    if (ret == ESP_OK)
+    {
+        ret = pcnt_channel_set_level_action(encoder->channel_b, PCNT_CHANNEL_LEVEL_ACTION_KEEP, PCNT_CHANNEL_LEVEL_ACTION_INVERSE);
+    }
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    // Watch points at the limits, needed for the accumulation
+    ret = pcnt_unit_add_watch_point(encoder->unit, -WHEEL_ENCODER_PCNT_LIMIT);
+    if (ret == ESP_OK)
+    {
+        ret = pcnt_unit_add_watch_point(encoder->unit, WHEEL_ENCODER_PCNT_LIMIT);
+    }
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    ret = pcnt_unit_enable(encoder->unit);
+    if (ret == ESP_OK)
+    {
+        ret = pcnt_unit_clear_count(encoder->unit);
+    }
+    if (ret == ESP_OK)
+    {
+        ret = pcnt_unit_start(encoder->unit);
+    }
+
+    return ret;
+}
+
+static void release_unit(wheel_encoder_handle_t *encoder)
+{
+    // Also used for a partially initialized unit, every step checks what exists
+    if (encoder->unit != NULL)
+    {
+        pcnt_unit_stop(encoder->unit);
+        pcnt_unit_disable(encoder->unit);
+    }
+    if (encoder->channel_a != NULL)
+    {
+        pcnt_del_channel(encoder->channel_a);
+        encoder->channel_a = NULL;
+    }
+    if (encoder->channel_b != NULL)
+    {
+        pcnt_del_channel(encoder->channel_b);
+        encoder->channel_b = NULL;
+    }
+    if (encoder->unit != NULL)
+    {
+        pcnt_del_unit(encoder->unit);
+        encoder->unit = NULL;
+    }
+}
+
+esp_err_t wheel_encoder_get_count(wheel_encoder_handle_t *encoder, int32_t *count)
+{
+    if (encoder == NULL || count == NULL || !encoder->initialized)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    int value = 0;
+    esp_err_t ret = pcnt_unit_get_count(encoder->unit, &value);
+    *count = value;
+
+    return ret;
+}
+
+esp_err_t wheel_encoder_get_delta(wheel_encoder_handle_t *encoder, int32_t *delta)
+{
+    if (encoder == NULL || delta == NULL || !encoder->initialized)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    int value = 0;
+    esp_err_t ret = pcnt_unit_get_count(encoder->unit, &value);
+    if (ret != ESP_OK)
+    {
+        *delta = 0;
+        return ret;
+    }
+
+    // Unsigned difference, stays correct when the accumulated count wraps after days of driving
+    *delta = (int32_t)((uint32_t)value - (uint32_t)encoder->last_count);
+    encoder->last_count = value;
+
+    return ESP_OK;
+}
+
+esp_err_t wheel_encoder_deinit(wheel_encoder_handle_t *encoder)
+{
+    if (encoder == NULL || !encoder->initialized)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    release_unit(encoder);
+    free(encoder);
+    encoder = NULL;
+
+    LOGI(TAG, "Encoder deinitialized");
+    return ESP_OK;
+}
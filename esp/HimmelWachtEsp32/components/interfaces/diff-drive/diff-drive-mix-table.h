@@ -0,0 +1,113 @@
+/**
+ * @file diff-drive-mix-table.h
+ * @brief Joystick mixing table of the differential drive
+ *
+ * Generated by tools/gen_mix_table.py, do not edit. Rows: vertical nodes, columns: horizontal nodes,
+ * values: {left, right} duty in 1/DIFF_DRIVE_MIX_ONE percent, positive = forward.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#define DIFF_DRIVE_MIX_STEPS 20
+#define DIFF_DRIVE_MIX_FRAC_BITS 15
+#define DIFF_DRIVE_MIX_ONE 256
+
+// Region borders as grid positions, their nodes are duplicated in the table
+#define DIFF_DRIVE_MIX_DEADBAND (4u << DIFF_DRIVE_MIX_FRAC_BITS)
+#define DIFF_DRIVE_MIX_SHARP_TURN (14u << DIFF_DRIVE_MIX_FRAC_BITS)
+
+#define DIFF_DRIVE_MIX_H_NODES 23
+#define DIFF_DRIVE_MIX_V_NODES 22
+
+static const int16_t diff_drive_mix_table[DIFF_DRIVE_MIX_V_NODES][DIFF_DRIVE_MIX_H_NODES][2] = {
+    // v = 0.00 (rotate)
+    {{0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}, {5120, -5120}, {6400, -6400}, {7680, -7680},
+     {8960, -8960}, {10240, -10240}, {11520, -11520}, {12800, -12800}, {14080, -14080}, {15360, -15360}, {16640, -16640}, {17920, -17920},
+     {17920, -17920}, {19200, -19200}, {20480, -20480}, {21760, -21760}, {23040, -23040}, {24320, -24320}, {25600, -25600}},
+    // v = 0.05 (rotate)
+    {{0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}, {5120, -5120}, {6400, -6400}, {7680, -7680},
+     {8960, -8960}, {10240, -10240}, {11520, -11520}, {12800, -12800}, {14080, -14080}, {15360, -15360}, {16640, -16640}, {17920, -17920},
+     {17920, -17920}, {19200, -19200}, {20480, -20480}, {21760, -21760}, {23040, -23040}, {24320, -24320}, {25600, -25600}},
+    // v = 0.10 (rotate)
+    {{0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}, {5120, -5120}, {6400, -6400}, {7680, -7680},
+     {8960, -8960}, {10240, -10240}, {11520, -11520}, {12800, -12800}, {14080, -14080}, {15360, -15360}, {16640, -16640}, {17920, -17920},
+     {17920, -17920}, {19200, -19200}, {20480, -20480}, {21760, -21760}, {23040, -23040}, {24320, -24320}, {25600, -25600}},
+    // v = 0.15 (rotate)
+    {{0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}, {5120, -5120}, {6400, -6400}, {7680, -7680},
+     {8960, -8960}, {10240, -10240}, {11520, -11520}, {12800, -12800}, {14080, -14080}, {15360, -15360}, {16640, -16640}, {17920, -17920},
+     {17920, -17920}, {19200, -19200}, {20480, -20480}, {21760, -21760}, {23040, -23040}, {24320, -24320}, {25600, -25600}},
+    // v = 0.20 (rotate)
+    {{0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}, {5120, -5120}, {6400, -6400}, {7680, -7680},
+     {8960, -8960}, {10240, -10240}, {11520, -11520}, {12800, -12800}, {14080, -14080}, {15360, -15360}, {16640, -16640}, {17920, -17920},
+     {17920, -17920}, {19200, -19200}, {20480, -20480}, {21760, -21760}, {23040, -23040}, {24320, -24320}, {25600, -25600}},
+    // v = 0.20
+    {{5120, 5120}, {5120, 5120}, {5120, 5120}, {5120, 5120}, {5120, 5120}, {5120, 4096}, {5120, 3840}, {5120, 3584},
+     {5120, 3328}, {5120, 3072}, {5120, 2816}, {5120, 2560}, {5120, 2304}, {5120, 2048}, {5120, 1792}, {5120, 1536},
+     {5120, -8960}, {5120, -9600}, {5120, -10240}, {5120, -10880}, {5120, -11520}, {5120, -12160}, {5120, -12800}},
+    // v = 0.25
+    {{6400, 6400}, {6400, 6400}, {6400, 6400}, {6400, 6400}, {6400, 6400}, {6400, 5120}, {6400, 4800}, {6400, 4480},
+     {6400, 4160}, {6400, 3840}, {6400, 3520}, {6400, 3200}, {6400, 2880}, {6400, 2560}, {6400, 2240}, {6400, 1920},
+     {6400, -8960}, {6400, -9600}, {6400, -10240}, {6400, -10880}, {6400, -11520}, {6400, -12160}, {6400, -12800}},
+    // v = 0.30
+    {{7680, 7680}, {7680, 7680}, {7680, 7680}, {7680, 7680}, {7680, 7680}, {7680, 6144}, {7680, 5760}, {7680, 5376},
+     {7680, 4992}, {7680, 4608}, {7680, 4224}, {7680, 3840}, {7680, 3456}, {7680, 3072}, {7680, 2688}, {7680, 2304},
+     {7680, -8960}, {7680, -9600}, {7680, -10240}, {7680, -10880}, {7680, -11520}, {7680, -12160}, {7680, -12800}},
+    // v = 0.35
+    {{8960, 8960}, {8960, 8960}, {8960, 8960}, {8960, 8960}, {8960, 8960}, {8960, 7168}, {8960, 6720}, {8960, 6272},
+     {8960, 5824}, {8960, 5376}, {8960, 4928}, {8960, 4480}, {8960, 4032}, {8960, 3584}, {8960, 3136}, {8960, 2688},
+     {8960, -8960}, {8960, -9600}, {8960, -10240}, {8960, -10880}, {8960, -11520}, {8960, -12160}, {8960, -12800}},
+    // v = 0.40
+    {{10240, 10240}, {10240, 10240}, {10240, 10240}, {10240, 10240}, {10240, 10240}, {10240, 8192}, {10240, 7680}, {10240, 7168},
+     {10240, 6656}, {10240, 6144}, {10240, 5632}, {10240, 5120}, {10240, 4608}, {10240, 4096}, {10240, 3584}, {10240, 3072},
+     {10240, -8960}, {10240, -9600}, {10240, -10240}, {10240, -10880}, {10240, -11520}, {10240, -12160}, {10240, -12800}},
+    // v = 0.45
+    {{11520, 11520}, {11520, 11520}, {11520, 11520}, {11520, 11520}, {11520, 11520}, {11520, 9216}, {11520, 8640}, {11520, 8064},
+     {11520, 7488}, {11520, 6912}, {11520, 6336}, {11520, 5760}, {11520, 5184}, {11520, 4608}, {11520, 4032}, {11520, 3456},
+     {11520, -8960}, {11520, -9600}, {11520, -10240}, {11520, -10880}, {11520, -11520}, {11520, -12160}, {11520, -12800}},
+    // v = 0.50
+    {{12800, 12800}, {12800, 12800}, {12800, 12800}, {12800, 12800}, {12800, 12800}, {12800, 10240}, {12800, 9600}, {12800, 8960},
+     {12800, 8320}, {12800, 7680}, {12800, 7040}, {12800, 6400}, {12800, 5760}, {12800, 5120}, {12800, 4480}, {12800, 3840},
+     {12800, -8960}, {12800, -9600}, {12800, -10240}, {12800, -10880}, {12800, -11520}, {12800, -12160}, {12800, -12800}},
+    // v = 0.55
+    {{14080, 14080}, {14080, 14080}, {14080, 14080}, {14080, 14080}, {14080, 14080}, {14080, 11264}, {14080, 10560}, {14080, 9856},
+     {14080, 9152}, {14080, 8448}, {14080, 7744}, {14080, 7040}, {14080, 6336}, {14080, 5632}, {14080, 4928}, {14080, 4224},
+     {14080, -8960}, {14080, -9600}, {14080, -10240}, {14080, -10880}, {14080, -11520}, {14080, -12160}, {14080, -12800}},
+    // v = 0.60
+    {{15360, 15360}, {15360, 15360}, {15360, 15360}, {15360, 15360}, {15360, 15360}, {15360, 12288}, {15360, 11520}, {15360, 10752},
+     {15360, 9984}, {15360, 9216}, {15360, 8448}, {15360, 7680}, {15360, 6912}, {15360, 6144}, {15360, 5376}, {15360, 4608},
+     {15360, -8960}, {15360, -9600}, {15360, -10240}, {15360, -10880}, {15360, -11520}, {15360, -12160}, {15360, -12800}},
+    // v = 0.65
+    {{16640, 16640}, {16640, 16640}, {16640, 16640}, {16640, 16640}, {16640, 16640}, {16640, 13312}, {16640, 12480}, {16640, 11648},
+     {16640, 10816}, {16640, 9984}, {16640, 9152}, {16640, 8320}, {16640, 7488}, {16640, 6656}, {16640, 5824}, {16640, 4992},
+     {16640, -8960}, {16640, -9600}, {16640, -10240}, {16640, -10880}, {16640, -11520}, {16640, -12160}, {16640, -12800}},
+    // v = 0.70
+    {{17920, 17920}, {17920, 17920}, {17920, 17920}, {17920, 17920}, {17920, 17920}, {17920, 14336}, {17920, 13440}, {17920, 12544},
+     {17920, 11648}, {17920, 10752}, {17920, 9856}, {17920, 8960}, {17920, 8064}, {17920, 7168}, {17920, 6272}, {17920, 5376},
+     {17920, -8960}, {17920, -9600}, {17920, -10240}, {17920, -10880}, {17920, -11520}, {17920, -12160}, {17920, -12800}},
+    // v = 0.75
+    {{19200, 19200}, {19200, 19200}, {19200, 19200}, {19200, 19200}, {19200, 19200}, {19200, 15360}, {19200, 14400}, {19200, 13440},
+     {19200, 12480}, {19200, 11520}, {19200, 10560}, {19200, 9600}, {19200, 8640}, {19200, 7680}, {19200, 6720}, {19200, 5760},
+     {19200, -8960}, {19200, -9600}, {19200, -10240}, {19200, -10880}, {19200, -11520}, {19200, -12160}, {19200, -12800}},
+    // v = 0.80
+    {{20480, 20480}, {20480, 20480}, {20480, 20480}, {20480, 20480}, {20480, 20480}, {20480, 16384}, {20480, 15360}, {20480, 14336},
+     {20480, 13312}, {20480, 12288}, {20480, 11264}, {20480, 10240}, {20480, 9216}, {20480, 8192}, {20480, 7168}, {20480, 6144},
+     {20480, -8960}, {20480, -9600}, {20480, -10240}, {20480, -10880}, {20480, -11520}, {20480, -12160}, {20480, -12800}},
+    // v = 0.85
+    {{21760, 21760}, {21760, 21760}, {21760, 21760}, {21760, 21760}, {21760, 21760}, {21760, 17408}, {21760, 16320}, {21760, 15232},
+     {21760, 14144}, {21760, 13056}, {21760, 11968}, {21760, 10880}, {21760, 9792}, {21760, 8704}, {21760, 7616}, {21760, 6528},
+     {21760, -8960}, {21760, -9600}, {21760, -10240}, {21760, -10880}, {21760, -11520}, {21760, -12160}, {21760, -12800}},
+    // v = 0.90
+    {{23040, 23040}, {23040, 23040}, {23040, 23040}, {23040, 23040}, {23040, 23040}, {23040, 18432}, {23040, 17280}, {23040, 16128},
+     {23040, 14976}, {23040, 13824}, {23040, 12672}, {23040, 11520}, {23040, 10368}, {23040, 9216}, {23040, 8064}, {23040, 6912},
+     {23040, -8960}, {23040, -9600}, {23040, -10240}, {23040, -10880}, {23040, -11520}, {23040, -12160}, {23040, -12800}},
+    // v = 0.95
+    {{24320, 24320}, {24320, 24320}, {24320, 24320}, {24320, 24320}, {24320, 24320}, {24320, 19456}, {24320, 18240}, {24320, 17024},
+     {24320, 15808}, {24320, 14592}, {24320, 13376}, {24320, 12160}, {24320, 10944}, {24320, 9728}, {24320, 8512}, {24320, 7296},
+     {24320, -8960}, {24320, -9600}, {24320, -10240}, {24320, -10880}, {24320, -11520}, {24320, -12160}, {24320, -12800}},
+    // v = 1.00
+    {{25600, 25600}, {25600, 25600}, {25600, 25600}, {25600, 25600}, {25600, 25600}, {25600, 20480}, {25600, 19200}, {25600, 17920},
+     {25600, 16640}, {25600, 15360}, {25600, 14080}, {25600, 12800}, {25600, 11520}, {25600, 10240}, {25600, 8960}, {25600, 7680},
+     {25600, -8960}, {25600, -9600}, {25600, -10240}, {25600, -10880}, {25600, -11520}, {25600, -12160}, {25600, -12800}},
+};
@@ -0,0 +1,93 @@
+#include "diff-drive-mix.h"
+#include "diff-drive-mix-table.h"
+#include <stdbool.h>
+#include <stdlib.h>
+
+#define INPUT_SCALE_BITS 24
+
+_Static_assert(DIFF_DRIVE_MIX_ONE == DIFF_DRIVE_MIX_OUTPUT_ONE, "diff-drive-mix-table.h does not match diff-drive-mix.h");
+
+esp_err_t diff_drive_mixer_init(diff_drive_mixer_t *mixer, int16_t max_input)
+{
+    if (mixer == NULL || max_input <= 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    mixer->max_input = (uint16_t)max_input;
+    // Rounded up, so an input exactly on a region border (e.g. 20 of 100) lands on the border and not below
+    mixer->input_scale = (((uint32_t)DIFF_DRIVE_MIX_STEPS << INPUT_SCALE_BITS) + (uint32_t)max_input - 1) / (uint32_t)max_input;
+
+    return ESP_OK;
+}
+
+// Grid position of |input| with DIFF_DRIVE_MIX_FRAC_BITS fractional bits, full deflection = DIFF_DRIVE_MIX_STEPS
+static inline uint32_t grid_position(const diff_drive_mixer_t *mixer, int16_t input)
+{
+    uint32_t magnitude = (uint32_t)abs(input);
+    if (magnitude >= mixer->max_input)
+    {
+        return (uint32_t)DIFF_DRIVE_MIX_STEPS << DIFF_DRIVE_MIX_FRAC_BITS;
+    }
+
+    // magnitude * input_scale stays below DIFF_DRIVE_MIX_STEPS << INPUT_SCALE_BITS for magnitude < max_input
+    return (magnitude * mixer->input_scale) >> (INPUT_SCALE_BITS - DIFF_DRIVE_MIX_FRAC_BITS);
+}
+
+static inline int32_t lerp(int32_t a, int32_t b, uint32_t frac)
+{
+    return a + (((b - a) * (int32_t)frac + (1 << (DIFF_DRIVE_MIX_FRAC_BITS - 1))) >> DIFF_DRIVE_MIX_FRAC_BITS);
+}
+
+diff_drive_mix_t diff_drive_mix(const diff_drive_mixer_t *mixer, int16_t x, int16_t y)
+{
+    uint32_t h = grid_position(mixer, x);
+    uint32_t v = grid_position(mixer, y);
+
+    // Cell of the position, the last cell also covers full deflection
+    uint32_t h_cell = h >> DIFF_DRIVE_MIX_FRAC_BITS;
+    uint32_t v_cell = v >> DIFF_DRIVE_MIX_FRAC_BITS;
+    if (h_cell == DIFF_DRIVE_MIX_STEPS)
+    {
+        h_cell--;
+    }
+    if (v_cell == DIFF_DRIVE_MIX_STEPS)
+    {
+        v_cell--;
+    }
+    uint32_t h_frac = h - (h_cell << DIFF_DRIVE_MIX_FRAC_BITS);
+    uint32_t v_frac = v - (v_cell << DIFF_DRIVE_MIX_FRAC_BITS);
+
+    // Skip the duplicated border nodes that belong to the other side: the deadband ends at its border,
+    // the sharp turn starts after its border
+    bool rotate = v < DIFF_DRIVE_MIX_DEADBAND;
+    uint32_t h_node = h_cell + (h >= DIFF_DRIVE_MIX_DEADBAND) + (h > DIFF_DRIVE_MIX_SHARP_TURN);
+    uint32_t v_node = v_cell + !rotate;
+
+    const int16_t(*low)[2] = &diff_drive_mix_table[v_node][h_node];
+    const int16_t(*high)[2] = &diff_drive_mix_table[v_node + 1][h_node];
+
+    int32_t left = lerp(lerp(low[0][0], low[1][0], h_frac), lerp(high[0][0], high[1][0], h_frac), v_frac);
+    int32_t right = lerp(lerp(low[0][1], low[1][1], h_frac), lerp(high[0][1], high[1][1], h_frac), v_frac);
+
+    // Other quadrants by symmetry: backwards reverses both wheels (rotation in place does not depend on
+    // the sign of y), turning left swaps them
+    if (y < 0 && !rotate)
+    {
+        left = -left;
+        right = -right;
+    }
+
+    diff_drive_mix_t mix;
+    if (x < 0)
+    {
+        mix.left = (int16_t)right;
+        mix.right = (int16_t)left;
+    }
+    else
+    {
+        mix.left = (int16_t)left;
+        mix.right = (int16_t)right;
+    }
+    return mix;
+}
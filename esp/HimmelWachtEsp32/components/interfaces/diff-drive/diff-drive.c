@@ -4,7 +4,7 @@
 #include <math.h>
 #include <string.h>
 #include "log_wrapper.h"
-#include <IQmathLib.h>
+#include "trace_log.h"
 
 #define TAG "DIFF_DRIVE"
 
@@ -15,18 +15,18 @@ esp_err_t diff_drive_update(diff_drive_handle_t *diff_drive);
 esp_err_t diff_drive_deinit(diff_drive_handle_t *diff_drive);
 void diff_drive_print_all_parameters(diff_drive_handle_t *diff_drive);
 static void diff_drive_task(void *pvParameters);
-static void calculate_speeds(int16_t x, int16_t y, int16_t *max_input,
-                             float *left_limit, float *right_limit,
-                             float *left_speed, float *right_speed,
-                             motor_direction_t *left_dir, motor_direction_t *right_dir);
-
-typedef struct diff_drive_cmd
-{
-    float left_speed;
-    float right_speed;
-    motor_direction_t left_dir;
-    motor_direction_t right_dir;
-} diff_drive_cmd_t;
+static void diff_drive_loop_timer_callback(void *arg);
+static inline void check_deadman(diff_drive_handle_t *drive, int64_t now_us);
+static inline void update_loop_stats(diff_drive_handle_t *drive, int64_t wake_us, int64_t done_us, uint32_t periods);
+static inline void mix_to_cmd(int16_t mix, float duty_scale, float *speed, motor_direction_t *dir);
+static esp_err_t init_speed_control(diff_drive_handle_t *drive, const motor_config_t *left_motor_config, const motor_config_t *right_motor_config);
+static void deinit_speed_control(diff_drive_handle_t *drive);
+static void current_sense_update(diff_drive_handle_t *drive);
+static void set_setpoints(diff_drive_handle_t *drive, int32_t left, int32_t right);
+static void speed_control_update(diff_drive_handle_t *drive, diff_drive_wheel_t *wheel, motor_handle_t *motor, int64_t now_us);
+
+// Full setpoint / output: 100 percent
+#define SPEED_FULL (100 * DIFF_DRIVE_MIX_OUTPUT_ONE)
 
 diff_drive_handle_t *diff_drive_init(const diff_drive_config_t *config, const motor_config_t *left_motor_config, const motor_config_t *right_motor_config)
 {
@@ -44,6 +44,25 @@ diff_drive_handle_t *diff_drive_init(const diff_drive_config_t *config, const mo
         return NULL;
     }
 
+    if (config->loop_rate_hz == 0 || config->loop_rate_hz > DIFF_DRIVE_MAX_LOOP_RATE_HZ)
+    {
+        ESP_LOGE(TAG, "Loop rate %u Hz out of range (1-%d Hz)", config->loop_rate_hz, DIFF_DRIVE_MAX_LOOP_RATE_HZ);
+        return NULL;
+    }
+
+    if (config->max_input <= 0)
+    {
+        ESP_LOGE(TAG, "Max input %d must be positive", config->max_input);
+        return NULL;
+    }
+
+    // At least one count per period at full speed
+    if (config->speed_control.enabled && config->speed_control.max_speed_cps < config->loop_rate_hz)
+    {
+        ESP_LOGE(TAG, "Max speed %ld counts/s below the loop rate", (long)config->speed_control.max_speed_cps);
+        return NULL;
+    }
+
     // Create handle
     diff_drive_handle_t *diff_drive = (diff_drive_handle_t *)calloc(1, sizeof(diff_drive_handle_t));
     if (!diff_drive)
@@ -54,6 +73,10 @@ diff_drive_handle_t *diff_drive_init(const diff_drive_config_t *config, const mo
 
     // Store configuration
     memcpy(&diff_drive->config, config, sizeof(diff_drive_config_t));
+    diff_drive_mixer_init(&diff_drive->mixer, config->max_input);
+    diff_drive->left_duty_scale = left_motor_config->pwm_duty_limit / (100.0f * DIFF_DRIVE_MIX_OUTPUT_ONE);
+    diff_drive->right_duty_scale = right_motor_config->pwm_duty_limit / (100.0f * DIFF_DRIVE_MIX_OUTPUT_ONE);
+    portMUX_INITIALIZE(&diff_drive->stats_lock);
 
     // Initialize motors
     diff_drive->left_motor = motor_driver_init(left_motor_config);
@@ -74,16 +97,44 @@ diff_drive_handle_t *diff_drive_init(const diff_drive_config_t *config, const mo
         return NULL;
     }
 
-    diff_drive->cmd_queue = xQueueCreate(config->cmd_queue_size, sizeof(diff_drive_cmd_t));
-    if (diff_drive->cmd_queue == NULL)
+    // One slot: a new command replaces one that was not applied yet
+    diff_drive->cmd_mailbox = xQueueCreate(1, sizeof(diff_drive_mix_t));
+    if (diff_drive->cmd_mailbox == NULL)
     {
-        ESP_LOGE(TAG, "Failed to create command queue");
+        ESP_LOGE(TAG, "Failed to create command mailbox");
         motor_driver_deinit(diff_drive->left_motor);
         motor_driver_deinit(diff_drive->right_motor);
         free(diff_drive);
         return NULL;
     }
 
+    if (config->speed_control.enabled && init_speed_control(diff_drive, left_motor_config, right_motor_config) != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to initialize the wheel encoders");
+        deinit_speed_control(diff_drive);
+        motor_driver_deinit(diff_drive->left_motor);
+        motor_driver_deinit(diff_drive->right_motor);
+        vQueueDelete(diff_drive->cmd_mailbox);
+        free(diff_drive);
+        return NULL;
+    }
+
+    if (config->current_sense.enabled)
+    {
+        diff_drive->current_sense = motor_current_init(&config->current_sense.sensor);
+        if (diff_drive->current_sense == NULL)
+        {
+            ESP_LOGE(TAG, "Failed to initialize the current sensing");
+            deinit_speed_control(diff_drive);
+            motor_driver_deinit(diff_drive->left_motor);
+            motor_driver_deinit(diff_drive->right_motor);
+            vQueueDelete(diff_drive->cmd_mailbox);
+            free(diff_drive);
+            return NULL;
+        }
+    }
+
+    diff_drive->last_cmd_us = esp_timer_get_time();
     diff_drive->initialized = true;
 
     ESP_LOGI(TAG, "Differential drive initialized successfully");
@@ -92,9 +143,14 @@ diff_drive_handle_t *diff_drive_init(const diff_drive_config_t *config, const mo
     if (ret != ESP_OK)
     {
         ESP_LOGE(TAG, "Failed to create differential drive task");
+        if (diff_drive->current_sense != NULL)
+        {
+            motor_current_deinit(diff_drive->current_sense);
+        }
+        deinit_speed_control(diff_drive);
         motor_driver_deinit(diff_drive->left_motor);
         motor_driver_deinit(diff_drive->right_motor);
-        vQueueDelete(diff_drive->cmd_queue);
+        vQueueDelete(diff_drive->cmd_mailbox);
         free(diff_drive);
         return NULL;
     }
@@ -102,6 +158,43 @@ diff_drive_handle_t *diff_drive_init(const diff_drive_config_t *config, const mo
     return diff_drive;
 }
 
+static esp_err_t init_speed_control(diff_drive_handle_t *drive, const motor_config_t *left_motor_config, const motor_config_t *right_motor_config)
+{
+    const diff_drive_speed_config_t *config = &drive->config.speed_control;
+
+    drive->left_wheel.encoder = wheel_encoder_init(&config->left_encoder);
+    drive->right_wheel.encoder = wheel_encoder_init(&config->right_encoder);
+    if (drive->left_wheel.encoder == NULL || drive->right_wheel.encoder == NULL)
+    {
+        return ESP_FAIL;
+    }
+    drive->left_wheel.sample_us = esp_timer_get_time();
+    drive->right_wheel.sample_us = drive->left_wheel.sample_us;
+
+    // Integral gain per period
+    drive->ki_per_period = (int32_t)(((int32_t)config->ki << (16 - DIFF_DRIVE_GAIN_SHIFT)) / drive->config.loop_rate_hz);
+
+    // Output in percent of pwm_duty_limit to the duty cycle of the ramp
+    drive->left_wheel.output_scale = (int32_t)(left_motor_config->pwm_duty_limit * MOTOR_RAMP_ONE / SPEED_FULL + 0.5f);
+    drive->right_wheel.output_scale = (int32_t)(right_motor_config->pwm_duty_limit * MOTOR_RAMP_ONE / SPEED_FULL + 0.5f);
+
+    return ESP_OK;
+}
+
+static void deinit_speed_control(diff_drive_handle_t *drive)
+{
+    if (drive->left_wheel.encoder != NULL)
+    {
+        wheel_encoder_deinit(drive->left_wheel.encoder);
+        drive->left_wheel.encoder = NULL;
+    }
+    if (drive->right_wheel.encoder != NULL)
+    {
+        wheel_encoder_deinit(drive->right_wheel.encoder);
+        drive->right_wheel.encoder = NULL;
+    }
+}
+
 esp_err_t create_task(diff_drive_handle_t *handle, uint8_t priority)
 {
     if (handle == NULL)
@@ -130,6 +223,32 @@ esp_err_t create_task(diff_drive_handle_t *handle, uint8_t priority)
         return ESP_FAIL;
     }
 
+    // The timer only notifies, the control work runs in the task with its priority and stack
+    const esp_timer_create_args_t timer_args = {
+        .callback = diff_drive_loop_timer_callback,
+        .arg = handle,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "diff_drive_loop",
+        .skip_unhandled_events = true,
+    };
+    esp_err_t err = esp_timer_create(&timer_args, &handle->loop_timer);
+    if (err == ESP_OK)
+    {
+        err = esp_timer_start_periodic(handle->loop_timer, 1000000ULL / handle->config.loop_rate_hz);
+    }
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to start the loop timer: %s", esp_err_to_name(err));
+        if (handle->loop_timer != NULL)
+        {
+            esp_timer_delete(handle->loop_timer);
+            handle->loop_timer = NULL;
+        }
+        vTaskDelete(handle->task_handle);
+        handle->task_handle = NULL;
+        return err;
+    }
+
     handle->is_running = true;
     ESP_LOGI(TAG, "Differential drive task started");
 
@@ -150,23 +269,13 @@ esp_err_t diff_drive_send_cmd(diff_drive_handle_t *diff_drive, input_matrix_t *m
         return ESP_ERR_INVALID_STATE;
     }
 
-    // Calculate motor speeds and directions based on x, y inputs
-    diff_drive_cmd_t cmd;
-
-    calculate_speeds(matrix->x, matrix->y, &diff_drive->config.max_input, &diff_drive->left_motor->config.pwm_duty_limit, &diff_drive->right_motor->config.pwm_duty_limit, &cmd.left_speed, &cmd.right_speed, &cmd.left_dir, &cmd.right_dir);
+    // Wheel setpoints from the x, y inputs, duties in open loop and speeds in closed loop
+    diff_drive_mix_t mix = diff_drive_mix(&diff_drive->mixer, (int16_t)matrix->x, (int16_t)matrix->y);
 
-    LOGI(TAG, "Sending command: left_speed=%.2f, right_speed=%.2f, left_dir=%d, right_dir=%d",
-         cmd.left_speed, cmd.right_speed, cmd.left_dir, cmd.right_dir);
-
-    // Send command to queue
-    if (xQueueSend(diff_drive->cmd_queue, &cmd, diff_drive->config.queue_timout_ms) != pdTRUE)
-    {
-        ESP_LOGW(TAG, "Failed to send command to queue, queue might be full");
-        return ESP_ERR_TIMEOUT;
-    }
+    // Latest wins, a command the task has not taken yet is stale
+    xQueueOverwrite(diff_drive->cmd_mailbox, &mix);
 
-    LOGI(TAG, "Command sent to queue: left_speed=%.2f, right_speed=%.2f, left_dir=%d, right_dir=%d",
-         cmd.left_speed, cmd.right_speed, cmd.left_dir, cmd.right_dir);
+    TRACE_LOG(TAG, "Command sent to mailbox: left=%d, right=%d", mix.left, mix.right);
 
     return ESP_OK;
 }
@@ -185,246 +294,300 @@ esp_err_t diff_drive_update(diff_drive_handle_t *diff_drive)
     // Update motor drivers
     if (motor_driver_is_update_necessary(diff_drive->left_motor))
     {
-        LOGI(TAG, "Left update detected");
+        TRACE_LOG(TAG, "Left update detected");
         left = motor_driver_update(diff_drive->left_motor);
     }
 
     if (motor_driver_is_update_necessary(diff_drive->right_motor))
     {
-        LOGI(TAG, "Right update detected");
+        TRACE_LOG(TAG, "Right update detected");
         right = motor_driver_update(diff_drive->right_motor);
     }
 
     return left == ESP_OK && right == ESP_OK ? ESP_OK : ESP_FAIL;
 }
 
-static void diff_drive_task(void *pvParameters)
+static void diff_drive_loop_timer_callback(void *arg)
 {
-    diff_drive_handle_t *drive = (diff_drive_handle_t *)pvParameters;
-    diff_drive_cmd_t cmd;
+    diff_drive_handle_t *drive = (diff_drive_handle_t *)arg;
+    xTaskNotifyGive(drive->task_handle);
+}
 
-    // Main task loop
-    while (1)
+static inline void update_loop_stats(diff_drive_handle_t *drive, int64_t wake_us, int64_t done_us, uint32_t periods)
+{
+    const int64_t period_us = 1000000 / drive->config.loop_rate_hz;
+
+    portENTER_CRITICAL(&drive->stats_lock);
+    diff_drive_loop_stats_t *stats = &drive->loop_stats;
+
+    // The iteration ran past its period, or the task woke up late for more than one period
+    uint32_t exec_us = (uint32_t)(done_us - wake_us);
+    if (exec_us > period_us || periods > 1)
     {
-        // Process commands from queue pdMS_TO_TICKS(drive->config.queue_timout_ms)
-        if (xQueueReceive(drive->cmd_queue, &cmd, drive->config.queue_timout_ms) == pdTRUE)
-        {
-            // Set motor speeds and directions
-            motor_driver_set_speed(drive->left_motor, cmd.left_speed, cmd.left_dir);
-            motor_driver_set_speed(drive->right_motor, cmd.right_speed, cmd.right_dir);
+        stats->overruns++;
+    }
 
-            // Log command
-            ESP_LOGI(TAG, "Command received: left_speed=%.2f, right_speed=%.2f, left_dir=%d, right_dir=%d",
-                     cmd.left_speed, cmd.right_speed, cmd.left_dir, cmd.right_dir);
+    if (drive->last_wake_us != 0)
+    {
+        int64_t jitter_us = (wake_us - drive->last_wake_us) - period_us * (periods > 0 ? periods : 1);
+        if (jitter_us < 0)
+        {
+            jitter_us = -jitter_us;
         }
-
-        // Update motors
-        esp_err_t ret = diff_drive_update(drive);
-        if (ret != ESP_OK)
+        if (jitter_us > stats->max_jitter_us)
         {
-            ESP_LOGE(TAG, "Failed to update motors: %s", esp_err_to_name(ret));
+            stats->max_jitter_us = (uint32_t)jitter_us;
         }
-        vTaskDelay(pdMS_TO_TICKS(drive->config.task_delay_ms)); // Adjust delay as needed
+        drive->jitter_sum_us += (uint64_t)jitter_us;
+        stats->iterations++;
     }
-}
+    drive->last_wake_us = wake_us;
 
-esp_err_t diff_drive_deinit(diff_drive_handle_t *diff_drive)
-{
-    // Input validation
-    if (diff_drive == NULL || !diff_drive->initialized)
+    if (exec_us > stats->max_exec_us)
     {
-        return ESP_ERR_INVALID_ARG;
+        stats->max_exec_us = exec_us;
     }
+    portEXIT_CRITICAL(&drive->stats_lock);
+}
 
-    // Delete queue
-    if (diff_drive->cmd_queue != NULL)
+esp_err_t diff_drive_get_loop_stats(diff_drive_handle_t *diff_drive, diff_drive_loop_stats_t *stats, bool reset)
+{
+    if (diff_drive == NULL || stats == NULL)
     {
-        vQueueDelete(diff_drive->cmd_queue);
+        return ESP_ERR_INVALID_ARG;
     }
 
-    if (diff_drive->task_handle != NULL)
+    portENTER_CRITICAL(&diff_drive->stats_lock);
+    *stats = diff_drive->loop_stats;
+    stats->mean_jitter_us = stats->iterations > 0 ? (uint32_t)(diff_drive->jitter_sum_us / stats->iterations) : 0;
+    if (reset)
     {
-        vTaskDelete(diff_drive->task_handle);
+        memset(&diff_drive->loop_stats, 0, sizeof(diff_drive->loop_stats));
+        diff_drive->jitter_sum_us = 0;
+        diff_drive->last_wake_us = 0;
     }
+    portEXIT_CRITICAL(&diff_drive->stats_lock);
 
-    // Deinitialize motors
-    motor_driver_deinit(diff_drive->left_motor);
-    motor_driver_deinit(diff_drive->right_motor);
-
-    // Free memory
-    free(diff_drive);
-    diff_drive = NULL;
-
-    ESP_LOGI(TAG, "Differential drive deinitialized");
     return ESP_OK;
 }
 
-static void calculate_speeds(int16_t x, int16_t y, int16_t *max_input,
-                             float *left_limit, float *right_limit,
-                             float *left_speed, float *right_speed,
-                             motor_direction_t *left_dir, motor_direction_t *right_dir)
+static inline void check_deadman(diff_drive_handle_t *drive, int64_t now_us)
 {
-    // Convert constants to IQ format
-    const _iq IQ_ZERO = _IQ(0.0);
-    const _iq IQ_ONE = _IQ(1.0);
-    const _iq IQ_MINUS_ONE = _IQ(-1.0);
-    const _iq IQ_DEADBAND = _IQ(0.20);
-    const _iq IQ_SHARP_TURN_THRESHOLD = _IQ(0.7);
-    const _iq IQ_HUNDRED = _IQ(100.0);
-    const _iq IQ_FIFTY = _IQ(50.0);
-
-    // Convert float inputs to IQ format
-    _iq left_limit_iq = _IQ(*left_limit);
-    _iq right_limit_iq = _IQ(*right_limit);
-
-    // Check stop condition
-    if (x == 0 && y == 0)
-    {
-        *left_speed = 0.0f;
-        *right_speed = 0.0f;
-        *left_dir = MOTOR_DIRECTION_STOP;
-        *right_dir = MOTOR_DIRECTION_STOP;
+    if (drive->config.recovery_time_ms == 0 || drive->deadman_stopped ||
+        now_us - drive->last_cmd_us < (int64_t)drive->config.recovery_time_ms * 1000)
+    {
         return;
     }
 
-    // Convert max_input to IQ format
-    _iq max_input_iq = _IQ((float)*max_input);
-
-    // Normalize inputs to -1.0 to 1.0 range
-    _iq h_norm = _IQdiv(_IQ((float)x), max_input_iq);
-    _iq v_norm = _IQdiv(_IQ((float)y), max_input_iq);
+    // Already standing (or stopping) needs no intervention
+    drive->deadman_stopped = true;
+    if (drive->left_wheel.setpoint == 0 && drive->right_wheel.setpoint == 0)
+    {
+        return;
+    }
 
-    // Clamp values to ensure they stay within bounds
-    if (h_norm > IQ_ONE)
-        h_norm = IQ_ONE;
-    if (h_norm < IQ_MINUS_ONE)
-        h_norm = IQ_MINUS_ONE;
-    if (v_norm > IQ_ONE)
-        v_norm = IQ_ONE;
-    if (v_norm < IQ_MINUS_ONE)
-        v_norm = IQ_MINUS_ONE;
+    // Ramp down like a stop command
+    ESP_LOGW(TAG, "No command for %lu ms, stopping", (unsigned long)drive->config.recovery_time_ms);
+    set_setpoints(drive, 0, 0);
+}
 
-    _iq left = IQ_ZERO;
-    _iq right = IQ_ZERO;
+static void set_setpoints(diff_drive_handle_t *drive, int32_t left, int32_t right)
+{
+    drive->left_wheel.setpoint = left;
+    drive->right_wheel.setpoint = right;
 
-    // Handle straight forward and backward movement (deadband)
-    if (_IQabs(h_norm) < IQ_DEADBAND)
+    // The speed controller takes the setpoints with its next update
+    if (drive->config.speed_control.enabled)
     {
-        h_norm = IQ_ZERO;
+        return;
     }
 
-    // Handle straight left and right movement for in place rotation (deadband)
-    if (_IQabs(v_norm) < IQ_DEADBAND)
+    float left_speed, right_speed;
+    motor_direction_t left_dir, right_dir;
+    mix_to_cmd((int16_t)left, drive->left_duty_scale, &left_speed, &left_dir);
+    mix_to_cmd((int16_t)right, drive->right_duty_scale, &right_speed, &right_dir);
+    motor_driver_set_speed(drive->left_motor, left_speed, left_dir);
+    motor_driver_set_speed(drive->right_motor, right_speed, right_dir);
+}
+
+static void speed_control_update(diff_drive_handle_t *drive, diff_drive_wheel_t *wheel, motor_handle_t *motor, int64_t now_us)
+{
+    const diff_drive_speed_config_t *config = &drive->config.speed_control;
+
+    // Counts since the last read as percent of max_speed_cps, divided by the actual time so a late
+    // wake-up does not read as a speed change. The low-pass smooths the count quantization.
+    int32_t delta = 0;
+    wheel_encoder_get_delta(wheel->encoder, &delta);
+    int64_t elapsed_us = now_us - wheel->sample_us;
+    wheel->sample_us = now_us;
+    if (elapsed_us <= 0)
     {
-        v_norm = IQ_ZERO;
+        return;
     }
+    int32_t measured = (int32_t)((int64_t)delta * SPEED_FULL * 1000000 / (config->max_speed_cps * elapsed_us));
+    wheel->speed += (measured - wheel->speed) >> DIFF_DRIVE_SPEED_FILTER_SHIFT;
 
-    // Zero or near-zero vertical input - rotate in place
-    if (_IQabs(v_norm) == IQ_ZERO)
+    // Stopping ramps down like in open loop, the next start begins without a stale integral
+    if (wheel->setpoint == 0)
     {
-        // Sharp turn mode - use opposing wheel directions
-        left = _IQmpy(_IQabs(h_norm), IQ_HUNDRED);
-        right = _IQmpy(_IQabs(h_norm), IQ_HUNDRED);
+        wheel->integral = 0;
+        wheel->output = 0;
+        motor_driver_set_target(motor, 0);
+        return;
+    }
 
-        if (h_norm > IQ_ZERO)
-        {
-            // Turning right (clockwise)
-            *left_dir = MOTOR_DIRECTION_FORWARD;
-            *right_dir = MOTOR_DIRECTION_BACKWARD;
-        }
-        else if (h_norm < IQ_ZERO)
+    // Feedforward of the setpoint plus PI correction
+    int32_t error = wheel->setpoint - wheel->speed;
+    int32_t proportional = (int32_t)(((int64_t)error * config->kp) >> DIFF_DRIVE_GAIN_SHIFT);
+    int32_t output = wheel->setpoint + proportional + wheel->integral;
+
+    // Direction in which the actuator limits: the duty limit, or the ramp still catching up with its
+    // target. The integral only grows in the other direction (anti-windup).
+    int32_t lag = motor->ramp.target - motor->ramp.velocity;
+    int32_t limited = output > SPEED_FULL || lag > motor->ramp.accel_limit     ? 1
+                      : output < -SPEED_FULL || lag < -motor->ramp.accel_limit ? -1
+                                                                               : 0;
+    if (limited == 0 || (error > 0) != (limited > 0))
+    {
+        wheel->integral += (int32_t)(((int64_t)error * drive->ki_per_period) >> 16);
+        if (wheel->integral > SPEED_FULL)
         {
-            // Turning left (counter-clockwise)
-            *left_dir = MOTOR_DIRECTION_BACKWARD;
-            *right_dir = MOTOR_DIRECTION_FORWARD;
+            wheel->integral = SPEED_FULL;
         }
-        else
+        else if (wheel->integral < -SPEED_FULL)
         {
-            // No movement
-            *left_dir = MOTOR_DIRECTION_STOP;
-            *right_dir = MOTOR_DIRECTION_STOP;
-            left = IQ_ZERO;
-            right = IQ_ZERO;
+            wheel->integral = -SPEED_FULL;
         }
     }
-    else
+
+    if (output > SPEED_FULL)
     {
-        // Set base directions according to vertical input
-        if (v_norm > IQ_ZERO)
+        output = SPEED_FULL;
+    }
+    else if (output < -SPEED_FULL)
+    {
+        output = -SPEED_FULL;
+    }
+    wheel->output = output;
+    motor_driver_set_target(motor, output * wheel->output_scale);
+}
+
+static void current_sense_update(diff_drive_handle_t *drive)
+{
+    // Without new conversions the motors keep the last current
+    if (motor_current_update(drive->current_sense) != ESP_OK)
+    {
+        return;
+    }
+
+    int32_t left_ma = 0;
+    int32_t right_ma = 0;
+    motor_current_get(drive->current_sense, MOTOR_CURRENT_LEFT, &left_ma);
+    motor_current_get(drive->current_sense, MOTOR_CURRENT_RIGHT, &right_ma);
+    motor_driver_set_current(drive->left_motor, (uint32_t)left_ma);
+    motor_driver_set_current(drive->right_motor, (uint32_t)right_ma);
+}
+
+static void diff_drive_task(void *pvParameters)
+{
+    diff_drive_handle_t *drive = (diff_drive_handle_t *)pvParameters;
+    diff_drive_mix_t mix;
+
+    // Main task loop, one iteration per timer period
+    while (1)
+    {
+        uint32_t periods = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        int64_t wake_us = esp_timer_get_time();
+
+        // Take the newest command without blocking
+        if (xQueueReceive(drive->cmd_mailbox, &mix, 0) == pdTRUE)
         {
-            *left_dir = MOTOR_DIRECTION_FORWARD;
-            *right_dir = MOTOR_DIRECTION_FORWARD;
+            // Set wheel setpoints
+            set_setpoints(drive, mix.left, mix.right);
+            drive->last_cmd_us = wake_us;
+            drive->deadman_stopped = false;
+
+            // Log command
+            TRACE_LOG(TAG, "Command received: left=%d, right=%d", mix.left, mix.right);
         }
         else
         {
-            *left_dir = MOTOR_DIRECTION_BACKWARD;
-            *right_dir = MOTOR_DIRECTION_BACKWARD;
+            check_deadman(drive, wake_us);
         }
 
-        // Get absolute value of vertical input for base speed
-        _iq base_speed = _IQabs(v_norm);
+        // Current limit of the motor ramps
+        if (drive->current_sense != NULL)
+        {
+            current_sense_update(drive);
+        }
 
-        // Apply turning factor
-        if (h_norm != IQ_ZERO)
+        // Closed loop: correct the duty cycles on the measured speeds
+        if (drive->config.speed_control.enabled)
         {
-            // Calculate turn influence (0.0 to 1.0)
-            _iq turn_factor = _IQabs(h_norm);
-
-            // Apply turn factor to appropriate wheel
-            if (h_norm > IQ_ZERO)
-            {
-                // Turning right - slow down right wheel
-                left = _IQmpy(base_speed, IQ_HUNDRED);
-                right = _IQmpy(_IQmpy(base_speed, (IQ_ONE - turn_factor)), IQ_HUNDRED);
-
-                // If sharp turn and strong horizontal input, reverse the inner wheel
-                if (turn_factor > IQ_SHARP_TURN_THRESHOLD)
-                {
-                    right = _IQmpy(turn_factor, IQ_FIFTY); // Scale for reasonable reverse speed
-                    if (*right_dir == MOTOR_DIRECTION_FORWARD)
-                        *right_dir = MOTOR_DIRECTION_BACKWARD;
-                    else
-                        *right_dir = MOTOR_DIRECTION_FORWARD;
-                }
-            }
-            else
-            {
-                // Turning left - slow down left wheel
-                left = _IQmpy(_IQmpy(base_speed, (IQ_ONE - turn_factor)), IQ_HUNDRED);
-                right = _IQmpy(base_speed, IQ_HUNDRED);
-
-                // If sharp turn and strong horizontal input, reverse the inner wheel
-                if (turn_factor > IQ_SHARP_TURN_THRESHOLD)
-                {
-                    left = _IQmpy(turn_factor, IQ_FIFTY); // Scale for reasonable reverse speed
-                    if (*left_dir == MOTOR_DIRECTION_FORWARD)
-                        *left_dir = MOTOR_DIRECTION_BACKWARD;
-                    else
-                        *left_dir = MOTOR_DIRECTION_FORWARD;
-                }
-            }
+            int64_t now_us = esp_timer_get_time();
+            speed_control_update(drive, &drive->left_wheel, drive->left_motor, now_us);
+            speed_control_update(drive, &drive->right_wheel, drive->right_motor, now_us);
         }
-        else
+
+        // Update motors
+        esp_err_t ret = diff_drive_update(drive);
+        if (ret != ESP_OK)
         {
-            // Straight movement
-            left = _IQmpy(base_speed, IQ_HUNDRED);
-            right = _IQmpy(base_speed, IQ_HUNDRED);
+            ESP_LOGE(TAG, "Failed to update motors: %s", esp_err_to_name(ret));
         }
+
+        update_loop_stats(drive, wake_us, esp_timer_get_time(), periods);
     }
+}
 
-    // Clamp speeds to [0, 100]
-    if (left > IQ_HUNDRED)
-        left = IQ_HUNDRED;
-    if (left < IQ_ZERO)
-        left = IQ_ZERO;
-    if (right > IQ_HUNDRED)
-        right = IQ_HUNDRED;
-    if (right < IQ_ZERO)
-        right = IQ_ZERO;
+esp_err_t diff_drive_deinit(diff_drive_handle_t *diff_drive)
+{
+    // Input validation
+    if (diff_drive == NULL || !diff_drive->initialized)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Stop the timer first, it notifies the task
+    if (diff_drive->loop_timer != NULL)
+    {
+        esp_timer_stop(diff_drive->loop_timer);
+        esp_timer_delete(diff_drive->loop_timer);
+    }
+
+    // Then the task, it may be waiting for the timer
+    if (diff_drive->task_handle != NULL)
+    {
+        vTaskDelete(diff_drive->task_handle);
+    }
 
-    // Scale them to 0-max_pwm and convert back to float
-    *left_speed = _IQtoF(_IQmpy(_IQdiv(left, IQ_HUNDRED), left_limit_iq));
-    *right_speed = _IQtoF(_IQmpy(_IQdiv(right, IQ_HUNDRED), right_limit_iq));
+    // Delete mailbox
+    if (diff_drive->cmd_mailbox != NULL)
+    {
+        vQueueDelete(diff_drive->cmd_mailbox);
+    }
+
+    // Deinitialize current sensing, encoders and motors
+    if (diff_drive->current_sense != NULL)
+    {
+        motor_current_deinit(diff_drive->current_sense);
+    }
+    deinit_speed_control(diff_drive);
+    motor_driver_deinit(diff_drive->left_motor);
+    motor_driver_deinit(diff_drive->right_motor);
+
+    // Free memory
+    free(diff_drive);
+    diff_drive = NULL;
+
+    ESP_LOGI(TAG, "Differential drive deinitialized");
+    return ESP_OK;
+}
+
+static inline void mix_to_cmd(int16_t mix, float duty_scale, float *speed, motor_direction_t *dir)
+{
+    *dir = mix > 0 ? MOTOR_DIRECTION_FORWARD : mix < 0 ? MOTOR_DIRECTION_BACKWARD : MOTOR_DIRECTION_STOP;
+    *speed = (float)abs(mix) * duty_scale;
 }
 
 void diff_drive_print_all_parameters(diff_drive_handle_t *diff_drive)
@@ -440,4 +603,23 @@ void diff_drive_print_all_parameters(diff_drive_handle_t *diff_drive)
     motor_driver_print_all_parameters(diff_drive->left_motor);
     ESP_LOGI(TAG, "  Right Motor: ");
     motor_driver_print_all_parameters(diff_drive->right_motor);
+
+    diff_drive_loop_stats_t stats;
+    diff_drive_get_loop_stats(diff_drive, &stats, false);
+    ESP_LOGI(TAG, "  Loop: %u Hz, %lu iterations, %lu overruns, jitter mean %lu us / max %lu us, max exec %lu us",
+             diff_drive->config.loop_rate_hz, (unsigned long)stats.iterations, (unsigned long)stats.overruns,
+             (unsigned long)stats.mean_jitter_us, (unsigned long)stats.max_jitter_us, (unsigned long)stats.max_exec_us);
+    if (diff_drive->config.speed_control.enabled)
+    {
+        ESP_LOGI(TAG, "  Speed control: max %ld counts/s, kp %u, ki %u, left %ld / %ld, right %ld / %ld",
+                 (long)diff_drive->config.speed_control.max_speed_cps, diff_drive->config.speed_control.kp,
+                 diff_drive->config.speed_control.ki, (long)diff_drive->left_wheel.speed,
+                 (long)diff_drive->left_wheel.setpoint, (long)diff_drive->right_wheel.speed,
+                 (long)diff_drive->right_wheel.setpoint);
+    }
+    if (diff_drive->current_sense != NULL)
+    {
+        ESP_LOGI(TAG, "  Current: left %lu mA, right %lu mA", (unsigned long)diff_drive->left_motor->current_ma,
+                 (unsigned long)diff_drive->right_motor->current_ma);
+    }
 }
\ No newline at end of file
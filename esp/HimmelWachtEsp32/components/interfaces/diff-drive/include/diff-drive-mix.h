@@ -0,0 +1,49 @@
+/**
+ * @file diff-drive-mix.h
+ * @brief Joystick mixing of the differential drive from a precomputed table
+ *
+ * Maps a stick position (x, y) to signed left / right wheel duties. The mixing function is generated by
+ * tools/gen_mix_table.py into a table over one quadrant; a lookup normalizes the input with a
+ * precomputed scale, picks the cell and interpolates bilinearly, all in integer math. The regions of the
+ * mixing (deadbands, sharp turn) border on grid lines, so the interpolation reproduces the function
+ * exactly up to the table resolution.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+// Wheel duty of a mix in 1/DIFF_DRIVE_MIX_OUTPUT_ONE percent, positive = forward
+#define DIFF_DRIVE_MIX_OUTPUT_ONE 256
+
+typedef struct
+{
+    int16_t left;
+    int16_t right;
+} diff_drive_mix_t;
+
+typedef struct
+{
+    uint16_t max_input;   // Stick value of full deflection
+    uint32_t input_scale; // Grid position per input unit, 24 fractional bits
+} diff_drive_mixer_t;
+
+/**
+ * @brief Prepare the input normalization for a stick range
+ *
+ * @param mixer Mixer to initialize
+ * @param max_input Stick value of full deflection, e.g. 512
+ * @return esp_err_t ESP_OK on success, ESP_ERR_INVALID_ARG if mixer is NULL or max_input is not positive
+ */
+esp_err_t diff_drive_mixer_init(diff_drive_mixer_t *mixer, int16_t max_input);
+
+/**
+ * @brief Mix a stick position into wheel duties
+ *
+ * @param mixer Initialized mixer
+ * @param x Horizontal input, positive = right, clamped to +-max_input
+ * @param y Vertical input, positive = forward, clamped to +-max_input
+ * @return diff_drive_mix_t Signed wheel duties, 0 for stop
+ */
+diff_drive_mix_t diff_drive_mix(const diff_drive_mixer_t *mixer, int16_t x, int16_t y);
@@ -5,9 +5,23 @@
  * This header file defines the differential drive interface for controlling two motors
  * using a queue for command handling. It includes the necessary structures, function declarations,
  * and configuration options.
- * 
- * Reference:
- *  - https://components.espressif.com/components/espressif/iqmath
+ *
+ * Commands are mixed from the stick position with a precomputed table (diff-drive-mix.h) in the caller's
+ * context and handed to the task through a one-slot mailbox: a new command replaces one that was not
+ * applied yet, so the task always applies the newest setpoint. If no command arrives within
+ * recovery_time_ms (deadman, e.g. after a controller disconnect), the task ramps both motors to a stop.
+ *
+ * The drive task runs at a fixed rate (loop_rate_hz), woken by a periodic esp_timer. Every iteration
+ * drains the pending commands without blocking and updates both motors, so the motor ramp advances in
+ * equal time steps independent of how often commands arrive.
+ *
+ * Without encoders the mix is the duty cycle of the motors (open loop), the speed then depends on battery
+ * voltage, load and floor. With speed_control enabled the mix is a speed setpoint in percent of
+ * max_speed_cps instead: every iteration reads the wheel encoders (wheel-encoder.h) and a fixed-point PI
+ * controller per wheel corrects the duty cycle, the setpoint itself is the feedforward.
+ *
+ * With current_sense enabled every iteration first reads the motor currents (motor-current.h) and hands
+ * them to the motors, whose ramps then regulate to their current_limit_ma.
  * 
  * @author Michael Specht
  */
@@ -18,7 +32,18 @@
 #include "freertos/task.h"
 #include "freertos/queue.h"
 #include "esp_err.h"
+#include "esp_timer.h"
 #include "motor-driver.h"
+#include "diff-drive-mix.h"
+#include "wheel-encoder.h"
+#include "motor-current.h"
+
+#define DIFF_DRIVE_MAX_LOOP_RATE_HZ 1000
+
+// Fractional bits of the speed controller gains (256 = 1.0)
+#define DIFF_DRIVE_GAIN_SHIFT 8
+// Low-pass of the measured speed, new sample weighted 1 / 2^shift
+#define DIFF_DRIVE_SPEED_FILTER_SHIFT 2
 
 typedef struct
 {
@@ -32,18 +57,56 @@ typedef struct input_matrix
     uint16_t y;
 } input_matrix_t;
 
+typedef struct
+{
+    bool enabled;                        // Closed loop on the encoders, open loop (duty = mix) otherwise
+    wheel_encoder_config_t left_encoder;
+    wheel_encoder_config_t right_encoder;
+    int32_t max_speed_cps;               // Encoder counts per second of a 100 % setpoint (at pwm_duty_limit), at least loop_rate_hz
+    uint16_t kp;                         // Duty per speed error, DIFF_DRIVE_GAIN_SHIFT fractional bits
+    uint16_t ki;                         // Duty per speed error and second, DIFF_DRIVE_GAIN_SHIFT fractional bits
+} diff_drive_speed_config_t;
+
+typedef struct
+{
+    bool enabled;                  // Read the CS outputs of the motor drivers, no current limit otherwise
+    motor_current_config_t sensor;
+} diff_drive_current_config_t;
+
 typedef struct
 {
     int16_t max_input; // e.g., 512
-    uint32_t cmd_queue_size;
-    uint32_t recovery_time_ms;
+    uint32_t recovery_time_ms; // Deadman: stop without a command for this long, 0 disables
     uint8_t task_priority;
     uint32_t task_stack_size;
     uint8_t task_core_id;
-    uint8_t task_delay_ms;
-    uint32_t queue_timout_ms;
+    uint16_t loop_rate_hz; // Control loop rate, 1 to DIFF_DRIVE_MAX_LOOP_RATE_HZ
+    diff_drive_speed_config_t speed_control;
+    diff_drive_current_config_t current_sense;
 } diff_drive_config_t;
 
+// One wheel, speeds and duties in 1/DIFF_DRIVE_MIX_OUTPUT_ONE percent
+typedef struct
+{
+    wheel_encoder_handle_t *encoder; // NULL in open loop
+    int32_t setpoint;                // Mix of the last command, signed
+    int32_t speed;                   // Filtered measured speed in percent of max_speed_cps
+    int64_t sample_us;               // Time of the last encoder read
+    int32_t integral;                // Integral term of the PI controller
+    int32_t output;                  // Controller output in percent of pwm_duty_limit
+    int32_t output_scale;            // MOTOR_RAMP_ONE duty per output unit (pwm_duty_limit)
+} diff_drive_wheel_t;
+
+// Timing of the control loop, measured against the configured period
+typedef struct
+{
+    uint32_t iterations;     // Loop iterations since init or the last reset
+    uint32_t overruns;       // Iterations that ran past their period or woke up more than one period late
+    uint32_t max_jitter_us;  // Largest deviation of a wake-up interval from the period
+    uint32_t mean_jitter_us; // Mean absolute deviation of the wake-up intervals
+    uint32_t max_exec_us;    // Longest iteration (command drain, current read + motor update)
+} diff_drive_loop_stats_t;
+
 typedef struct
 {
     motor_handle_t *left_motor;
@@ -51,8 +114,22 @@ typedef struct
     bool initialized;
     bool is_running;
     diff_drive_config_t config;
-    QueueHandle_t cmd_queue;
+    QueueHandle_t cmd_mailbox;     // Newest command not applied yet
+    int64_t last_cmd_us;           // Time the task took the last command
+    bool deadman_stopped;          // Stopped by the deadman, cleared by the next command
     TaskHandle_t task_handle;
+    diff_drive_mixer_t mixer;      // Stick position to wheel duties
+    float left_duty_scale;         // Left pwm_duty_limit per mix unit
+    float right_duty_scale;        // Right pwm_duty_limit per mix unit
+    diff_drive_wheel_t left_wheel;
+    diff_drive_wheel_t right_wheel;
+    int32_t ki_per_period;         // Integral gain per period, 16 fractional bits
+    motor_current_handle_t *current_sense; // NULL without current sensing
+    esp_timer_handle_t loop_timer; // Notifies the task once per period
+    portMUX_TYPE stats_lock;
+    diff_drive_loop_stats_t loop_stats;
+    uint64_t jitter_sum_us;
+    int64_t last_wake_us;
 } diff_drive_handle_t;
 
 /**
@@ -68,13 +145,26 @@ diff_drive_handle_t *diff_drive_init(const diff_drive_config_t *config, const mo
 /**
  * @brief Send a command to the differential drive
  *
+ * Never blocks: the command replaces one the task has not applied yet. Repeat an unchanged command
+ * within recovery_time_ms to keep the drive moving.
+ *
  * @param diff_drive Pointer to the differential drive handle
  * @param matrix Pointer to the input matrix containing x and y values
  * @return esp_err_t ESP_OK on success, ESP_ERR_INVALID_ARG if diff_drive or matrix is NULL,
- *                  ESP_ERR_INVALID_STATE if the task is not running, or ESP_ERR_TIMEOUT if the command could not be sent within the timeout period.
+ *                  ESP_ERR_INVALID_STATE if the task is not running.
  */
 esp_err_t diff_drive_send_cmd(diff_drive_handle_t *diff_drive, input_matrix_t *matrix);
 
+/**
+ * @brief Get the timing statistics of the control loop
+ *
+ * @param diff_drive Pointer to the differential drive handle
+ * @param stats Receives the statistics
+ * @param reset Start a new measurement after reading
+ * @return esp_err_t ESP_OK on success, ESP_ERR_INVALID_ARG if diff_drive or stats is NULL
+ */
+esp_err_t diff_drive_get_loop_stats(diff_drive_handle_t *diff_drive, diff_drive_loop_stats_t *stats, bool reset);
+
 /**
  * @brief Print all parameters of the differential drive
  * 
@@ -0,0 +1,155 @@
+import argparse
+import sys
+from fractions import Fraction
+from pathlib import Path
+
+
+# ************************************** DOCUMENTATION **************************************
+# Generates diff-drive-mix-table.h, the joystick mixing of the differential drive as a lookup table
+# (see include/diff-drive-mix.h for the lookup).
+#
+#   python3 tools/gen_mix_table.py          rewrite the header
+#   python3 tools/gen_mix_table.py --check  exit 1 if the header is not up to date (host ctest)
+#
+# The mixing works on the normalized stick position (h, v) in the quadrant h, v >= 0, the other quadrants
+# follow by symmetry (negative x swaps the wheels, negative y outside the vertical deadband reverses both).
+# Output is the signed wheel duty in percent, positive = forward:
+#
+#   v in deadband (rotate in place)   left =  100 h             right = -100 h
+#   h in deadband (straight)          left =  100 v             right =  100 v
+#   turn                              left =  100 v             right =  100 v (1 - h)
+#   sharp turn (h > SHARP_TURN)       left =  100 v             right = -SHARP_TURN_SCALE h
+#
+# with h, v set to 0 inside their deadband. Every region is bilinear in (h, v), so bilinear interpolation
+# between grid nodes is exact as long as no cell crosses a region border. The borders lie on grid lines and
+# their nodes exist twice, once evaluated with the region on each side; the lookup picks the node pair of
+# its side with one comparison per border.
+
+STEPS = 20               # grid cells per axis from 0 to full deflection
+FRAC_BITS = 15           # fractional bits of the grid position
+OUTPUT_ONE = 256         # table unit: 1/256 percent duty
+
+DEADBAND = Fraction(1, 5)       # |h| or |v| below is treated as 0
+SHARP_TURN = Fraction(7, 10)    # |h| above reverses the inner wheel
+SHARP_TURN_SCALE = 50           # inner wheel duty per h in a sharp turn
+
+CELLS_PER_LINE = 8
+
+HEADER = Path(__file__).resolve().parent.parent / "diff-drive-mix-table.h"
+
+
+def grid_line(value):
+    line = value * STEPS
+    if line.denominator != 1:
+        sys.exit(f"border {value} is not on the grid, change STEPS")
+    return int(line)
+
+
+def h_nodes():
+    """Horizontal nodes as (h, region), the borders twice"""
+    nodes = []
+    for k in range(STEPS + 1):
+        h = Fraction(k, STEPS)
+        if h == DEADBAND:
+            nodes.append((h, "straight"))
+        if h < DEADBAND:
+            nodes.append((h, "straight"))
+        elif h <= SHARP_TURN:
+            nodes.append((h, "turn"))
+        else:
+            nodes.append((h, "sharp"))
+        if h == SHARP_TURN:
+            nodes.append((h, "sharp"))
+    return nodes
+
+
+def v_nodes():
+    """Vertical nodes as (v, rotate), the deadband border twice"""
+    nodes = []
+    for k in range(STEPS + 1):
+        v = Fraction(k, STEPS)
+        if v == DEADBAND:
+            nodes.append((v, True))
+        nodes.append((v, v < DEADBAND))
+    return nodes
+
+
+def mix(h, h_region, v, rotate):
+    if h_region == "straight":
+        h = Fraction(0)
+    if rotate:
+        return 100 * h, -100 * h
+    if h_region == "straight":
+        return 100 * v, 100 * v
+    if h_region == "turn":
+        return 100 * v, 100 * v * (1 - h)
+    return 100 * v, -SHARP_TURN_SCALE * h
+
+
+def to_table(value):
+    return int(round(value * OUTPUT_ONE))
+
+
+def render():
+    hs = h_nodes()
+    vs = v_nodes()
+    rows = []
+    for v, rotate in vs:
+        cells = []
+        for h, region in hs:
+            left, right = mix(h, region, v, rotate)
+            cells.append(f"{{{to_table(left)}, {to_table(right)}}}")
+        chunks = [", ".join(cells[i:i + CELLS_PER_LINE]) for i in range(0, len(cells), CELLS_PER_LINE)]
+        rows.append(f"    // v = {float(v):.2f}{' (rotate)' if rotate else ''}")
+        rows.append("    {" + ",\n     ".join(chunks) + "},")
+
+    lines = [
+        "/**",
+        " * @file diff-drive-mix-table.h",
+        " * @brief Joystick mixing table of the differential drive",
+        " *",
+        " * Generated by tools/gen_mix_table.py, do not edit. Rows: vertical nodes, columns: horizontal nodes,",
+        " * values: {left, right} duty in 1/DIFF_DRIVE_MIX_ONE percent, positive = forward.",
+        " */",
+        "",
+        "#pragma once",
+        "",
+        "#include <stdint.h>",
+        "",
+        f"#define DIFF_DRIVE_MIX_STEPS {STEPS}",
+        f"#define DIFF_DRIVE_MIX_FRAC_BITS {FRAC_BITS}",
+        f"#define DIFF_DRIVE_MIX_ONE {OUTPUT_ONE}",
+        "",
+        "// Region borders as grid positions, their nodes are duplicated in the table",
+        f"#define DIFF_DRIVE_MIX_DEADBAND ({grid_line(DEADBAND)}u << DIFF_DRIVE_MIX_FRAC_BITS)",
+        f"#define DIFF_DRIVE_MIX_SHARP_TURN ({grid_line(SHARP_TURN)}u << DIFF_DRIVE_MIX_FRAC_BITS)",
+        "",
+        f"#define DIFF_DRIVE_MIX_H_NODES {len(hs)}",
+        f"#define DIFF_DRIVE_MIX_V_NODES {len(vs)}",
+        "",
+        "static const int16_t diff_drive_mix_table[DIFF_DRIVE_MIX_V_NODES][DIFF_DRIVE_MIX_H_NODES][2] = {",
+        *rows,
+        "};",
+        "",
+    ]
+    return "\n".join(lines)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Generate the differential drive mixing table")
+    parser.add_argument("--check", action="store_true", help="only check that the header is up to date")
+    args = parser.parse_args()
+
+    content = render()
+    if args.check:
+        if not HEADER.exists() or HEADER.read_text() != content:
+            print(f"{HEADER.name} is out of date, run tools/gen_mix_table.py")
+            return 1
+        return 0
+
+    HEADER.write_text(content)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -15,6 +15,7 @@
 #pragma once
 
 #include "esp_err.h"
+#include "turret-protocol.h"
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -23,12 +24,14 @@ typedef struct
     int8_t platform_x_angle;
     int8_t platform_y_angle;
     bool fire_command;
+    uint16_t seq;                // Sequence number of a binary command frame, 0 for JSON commands
 } mqtt_turret_cmd_t;
 
 typedef struct
 {
     char broker_uri[32];         // e.g., "mqtt://192.168.1.100:1883"
     char topic[64];
+    char telemetry_topic[64];    // Binary telemetry frames, empty to disable
     char client_id[32];
     uint16_t keepalive;
     uint32_t network_timeout_ms;
@@ -66,6 +69,23 @@ esp_err_t mqtt_stack_get_turret_command(mqtt_turret_cmd_t *cmd);
  */
 bool mqtt_stack_is_connected(void);
 
+/**
+ * @brief Number of turret commands dropped because the command queue was full (wraps)
+ *
+ * @return uint16_t dropped commands since boot
+ */
+uint16_t mqtt_stack_get_dropped_commands(void);
+
+/**
+ * @brief Publish a binary telemetry frame (see turret-protocol.h) on the telemetry topic
+ *
+ * Does not block, the frame is sent by the MQTT task.
+ *
+ * @param frame Telemetry to send
+ * @return esp_err_t ESP_OK if queued, ESP_ERR_INVALID_STATE if not connected or no telemetry topic is set
+ */
+esp_err_t mqtt_stack_publish_telemetry(const turret_telemetry_frame_t *frame);
+
 /**
  * @brief Set the status of the discard command
  *
@@ -8,6 +8,7 @@
 #include "cJSON.h"
 #include <string.h>
 #include "mqtt-stack.h"
+#include "turret-protocol.h"
 #include "log_wrapper.h"
 
 static const char *TAG = "MQTT_STACK";
@@ -19,12 +20,15 @@ static bool mqtt_connected = false;
 static bool discard_commands = true;
 static SemaphoreHandle_t connection_mutex = NULL;
 static SemaphoreHandle_t discard_command_mutex = NULL;
+static volatile uint16_t dropped_commands = 0;
 
 static void set_connection_status(bool connected);
 static bool get_connection_status(void);
 void set_discard_command_status(bool connected);
 bool get_discard_command_status(void);
 static bool parse_turret_command(const char *data, int data_len, mqtt_turret_cmd_t *cmd);
+static bool parse_turret_command_json(const char *data, int data_len, mqtt_turret_cmd_t *cmd);
+static bool parse_turret_command_binary(const char *data, int data_len, mqtt_turret_cmd_t *cmd);
 static void stack_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data);
 esp_err_t mqtt_stack_init(const mqtt_config_t *config);
 esp_err_t mqtt_stack_deinit(void);
@@ -73,8 +77,42 @@ bool get_discard_command_status(void) {
     return status;
 }
 
-// Parse JSON message and extract turret command
+// Parse a turret command, binary frames are recognized by their magic byte, everything else is treated as JSON
 static bool parse_turret_command(const char *data, int data_len, mqtt_turret_cmd_t *cmd) {
+    if (turret_protocol_is_binary((const uint8_t *)data, data_len)) {
+        return parse_turret_command_binary(data, data_len, cmd);
+    }
+    return parse_turret_command_json(data, data_len, cmd);
+}
+
+// 0.01 degrees -> whole degrees (rounded), limited to the int8 range, the platform applies its own stops
+static int8_t centideg_to_deg(int16_t centideg) {
+    int32_t deg = (centideg >= 0 ? centideg + 50 : centideg - 50) / 100;
+    if (deg > INT8_MAX) return INT8_MAX;
+    if (deg < INT8_MIN) return INT8_MIN;
+    return (int8_t)deg;
+}
+
+// Decode a fixed-size binary command frame (see turret-protocol.h), no heap allocation
+static bool parse_turret_command_binary(const char *data, int data_len, mqtt_turret_cmd_t *cmd) {
+    turret_command_frame_t frame;
+    turret_protocol_status_t status = turret_protocol_decode_command((const uint8_t *)data, data_len, &frame);
+    if (status != TURRET_PROTOCOL_OK) {
+        ESP_LOGE(TAG, "Invalid command frame: %s", turret_protocol_status_name(status));
+        return false;
+    }
+
+    cmd->platform_x_angle = centideg_to_deg(frame.x_centideg);
+    cmd->platform_y_angle = centideg_to_deg(frame.y_centideg);
+    cmd->fire_command = (frame.flags & TURRET_COMMAND_FLAG_FIRE) != 0;
+    cmd->seq = frame.seq;
+    return true;
+}
+
+// Parse JSON message and extract turret command (legacy format, kept during the migration)
+static bool parse_turret_command_json(const char *data, int data_len, mqtt_turret_cmd_t *cmd) {
+    cmd->seq = 0;
+
     cJSON *json = cJSON_ParseWithLength(data, data_len);
     if (json == NULL) {
         ESP_LOGE(TAG, "Failed to parse JSON");
@@ -147,7 +185,7 @@ static void stack_event_handler(void *handler_args, esp_event_base_t base, int32
         case MQTT_EVENT_DATA:
             LOGI(TAG, "MQTT_EVENT_DATA");
             LOGI(TAG, "TOPIC=%.*s", event->topic_len, event->topic);
-            LOGI(TAG, "DATA=%.*s", event->data_len, event->data);
+            LOGI(TAG, "DATA_LEN=%d", event->data_len);
 
             if(get_discard_command_status()) {
                 LOGI(TAG, "Discarding command due to discard_commands flag");
@@ -161,6 +199,7 @@ static void stack_event_handler(void *handler_args, esp_event_base_t base, int32
                 mqtt_turret_cmd_t cmd;
                 if (parse_turret_command(event->data, event->data_len, &cmd)) {
                     if (xQueueSend(turret_cmd_queue, &cmd, 0) != pdTRUE) {
+                        dropped_commands++;
                         ESP_LOGW(TAG, "Turret command queue full, dropping command");
                     }
                 }
@@ -306,4 +345,25 @@ esp_err_t mqtt_stack_get_turret_command(mqtt_turret_cmd_t *cmd) {
 
 bool mqtt_stack_is_connected(void) {
     return get_connection_status();
+}
+
+uint16_t mqtt_stack_get_dropped_commands(void) {
+    return dropped_commands;
+}
+
+esp_err_t mqtt_stack_publish_telemetry(const turret_telemetry_frame_t *frame) {
+    if (frame == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (mqtt_client == NULL || mqtt_cfg.telemetry_topic[0] == '\0' || !get_connection_status()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    uint8_t payload[TURRET_TELEMETRY_FRAME_SIZE];
+    turret_protocol_encode_telemetry(frame, payload);
+
+    // Enqueue instead of publish: the MQTT task sends it, the calling control loop never waits for the socket
+    int msg_id = esp_mqtt_client_enqueue(mqtt_client, mqtt_cfg.telemetry_topic, (const char *)payload,
+                                         sizeof(payload), 0, 0, true);
+    return msg_id < 0 ? ESP_FAIL : ESP_OK;
 }
\ No newline at end of file
@@ -0,0 +1,280 @@
+/**
+ * @file turret-protocol.h
+ * @brief Binary turret command and telemetry frames shared by ESP32, Raspberry Pi and laboratory computer
+ *
+ * Fixed-size frames replace the JSON turret commands. Parsing needs no heap and no string handling,
+ * a command is 16 bytes instead of ~70.
+ *
+ * All multi-byte fields are little-endian and are written byte by byte, so the frames do not depend on
+ * the host byte order or struct packing. The frames start with a magic byte that can never start a JSON
+ * document, a receiver can therefore accept both formats during the migration (see mqtt-stack.c).
+ *
+ * Command frame (lab -> ESP, topic vehicle/turret/cmd), 16 bytes:
+ *   0  u8   magic            TURRET_PROTOCOL_MAGIC
+ *   1  u8   version          TURRET_PROTOCOL_VERSION
+ *   2  u8   type             TURRET_FRAME_COMMAND
+ *   3  u8   flags            TURRET_COMMAND_FLAG_*
+ *   4  u16  seq              sender sequence number, wraps
+ *   6  u32  timestamp_ms     sender clock in milliseconds, wraps
+ *  10  i16  x_centideg       platform x angle in 0.01 degrees
+ *  12  i16  y_centideg       platform y angle in 0.01 degrees
+ *  14  u16  crc              CRC-16/CCITT-FALSE over bytes 0..13
+ *
+ * Telemetry frame (ESP -> lab, topic vehicle/turret/telemetry), 26 bytes:
+ *   0  u8   magic, version, type (TURRET_FRAME_TELEMETRY), flags (TURRET_TELEMETRY_FLAG_*)
+ *   4  u16  seq
+ *   6  u32  timestamp_ms     ESP uptime in milliseconds
+ *  10  i16  x_centideg       applied platform x angle
+ *  12  i16  y_centideg       applied platform y angle
+ *  14  u16  last_cmd_seq     seq of the last applied command frame
+ *  16  i8   left_duty        drive duty in percent, negative = backward
+ *  17  i8   right_duty
+ *  18  u16  left_current_ma  motor current, 0 if not measured
+ *  20  u16  right_current_ma
+ *  22  u16  dropped_cmds     commands dropped by the ESP since boot, wraps
+ *  24  u16  crc              CRC-16/CCITT-FALSE over bytes 0..23
+ *
+ * A frame layout change requires a new TURRET_PROTOCOL_VERSION, decoders reject other versions.
+ * Python counterpart: laboratory_computer/webRTC_inference/Inference_Scripts/turret_protocol.py
+ * C++ wrapper: turret-protocol.hpp
+ *
+ * Reference:
+ *  - https://reveng.sourceforge.io/crc-catalogue/16.htm (CRC-16/IBM-3740, formerly CCITT-FALSE)
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TURRET_PROTOCOL_MAGIC 0xA5
+#define TURRET_PROTOCOL_VERSION 1
+
+#define TURRET_FRAME_COMMAND 0x01
+#define TURRET_FRAME_TELEMETRY 0x02
+
+#define TURRET_COMMAND_FRAME_SIZE 16
+#define TURRET_TELEMETRY_FRAME_SIZE 26
+
+#define TURRET_COMMAND_FLAG_FIRE 0x01
+
+#define TURRET_TELEMETRY_FLAG_AUTOMATIC 0x01 // turret follows the commands (semi automatic mode)
+
+typedef struct
+{
+    uint8_t flags;
+    uint16_t seq;
+    uint32_t timestamp_ms;
+    int16_t x_centideg;
+    int16_t y_centideg;
+} turret_command_frame_t;
+
+typedef struct
+{
+    uint8_t flags;
+    uint16_t seq;
+    uint32_t timestamp_ms;
+    int16_t x_centideg;
+    int16_t y_centideg;
+    uint16_t last_cmd_seq;
+    int8_t left_duty;
+    int8_t right_duty;
+    uint16_t left_current_ma;
+    uint16_t right_current_ma;
+    uint16_t dropped_cmds;
+} turret_telemetry_frame_t;
+
+typedef enum
+{
+    TURRET_PROTOCOL_OK = 0,
+    TURRET_PROTOCOL_ERR_LENGTH,
+    TURRET_PROTOCOL_ERR_MAGIC,
+    TURRET_PROTOCOL_ERR_VERSION,
+    TURRET_PROTOCOL_ERR_TYPE,
+    TURRET_PROTOCOL_ERR_CRC
+} turret_protocol_status_t;
+
+/**
+ * @brief CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF, no reflection, no final xor)
+ */
+static inline uint16_t turret_protocol_crc16(const uint8_t *data, size_t len)
+{
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < len; i++)
+    {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static inline void turret_protocol_put_u16(uint8_t *p, uint16_t value)
+{
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+}
+
+static inline void turret_protocol_put_u32(uint8_t *p, uint32_t value)
+{
+    turret_protocol_put_u16(p, (uint16_t)value);
+    turret_protocol_put_u16(p + 2, (uint16_t)(value >> 16));
+}
+
+static inline uint16_t turret_protocol_get_u16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t turret_protocol_get_u32(const uint8_t *p)
+{
+    return turret_protocol_get_u16(p) | ((uint32_t)turret_protocol_get_u16(p + 2) << 16);
+}
+
+/**
+ * @brief Checks magic, version, type, length and CRC of a received frame
+ */
+static inline turret_protocol_status_t turret_protocol_check(const uint8_t *data, size_t len, uint8_t type, size_t size)
+{
+    if (data == NULL || len < 3)
+    {
+        return TURRET_PROTOCOL_ERR_LENGTH;
+    }
+    if (data[0] != TURRET_PROTOCOL_MAGIC)
+    {
+        return TURRET_PROTOCOL_ERR_MAGIC;
+    }
+    if (data[1] != TURRET_PROTOCOL_VERSION)
+    {
+        return TURRET_PROTOCOL_ERR_VERSION;
+    }
+    if (data[2] != type)
+    {
+        return TURRET_PROTOCOL_ERR_TYPE;
+    }
+    if (len != size)
+    {
+        return TURRET_PROTOCOL_ERR_LENGTH;
+    }
+    if (turret_protocol_crc16(data, size - 2) != turret_protocol_get_u16(data + size - 2))
+    {
+        return TURRET_PROTOCOL_ERR_CRC;
+    }
+    return TURRET_PROTOCOL_OK;
+}
+
+static inline void turret_protocol_put_header(uint8_t *out, uint8_t type, uint8_t flags, uint16_t seq, uint32_t timestamp_ms)
+{
+    out[0] = TURRET_PROTOCOL_MAGIC;
+    out[1] = TURRET_PROTOCOL_VERSION;
+    out[2] = type;
+    out[3] = flags;
+    turret_protocol_put_u16(out + 4, seq);
+    turret_protocol_put_u32(out + 6, timestamp_ms);
+}
+
+/**
+ * @brief Writes a command frame into out (TURRET_COMMAND_FRAME_SIZE bytes)
+ */
+static inline void turret_protocol_encode_command(const turret_command_frame_t *frame, uint8_t *out)
+{
+    turret_protocol_put_header(out, TURRET_FRAME_COMMAND, frame->flags, frame->seq, frame->timestamp_ms);
+    turret_protocol_put_u16(out + 10, (uint16_t)frame->x_centideg);
+    turret_protocol_put_u16(out + 12, (uint16_t)frame->y_centideg);
+    turret_protocol_put_u16(out + 14, turret_protocol_crc16(out, 14));
+}
+
+/**
+ * @brief Decodes a command frame, frame is only written on TURRET_PROTOCOL_OK
+ */
+static inline turret_protocol_status_t turret_protocol_decode_command(const uint8_t *data, size_t len, turret_command_frame_t *frame)
+{
+    turret_protocol_status_t status = turret_protocol_check(data, len, TURRET_FRAME_COMMAND, TURRET_COMMAND_FRAME_SIZE);
+    if (status != TURRET_PROTOCOL_OK)
+    {
+        return status;
+    }
+    frame->flags = data[3];
+    frame->seq = turret_protocol_get_u16(data + 4);
+    frame->timestamp_ms = turret_protocol_get_u32(data + 6);
+    frame->x_centideg = (int16_t)turret_protocol_get_u16(data + 10);
+    frame->y_centideg = (int16_t)turret_protocol_get_u16(data + 12);
+    return TURRET_PROTOCOL_OK;
+}
+
+/**
+ * @brief Writes a telemetry frame into out (TURRET_TELEMETRY_FRAME_SIZE bytes)
+ */
+static inline void turret_protocol_encode_telemetry(const turret_telemetry_frame_t *frame, uint8_t *out)
+{
+    turret_protocol_put_header(out, TURRET_FRAME_TELEMETRY, frame->flags, frame->seq, frame->timestamp_ms);
+    turret_protocol_put_u16(out + 10, (uint16_t)frame->x_centideg);
+    turret_protocol_put_u16(out + 12, (uint16_t)frame->y_centideg);
+    turret_protocol_put_u16(out + 14, frame->last_cmd_seq);
+    out[16] = (uint8_t)frame->left_duty;
+    out[17] = (uint8_t)frame->right_duty;
+    turret_protocol_put_u16(out + 18, frame->left_current_ma);
+    turret_protocol_put_u16(out + 20, frame->right_current_ma);
+    turret_protocol_put_u16(out + 22, frame->dropped_cmds);
+    turret_protocol_put_u16(out + 24, turret_protocol_crc16(out, 24));
+}
+
+/**
+ * @brief Decodes a telemetry frame, frame is only written on TURRET_PROTOCOL_OK
+ */
+static inline turret_protocol_status_t turret_protocol_decode_telemetry(const uint8_t *data, size_t len, turret_telemetry_frame_t *frame)
+{
+    turret_protocol_status_t status = turret_protocol_check(data, len, TURRET_FRAME_TELEMETRY, TURRET_TELEMETRY_FRAME_SIZE);
+    if (status != TURRET_PROTOCOL_OK)
+    {
+        return status;
+    }
+    frame->flags = data[3];
+    frame->seq = turret_protocol_get_u16(data + 4);
+    frame->timestamp_ms = turret_protocol_get_u32(data + 6);
+    frame->x_centideg = (int16_t)turret_protocol_get_u16(data + 10);
+    frame->y_centideg = (int16_t)turret_protocol_get_u16(data + 12);
+    frame->last_cmd_seq = turret_protocol_get_u16(data + 14);
+    frame->left_duty = (int8_t)data[16];
+    frame->right_duty = (int8_t)data[17];
+    frame->left_current_ma = turret_protocol_get_u16(data + 18);
+    frame->right_current_ma = turret_protocol_get_u16(data + 20);
+    frame->dropped_cmds = turret_protocol_get_u16(data + 22);
+    return TURRET_PROTOCOL_OK;
+}
+
+/**
+ * @brief True if the first byte marks a binary frame (JSON starts with '{' or whitespace)
+ */
+static inline bool turret_protocol_is_binary(const uint8_t *data, size_t len)
+{
+    return len > 0 && data[0] == TURRET_PROTOCOL_MAGIC;
+}
+
+/**
+ * @brief Name of a status for log output
+ */
+static inline const char *turret_protocol_status_name(turret_protocol_status_t status)
+{
+    switch (status)
+    {
+    case TURRET_PROTOCOL_OK: return "ok";
+    case TURRET_PROTOCOL_ERR_LENGTH: return "wrong length";
+    case TURRET_PROTOCOL_ERR_MAGIC: return "wrong magic byte";
+    case TURRET_PROTOCOL_ERR_VERSION: return "unsupported version";
+    case TURRET_PROTOCOL_ERR_TYPE: return "wrong frame type";
+    case TURRET_PROTOCOL_ERR_CRC: return "CRC mismatch";
+    }
+    return "unknown";
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,90 @@
+/**
+ * @file turret-protocol.hpp
+ * @brief C++ wrapper of the binary turret frames for the Raspberry Pi and laboratory computer tools
+ *
+ * Thin layer over turret-protocol.h: fixed-size byte arrays instead of raw buffers, std::optional
+ * results and degree conversion. The frame layout is only defined in the C header.
+ */
+
+#pragma once
+
+#include "turret-protocol.h"
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+namespace turret_protocol
+{
+    using CommandFrame = turret_command_frame_t;
+    using TelemetryFrame = turret_telemetry_frame_t;
+    using CommandBytes = std::array<uint8_t, TURRET_COMMAND_FRAME_SIZE>;
+    using TelemetryBytes = std::array<uint8_t, TURRET_TELEMETRY_FRAME_SIZE>;
+
+    // Degrees -> 0.01 degrees, rounded and saturated to the int16 range
+    inline int16_t toCentideg(float degrees)
+    {
+        float centideg = std::round(degrees * 100.0f);
+        if (centideg > INT16_MAX) return INT16_MAX;
+        if (centideg < INT16_MIN) return INT16_MIN;
+        return static_cast<int16_t>(centideg);
+    }
+
+    inline float toDegrees(int16_t centideg)
+    {
+        return centideg / 100.0f;
+    }
+
+    inline CommandBytes encode(const CommandFrame &frame)
+    {
+        CommandBytes out{};
+        turret_protocol_encode_command(&frame, out.data());
+        return out;
+    }
+
+    inline TelemetryBytes encode(const TelemetryFrame &frame)
+    {
+        TelemetryBytes out{};
+        turret_protocol_encode_telemetry(&frame, out.data());
+        return out;
+    }
+
+    inline std::optional<CommandFrame> decodeCommand(const uint8_t *data, size_t len, turret_protocol_status_t *status = nullptr)
+    {
+        CommandFrame frame{};
+        turret_protocol_status_t result = turret_protocol_decode_command(data, len, &frame);
+        if (status) *status = result;
+        if (result != TURRET_PROTOCOL_OK) return std::nullopt;
+        return frame;
+    }
+
+    inline std::optional<TelemetryFrame> decodeTelemetry(const uint8_t *data, size_t len, turret_protocol_status_t *status = nullptr)
+    {
+        TelemetryFrame frame{};
+        turret_protocol_status_t result = turret_protocol_decode_telemetry(data, len, &frame);
+        if (status) *status = result;
+        if (result != TURRET_PROTOCOL_OK) return std::nullopt;
+        return frame;
+    }
+
+    // Numbers consecutive commands of one sender
+    class CommandEncoder
+    {
+    public:
+        CommandBytes next(float xDegrees, float yDegrees, bool fire, uint32_t timestampMs)
+        {
+            CommandFrame frame{};
+            frame.flags = fire ? TURRET_COMMAND_FLAG_FIRE : 0;
+            frame.seq = seq++;
+            frame.timestamp_ms = timestampMs;
+            frame.x_centideg = toCentideg(xDegrees);
+            frame.y_centideg = toCentideg(yDegrees);
+            return encode(frame);
+        }
+
+    private:
+        uint16_t seq = 0;
+    };
+}
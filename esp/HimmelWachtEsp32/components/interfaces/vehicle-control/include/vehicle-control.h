@@ -20,6 +20,7 @@ typedef struct {
     int8_t deadzone_y; // Y Deadzone for the joystick input
     int8_t core; // Core to run the control on
     int8_t deadzone_drive_update; // Deadzone for the drive update
+    uint16_t telemetry_period_ms; // Interval of the MQTT telemetry frames, 0 to disable
 } vehicle_control_config_t;
 
 esp_err_t vehicle_control_init(vehicle_control_config_t* cfg, diff_drive_handle_t *diff_drive);
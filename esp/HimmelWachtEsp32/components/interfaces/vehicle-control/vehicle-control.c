@@ -48,6 +48,7 @@ static inline void process_manual_platform_up_down(int16_t stickY);
 static inline void process_platform_left_right();
 static inline void process_platform_up_down();
 static inline void process_drive(diff_drive_handle_t *diff_drive, int16_t x, int16_t y);
+static inline void publish_telemetry(diff_drive_handle_t *diff_drive);
 
 static int8_t platform_x_angle = 0;
 static int8_t platform_y_angle = 0;
@@ -65,6 +66,9 @@ static _iq21 dt = 0;
 
 static int64_t button_hold_threshold_us = 0;
 
+static int64_t telemetry_period_us = 0;
+static uint16_t last_cmd_seq = 0;
+
 // Data structure to be able to check if a button has been held for a certain amount of time
 typedef struct {
     bool is_held;
@@ -193,6 +197,7 @@ static void vehicle_control_task(void* arg) {
                 // Update platform positions
                 platform_x_angle = mqtt_cmd.platform_x_angle;
                 platform_y_angle = mqtt_cmd.platform_y_angle;
+                last_cmd_seq = mqtt_cmd.seq;
 
                 process_platform_left_right();
                 process_platform_up_down();
@@ -210,6 +215,62 @@ static void vehicle_control_task(void* arg) {
         // Set the proper lightbar color based on the current vehicle mode
         // This is done here to ensure the color is set after the controller reconnects
         set_vehicle_mode_color();
+
+        publish_telemetry(diff_drive);
+    }
+}
+
+/**
+ * Signed duty in percent of one drive motor for the telemetry
+ */
+static inline int8_t telemetry_duty(const motor_handle_t *motor){
+    if(motor == NULL || motor->current_direction == MOTOR_DIRECTION_STOP ||
+       motor->current_direction == MOTOR_DIRECTION_BRAKE){
+        return 0;
+    }
+    int8_t duty = (int8_t)(motor->current_pwm + 0.5f);
+    return motor->current_direction == MOTOR_DIRECTION_BACKWARD ? -duty : duty;
+}
+
+/**
+ * Measured current of one drive motor for the telemetry, 0 without current sensing
+ */
+static inline uint16_t telemetry_current(const motor_handle_t *motor){
+    if(motor == NULL){
+        return 0;
+    }
+    return motor->current_ma > UINT16_MAX ? UINT16_MAX : (uint16_t)motor->current_ma;
+}
+
+/**
+ * Sends the applied turret angles and drive state as binary telemetry frame (see turret-protocol.h)
+ * every telemetry_period_ms. The lab matches last_cmd_seq against its own command frames.
+ */
+static inline void publish_telemetry(diff_drive_handle_t *diff_drive){
+    static int64_t last_publish_us = 0;
+    static uint16_t seq = 0;
+
+    int64_t now_us = esp_timer_get_time();
+    if(telemetry_period_us == 0 || now_us - last_publish_us < telemetry_period_us || !mqtt_stack_is_connected()){
+        return;
+    }
+    last_publish_us = now_us;
+
+    turret_telemetry_frame_t frame = {
+        .flags = vehicle_state == AUTOMATIC_TURRET_CONTROL ? TURRET_TELEMETRY_FLAG_AUTOMATIC : 0,
+        .seq = seq++,
+        .timestamp_ms = (uint32_t)(now_us / 1000),
+        .x_centideg = (int16_t)(platform_x_angle * 100),
+        .y_centideg = (int16_t)(platform_y_angle * 100),
+        .last_cmd_seq = last_cmd_seq,
+        .left_duty = telemetry_duty(diff_drive->left_motor),
+        .right_duty = telemetry_duty(diff_drive->right_motor),
+        .left_current_ma = telemetry_current(diff_drive->left_motor),
+        .right_current_ma = telemetry_current(diff_drive->right_motor),
+        .dropped_cmds = mqtt_stack_get_dropped_commands()};
+
+    if(mqtt_stack_publish_telemetry(&frame) != ESP_OK){
+        ESP_LOGW(VEHICLE_CONTROL_TAG, "Telemetry frame could not be queued");
     }
 }
 
@@ -217,9 +278,17 @@ static void vehicle_control_task(void* arg) {
  * @author Michael Specht
  */
 static inline void process_drive(diff_drive_handle_t *diff_drive, int16_t x, int16_t y){
+    static int64_t last_send_us = 0;
+
     bool is_null_position = (abs(x) < DRIVING_NULL_BOUNDARY && abs(y) < DRIVING_NULL_BOUNDARY);
     bool significant_change = (abs(x - diff_drive_prev_x) >= DRIVING_MIN_CHANGE || abs(y - diff_drive_prev_y) >= DRIVING_MIN_CHANGE);
 
+    // A held stick is still a command: repeat it at half the deadman time of the drive, which stops the
+    // vehicle only when the reports stop (controller disconnected)
+    int64_t now_us = esp_timer_get_time();
+    bool keepalive = diff_drive->config.recovery_time_ms != 0 &&
+                     now_us - last_send_us >= (int64_t)diff_drive->config.recovery_time_ms * 500;
+
     if (is_null_position) {
         if (null_pos_done) {
             return;
@@ -232,10 +301,11 @@ static inline void process_drive(diff_drive_handle_t *diff_drive, int16_t x, int
         null_pos_done = 0;
 
         // Skip update if change is too small
-        if (!significant_change) {
+        if (!significant_change && !keepalive) {
             return;
         }
     }
+    last_send_us = now_us;
 
     // Save the previous x, y values
     diff_drive_prev_x = x;
@@ -406,6 +476,7 @@ esp_err_t vehicle_control_init(vehicle_control_config_t* cfg, diff_drive_handle_
 
     // Assign the configuration values
     button_hold_threshold_us = cfg->button_hold_threshold_us;
+    telemetry_period_us = (int64_t)cfg->telemetry_period_ms * 1000;
     deadzone_y = cfg->deadzone_y;
     deadzone_x = cfg->deadzone_x;
     max_deg_per_sec_x = _IQ21(cfg->max_deg_per_sec_x);
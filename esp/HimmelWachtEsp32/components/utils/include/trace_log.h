@@ -0,0 +1,113 @@
+/**
+ * @file trace_log.h
+ * @brief Deferred binary logging for the control loop
+ *
+ * TRACE_LOG() stores a record in a RAM ring instead of formatting text: the time, an ID of the format
+ * string and up to TRACE_LOG_MAX_ARGS raw 32 bit arguments. That takes a few dozen cycles and no UART,
+ * so the trace can stay enabled in production builds. The format string stays in flash, its ID is the
+ * offset from trace_log_anchor, the same in the ELF file and at run time.
+ *
+ * trace_log_dump() prints the records in the ring as "TRACE" lines, components/utils/tools/trace_decode.py
+ * renders them with the format strings from the ELF file of the build:
+ *
+ *   python3 components/utils/tools/trace_decode.py build/HimmelWachtEsp32.elf monitor.log
+ *
+ * Arguments are integers up to 32 bits (%d, %i, %u, %x, %X, %c, length modifiers h, l) and floats (%f, %e,
+ * %g, a double is stored as float). Strings and 64 bit values cannot be deferred, the tag has to be a
+ * string literal. Define TRACE_LOG_DISABLE to compile the records out.
+ *
+ * Usage:
+ * - TRACE_LOG(TAG, "Instance %d: velocity %ld", nr, velocity);
+ * - trace_log_dump() from a console command or after a fault
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#define TRACE_LOG_MAX_ARGS 6
+
+// Ring size in records, a power of 2 (256 records: 9 KB, about a second of the drive loop)
+#ifndef TRACE_LOG_RECORDS
+#define TRACE_LOG_RECORDS 256
+#endif
+
+typedef struct
+{
+    uint32_t seq;     // Sequence number + 1, 0 while the record is written
+    uint32_t time_us; // esp_timer_get_time(), wraps after 71 minutes
+    int32_t fmt_id;   // Offset of the format string from trace_log_anchor
+    uint32_t args[TRACE_LOG_MAX_ARGS];
+} trace_log_record_t;
+
+// Reference of the format string IDs
+extern const char trace_log_anchor[];
+
+/**
+ * @brief Store one record, safe from any task, core and ISR
+ *
+ * A writer that is preempted while the other writers fill the whole ring drops its record instead of
+ * overwriting a newer one, the ring then has a gap in seq.
+ *
+ * @param fmt_id Format string ID, see TRACE_LOG_ID()
+ * @param args TRACE_LOG_MAX_ARGS raw arguments, unused ones are ignored by the decoder
+ */
+void trace_log_write(int32_t fmt_id, const uint32_t args[TRACE_LOG_MAX_ARGS]);
+
+/**
+ * @brief Copy the records in the ring, oldest first
+ *
+ * Records overwritten during the copy or dropped by a lapped writer are skipped.
+ *
+ * @param records Receives the records
+ * @param max_records Size of records
+ * @return Number of records copied
+ */
+uint32_t trace_log_snapshot(trace_log_record_t *records, uint32_t max_records);
+
+/**
+ * @brief Print the records in the ring on stdout, one "TRACE" line each, for trace_decode.py
+ */
+void trace_log_dump(void);
+
+/**
+ * @brief Empty the ring
+ */
+void trace_log_clear(void);
+
+static inline uint32_t trace_log_u32(uint32_t value)
+{
+    return value;
+}
+
+static inline uint32_t trace_log_f32(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static inline uint32_t trace_log_f64(double value)
+{
+    return trace_log_f32((float)value);
+}
+
+#define TRACE_LOG_ID(fmt) ((int32_t)((intptr_t)(fmt) - (intptr_t)trace_log_anchor))
+#define TRACE_LOG_ARG(x) _Generic((x), float: trace_log_f32, double: trace_log_f64, default: trace_log_u32)(x)
+#define TRACE_LOG_ARGS(dummy, a, b, c, d, e, f, ...)                                                              \
+    {TRACE_LOG_ARG(a), TRACE_LOG_ARG(b), TRACE_LOG_ARG(c), TRACE_LOG_ARG(d), TRACE_LOG_ARG(e), TRACE_LOG_ARG(f)}
+#define TRACE_LOG_COUNT(dummy, _1, _2, _3, _4, _5, _6, _7, _8, n, ...) n
+
+#ifndef TRACE_LOG_DISABLE
+    #define TRACE_LOG(tag, fmt, ...)                                                                              \
+        do                                                                                                        \
+        {                                                                                                         \
+            _Static_assert(TRACE_LOG_COUNT(0, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0) <= TRACE_LOG_MAX_ARGS,   \
+                           "Too many trace arguments");                                                           \
+            const uint32_t trace_log_args_[TRACE_LOG_MAX_ARGS] = TRACE_LOG_ARGS(0, ##__VA_ARGS__, 0, 0, 0, 0, 0, 0, 0); \
+            trace_log_write(TRACE_LOG_ID(tag ": " fmt), trace_log_args_);                                        \
+        } while (0)
+#else
+    #define TRACE_LOG(tag, fmt, ...)
+#endif
@@ -0,0 +1,153 @@
+import argparse
+import re
+import struct
+import sys
+
+
+# ************************************** DOCUMENTATION **************************************
+# Renders the records of trace_log_dump() (see include/trace_log.h) with the format strings of the build.
+#
+#   python3 tools/trace_decode.py build/HimmelWachtEsp32.elf monitor.log   captured console output
+#   idf.py monitor | python3 tools/trace_decode.py build/HimmelWachtEsp32.elf
+#
+# Every other line of the input is ignored, so a whole monitor log can be passed. A record in several dumps
+# is rendered once, all records in the order they were written. The ELF file has to be the one running on
+# the device: a format string ID is the offset of the string from the symbol trace_log_anchor.
+
+MAX_ARGS = 6  # TRACE_LOG_MAX_ARGS
+
+RECORD = re.compile(r"TRACE ([0-9a-f]{8}) ([0-9a-f]{8}) ([0-9a-f]{8})((?: [0-9a-f]{8}){%d})" % MAX_ARGS)
+CONVERSION = re.compile(r"%([-+ #0]*)(\d*)(\.\d+)?(hh|h|ll|l|L|z|j|t)?([diouxXcfFeEgGaAsp%])")
+
+SHT_SYMTAB = 2
+SHT_NOBITS = 8
+SHF_ALLOC = 2
+
+
+class Elf:
+    """Sections and symbols of an ELF file, just enough to find strings by address"""
+
+    def __init__(self, path):
+        with open(path, "rb") as file:
+            self.data = file.read()
+        if self.data[:4] != b"\x7fELF":
+            raise ValueError(f"{path} is no ELF file")
+
+        self.is64 = self.data[4] == 2
+        self.endian = "<" if self.data[5] == 1 else ">"
+        if self.is64:
+            shoff, = self.unpack("Q", 0x28)
+            shentsize, shnum = self.unpack("HH", 0x3A)
+        else:
+            shoff, = self.unpack("I", 0x20)
+            shentsize, shnum = self.unpack("HH", 0x2E)
+
+        self.sections = []
+        for i in range(shnum):
+            offset = shoff + i * shentsize
+            if self.is64:
+                _, sh_type, flags, addr, sh_offset, size, link, _, _, entsize = self.unpack("IIQQQQIIQQ", offset)
+            else:
+                _, sh_type, flags, addr, sh_offset, size, link, _, _, entsize = self.unpack("IIIIIIIIII", offset)
+            self.sections.append((sh_type, flags, addr, sh_offset, size, link, entsize))
+
+    def unpack(self, fmt, offset):
+        return struct.unpack_from(self.endian + fmt, self.data, offset)
+
+    def symbol(self, name):
+        wanted = name.encode()
+        for sh_type, _, _, offset, size, link, entsize in self.sections:
+            if sh_type != SHT_SYMTAB:
+                continue
+            strtab = self.sections[link][3]
+            for entry in range(offset, offset + size, entsize):
+                if self.is64:
+                    st_name, _, _, _, value, _ = self.unpack("IBBHQQ", entry)
+                else:
+                    st_name, value, _, _, _, _ = self.unpack("IIIBBH", entry)
+                if self.data.startswith(wanted + b"\0", strtab + st_name):
+                    return value
+        raise KeyError(f"symbol {name} not found, build without trace_log.c or stripped ELF")
+
+    def string(self, address):
+        for sh_type, flags, addr, offset, size, _, _ in self.sections:
+            if sh_type != SHT_NOBITS and flags & SHF_ALLOC and addr <= address < addr + size:
+                start = offset + address - addr
+                return self.data[start:self.data.index(b"\0", start)].decode(errors="replace")
+        return None
+
+
+def signed(value, bits):
+    value &= (1 << bits) - 1
+    return value - (1 << bits) if value >> (bits - 1) else value
+
+
+def render(fmt, args):
+    """printf of a format string with the raw 32 bit arguments of a record"""
+    remaining = list(args)
+
+    def convert(match):
+        flags, width, precision, length, conv = match.groups()
+        if conv == "%":
+            return "%"
+        if not remaining:
+            return "<missing>"
+        raw = remaining.pop(0)
+        if conv in "sp" or length in ("ll", "L", "j"):
+            return f"<%{length or ''}{conv} not deferrable>"
+
+        bits = 8 if length == "hh" else 16 if length == "h" else 32
+        if conv in "fFeEgG":
+            value = struct.unpack("<f", struct.pack("<I", raw))[0]
+        elif conv in "aA":
+            return struct.unpack("<f", struct.pack("<I", raw))[0].hex()
+        elif conv in "di":
+            value = signed(raw, bits)
+        elif conv == "c":
+            value = raw & 0xFF
+        else:
+            value = raw & ((1 << bits) - 1)
+        return ("%" + flags + width + (precision or "") + conv) % value
+
+    return CONVERSION.sub(convert, fmt)
+
+
+def read_records(lines):
+    records = {}
+    for line in lines:
+        match = RECORD.search(line)
+        if match:
+            seq, time_us, fmt_id = (int(value, 16) for value in match.groups()[:3])
+            args = [int(value, 16) for value in match.group(4).split()]
+            records[seq] = (time_us, signed(fmt_id, 32), args)
+    return [records[seq] for seq in sorted(records)]
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Render the records of trace_log_dump() from the ELF file")
+    parser.add_argument("elf", help="ELF file of the firmware that wrote the records")
+    parser.add_argument("log", nargs="?", help="console output with TRACE lines (default: stdin)")
+    parser.add_argument("--no-time", action="store_true", help="only the messages, without timestamps")
+    args = parser.parse_args()
+
+    elf = Elf(args.elf)
+    anchor = elf.symbol("trace_log_anchor")
+
+    if args.log:
+        with open(args.log, errors="replace") as file:
+            records = read_records(file)
+    else:
+        records = read_records(sys.stdin)
+
+    # 32 bit microseconds, unwrapped along the order of the records
+    time_us = None
+    for raw_us, fmt_id, raw_args in records:
+        time_us = raw_us if time_us is None else time_us + ((raw_us - time_us) & 0xFFFFFFFF)
+        fmt = elf.string(anchor + fmt_id)
+        message = render(fmt, raw_args) if fmt is not None else f"<unknown format {fmt_id:#x}>"
+        print(message if args.no_time else f"[{time_us / 1e6:12.6f}] {message}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,118 @@
+#include "trace_log.h"
+#include "esp_timer.h"
+#include <stdbool.h>
+#include <stdio.h>
+
+_Static_assert((TRACE_LOG_RECORDS & (TRACE_LOG_RECORDS - 1)) == 0, "TRACE_LOG_RECORDS must be a power of 2");
+
+const char trace_log_anchor[] = "trace_log";
+
+static trace_log_record_t ring[TRACE_LOG_RECORDS];
+static uint32_t head;                      // Sequence number of the next record
+static uint8_t claimed[TRACE_LOG_RECORDS]; // Slot taken by a writer
+
+void trace_log_write(int32_t fmt_id, const uint32_t args[TRACE_LOG_MAX_ARGS]);
+static bool read_record(uint32_t seq, trace_log_record_t *record);
+uint32_t trace_log_snapshot(trace_log_record_t *records, uint32_t max_records);
+void trace_log_dump(void);
+void trace_log_clear(void);
+
+void trace_log_write(int32_t fmt_id, const uint32_t args[TRACE_LOG_MAX_ARGS])
+{
+    uint32_t seq = __atomic_fetch_add(&head, 1, __ATOMIC_RELAXED);
+    uint32_t index = seq & (TRACE_LOG_RECORDS - 1);
+    trace_log_record_t *record = &ring[index];
+
+    // One writer per slot. A writer that finds the slot taken or already holding a newer record was lapped
+    // by a full ring of records while it was preempted and drops its record, the reader sees a gap in seq.
+    uint8_t free_slot = 0;
+    if (!__atomic_compare_exchange_n(&claimed[index], &free_slot, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+    {
+        return;
+    }
+    if ((int32_t)(__atomic_load_n(&record->seq, __ATOMIC_RELAXED) - (seq + 1)) > 0)
+    {
+        __atomic_store_n(&claimed[index], 0, __ATOMIC_RELEASE);
+        return;
+    }
+
+    // A reader recognizes a slot in writing by seq 0
+    __atomic_store_n(&record->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    record->time_us = (uint32_t)esp_timer_get_time();
+    record->fmt_id = fmt_id;
+    memcpy(record->args, args, sizeof(record->args));
+    __atomic_store_n(&record->seq, seq + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&claimed[index], 0, __ATOMIC_RELEASE);
+}
+
+static bool read_record(uint32_t seq, trace_log_record_t *record)
+{
+    const trace_log_record_t *slot = &ring[seq & (TRACE_LOG_RECORDS - 1)];
+    if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != seq + 1)
+    {
+        return false;
+    }
+
+    record->time_us = slot->time_us;
+    record->fmt_id = slot->fmt_id;
+    memcpy(record->args, slot->args, sizeof(record->args));
+    record->seq = seq + 1;
+
+    // Still the same record after the copy
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == seq + 1;
+}
+
+uint32_t trace_log_snapshot(trace_log_record_t *records, uint32_t max_records)
+{
+    if (records == NULL)
+    {
+        return 0;
+    }
+
+    uint32_t end = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+    uint32_t available = end < TRACE_LOG_RECORDS ? end : TRACE_LOG_RECORDS;
+    uint32_t count = 0;
+    for (uint32_t seq = end - available; seq != end && count < max_records; seq++)
+    {
+        if (read_record(seq, &records[count]))
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
+void trace_log_dump(void)
+{
+    // One record at a time, the ring keeps filling while the UART is busy
+    uint32_t end = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+    uint32_t available = end < TRACE_LOG_RECORDS ? end : TRACE_LOG_RECORDS;
+    trace_log_record_t record;
+    for (uint32_t seq = end - available; seq != end; seq++)
+    {
+        if (!read_record(seq, &record))
+        {
+            continue;
+        }
+
+        printf("TRACE %08lx %08lx %08lx", (unsigned long)record.seq, (unsigned long)record.time_us,
+               (unsigned long)(uint32_t)record.fmt_id);
+        for (int i = 0; i < TRACE_LOG_MAX_ARGS; i++)
+        {
+            printf(" %08lx", (unsigned long)record.args[i]);
+        }
+        printf("\n");
+    }
+    fflush(stdout);
+}
+
+void trace_log_clear(void)
+{
+    for (uint32_t i = 0; i < TRACE_LOG_RECORDS; i++)
+    {
+        __atomic_store_n(&ring[i].seq, 0, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&head, 0, __ATOMIC_RELEASE);
+}
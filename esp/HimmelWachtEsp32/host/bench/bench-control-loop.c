@@ -0,0 +1,338 @@
+/**
+ * @file bench-control-loop.c
+ * @brief Latency of the control loop from an input to the resulting hardware write on the host build
+ *
+ * Runs the firmware with the configuration of main.c. The first half feeds controller reports in
+ * manual mode (moving sticks), then the vehicle switches to automatic mode and additionally receives
+ * binary turret commands over MQTT. Afterwards the hardware trace is evaluated:
+ *
+ *   ds4 -> i2c     controller report to the next PCA9685 write (platform servos)
+ *   mqtt -> i2c    turret command to the next PCA9685 write (automatic mode)
+ *   ds4 -> mcpwm   controller report to the next motor duty write
+ *
+ * Usage: bench-control-loop [--seconds N] [--rate HZ] [--cmd-rate HZ] [--trace FILE]
+ *
+ * The host scheduler is not the ESP32 one, absolute numbers are only comparable between runs on the
+ * same machine. The structure of the latency (which task waits for which) is the same as on target.
+ */
+
+#include "vehicle-control.h"
+#include "platform-control.h"
+#include "fire-control.h"
+#include "mqtt-stack.h"
+#include "ds4-sim.h"
+#include "ds4-common.h"
+#include "mqtt-sim.h"
+#include "hw-trace.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define CMD_TOPIC "vehicle/turret/cmd"
+#define TELEMETRY_TOPIC "vehicle/turret/telemetry"
+#define PCA9685_ADDRESS 0x40
+
+typedef struct
+{
+    double seconds;
+    int rate_hz;
+    int cmd_rate_hz;
+    const char *trace_path;
+} bench_options_t;
+
+static bool parse_options(int argc, char **argv, bench_options_t *options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--seconds") == 0 && has_value)
+        {
+            options->seconds = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--rate") == 0 && has_value)
+        {
+            options->rate_hz = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--cmd-rate") == 0 && has_value)
+        {
+            options->cmd_rate_hz = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--trace") == 0 && has_value)
+        {
+            options->trace_path = argv[++i];
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return options->seconds > 0 && options->rate_hz > 0 && options->cmd_rate_hz > 0;
+}
+
+static esp_err_t init_firmware(diff_drive_handle_t **diff_drive)
+{
+    mqtt_config_t mqtt_config = {
+        .broker_uri = "mqtt://127.0.0.1:1883",
+        .topic = CMD_TOPIC,
+        .telemetry_topic = TELEMETRY_TOPIC,
+        .client_id = "bench",
+        .keepalive = 60,
+        .network_timeout_ms = 5000,
+        .reconnect_timeout_ms = 5000,
+        .queue_timeout_ticks = 10};
+    ESP_ERROR_CHECK(mqtt_stack_init(&mqtt_config));
+    ESP_ERROR_CHECK(mqtt_sim_connect());
+
+    platform_config_t platform_cfg = {
+        .pwm_board_config = {
+            .device_address = PCA9685_ADDRESS,
+            .freq = 50,
+            .i2c_port = 0,
+            .sda_port = 18,
+            .scl_port = 19,
+            .internal_pullup = true},
+        .platform_x_channel = 2,
+        .platform_x_start_angle = 0,
+        .platform_x_left_stop_angle = -90,
+        .platform_x_right_stop_angle = 90,
+        .platform_y_channel = 1,
+        .platform_y_start_angle = 48,
+        .platform_y_left_stop_angle = 0,
+        .platform_y_right_stop_angle = 80};
+    ESP_ERROR_CHECK(platform_init(&platform_cfg));
+
+    fire_control_config_t fire_control_cfg = {.gun_arm_channel = 0, .flywheel_control_gpio_port = 5, .run_on_core = 1};
+    ESP_ERROR_CHECK(fire_control_init(&fire_control_cfg));
+
+    motor_config_t left_motor_config = {
+        .mcpwm_group_id = 0,
+        .pwm_gpio_num = 27,
+        .dir_gpio_num = 26,
+        .pwm_frequency_hz = 20000,
+        .ramp_rate = 5,
+        .ramp_intervall_ms = 10,
+        .ramp_jerk_time_ms = 50,
+        .direction_hysteresis = 5,
+        .pwm_duty_limit = 100,
+        .mynr = 0};
+    motor_config_t right_motor_config = left_motor_config;
+    right_motor_config.pwm_gpio_num = 23;
+    right_motor_config.dir_gpio_num = 22;
+    right_motor_config.mynr = 1;
+
+    diff_drive_config_t diff_drive_config = {
+        .max_input = 512,
+        .recovery_time_ms = 1000,
+        .task_priority = 0,
+        .task_stack_size = 4096,
+        .task_core_id = 0,
+        .loop_rate_hz = 100};
+    *diff_drive = diff_drive_init(&diff_drive_config, &left_motor_config, &right_motor_config);
+    if (*diff_drive == NULL)
+    {
+        return ESP_FAIL;
+    }
+
+    ESP_ERROR_CHECK(ds4_init());
+    ds4_sim_set_connected(true);
+
+    // Only the button hold threshold differs from main.c, the mode change should not eat the run time
+    vehicle_control_config_t vehicle_control_cfg = {
+        .button_hold_threshold_us = 100000,
+        .max_deg_per_sec_x = 300,
+        .max_deg_per_sec_y = 150,
+        .input_processing_freq_hz = 60,
+        .deadzone_x = 30,
+        .deadzone_y = 100,
+        .deadzone_drive_update = 10,
+        .telemetry_period_ms = 100,
+        .core = 1};
+    return vehicle_control_init(&vehicle_control_cfg, *diff_drive);
+}
+
+// Moving sticks: the platform turns back and forth, the vehicle drives slow and fast
+static ds4_input_t stick_pattern(double t)
+{
+    ds4_input_t input = {
+        .rightStickX = (int16_t)(400 * sin(2 * M_PI * 0.5 * t)),
+        .rightStickY = (int16_t)(300 * sin(2 * M_PI * 0.3 * t)),
+        .leftStickX = (int16_t)(200 * sin(2 * M_PI * 0.2 * t)),
+        .leftStickY = (int16_t)(-400 * sin(2 * M_PI * 0.25 * t)),
+        .battery = 0xFE};
+    return input;
+}
+
+static void run(const bench_options_t *options)
+{
+    int64_t input_period_us = 1000000 / options->rate_hz;
+    int64_t cmd_period_us = 1000000 / options->cmd_rate_hz;
+    int64_t start = esp_timer_get_time();
+    int64_t end = start + (int64_t)(options->seconds * 1e6);
+    int64_t automatic_from = start + (int64_t)(options->seconds * 1e6 / 2);
+    int64_t next_input = start;
+    int64_t next_cmd = automatic_from;
+    bool automatic = false;
+    uint16_t cmd_seq = 0;
+
+    for (int64_t now = start; now < end; now = esp_timer_get_time())
+    {
+        double t = (now - start) / 1e6;
+
+        if (now >= next_input)
+        {
+            ds4_input_t input = stick_pattern(t);
+            // Mode change: dpad up + cross, held until the firmware switched
+            if (now >= automatic_from && !automatic)
+            {
+                input.dpad = DPAD_UP_MASK;
+                input.buttons = BUTTON_CROSS_MASK;
+                automatic = !get_discard_command_status();
+            }
+            ds4_sim_send_input(&input);
+            next_input += input_period_us;
+        }
+
+        if (automatic && now >= next_cmd)
+        {
+            turret_command_frame_t frame = {
+                .seq = ++cmd_seq,
+                .timestamp_ms = (uint32_t)(now / 1000),
+                .x_centideg = (int16_t)(6000 * sin(2 * M_PI * 0.4 * t)),
+                .y_centideg = (int16_t)(4000 + 3000 * sin(2 * M_PI * 0.7 * t))};
+            uint8_t payload[TURRET_COMMAND_FRAME_SIZE];
+            turret_protocol_encode_command(&frame, payload);
+            mqtt_sim_deliver(CMD_TOPIC, payload, sizeof(payload));
+            next_cmd += cmd_period_us;
+        }
+
+        int64_t next = next_input < next_cmd || !automatic ? next_input : next_cmd;
+        int64_t wait = next - esp_timer_get_time();
+        if (wait > 0)
+        {
+            usleep((useconds_t)wait);
+        }
+    }
+}
+
+static int compare_latency(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a;
+    int64_t y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/*
+    Latency from each input event to the first write of the given kind before the next input,
+    inputs without a resulting write are counted as unanswered.
+*/
+static void report_latency(const char *name, hw_trace_kind_t input_kind, hw_trace_kind_t write_kind, uint16_t target)
+{
+    size_t count = hw_trace_count();
+    int64_t *latencies = malloc(count * sizeof(int64_t));
+    size_t latency_count = 0;
+    size_t unanswered = 0;
+    hw_trace_event_t input;
+    hw_trace_event_t write;
+
+    for (size_t i = hw_trace_find(0, input_kind, HW_TRACE_ANY_TARGET); i < count;)
+    {
+        size_t next_input = hw_trace_find(i + 1, input_kind, HW_TRACE_ANY_TARGET);
+        size_t answer = hw_trace_find(i + 1, write_kind, target);
+        if (answer < next_input && hw_trace_get(i, &input) && hw_trace_get(answer, &write))
+        {
+            latencies[latency_count++] = write.time_us - input.time_us;
+        }
+        else
+        {
+            unanswered++;
+        }
+        i = next_input;
+    }
+
+    if (latency_count == 0)
+    {
+        printf("%-14s no samples (%zu inputs unanswered)\n", name, unanswered);
+        free(latencies);
+        return;
+    }
+
+    qsort(latencies, latency_count, sizeof(int64_t), compare_latency);
+    int64_t sum = 0;
+    for (size_t i = 0; i < latency_count; i++)
+    {
+        sum += latencies[i];
+    }
+    printf("%-14s n=%-6zu unanswered=%-6zu min=%-7lld avg=%-7lld p50=%-7lld p99=%-7lld max=%lld us\n", name,
+           latency_count, unanswered, (long long)latencies[0], (long long)(sum / (int64_t)latency_count),
+           (long long)latencies[latency_count / 2], (long long)latencies[latency_count * 99 / 100],
+           (long long)latencies[latency_count - 1]);
+    free(latencies);
+}
+
+int main(int argc, char **argv)
+{
+    bench_options_t options = {.seconds = 10, .rate_hz = 60, .cmd_rate_hz = 30, .trace_path = NULL};
+    if (!parse_options(argc, argv, &options))
+    {
+        fprintf(stderr, "Usage: %s [--seconds N] [--rate HZ] [--cmd-rate HZ] [--trace FILE]\n", argv[0]);
+        return 2;
+    }
+
+    // The per-command info logs of the components would bury the report, ESP_LOG_LEVEL overrides
+    if (getenv("ESP_LOG_LEVEL") == NULL)
+    {
+        esp_log_level_set("*", ESP_LOG_ERROR);
+    }
+
+    diff_drive_handle_t *diff_drive = NULL;
+    if (init_firmware(&diff_drive) != ESP_OK)
+    {
+        fprintf(stderr, "Firmware initialization failed\n");
+        return 1;
+    }
+
+    hw_trace_reset();
+    diff_drive_loop_stats_t loop_stats;
+    diff_drive_get_loop_stats(diff_drive, &loop_stats, true);
+    run(&options);
+    diff_drive_get_loop_stats(diff_drive, &loop_stats, false);
+
+    printf("%.1f s, controller %d Hz, commands %d Hz (automatic mode in the second half)\n", options.seconds,
+           options.rate_hz, options.cmd_rate_hz);
+    report_latency("ds4 -> i2c", HW_TRACE_DS4_INPUT, HW_TRACE_I2C_WRITE, PCA9685_ADDRESS);
+    report_latency("mqtt -> i2c", HW_TRACE_MQTT_RECEIVE, HW_TRACE_I2C_WRITE, PCA9685_ADDRESS);
+    report_latency("ds4 -> mcpwm", HW_TRACE_DS4_INPUT, HW_TRACE_MCPWM_DUTY, HW_TRACE_ANY_TARGET);
+
+    printf("drive loop %u Hz: iterations=%lu overruns=%lu jitter avg=%lu max=%lu us, exec max=%lu us\n",
+           diff_drive->config.loop_rate_hz, (unsigned long)loop_stats.iterations, (unsigned long)loop_stats.overruns,
+           (unsigned long)loop_stats.mean_jitter_us, (unsigned long)loop_stats.max_jitter_us,
+           (unsigned long)loop_stats.max_exec_us);
+
+    printf("writes/s:");
+    for (hw_trace_kind_t kind = 0; kind < HW_TRACE_KIND_COUNT; kind++)
+    {
+        size_t count = hw_trace_count_of(kind, HW_TRACE_ANY_TARGET);
+        if (count > 0)
+        {
+            printf(" %s=%.1f", hw_trace_kind_name(kind), count / options.seconds);
+        }
+    }
+    printf("\n");
+
+    if (hw_trace_count() > HW_TRACE_CAPACITY)
+    {
+        printf("trace overflowed, only the last %d events were evaluated\n", HW_TRACE_CAPACITY);
+    }
+
+    if (options.trace_path != NULL && hw_trace_write_csv(options.trace_path) != ESP_OK)
+    {
+        fprintf(stderr, "Could not write %s\n", options.trace_path);
+        return 1;
+    }
+    return 0;
+}
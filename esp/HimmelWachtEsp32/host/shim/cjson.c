@@ -0,0 +1,351 @@
+/**
+ * @file cjson.c
+ * @brief Recursive descent JSON parser behind the cJSON subset of the host build
+ *
+ * Accepts RFC 8259 documents. String escapes are decoded except \uXXXX, which becomes '?'
+ * (the turret commands contain no strings). Numbers are saturated into valueint like cJSON does.
+ */
+
+#include "cJSON.h"
+
+#include <ctype.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define MAX_DEPTH 64
+
+typedef struct
+{
+    const char *data;
+    size_t length;
+    size_t pos;
+    int depth;
+} parser_t;
+
+static cJSON *parse_value(parser_t *p);
+
+static void skip_whitespace(parser_t *p)
+{
+    while (p->pos < p->length && isspace((unsigned char)p->data[p->pos]))
+    {
+        p->pos++;
+    }
+}
+
+static bool consume(parser_t *p, char c)
+{
+    skip_whitespace(p);
+    if (p->pos < p->length && p->data[p->pos] == c)
+    {
+        p->pos++;
+        return true;
+    }
+    return false;
+}
+
+static bool consume_literal(parser_t *p, const char *literal)
+{
+    size_t len = strlen(literal);
+    if (p->length - p->pos >= len && strncmp(p->data + p->pos, literal, len) == 0)
+    {
+        p->pos += len;
+        return true;
+    }
+    return false;
+}
+
+static char *parse_string_raw(parser_t *p)
+{
+    if (!consume(p, '"'))
+    {
+        return NULL;
+    }
+
+    // The decoded string is never longer than the encoded one
+    size_t start = p->pos;
+    while (p->pos < p->length && p->data[p->pos] != '"')
+    {
+        p->pos += p->data[p->pos] == '\\' ? 2 : 1;
+    }
+    if (p->pos >= p->length)
+    {
+        return NULL;
+    }
+
+    char *out = malloc(p->pos - start + 1);
+    if (out == NULL)
+    {
+        return NULL;
+    }
+
+    size_t n = 0;
+    for (size_t i = start; i < p->pos; i++)
+    {
+        char c = p->data[i];
+        if (c != '\\')
+        {
+            out[n++] = c;
+            continue;
+        }
+        switch (p->data[++i])
+        {
+        case 'b': out[n++] = '\b'; break;
+        case 'f': out[n++] = '\f'; break;
+        case 'n': out[n++] = '\n'; break;
+        case 'r': out[n++] = '\r'; break;
+        case 't': out[n++] = '\t'; break;
+        case 'u':
+            out[n++] = '?';
+            i += 4;
+            break;
+        default: out[n++] = p->data[i]; break;
+        }
+    }
+    out[n] = '\0';
+    p->pos++; // closing quote
+    return out;
+}
+
+static bool parse_number(parser_t *p, cJSON *item)
+{
+    char buffer[64];
+    size_t n = 0;
+    while (p->pos < p->length && n < sizeof(buffer) - 1 && strchr("+-0123456789.eE", p->data[p->pos]) != NULL)
+    {
+        buffer[n++] = p->data[p->pos++];
+    }
+    buffer[n] = '\0';
+
+    char *end = NULL;
+    double value = strtod(buffer, &end);
+    if (n == 0 || end != buffer + n)
+    {
+        return false;
+    }
+
+    item->type = cJSON_Number;
+    item->valuedouble = value;
+    if (value >= INT_MAX)
+        item->valueint = INT_MAX;
+    else if (value <= (double)INT_MIN)
+        item->valueint = INT_MIN;
+    else
+        item->valueint = (int)value;
+    return true;
+}
+
+static void append_child(cJSON *parent, cJSON *child, cJSON **last)
+{
+    if (*last == NULL)
+    {
+        parent->child = child;
+    }
+    else
+    {
+        (*last)->next = child;
+        child->prev = *last;
+    }
+    *last = child;
+    // cJSON keeps the last element in child->prev
+    parent->child->prev = child;
+}
+
+static bool parse_container(parser_t *p, cJSON *item, bool object)
+{
+    char close = object ? '}' : ']';
+    item->type = object ? cJSON_Object : cJSON_Array;
+
+    if (++p->depth > MAX_DEPTH)
+    {
+        return false;
+    }
+    if (consume(p, close))
+    {
+        p->depth--;
+        return true;
+    }
+
+    cJSON *last = NULL;
+    do
+    {
+        char *key = NULL;
+        if (object)
+        {
+            skip_whitespace(p);
+            key = parse_string_raw(p);
+            if (key == NULL || !consume(p, ':'))
+            {
+                free(key);
+                return false;
+            }
+        }
+
+        cJSON *child = parse_value(p);
+        if (child == NULL)
+        {
+            free(key);
+            return false;
+        }
+        child->string = key;
+        append_child(item, child, &last);
+    } while (consume(p, ','));
+
+    p->depth--;
+    return consume(p, close);
+}
+
+static cJSON *parse_value(parser_t *p)
+{
+    cJSON *item = calloc(1, sizeof(cJSON));
+    if (item == NULL)
+    {
+        return NULL;
+    }
+
+    skip_whitespace(p);
+    bool ok = false;
+    if (p->pos < p->length)
+    {
+        char c = p->data[p->pos];
+        if (c == '{' || c == '[')
+        {
+            p->pos++;
+            ok = parse_container(p, item, c == '{');
+        }
+        else if (c == '"')
+        {
+            item->type = cJSON_String;
+            item->valuestring = parse_string_raw(p);
+            ok = item->valuestring != NULL;
+        }
+        else if (consume_literal(p, "true"))
+        {
+            item->type = cJSON_True;
+            item->valueint = 1;
+            ok = true;
+        }
+        else if (consume_literal(p, "false"))
+        {
+            item->type = cJSON_False;
+            ok = true;
+        }
+        else if (consume_literal(p, "null"))
+        {
+            item->type = cJSON_NULL;
+            ok = true;
+        }
+        else
+        {
+            ok = parse_number(p, item);
+        }
+    }
+
+    if (!ok)
+    {
+        cJSON_Delete(item);
+        return NULL;
+    }
+    return item;
+}
+
+cJSON *cJSON_ParseWithLength(const char *value, size_t buffer_length)
+{
+    if (value == NULL || buffer_length == 0)
+    {
+        return NULL;
+    }
+
+    parser_t p = {.data = value, .length = buffer_length};
+    cJSON *item = parse_value(&p);
+    if (item == NULL)
+    {
+        return NULL;
+    }
+
+    // Only whitespace (or a terminating NUL) may follow the document
+    skip_whitespace(&p);
+    if (p.pos < p.length && p.data[p.pos] != '\0')
+    {
+        cJSON_Delete(item);
+        return NULL;
+    }
+    return item;
+}
+
+cJSON *cJSON_Parse(const char *value)
+{
+    return value != NULL ? cJSON_ParseWithLength(value, strlen(value) + 1) : NULL;
+}
+
+void cJSON_Delete(cJSON *item)
+{
+    while (item != NULL)
+    {
+        cJSON *next = item->next;
+        cJSON_Delete(item->child);
+        free(item->valuestring);
+        free(item->string);
+        free(item);
+        item = next;
+    }
+}
+
+static cJSON *get_object_item(const cJSON *object, const char *string, bool case_sensitive)
+{
+    if (object == NULL || string == NULL || !cJSON_IsObject(object))
+    {
+        return NULL;
+    }
+    for (cJSON *child = object->child; child != NULL; child = child->next)
+    {
+        if (child->string != NULL &&
+            (case_sensitive ? strcmp(child->string, string) : strcasecmp(child->string, string)) == 0)
+        {
+            return child;
+        }
+    }
+    return NULL;
+}
+
+cJSON *cJSON_GetObjectItem(const cJSON *object, const char *string)
+{
+    return get_object_item(object, string, false);
+}
+
+cJSON *cJSON_GetObjectItemCaseSensitive(const cJSON *object, const char *string)
+{
+    return get_object_item(object, string, true);
+}
+
+int cJSON_GetArraySize(const cJSON *array)
+{
+    int size = 0;
+    for (cJSON *child = array ? array->child : NULL; child != NULL; child = child->next)
+    {
+        size++;
+    }
+    return size;
+}
+
+cJSON *cJSON_GetArrayItem(const cJSON *array, int index)
+{
+    cJSON *child = array ? array->child : NULL;
+    while (child != NULL && index-- > 0)
+    {
+        child = child->next;
+    }
+    return index < 0 ? NULL : child;
+}
+
+cJSON_bool cJSON_IsInvalid(const cJSON *item) { return item != NULL && (item->type & 0xFF) == cJSON_Invalid; }
+cJSON_bool cJSON_IsFalse(const cJSON *item) { return item != NULL && (item->type & 0xFF) == cJSON_False; }
+cJSON_bool cJSON_IsTrue(const cJSON *item) { return item != NULL && (item->type & 0xFF) == cJSON_True; }
+cJSON_bool cJSON_IsBool(const cJSON *item) { return item != NULL && (item->type & (cJSON_True | cJSON_False)) != 0; }
+cJSON_bool cJSON_IsNull(const cJSON *item) { return item != NULL && (item->type & 0xFF) == cJSON_NULL; }
+cJSON_bool cJSON_IsNumber(const cJSON *item) { return item != NULL && (item->type & 0xFF) == cJSON_Number; }
+cJSON_bool cJSON_IsString(const cJSON *item) { return item != NULL && (item->type & 0xFF) == cJSON_String; }
+cJSON_bool cJSON_IsArray(const cJSON *item) { return item != NULL && (item->type & 0xFF) == cJSON_Array; }
+cJSON_bool cJSON_IsObject(const cJSON *item) { return item != NULL && (item->type & 0xFF) == cJSON_Object; }
@@ -0,0 +1,140 @@
+/**
+ * @file esp-system.c
+ * @brief esp_err, esp_log and esp_timer for the host build
+ */
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include "sim-clock.h"
+#include "sim-clock-internal.h"
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static _Atomic int64_t boot_time_us = 0;
+static atomic_bool simulated = false;
+static _Atomic int64_t simulated_us = 0;
+static atomic_int log_level = CONFIG_LOG_DEFAULT_LEVEL;
+static pthread_mutex_t log_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static int64_t monotonic_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Runs before main(), the process start is the "boot" of the simulated ESP32
+__attribute__((constructor)) static void esp_system_boot(void)
+{
+    boot_time_us = monotonic_us();
+
+    const char *level = getenv("ESP_LOG_LEVEL");
+    if (level != NULL && *level >= '0' && *level <= '5')
+    {
+        atomic_store(&log_level, *level - '0');
+    }
+}
+
+int64_t esp_timer_get_time(void)
+{
+    if (atomic_load(&simulated))
+    {
+        return atomic_load(&simulated_us);
+    }
+    return monotonic_us() - atomic_load(&boot_time_us);
+}
+
+bool sim_clock_enabled(void)
+{
+    return atomic_load(&simulated);
+}
+
+void sim_clock_set_simulated(bool enable)
+{
+    if (enable == atomic_load(&simulated))
+    {
+        return;
+    }
+
+    // Either way the time continues where the other clock stands
+    if (enable)
+    {
+        atomic_store(&simulated_us, esp_timer_get_time());
+    }
+    else
+    {
+        atomic_store(&boot_time_us, monotonic_us() - atomic_load(&simulated_us));
+    }
+    atomic_store(&simulated, enable);
+}
+
+void sim_clock_set_time(int64_t now_us)
+{
+    atomic_store(&simulated_us, now_us);
+}
+
+uint32_t esp_log_timestamp(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    if (tag != NULL && tag[0] == '*' && tag[1] == '\0')
+    {
+        atomic_store(&log_level, (int)level);
+    }
+}
+
+esp_log_level_t esp_log_level_get(const char *tag)
+{
+    (void)tag;
+    return (esp_log_level_t)atomic_load(&log_level);
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    (void)tag;
+    if ((int)level > atomic_load(&log_level))
+    {
+        return;
+    }
+
+    // One line at a time, the tasks log concurrently
+    va_list args;
+    va_start(args, format);
+    pthread_mutex_lock(&log_mutex);
+    vfprintf(level <= ESP_LOG_WARN ? stderr : stdout, format, args);
+    pthread_mutex_unlock(&log_mutex);
+    va_end(args);
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code)
+    {
+    case ESP_OK: return "ESP_OK";
+    case ESP_FAIL: return "ESP_FAIL";
+    case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_INVALID_RESPONSE: return "ESP_ERR_INVALID_RESPONSE";
+    case ESP_ERR_INVALID_CRC: return "ESP_ERR_INVALID_CRC";
+    case ESP_ERR_INVALID_VERSION: return "ESP_ERR_INVALID_VERSION";
+    case ESP_ERR_INVALID_MAC: return "ESP_ERR_INVALID_MAC";
+    case ESP_ERR_NOT_FINISHED: return "ESP_ERR_NOT_FINISHED";
+    case ESP_ERR_NOT_ALLOWED: return "ESP_ERR_NOT_ALLOWED";
+    }
+    return "UNKNOWN ERROR";
+}
@@ -0,0 +1,339 @@
+/**
+ * @file esp-timer.c
+ * @brief esp_timer one-shot and periodic timers for the host build, and the simulated time that runs them
+ */
+
+#include "esp_timer.h"
+#include "sim-clock.h"
+#include "sim-clock-internal.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+struct esp_timer
+{
+    esp_timer_cb_t callback;
+    void *arg;
+    bool skip_unhandled_events;
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t changed;
+    bool active;
+    bool deleted;
+    bool firing;        // The thread runs the callback
+    int64_t next_us;    // esp_timer_get_time() of the next callback
+    uint64_t period_us; // 0 for one-shot
+    struct esp_timer *next;
+};
+
+// All timers in the order of creation, which is the order sim_clock_advance() fires simultaneous ones in
+static pthread_mutex_t timers_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct esp_timer *timers = NULL;
+
+static void deadline_timespec(int64_t esp_time_us, struct timespec *ts)
+{
+    // esp_timer_get_time() is the monotonic clock shifted by the process start
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    int64_t monotonic_us = (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+    int64_t target_us = monotonic_us + (esp_time_us - esp_timer_get_time());
+    ts->tv_sec = target_us / 1000000;
+    ts->tv_nsec = (target_us % 1000000) * 1000;
+}
+
+// Takes the due callback, called with the timer mutex held
+static bool take_due(struct esp_timer *timer, int64_t now)
+{
+    if (!timer->active || now < timer->next_us)
+    {
+        return false;
+    }
+
+    if (timer->period_us == 0)
+    {
+        timer->active = false;
+    }
+    else
+    {
+        timer->next_us += (int64_t)timer->period_us;
+        if (timer->skip_unhandled_events && timer->next_us <= now)
+        {
+            timer->next_us = now + (int64_t)timer->period_us;
+        }
+    }
+    return true;
+}
+
+static void *timer_thread(void *arg)
+{
+    struct esp_timer *timer = (struct esp_timer *)arg;
+
+    pthread_mutex_lock(&timer->mutex);
+    while (!timer->deleted)
+    {
+        // Under simulated time sim_clock_advance() runs the callbacks
+        if (!timer->active || sim_clock_enabled())
+        {
+            pthread_cond_wait(&timer->changed, &timer->mutex);
+            continue;
+        }
+
+        if (!take_due(timer, esp_timer_get_time()))
+        {
+            struct timespec ts;
+            deadline_timespec(timer->next_us, &ts);
+            pthread_cond_timedwait(&timer->changed, &timer->mutex, &ts);
+            continue;
+        }
+
+        timer->firing = true;
+        pthread_mutex_unlock(&timer->mutex);
+        timer->callback(timer->arg);
+        pthread_mutex_lock(&timer->mutex);
+        timer->firing = false;
+        pthread_cond_broadcast(&timer->changed);
+    }
+    pthread_mutex_unlock(&timer->mutex);
+    return NULL;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *create_args, esp_timer_handle_t *out_handle)
+{
+    if (create_args == NULL || create_args->callback == NULL || out_handle == NULL ||
+        create_args->dispatch_method >= ESP_TIMER_MAX)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    struct esp_timer *timer = calloc(1, sizeof(struct esp_timer));
+    if (timer == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    timer->callback = create_args->callback;
+    timer->arg = create_args->arg;
+    timer->skip_unhandled_events = create_args->skip_unhandled_events;
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&timer->changed, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_mutex_init(&timer->mutex, NULL);
+
+    if (pthread_create(&timer->thread, NULL, timer_thread, timer) != 0)
+    {
+        pthread_mutex_destroy(&timer->mutex);
+        pthread_cond_destroy(&timer->changed);
+        free(timer);
+        return ESP_ERR_NO_MEM;
+    }
+
+    pthread_mutex_lock(&timers_mutex);
+    struct esp_timer **link = &timers;
+    while (*link != NULL)
+    {
+        link = &(*link)->next;
+    }
+    *link = timer;
+    pthread_mutex_unlock(&timers_mutex);
+
+    *out_handle = timer;
+    return ESP_OK;
+}
+
+static esp_err_t start(esp_timer_handle_t timer, uint64_t timeout_us, uint64_t period_us)
+{
+    if (timer == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&timer->mutex);
+    if (timer->active)
+    {
+        pthread_mutex_unlock(&timer->mutex);
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->active = true;
+    timer->next_us = esp_timer_get_time() + (int64_t)timeout_us;
+    timer->period_us = period_us;
+    pthread_cond_broadcast(&timer->changed);
+    pthread_mutex_unlock(&timer->mutex);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    return start(timer, timeout_us, 0);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period)
+{
+    if (period == 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return start(timer, period, period);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    if (timer == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&timer->mutex);
+    if (!timer->active)
+    {
+        pthread_mutex_unlock(&timer->mutex);
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->active = false;
+    pthread_cond_broadcast(&timer->changed);
+    pthread_mutex_unlock(&timer->mutex);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    if (timer == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&timer->mutex);
+    if (timer->active)
+    {
+        pthread_mutex_unlock(&timer->mutex);
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->deleted = true;
+    pthread_cond_broadcast(&timer->changed);
+    pthread_mutex_unlock(&timer->mutex);
+
+    pthread_mutex_lock(&timers_mutex);
+    for (struct esp_timer **link = &timers; *link != NULL; link = &(*link)->next)
+    {
+        if (*link == timer)
+        {
+            *link = timer->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&timers_mutex);
+
+    // A callback that is running right now finishes first, like esp_timer_delete() on the ESP32
+    pthread_join(timer->thread, NULL);
+    pthread_mutex_destroy(&timer->mutex);
+    pthread_cond_destroy(&timer->changed);
+    free(timer);
+    return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer)
+{
+    if (timer == NULL)
+    {
+        return false;
+    }
+
+    pthread_mutex_lock(&timer->mutex);
+    bool active = timer->active;
+    pthread_mutex_unlock(&timer->mutex);
+    return active;
+}
+
+/* ---------------------------------------------------------- simulated time */
+
+void sim_clock_enable(void)
+{
+    sim_clock_set_simulated(true);
+
+    // A callback the thread started before keeps running on the monotonic clock until it returns
+    pthread_mutex_lock(&timers_mutex);
+    for (struct esp_timer *timer = timers; timer != NULL; timer = timer->next)
+    {
+        pthread_mutex_lock(&timer->mutex);
+        pthread_cond_broadcast(&timer->changed);
+        while (timer->firing)
+        {
+            pthread_cond_wait(&timer->changed, &timer->mutex);
+        }
+        pthread_mutex_unlock(&timer->mutex);
+    }
+    pthread_mutex_unlock(&timers_mutex);
+}
+
+void sim_clock_disable(void)
+{
+    sim_clock_set_simulated(false);
+
+    // The threads take their timers over again
+    pthread_mutex_lock(&timers_mutex);
+    for (struct esp_timer *timer = timers; timer != NULL; timer = timer->next)
+    {
+        pthread_mutex_lock(&timer->mutex);
+        pthread_cond_broadcast(&timer->changed);
+        pthread_mutex_unlock(&timer->mutex);
+    }
+    pthread_mutex_unlock(&timers_mutex);
+}
+
+void sim_clock_advance(int64_t us)
+{
+    if (!sim_clock_enabled())
+    {
+        return;
+    }
+
+    int64_t target_us = esp_timer_get_time() + us;
+    for (;;)
+    {
+        // Whatever the last step started runs to its end first
+        host_tasks_wait_idle();
+
+        // The next event: a task timeout, then the timers in the order of creation
+        int64_t next_us = host_tasks_next_deadline();
+        struct esp_timer *due = NULL;
+        pthread_mutex_lock(&timers_mutex);
+        for (struct esp_timer *timer = timers; timer != NULL; timer = timer->next)
+        {
+            pthread_mutex_lock(&timer->mutex);
+            if (timer->active && timer->next_us < next_us)
+            {
+                next_us = timer->next_us;
+                due = timer;
+            }
+            pthread_mutex_unlock(&timer->mutex);
+        }
+        pthread_mutex_unlock(&timers_mutex);
+
+        if (next_us > target_us)
+        {
+            sim_clock_set_time(target_us);
+            return;
+        }
+        if (next_us > esp_timer_get_time())
+        {
+            sim_clock_set_time(next_us);
+        }
+
+        if (due == NULL)
+        {
+            host_tasks_wake_due(esp_timer_get_time());
+            continue;
+        }
+
+        // The tasks are blocked and the callbacks run on this thread, nobody deleted due in between
+        pthread_mutex_lock(&due->mutex);
+        bool fire = take_due(due, esp_timer_get_time());
+        pthread_mutex_unlock(&due->mutex);
+        if (fire)
+        {
+            due->callback(due->arg);
+        }
+    }
+}
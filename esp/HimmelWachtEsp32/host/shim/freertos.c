@@ -0,0 +1,772 @@
+/**
+ * @file freertos.c
+ * @brief FreeRTOS tasks, queues, semaphores and event groups on pthreads
+ *
+ * Every blocking call waits on a condition variable, timeouts count in esp_timer_get_time(). Blocked
+ * tasks wake up at least every DELETE_POLL_US to notice a vTaskDelete() from another task, FreeRTOS
+ * can delete a blocked task at any time and the components rely on that (diff_drive_deinit).
+ *
+ * Each task is either busy or blocked, whoever wakes a task marks it busy again. Under simulated time
+ * (sim-clock.h) a timeout only expires through sim_clock_advance(), which waits for the busy tasks.
+ */
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/event_groups.h"
+#include "esp_timer.h"
+#include "sim-clock.h"
+#include "sim-clock-internal.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DELETE_POLL_US 5000
+#define WAIT_FOREVER -1
+
+struct host_task
+{
+    pthread_t thread;
+    TaskFunction_t function;
+    void *parameters;
+    char name[configMAX_TASK_NAME_LEN];
+    atomic_bool delete_requested;
+    pthread_mutex_t notify_mutex;
+    pthread_cond_t notify_changed;
+    uint32_t notify_value;
+
+    // Guarded by tasks_mutex
+    struct host_task *next;
+    bool blocked;
+    int64_t blocked_until; // Timeout of the wait, WAIT_FOREVER for none
+    pthread_cond_t *blocked_cond;
+    pthread_mutex_t *blocked_mutex;
+};
+
+struct host_queue
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t changed;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t count;
+    UBaseType_t head;
+    uint8_t *storage;
+};
+
+struct host_event_group
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t changed;
+    EventBits_t bits;
+};
+
+static _Thread_local struct host_task *current_task = NULL;
+
+// All tasks and how many of them are busy
+static pthread_mutex_t tasks_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t tasks_idle = PTHREAD_COND_INITIALIZER;
+static struct host_task *tasks = NULL;
+static int busy_tasks = 0;
+
+static int64_t monotonic_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Absolute CLOCK_MONOTONIC time wait_us from now
+static void monotonic_deadline(int64_t wait_us, struct timespec *ts)
+{
+    int64_t wake_us = monotonic_us() + wait_us;
+    ts->tv_sec = wake_us / 1000000;
+    ts->tv_nsec = (wake_us % 1000000) * 1000;
+}
+
+static int64_t ticks_to_deadline(TickType_t ticks)
+{
+    if (ticks == portMAX_DELAY)
+    {
+        return WAIT_FOREVER;
+    }
+    return esp_timer_get_time() + (int64_t)ticks * portTICK_PERIOD_MS * 1000;
+}
+
+static void init_sync(pthread_mutex_t *mutex, pthread_cond_t *cond)
+{
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_mutex_init(mutex, NULL);
+}
+
+/* ------------------------------------------------------ busy and blocked */
+
+// Called with tasks_mutex held
+static void set_busy(struct host_task *task)
+{
+    if (task->blocked)
+    {
+        task->blocked = false;
+        busy_tasks++;
+    }
+}
+
+// Called with tasks_mutex held
+static void signal_if_idle(void)
+{
+    if (busy_tasks == 0)
+    {
+        pthread_cond_broadcast(&tasks_idle);
+    }
+}
+
+static void add_task(struct host_task *task)
+{
+    pthread_mutex_lock(&tasks_mutex);
+    task->next = tasks;
+    tasks = task;
+    busy_tasks++;
+    pthread_mutex_unlock(&tasks_mutex);
+}
+
+static void remove_task(struct host_task *task)
+{
+    pthread_mutex_lock(&tasks_mutex);
+    for (struct host_task **link = &tasks; *link != NULL; link = &(*link)->next)
+    {
+        if (*link == task)
+        {
+            *link = task->next;
+            if (!task->blocked)
+            {
+                busy_tasks--;
+            }
+            break;
+        }
+    }
+    signal_if_idle();
+    pthread_mutex_unlock(&tasks_mutex);
+}
+
+// The calling task blocks on cond with mutex held until deadline_us, the main thread is not counted
+static void set_blocked(pthread_cond_t *cond, pthread_mutex_t *mutex, int64_t deadline_us)
+{
+    if (current_task == NULL)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&tasks_mutex);
+    current_task->blocked = true;
+    current_task->blocked_until = deadline_us;
+    current_task->blocked_cond = cond;
+    current_task->blocked_mutex = mutex;
+    busy_tasks--;
+    signal_if_idle();
+    pthread_mutex_unlock(&tasks_mutex);
+}
+
+static void set_running(void)
+{
+    if (current_task == NULL)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&tasks_mutex);
+    set_busy(current_task);
+    pthread_mutex_unlock(&tasks_mutex);
+}
+
+// Wakes the tasks waiting on cond, called with the mutex of cond held
+static void broadcast(pthread_cond_t *cond)
+{
+    pthread_mutex_lock(&tasks_mutex);
+    for (struct host_task *task = tasks; task != NULL; task = task->next)
+    {
+        if (task->blocked && task->blocked_cond == cond)
+        {
+            set_busy(task);
+        }
+    }
+    pthread_mutex_unlock(&tasks_mutex);
+    pthread_cond_broadcast(cond);
+}
+
+void host_tasks_wait_idle(void)
+{
+    pthread_mutex_lock(&tasks_mutex);
+    while (busy_tasks > 0)
+    {
+        pthread_cond_wait(&tasks_idle, &tasks_mutex);
+    }
+    pthread_mutex_unlock(&tasks_mutex);
+}
+
+int64_t host_tasks_next_deadline(void)
+{
+    int64_t next_us = INT64_MAX;
+    pthread_mutex_lock(&tasks_mutex);
+    for (struct host_task *task = tasks; task != NULL; task = task->next)
+    {
+        if (task->blocked && task->blocked_until != WAIT_FOREVER && task->blocked_until < next_us)
+        {
+            next_us = task->blocked_until;
+        }
+    }
+    pthread_mutex_unlock(&tasks_mutex);
+    return next_us;
+}
+
+void host_tasks_wake_due(int64_t now_us)
+{
+    for (;;)
+    {
+        pthread_cond_t *cond = NULL;
+        pthread_mutex_t *mutex = NULL;
+        pthread_mutex_lock(&tasks_mutex);
+        for (struct host_task *task = tasks; task != NULL; task = task->next)
+        {
+            if (task->blocked && task->blocked_until != WAIT_FOREVER && task->blocked_until <= now_us)
+            {
+                set_busy(task);
+                cond = task->blocked_cond;
+                mutex = task->blocked_mutex;
+                break;
+            }
+        }
+        pthread_mutex_unlock(&tasks_mutex);
+        if (cond == NULL)
+        {
+            return;
+        }
+
+        // With the mutex the task either waits already or has not checked the time yet
+        pthread_mutex_lock(mutex);
+        pthread_cond_broadcast(cond);
+        pthread_mutex_unlock(mutex);
+    }
+}
+
+/* ---------------------------------------------------------------- waiting */
+
+// Ends the calling task if another task deleted it, releases the mutex it is blocked with first
+static void exit_if_deleted(pthread_mutex_t *held)
+{
+    if (current_task != NULL && atomic_load(&current_task->delete_requested))
+    {
+        if (held != NULL)
+        {
+            pthread_mutex_unlock(held);
+        }
+        remove_task(current_task);
+        pthread_exit(NULL);
+    }
+}
+
+/*
+    One wait step on cond, at most until deadline_us (WAIT_FOREVER for none) and at most DELETE_POLL_US.
+    Callers loop until their condition holds, false means the deadline has passed.
+*/
+static bool wait_step(pthread_cond_t *cond, pthread_mutex_t *mutex, int64_t deadline_us)
+{
+    int64_t now = esp_timer_get_time();
+    if (deadline_us != WAIT_FOREVER && now >= deadline_us)
+    {
+        return false;
+    }
+
+    // A simulated deadline is not waited for, sim_clock_advance() wakes the task when it is due
+    int64_t wait_us = DELETE_POLL_US;
+    if (!sim_clock_enabled() && deadline_us != WAIT_FOREVER && deadline_us - now < wait_us)
+    {
+        wait_us = deadline_us - now;
+    }
+
+    struct timespec ts;
+    monotonic_deadline(wait_us, &ts);
+    set_blocked(cond, mutex, deadline_us);
+    pthread_cond_timedwait(cond, mutex, &ts);
+    set_running();
+    exit_if_deleted(mutex);
+    return true;
+}
+
+static void sleep_until(int64_t deadline_us)
+{
+    struct host_task *task = current_task;
+    if (task != NULL)
+    {
+        // Notifications wake the task early, it sleeps on
+        pthread_mutex_lock(&task->notify_mutex);
+        while (wait_step(&task->notify_changed, &task->notify_mutex, deadline_us))
+        {
+        }
+        pthread_mutex_unlock(&task->notify_mutex);
+        return;
+    }
+
+    // The main thread drives the simulated time itself
+    int64_t now;
+    while ((now = esp_timer_get_time()) < deadline_us)
+    {
+        if (sim_clock_enabled())
+        {
+            sim_clock_advance(deadline_us - now);
+            continue;
+        }
+        struct timespec ts;
+        monotonic_deadline(deadline_us - now, &ts);
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+    }
+}
+
+/* ------------------------------------------------------------------ tasks */
+
+static void *task_entry(void *arg)
+{
+    current_task = (struct host_task *)arg;
+    current_task->function(current_task->parameters);
+    remove_task(current_task);
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name, uint32_t stack_depth, void *parameters,
+                                   UBaseType_t priority, TaskHandle_t *created_task, BaseType_t core_id)
+{
+    (void)stack_depth;
+    (void)priority;
+    (void)core_id;
+
+    struct host_task *task = calloc(1, sizeof(struct host_task));
+    if (task == NULL)
+    {
+        return pdFAIL;
+    }
+    task->function = function;
+    task->parameters = parameters;
+    strncpy(task->name, name ? name : "", sizeof(task->name) - 1);
+    atomic_init(&task->delete_requested, false);
+    init_sync(&task->notify_mutex, &task->notify_changed);
+
+    // Busy from the start, sim_clock_advance() waits until it blocks for the first time
+    add_task(task);
+    if (pthread_create(&task->thread, NULL, task_entry, task) != 0)
+    {
+        remove_task(task);
+        free(task);
+        return pdFAIL;
+    }
+    if (created_task != NULL)
+    {
+        *created_task = task;
+    }
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if (task == NULL || task == current_task)
+    {
+        // The handle of a task that deletes itself stays allocated, nobody joins it
+        if (current_task != NULL)
+        {
+            remove_task(current_task);
+        }
+        pthread_detach(pthread_self());
+        pthread_exit(NULL);
+    }
+
+    atomic_store(&task->delete_requested, true);
+    pthread_join(task->thread, NULL);
+    pthread_mutex_destroy(&task->notify_mutex);
+    pthread_cond_destroy(&task->notify_changed);
+    free(task);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    if (ticks == 0)
+    {
+        sched_yield();
+        exit_if_deleted(NULL);
+        return;
+    }
+    sleep_until(esp_timer_get_time() + (int64_t)ticks * portTICK_PERIOD_MS * 1000);
+}
+
+BaseType_t xTaskDelayUntil(TickType_t *previous_wake_time, TickType_t increment)
+{
+    TickType_t wake_tick = *previous_wake_time + increment;
+    TickType_t now_tick = xTaskGetTickCount();
+    *previous_wake_time = wake_tick;
+
+    // Wrap-safe: the wake time lies in the past if it is "behind" the current tick
+    if ((int32_t)(wake_tick - now_tick) <= 0)
+    {
+        exit_if_deleted(NULL);
+        return pdFALSE;
+    }
+    sleep_until(esp_timer_get_time() + (int64_t)(wake_tick - now_tick) * portTICK_PERIOD_MS * 1000);
+    return pdTRUE;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    if (task == NULL)
+    {
+        return pdFAIL;
+    }
+
+    pthread_mutex_lock(&task->notify_mutex);
+    task->notify_value++;
+    broadcast(&task->notify_changed);
+    pthread_mutex_unlock(&task->notify_mutex);
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higher_priority_task_woken)
+{
+    xTaskNotifyGive(task);
+    if (higher_priority_task_woken != NULL)
+    {
+        *higher_priority_task_woken = pdFALSE;
+    }
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_count_on_exit, TickType_t ticks_to_wait)
+{
+    struct host_task *task = current_task;
+    if (task == NULL)
+    {
+        // The main thread is no task and cannot be notified
+        vTaskDelay(ticks_to_wait == portMAX_DELAY ? 0 : ticks_to_wait);
+        return 0;
+    }
+
+    int64_t deadline = ticks_to_deadline(ticks_to_wait);
+    pthread_mutex_lock(&task->notify_mutex);
+    while (task->notify_value == 0 && wait_step(&task->notify_changed, &task->notify_mutex, deadline))
+    {
+    }
+    uint32_t value = task->notify_value;
+    if (value > 0)
+    {
+        task->notify_value = clear_count_on_exit ? 0 : value - 1;
+    }
+    pthread_mutex_unlock(&task->notify_mutex);
+    return value;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(esp_timer_get_time() / ((int64_t)portTICK_PERIOD_MS * 1000));
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return current_task;
+}
+
+const char *pcTaskGetName(TaskHandle_t task)
+{
+    if (task == NULL)
+    {
+        task = current_task;
+    }
+    return task != NULL ? task->name : "main";
+}
+
+/* ----------------------------------------------------------------- queues */
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    if (length == 0)
+    {
+        return NULL;
+    }
+
+    struct host_queue *queue = calloc(1, sizeof(struct host_queue));
+    if (queue == NULL)
+    {
+        return NULL;
+    }
+    if (item_size > 0)
+    {
+        queue->storage = malloc((size_t)length * item_size);
+        if (queue->storage == NULL)
+        {
+            free(queue);
+            return NULL;
+        }
+    }
+    queue->length = length;
+    queue->item_size = item_size;
+    init_sync(&queue->mutex, &queue->changed);
+    return queue;
+}
+
+QueueHandle_t xQueueCreateCountingSemaphore(UBaseType_t max_count, UBaseType_t initial_count)
+{
+    QueueHandle_t queue = xQueueCreate(max_count, 0);
+    if (queue != NULL)
+    {
+        queue->count = initial_count > max_count ? max_count : initial_count;
+    }
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    if (queue == NULL)
+    {
+        return;
+    }
+    pthread_cond_destroy(&queue->changed);
+    pthread_mutex_destroy(&queue->mutex);
+    free(queue->storage);
+    free(queue);
+}
+
+static uint8_t *slot(QueueHandle_t queue, UBaseType_t index)
+{
+    return queue->storage + (size_t)((queue->head + index) % queue->length) * queue->item_size;
+}
+
+// Caller holds the mutex and made sure there is space
+static void put_item(QueueHandle_t queue, const void *item, bool front)
+{
+    if (front)
+    {
+        queue->head = (queue->head + queue->length - 1) % queue->length;
+    }
+    if (queue->item_size > 0)
+    {
+        memcpy(slot(queue, front ? 0 : queue->count), item, queue->item_size);
+    }
+    queue->count++;
+    broadcast(&queue->changed);
+}
+
+static BaseType_t send(QueueHandle_t queue, const void *item, TickType_t ticks_to_wait, bool front)
+{
+    int64_t deadline_us = ticks_to_deadline(ticks_to_wait);
+
+    pthread_mutex_lock(&queue->mutex);
+    while (queue->count == queue->length)
+    {
+        if (!wait_step(&queue->changed, &queue->mutex, deadline_us))
+        {
+            pthread_mutex_unlock(&queue->mutex);
+            return errQUEUE_FULL;
+        }
+    }
+    put_item(queue, item, front);
+    pthread_mutex_unlock(&queue->mutex);
+    return pdPASS;
+}
+
+static BaseType_t receive(QueueHandle_t queue, void *buffer, TickType_t ticks_to_wait, bool remove)
+{
+    int64_t deadline_us = ticks_to_deadline(ticks_to_wait);
+
+    pthread_mutex_lock(&queue->mutex);
+    while (queue->count == 0)
+    {
+        if (!wait_step(&queue->changed, &queue->mutex, deadline_us))
+        {
+            pthread_mutex_unlock(&queue->mutex);
+            return errQUEUE_EMPTY;
+        }
+    }
+    if (queue->item_size > 0 && buffer != NULL)
+    {
+        memcpy(buffer, slot(queue, 0), queue->item_size);
+    }
+    if (remove)
+    {
+        queue->head = (queue->head + 1) % queue->length;
+        queue->count--;
+        broadcast(&queue->changed);
+    }
+    pthread_mutex_unlock(&queue->mutex);
+    return pdPASS;
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void *item, TickType_t ticks_to_wait)
+{
+    return send(queue, item, ticks_to_wait, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void *item, TickType_t ticks_to_wait)
+{
+    return send(queue, item, ticks_to_wait, true);
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void *item)
+{
+    // FreeRTOS only allows overwriting queues of length 1
+    if (queue->length != 1)
+    {
+        return pdFAIL;
+    }
+
+    pthread_mutex_lock(&queue->mutex);
+    queue->count = 0;
+    put_item(queue, item, false);
+    pthread_mutex_unlock(&queue->mutex);
+    return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *buffer, TickType_t ticks_to_wait)
+{
+    return receive(queue, buffer, ticks_to_wait, true);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void *buffer, TickType_t ticks_to_wait)
+{
+    return receive(queue, buffer, ticks_to_wait, false);
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue)
+{
+    pthread_mutex_lock(&queue->mutex);
+    queue->count = 0;
+    queue->head = 0;
+    broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->mutex);
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    pthread_mutex_lock(&queue->mutex);
+    UBaseType_t count = queue->count;
+    pthread_mutex_unlock(&queue->mutex);
+    return count;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue)
+{
+    pthread_mutex_lock(&queue->mutex);
+    UBaseType_t spaces = queue->length - queue->count;
+    pthread_mutex_unlock(&queue->mutex);
+    return spaces;
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void *item, BaseType_t *higher_priority_task_woken)
+{
+    if (higher_priority_task_woken != NULL)
+    {
+        *higher_priority_task_woken = pdFALSE;
+    }
+    return send(queue, item, 0, false);
+}
+
+BaseType_t xQueueOverwriteFromISR(QueueHandle_t queue, const void *item, BaseType_t *higher_priority_task_woken)
+{
+    if (higher_priority_task_woken != NULL)
+    {
+        *higher_priority_task_woken = pdFALSE;
+    }
+    return xQueueOverwrite(queue, item);
+}
+
+BaseType_t xQueueReceiveFromISR(QueueHandle_t queue, void *buffer, BaseType_t *higher_priority_task_woken)
+{
+    if (higher_priority_task_woken != NULL)
+    {
+        *higher_priority_task_woken = pdFALSE;
+    }
+    return receive(queue, buffer, 0, true);
+}
+
+/* ----------------------------------------------------------- event groups */
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+    struct host_event_group *group = calloc(1, sizeof(struct host_event_group));
+    if (group != NULL)
+    {
+        init_sync(&group->mutex, &group->changed);
+    }
+    return group;
+}
+
+void vEventGroupDelete(EventGroupHandle_t group)
+{
+    if (group == NULL)
+    {
+        return;
+    }
+    pthread_cond_destroy(&group->changed);
+    pthread_mutex_destroy(&group->mutex);
+    free(group);
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    pthread_mutex_lock(&group->mutex);
+    group->bits |= bits;
+    EventBits_t result = group->bits;
+    broadcast(&group->changed);
+    pthread_mutex_unlock(&group->mutex);
+    return result;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    pthread_mutex_lock(&group->mutex);
+    EventBits_t before = group->bits;
+    group->bits &= ~bits;
+    pthread_mutex_unlock(&group->mutex);
+    return before;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group)
+{
+    pthread_mutex_lock(&group->mutex);
+    EventBits_t bits = group->bits;
+    pthread_mutex_unlock(&group->mutex);
+    return bits;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear_on_exit,
+                                BaseType_t wait_for_all, TickType_t ticks_to_wait)
+{
+    int64_t deadline_us = ticks_to_deadline(ticks_to_wait);
+
+    pthread_mutex_lock(&group->mutex);
+    for (;;)
+    {
+        bool satisfied = wait_for_all ? (group->bits & bits) == bits : (group->bits & bits) != 0;
+        if (satisfied)
+        {
+            break;
+        }
+        if (!wait_step(&group->changed, &group->mutex, deadline_us))
+        {
+            EventBits_t result = group->bits;
+            pthread_mutex_unlock(&group->mutex);
+            return result;
+        }
+    }
+
+    // Like FreeRTOS: the value before clearing is returned
+    EventBits_t result = group->bits;
+    if (clear_on_exit)
+    {
+        group->bits &= ~bits;
+    }
+    pthread_mutex_unlock(&group->mutex);
+    return result;
+}
@@ -0,0 +1,21 @@
+/**
+ * @file i2c_types.h
+ * @brief ESP-IDF I2C master types for the host build
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "soc/clk_tree_defs.h"
+
+typedef int i2c_port_num_t;
+
+typedef enum
+{
+    I2C_ADDR_BIT_LEN_7 = 0,
+    I2C_ADDR_BIT_LEN_10 = 1
+} i2c_addr_bit_len_t;
+
+typedef struct i2c_master_bus_t *i2c_master_bus_handle_t;
+typedef struct i2c_master_dev_t *i2c_master_dev_handle_t;
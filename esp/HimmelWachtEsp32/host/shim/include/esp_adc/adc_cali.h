@@ -0,0 +1,20 @@
+/**
+ * @file adc_cali.h
+ * @brief ESP-IDF ADC calibration (esp_adc/adc_cali.h) for the host build, backed by sim/adc.c
+ */
+
+#pragma once
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct adc_cali_scheme_t *adc_cali_handle_t;
+
+esp_err_t adc_cali_raw_to_voltage(adc_cali_handle_t handle, int raw, int *voltage);
+
+#ifdef __cplusplus
+}
+#endif
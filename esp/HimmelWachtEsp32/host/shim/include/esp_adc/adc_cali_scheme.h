@@ -0,0 +1,33 @@
+/**
+ * @file adc_cali_scheme.h
+ * @brief ESP-IDF ADC calibration schemes (esp_adc/adc_cali_scheme.h) for the host build
+ *
+ * The ESP32 has the line fitting scheme. The simulated ADC is linear, so the scheme converts with the
+ * nominal full scale voltage of the attenuation.
+ */
+
+#pragma once
+
+#include "esp_adc/adc_cali.h"
+#include "hal/adc_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ADC_CALI_SCHEME_LINE_FITTING_SUPPORTED 1
+
+typedef struct
+{
+    adc_unit_t unit_id;
+    adc_atten_t atten;
+    adc_bitwidth_t bitwidth;
+    uint32_t default_vref;
+} adc_cali_line_fitting_config_t;
+
+esp_err_t adc_cali_create_scheme_line_fitting(const adc_cali_line_fitting_config_t *config, adc_cali_handle_t *ret_handle);
+esp_err_t adc_cali_delete_scheme_line_fitting(adc_cali_handle_t handle);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,12 @@
+/**
+ * @file esp_attr.h
+ * @brief ESP-IDF memory placement attributes, no-ops on the host
+ */
+
+#pragma once
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define RTC_DATA_ATTR
+#define FORCE_INLINE_ATTR static inline __attribute__((always_inline))
+#define NOINLINE_ATTR __attribute__((noinline))
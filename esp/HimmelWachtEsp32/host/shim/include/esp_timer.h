@@ -0,0 +1,57 @@
+/**
+ * @file esp_timer.h
+ * @brief ESP-IDF high resolution timer for the host build
+ *
+ * Every timer has its own thread sleeping on absolute monotonic deadlines, callbacks therefore run
+ * in "task" context like ESP_TIMER_TASK on the ESP32. A periodic timer that fell behind fires the
+ * missed periods back to back unless skip_unhandled_events is set. Under simulated time (sim-clock.h)
+ * sim_clock_advance() runs the callbacks instead.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Microseconds since start of the process (monotonic clock), like the time since boot on the ESP32
+ *
+ * Stands still while the clock is simulated, see sim-clock.h.
+ */
+int64_t esp_timer_get_time(void);
+
+typedef struct esp_timer *esp_timer_handle_t;
+typedef void (*esp_timer_cb_t)(void *arg);
+
+typedef enum
+{
+    ESP_TIMER_TASK,
+    ESP_TIMER_ISR,
+    ESP_TIMER_MAX
+} esp_timer_dispatch_t;
+
+typedef struct
+{
+    esp_timer_cb_t callback;
+    void *arg;
+    esp_timer_dispatch_t dispatch_method;
+    const char *name;
+    bool skip_unhandled_events;
+} esp_timer_create_args_t;
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *create_args, esp_timer_handle_t *out_handle);
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us);
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period);
+esp_err_t esp_timer_stop(esp_timer_handle_t timer);
+esp_err_t esp_timer_delete(esp_timer_handle_t timer);
+bool esp_timer_is_active(esp_timer_handle_t timer);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,10 @@
+/**
+ * @file esp_wifi.h
+ * @brief Placeholder, the host build has no Wi-Fi (wifi-stack is not part of it)
+ *
+ * mqtt-stack.c includes the header but uses none of its declarations.
+ */
+
+#pragma once
+
+#include "esp_err.h"
@@ -0,0 +1,31 @@
+/**
+ * @file FreeRTOS.h
+ * @brief FreeRTOS subset for the host build, implemented on pthreads (shim/freertos.c)
+ *
+ * Tasks are threads, the priority and the core affinity are accepted but ignored. Ticks are derived from
+ * the monotonic clock with the tick rate of the firmware, so timeouts and delays have the same granularity
+ * as on the ESP32.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sdkconfig.h"
+
+#define configTICK_RATE_HZ CONFIG_FREERTOS_HZ
+#define configMAX_TASK_NAME_LEN 16
+
+#include "freertos/portmacro.h"
+
+#define pdFALSE ((BaseType_t)0)
+#define pdTRUE ((BaseType_t)1)
+#define pdFAIL pdFALSE
+#define pdPASS pdTRUE
+#define errQUEUE_EMPTY ((BaseType_t)0)
+#define errQUEUE_FULL ((BaseType_t)0)
+
+#define pdMS_TO_TICKS(ms) ((TickType_t)(((uint64_t)(ms) * (uint64_t)configTICK_RATE_HZ) / 1000U))
+#define pdTICKS_TO_MS(ticks) ((uint32_t)(((uint64_t)(ticks) * 1000U) / (uint64_t)configTICK_RATE_HZ))
@@ -0,0 +1,31 @@
+/**
+ * @file event_groups.h
+ * @brief FreeRTOS event groups of the host shim
+ */
+
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct host_event_group *EventGroupHandle_t;
+typedef uint32_t EventBits_t;
+
+EventGroupHandle_t xEventGroupCreate(void);
+void vEventGroupDelete(EventGroupHandle_t group);
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits);
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits);
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group);
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear_on_exit,
+                                BaseType_t wait_for_all, TickType_t ticks_to_wait);
+
+#define xEventGroupGetBitsFromISR(group) xEventGroupGetBits(group)
+#define xEventGroupSetBitsFromISR(group, bits, woken) (xEventGroupSetBits((group), (bits)), pdPASS)
+
+#ifdef __cplusplus
+}
+#endif
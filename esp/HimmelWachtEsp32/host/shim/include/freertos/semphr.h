@@ -0,0 +1,21 @@
+/**
+ * @file semphr.h
+ * @brief FreeRTOS semaphores of the host shim, queues with item size 0 like in FreeRTOS
+ */
+
+#pragma once
+
+#include "freertos/queue.h"
+
+typedef QueueHandle_t SemaphoreHandle_t;
+
+#define xSemaphoreCreateBinary() xQueueCreate(1, 0)
+#define xSemaphoreCreateCounting(max_count, initial_count) xQueueCreateCountingSemaphore((max_count), (initial_count))
+#define xSemaphoreCreateMutex() xQueueCreateCountingSemaphore(1, 1)
+#define vSemaphoreDelete(semaphore) vQueueDelete(semaphore)
+
+#define xSemaphoreTake(semaphore, ticks_to_wait) xQueueReceive((semaphore), NULL, (ticks_to_wait))
+#define xSemaphoreGive(semaphore) xQueueSendToBack((semaphore), NULL, 0)
+#define xSemaphoreTakeFromISR(semaphore, woken) xQueueReceiveFromISR((semaphore), NULL, (woken))
+#define xSemaphoreGiveFromISR(semaphore, woken) xQueueSendFromISR((semaphore), NULL, (woken))
+#define uxSemaphoreGetCount(semaphore) uxQueueMessagesWaiting(semaphore)
@@ -0,0 +1,14 @@
+/**
+ * @file sdkconfig.h
+ * @brief Host build subset of the generated sdkconfig.h
+ *
+ * Only the options the components and the shims read, with the values of esp/HimmelWachtEsp32/sdkconfig.
+ * Keep both in sync when the tick rate or the log level changes.
+ */
+
+#pragma once
+
+#define CONFIG_IDF_TARGET "linux"
+#define CONFIG_FREERTOS_HZ 100
+#define CONFIG_FREERTOS_NUMBER_OF_CORES 2
+#define CONFIG_LOG_DEFAULT_LEVEL 3
@@ -0,0 +1,43 @@
+/**
+ * @file sim-clock.h
+ * @brief Simulated time of the host build, instead of the monotonic clock
+ *
+ * While enabled esp_timer_get_time() stands still and only sim_clock_advance() moves it on. The
+ * advance runs the due esp_timer callbacks on the calling thread and wakes the tasks whose timeouts
+ * expire, each at its exact time, and waits after every step until all tasks block again. A test that
+ * drives the time from the main thread therefore gets the same result on every run, however loaded
+ * the host is. The main thread is no task: it must not block on the FreeRTOS objects with a timeout
+ * while the clock is simulated, vTaskDelay() advances the clock instead.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Freezes esp_timer_get_time() at its current value, waits for a running timer callback first
+ */
+void sim_clock_enable(void);
+
+/**
+ * @brief Back to the monotonic clock, the time continues from the simulated one
+ */
+void sim_clock_disable(void);
+
+bool sim_clock_enabled(void);
+
+/**
+ * @brief Moves the simulated time on by us, with all timer callbacks and task wake-ups on the way
+ *
+ * Returns when the time is reached and every task is blocked again.
+ */
+void sim_clock_advance(int64_t us);
+
+#ifdef __cplusplus
+}
+#endif
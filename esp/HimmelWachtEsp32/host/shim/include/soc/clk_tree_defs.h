@@ -0,0 +1,18 @@
+/**
+ * @file clk_tree_defs.h
+ * @brief Clock sources of the ESP32 peripherals used by the host build
+ */
+
+#pragma once
+
+typedef enum
+{
+    I2C_CLK_SRC_APB = 0,
+    I2C_CLK_SRC_DEFAULT = I2C_CLK_SRC_APB
+} i2c_clock_source_t;
+
+typedef enum
+{
+    MCPWM_TIMER_CLK_SRC_PLL160M = 0,
+    MCPWM_TIMER_CLK_SRC_DEFAULT = MCPWM_TIMER_CLK_SRC_PLL160M
+} mcpwm_timer_clock_source_t;
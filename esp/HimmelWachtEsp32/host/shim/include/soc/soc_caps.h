@@ -0,0 +1,18 @@
+/**
+ * @file soc_caps.h
+ * @brief Peripheral counts of the ESP32 used by the host build
+ */
+
+#pragma once
+
+#define SOC_MCPWM_GROUPS 2
+#define SOC_MCPWM_TIMERS_PER_GROUP 3
+#define SOC_MCPWM_OPERATORS_PER_GROUP 3
+#define SOC_MCPWM_COMPARATORS_PER_OPERATOR 2
+#define SOC_MCPWM_GENERATORS_PER_OPERATOR 2
+
+#define SOC_ADC_DIGI_MAX_BITWIDTH 12
+#define SOC_ADC_DIGI_DATA_BYTES_PER_CONV 2
+#define SOC_ADC_SAMPLE_FREQ_THRES_LOW 20000
+#define SOC_ADC_SAMPLE_FREQ_THRES_HIGH 2000000
+#define SOC_ADC_PATT_LEN_MAX 16
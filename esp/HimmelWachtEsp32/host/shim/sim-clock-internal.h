@@ -0,0 +1,22 @@
+/**
+ * @file sim-clock-internal.h
+ * @brief What the shim parts behind sim-clock.h provide each other
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// esp-system.c: switches esp_timer_get_time() between the monotonic clock and the simulated time
+void sim_clock_set_simulated(bool enable);
+void sim_clock_set_time(int64_t now_us);
+
+// freertos.c: waits until every task is blocked
+void host_tasks_wait_idle(void);
+
+// freertos.c: earliest timeout of a blocked task, INT64_MAX if none waits with one
+int64_t host_tasks_next_deadline(void);
+
+// freertos.c: wakes the blocked tasks whose timeout is at or before now_us
+void host_tasks_wake_due(int64_t now_us);
@@ -0,0 +1,325 @@
+/**
+ * @file adc.c
+ * @brief Simulated ADC1 of the host build in continuous (DMA) mode
+ *
+ * Every channel has a voltage, set by the test or a motor plant (adc_sim_set_voltage()). A read first
+ * converts everything that the pattern sampled since the previous read at sample_freq_hz, each value
+ * with +-2 LSB noise, into a ring of max_store_buf_size bytes that drops the oldest conversions when it
+ * overflows. The ADC is linear from 0 mV to the nominal full scale of the attenuation.
+ */
+
+#include "esp_adc/adc_continuous.h"
+#include "esp_adc/adc_cali_scheme.h"
+#include "hw-sim.h"
+#include "motor-plant-sim.h"
+#include "esp_timer.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define ADC_SIM_CHANNELS 10
+#define ADC_SIM_MAX_RAW 4095
+
+struct adc_continuous_ctx_t
+{
+    bool in_use;
+    bool configured;
+    bool running;
+    uint32_t capacity; // Conversions the ring holds
+    uint16_t *ring;
+    uint32_t head;     // Oldest conversion
+    uint32_t count;
+    adc_digi_pattern_config_t pattern[SOC_ADC_PATT_LEN_MAX];
+    uint32_t pattern_num;
+    uint32_t pattern_pos;
+    uint32_t sample_freq_hz;
+    int64_t next_ns;   // Time of the next conversion
+    uint32_t dropped;
+};
+
+struct adc_cali_scheme_t
+{
+    adc_atten_t atten;
+};
+
+static struct adc_continuous_ctx_t ctx;
+static int channel_mv[ADC_SIM_CHANNELS];
+static uint32_t noise_state = 12345;
+static pthread_mutex_t adc_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static int full_scale_mv(adc_atten_t atten)
+{
+    static const int full_scale[] = {950, 1250, 1750, 2450};
+    return atten <= ADC_ATTEN_DB_12 ? full_scale[atten] : full_scale[ADC_ATTEN_DB_12];
+}
+
+// -2 .. 2 LSB, deterministic for reproducible tests
+static int noise(void)
+{
+    noise_state = noise_state * 1103515245u + 12345u;
+    return (int)((noise_state >> 16) % 5) - 2;
+}
+
+static uint16_t convert(const adc_digi_pattern_config_t *pattern)
+{
+    int raw = (channel_mv[pattern->channel] * ADC_SIM_MAX_RAW + full_scale_mv(pattern->atten) / 2) / full_scale_mv(pattern->atten) + noise();
+    raw = raw < 0 ? 0 : raw > ADC_SIM_MAX_RAW ? ADC_SIM_MAX_RAW : raw;
+
+    adc_digi_output_data_t data = {.type1 = {.data = (uint16_t)raw, .channel = pattern->channel}};
+    return data.val;
+}
+
+// Converts up to now, called with adc_mutex held
+static void sample(void)
+{
+    int64_t now_ns = esp_timer_get_time() * 1000;
+    if (!ctx.running || now_ns < ctx.next_ns)
+    {
+        return;
+    }
+
+    int64_t period_ns = 1000000000 / ctx.sample_freq_hz;
+    int64_t due = (now_ns - ctx.next_ns) / period_ns + 1;
+    ctx.next_ns += due * period_ns;
+
+    // After a long pause only the newest conversions survive in the ring
+    if (due > ctx.capacity)
+    {
+        ctx.dropped += (uint32_t)(due - ctx.capacity);
+        ctx.pattern_pos = (uint32_t)((ctx.pattern_pos + due - ctx.capacity) % ctx.pattern_num);
+        due = ctx.capacity;
+    }
+
+    for (int64_t i = 0; i < due; i++)
+    {
+        if (ctx.count == ctx.capacity)
+        {
+            ctx.head = (ctx.head + 1) % ctx.capacity;
+            ctx.count--;
+            ctx.dropped++;
+        }
+        ctx.ring[(ctx.head + ctx.count) % ctx.capacity] = convert(&ctx.pattern[ctx.pattern_pos]);
+        ctx.count++;
+        ctx.pattern_pos = (ctx.pattern_pos + 1) % ctx.pattern_num;
+    }
+}
+
+esp_err_t adc_continuous_new_handle(const adc_continuous_handle_cfg_t *hdl_config, adc_continuous_handle_t *ret_handle)
+{
+    if (hdl_config == NULL || ret_handle == NULL || hdl_config->conv_frame_size == 0 ||
+        hdl_config->conv_frame_size % SOC_ADC_DIGI_DATA_BYTES_PER_CONV != 0 ||
+        hdl_config->max_store_buf_size < hdl_config->conv_frame_size)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&adc_mutex);
+    esp_err_t ret = ESP_OK;
+    if (ctx.in_use)
+    {
+        // There is one DMA controller for the ADC
+        ret = ESP_ERR_INVALID_STATE;
+    }
+    else
+    {
+        uint32_t capacity = hdl_config->max_store_buf_size / SOC_ADC_DIGI_DATA_BYTES_PER_CONV;
+        uint16_t *ring = calloc(capacity, sizeof(uint16_t));
+        if (ring == NULL)
+        {
+            ret = ESP_ERR_NO_MEM;
+        }
+        else
+        {
+            ctx = (struct adc_continuous_ctx_t){.in_use = true, .capacity = capacity, .ring = ring};
+            *ret_handle = &ctx;
+        }
+    }
+    pthread_mutex_unlock(&adc_mutex);
+    return ret;
+}
+
+esp_err_t adc_continuous_config(adc_continuous_handle_t handle, const adc_continuous_config_t *config)
+{
+    if (handle == NULL || config == NULL || config->adc_pattern == NULL || config->pattern_num == 0 ||
+        config->pattern_num > SOC_ADC_PATT_LEN_MAX || config->sample_freq_hz < SOC_ADC_SAMPLE_FREQ_THRES_LOW ||
+        config->sample_freq_hz > SOC_ADC_SAMPLE_FREQ_THRES_HIGH || config->conv_mode != ADC_CONV_SINGLE_UNIT_1 ||
+        config->format != ADC_DIGI_OUTPUT_FORMAT_TYPE1)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (uint32_t i = 0; i < config->pattern_num; i++)
+    {
+        if (config->adc_pattern[i].unit != ADC_UNIT_1 || config->adc_pattern[i].channel >= ADC_SIM_CHANNELS ||
+            config->adc_pattern[i].atten > ADC_ATTEN_DB_12)
+        {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+    pthread_mutex_lock(&adc_mutex);
+    esp_err_t ret = handle->running ? ESP_ERR_INVALID_STATE : ESP_OK;
+    if (ret == ESP_OK)
+    {
+        for (uint32_t i = 0; i < config->pattern_num; i++)
+        {
+            handle->pattern[i] = config->adc_pattern[i];
+        }
+        handle->pattern_num = config->pattern_num;
+        handle->sample_freq_hz = config->sample_freq_hz;
+        handle->configured = true;
+    }
+    pthread_mutex_unlock(&adc_mutex);
+    return ret;
+}
+
+esp_err_t adc_continuous_start(adc_continuous_handle_t handle)
+{
+    if (handle == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&adc_mutex);
+    esp_err_t ret = !handle->configured || handle->running ? ESP_ERR_INVALID_STATE : ESP_OK;
+    if (ret == ESP_OK)
+    {
+        handle->running = true;
+        handle->pattern_pos = 0;
+        handle->next_ns = esp_timer_get_time() * 1000;
+    }
+    pthread_mutex_unlock(&adc_mutex);
+    return ret;
+}
+
+esp_err_t adc_continuous_read(adc_continuous_handle_t handle, uint8_t *buf, uint32_t length_max, uint32_t *out_length, uint32_t timeout_ms)
+{
+    if (handle == NULL || buf == NULL || out_length == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Channel voltages of the plants up to now
+    motor_plant_sim_sync();
+
+    pthread_mutex_lock(&adc_mutex);
+    esp_err_t ret = handle->running ? ESP_OK : ESP_ERR_INVALID_STATE;
+    if (ret == ESP_OK)
+    {
+        sample();
+        if (handle->count == 0 && timeout_ms > 0)
+        {
+            // Wait for one conversion at most, a longer timeout is not needed by the firmware
+            pthread_mutex_unlock(&adc_mutex);
+            usleep(1000000 / handle->sample_freq_hz + 1);
+            pthread_mutex_lock(&adc_mutex);
+            sample();
+        }
+
+        uint32_t n = length_max / SOC_ADC_DIGI_DATA_BYTES_PER_CONV;
+        n = n < handle->count ? n : handle->count;
+        uint16_t *out = (uint16_t *)buf;
+        for (uint32_t i = 0; i < n; i++)
+        {
+            out[i] = handle->ring[handle->head];
+            handle->head = (handle->head + 1) % handle->capacity;
+        }
+        handle->count -= n;
+        *out_length = n * SOC_ADC_DIGI_DATA_BYTES_PER_CONV;
+        ret = n > 0 ? ESP_OK : ESP_ERR_TIMEOUT;
+    }
+    pthread_mutex_unlock(&adc_mutex);
+    return ret;
+}
+
+esp_err_t adc_continuous_stop(adc_continuous_handle_t handle)
+{
+    if (handle == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&adc_mutex);
+    esp_err_t ret = handle->running ? ESP_OK : ESP_ERR_INVALID_STATE;
+    handle->running = false;
+    pthread_mutex_unlock(&adc_mutex);
+    return ret;
+}
+
+esp_err_t adc_continuous_deinit(adc_continuous_handle_t handle)
+{
+    if (handle == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&adc_mutex);
+    esp_err_t ret = handle->running ? ESP_ERR_INVALID_STATE : ESP_OK;
+    if (ret == ESP_OK)
+    {
+        free(handle->ring);
+        *handle = (struct adc_continuous_ctx_t){0};
+    }
+    pthread_mutex_unlock(&adc_mutex);
+    return ret;
+}
+
+esp_err_t adc_cali_create_scheme_line_fitting(const adc_cali_line_fitting_config_t *config, adc_cali_handle_t *ret_handle)
+{
+    if (config == NULL || ret_handle == NULL || config->unit_id != ADC_UNIT_1 || config->atten > ADC_ATTEN_DB_12)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    struct adc_cali_scheme_t *scheme = malloc(sizeof(struct adc_cali_scheme_t));
+    if (scheme == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    scheme->atten = config->atten;
+    *ret_handle = scheme;
+    return ESP_OK;
+}
+
+esp_err_t adc_cali_delete_scheme_line_fitting(adc_cali_handle_t handle)
+{
+    if (handle == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    free(handle);
+    return ESP_OK;
+}
+
+esp_err_t adc_cali_raw_to_voltage(adc_cali_handle_t handle, int raw, int *voltage)
+{
+    if (handle == NULL || voltage == NULL || raw < 0 || raw > ADC_SIM_MAX_RAW)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    *voltage = (raw * full_scale_mv(handle->atten) + ADC_SIM_MAX_RAW / 2) / ADC_SIM_MAX_RAW;
+    return ESP_OK;
+}
+
+void adc_sim_set_voltage(int channel, int mv)
+{
+    if (channel < 0 || channel >= ADC_SIM_CHANNELS)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&adc_mutex);
+    channel_mv[channel] = mv < 0 ? 0 : mv;
+    pthread_mutex_unlock(&adc_mutex);
+}
+
+uint32_t adc_sim_get_dropped(void)
+{
+    pthread_mutex_lock(&adc_mutex);
+    uint32_t dropped = ctx.dropped;
+    pthread_mutex_unlock(&adc_mutex);
+    return dropped;
+}
@@ -0,0 +1,80 @@
+/**
+ * @file ds4-sim.c
+ * @brief Simulated DualShock 4 controller of the host build
+ */
+
+#include "ds4-sim.h"
+#include "ds4-common.h"
+#include "hw-trace.h"
+
+#include <esp_log.h>
+
+#define TAG "DS4 Sim"
+
+QueueHandle_t ds4_input_queue = NULL;
+
+EventGroupHandle_t ds4_event_group = NULL;
+
+esp_err_t ds4_init(void){
+    ds4_event_group = xEventGroupCreate();
+    if(ds4_event_group == NULL){
+        ESP_LOGE(TAG, "Failed to create event group");
+        return ESP_FAIL;
+    }
+
+    // One slot, the newest report wins (same as ds4-driver.c)
+    ds4_input_queue = xQueueCreate(1, sizeof(ds4_input_t));
+    if(ds4_input_queue == NULL){
+        ESP_LOGE(TAG, "Failed to create input queue");
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "DS4 simulation initialized");
+    return ESP_OK;
+}
+
+esp_err_t ds4_rumble(uint16_t start_delay_ms, uint16_t duration_ms, uint8_t weak_magnitude, uint8_t strong_magnitude){
+    const uint8_t data[4] = {start_delay_ms & 0xFF, start_delay_ms >> 8, weak_magnitude, strong_magnitude};
+    hw_trace_record(HW_TRACE_DS4_RUMBLE, 0, duration_ms, data, sizeof(data));
+    return ESP_OK;
+}
+
+esp_err_t ds4_lightbar_color(uint8_t red, uint8_t green, uint8_t blue){
+    // The driver keeps the low battery blinking and drops color events
+    if(xEventGroupGetBits(ds4_event_group) & DS4_BATTERY_LOW){
+        return ESP_OK;
+    }
+
+    const uint8_t data[3] = {red, green, blue};
+    hw_trace_record(HW_TRACE_DS4_LIGHTBAR, 0, 0, data, sizeof(data));
+    return ESP_OK;
+}
+
+bool ds4_is_connected(void){
+    return xEventGroupGetBits(ds4_event_group) & DS4_CONNECTED ? true : false;
+}
+
+void ds4_wait_for_connection(void){
+    xEventGroupWaitBits(ds4_event_group, DS4_CONNECTED, pdFALSE, pdTRUE, portMAX_DELAY);
+}
+
+void ds4_sim_set_connected(bool connected){
+    if(connected){
+        xEventGroupSetBits(ds4_event_group, DS4_CONNECTED);
+    } else {
+        xEventGroupClearBits(ds4_event_group, DS4_CONNECTED);
+    }
+}
+
+void ds4_sim_set_battery_low(bool low){
+    if(low){
+        xEventGroupSetBits(ds4_event_group, DS4_BATTERY_LOW);
+    } else {
+        xEventGroupClearBits(ds4_event_group, DS4_BATTERY_LOW);
+    }
+}
+
+void ds4_sim_send_input(const ds4_input_t *input){
+    hw_trace_record(HW_TRACE_DS4_INPUT, 0, 0, input, sizeof(*input));
+    xQueueOverwrite(ds4_input_queue, input);
+}
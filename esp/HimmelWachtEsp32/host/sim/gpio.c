@@ -0,0 +1,76 @@
+/**
+ * @file gpio.c
+ * @brief Simulated GPIO pins of the host build
+ */
+
+#include "driver/gpio.h"
+#include "hw-sim.h"
+#include "hw-trace.h"
+
+#include <stdatomic.h>
+
+static atomic_int levels[GPIO_NUM_MAX];
+static atomic_bool isr_service_installed = false;
+
+__attribute__((constructor)) static void gpio_sim_init(void)
+{
+    for (int i = 0; i < GPIO_NUM_MAX; i++)
+    {
+        atomic_init(&levels[i], -1);
+    }
+}
+
+static bool valid_pin(int gpio_num)
+{
+    return gpio_num >= 0 && gpio_num < GPIO_NUM_MAX;
+}
+
+esp_err_t gpio_config(const gpio_config_t *config)
+{
+    if (config == NULL || config->pin_bit_mask == 0 || (config->pin_bit_mask >> GPIO_NUM_MAX) != 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    for (int pin = 0; pin < GPIO_NUM_MAX; pin++)
+    {
+        if (config->pin_bit_mask & (1ULL << pin))
+        {
+            hw_trace_record(HW_TRACE_GPIO_CONFIG, (uint16_t)pin, (float)config->mode, NULL, 0);
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level)
+{
+    if (!valid_pin(gpio_num))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    level = level ? 1 : 0;
+    atomic_store(&levels[gpio_num], (int)level);
+    hw_trace_record(HW_TRACE_GPIO_LEVEL, (uint16_t)gpio_num, (float)level, NULL, 0);
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num)
+{
+    int level = valid_pin(gpio_num) ? atomic_load(&levels[gpio_num]) : 0;
+    return level < 0 ? 0 : level;
+}
+
+esp_err_t gpio_install_isr_service(int intr_alloc_flags)
+{
+    (void)intr_alloc_flags;
+
+    // Like ESP-IDF: installing twice is an error
+    bool expected = false;
+    return atomic_compare_exchange_strong(&isr_service_installed, &expected, true) ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+int gpio_sim_get_level(gpio_num_t gpio_num)
+{
+    return valid_pin(gpio_num) ? atomic_load(&levels[gpio_num]) : -1;
+}
@@ -0,0 +1,162 @@
+/**
+ * @file hw-trace.c
+ * @brief Ring buffer of the simulated hardware writes
+ */
+
+#include "hw-trace.h"
+#include "esp_timer.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+static hw_trace_event_t events[HW_TRACE_CAPACITY];
+static size_t recorded = 0;
+static pthread_mutex_t trace_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static const char *const kind_names[HW_TRACE_KIND_COUNT] = {
+    [HW_TRACE_GPIO_CONFIG] = "gpio_config",
+    [HW_TRACE_GPIO_LEVEL] = "gpio_level",
+    [HW_TRACE_MCPWM_INIT] = "mcpwm_init",
+    [HW_TRACE_MCPWM_DUTY] = "mcpwm_duty",
+    [HW_TRACE_I2C_WRITE] = "i2c_write",
+    [HW_TRACE_DS4_RUMBLE] = "ds4_rumble",
+    [HW_TRACE_DS4_LIGHTBAR] = "ds4_lightbar",
+    [HW_TRACE_MQTT_PUBLISH] = "mqtt_publish",
+    [HW_TRACE_DS4_INPUT] = "ds4_input",
+    [HW_TRACE_MQTT_RECEIVE] = "mqtt_receive",
+};
+
+// Caller holds the mutex
+static size_t oldest_index(void)
+{
+    return recorded > HW_TRACE_CAPACITY ? recorded - HW_TRACE_CAPACITY : 0;
+}
+
+static bool matches(const hw_trace_event_t *event, hw_trace_kind_t kind, uint16_t target)
+{
+    return event->kind == kind && (target == HW_TRACE_ANY_TARGET || event->target == target);
+}
+
+void hw_trace_reset(void)
+{
+    pthread_mutex_lock(&trace_mutex);
+    recorded = 0;
+    pthread_mutex_unlock(&trace_mutex);
+}
+
+void hw_trace_record(hw_trace_kind_t kind, uint16_t target, float value, const void *data, size_t len)
+{
+    hw_trace_event_t event = {
+        .time_us = esp_timer_get_time(),
+        .kind = kind,
+        .target = target,
+        .value = value,
+        .len = (uint16_t)(len > UINT16_MAX ? UINT16_MAX : len)};
+    if (data != NULL)
+    {
+        memcpy(event.data, data, len < HW_TRACE_DATA_SIZE ? len : HW_TRACE_DATA_SIZE);
+    }
+
+    pthread_mutex_lock(&trace_mutex);
+    events[recorded % HW_TRACE_CAPACITY] = event;
+    recorded++;
+    pthread_mutex_unlock(&trace_mutex);
+}
+
+size_t hw_trace_count(void)
+{
+    pthread_mutex_lock(&trace_mutex);
+    size_t count = recorded;
+    pthread_mutex_unlock(&trace_mutex);
+    return count;
+}
+
+bool hw_trace_get(size_t index, hw_trace_event_t *event)
+{
+    pthread_mutex_lock(&trace_mutex);
+    bool available = index >= oldest_index() && index < recorded;
+    if (available)
+    {
+        *event = events[index % HW_TRACE_CAPACITY];
+    }
+    pthread_mutex_unlock(&trace_mutex);
+    return available;
+}
+
+size_t hw_trace_find(size_t start, hw_trace_kind_t kind, uint16_t target)
+{
+    pthread_mutex_lock(&trace_mutex);
+    size_t index = start > oldest_index() ? start : oldest_index();
+    while (index < recorded && !matches(&events[index % HW_TRACE_CAPACITY], kind, target))
+    {
+        index++;
+    }
+    size_t result = index < recorded ? index : recorded;
+    pthread_mutex_unlock(&trace_mutex);
+    return result;
+}
+
+bool hw_trace_last(hw_trace_kind_t kind, uint16_t target, hw_trace_event_t *event)
+{
+    bool found = false;
+    pthread_mutex_lock(&trace_mutex);
+    for (size_t index = recorded; index > oldest_index(); index--)
+    {
+        const hw_trace_event_t *candidate = &events[(index - 1) % HW_TRACE_CAPACITY];
+        if (matches(candidate, kind, target))
+        {
+            *event = *candidate;
+            found = true;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&trace_mutex);
+    return found;
+}
+
+size_t hw_trace_count_of(hw_trace_kind_t kind, uint16_t target)
+{
+    size_t count = 0;
+    pthread_mutex_lock(&trace_mutex);
+    for (size_t index = oldest_index(); index < recorded; index++)
+    {
+        count += matches(&events[index % HW_TRACE_CAPACITY], kind, target);
+    }
+    pthread_mutex_unlock(&trace_mutex);
+    return count;
+}
+
+const char *hw_trace_kind_name(hw_trace_kind_t kind)
+{
+    return kind < HW_TRACE_KIND_COUNT ? kind_names[kind] : "unknown";
+}
+
+esp_err_t hw_trace_write_csv(const char *path)
+{
+    FILE *file = fopen(path, "w");
+    if (file == NULL)
+    {
+        return ESP_FAIL;
+    }
+
+    fprintf(file, "time_us,kind,target,value,len,data\n");
+    size_t end = hw_trace_count();
+    hw_trace_event_t event;
+    for (size_t index = 0; index < end; index++)
+    {
+        if (!hw_trace_get(index, &event))
+        {
+            continue;
+        }
+        fprintf(file, "%lld,%s,%u,%g,%u,", (long long)event.time_us, hw_trace_kind_name(event.kind),
+                event.target, event.value, event.len);
+        for (size_t i = 0; i < event.len && i < HW_TRACE_DATA_SIZE; i++)
+        {
+            fprintf(file, "%02x", event.data[i]);
+        }
+        fputc('\n', file);
+    }
+
+    return fclose(file) == 0 ? ESP_OK : ESP_FAIL;
+}
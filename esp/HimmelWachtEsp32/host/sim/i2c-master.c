@@ -0,0 +1,158 @@
+/**
+ * @file i2c-master.c
+ * @brief Simulated I2C master bus of the host build with a PCA9685 register model
+ *
+ * Every device on the bus is served by the same PCA9685 model (the firmware has only the one board).
+ * The model follows the datasheet for register writes: the first byte selects the register, further
+ * bytes go to the following registers while MODE1.AI (auto increment) is set, otherwise to the same one.
+ *
+ * Reference:
+ *  - https://www.nxp.com/docs/en/data-sheet/PCA9685.pdf (7.3 Register definitions)
+ */
+
+#include "driver/i2c_master.h"
+#include "hw-sim.h"
+#include "hw-trace.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#define PCA9685_MODE1 0x00
+#define PCA9685_MODE1_AI 0x20
+#define PCA9685_LED0_ON_L 0x06
+
+struct i2c_master_bus_t
+{
+    i2c_port_num_t port;
+};
+
+struct i2c_master_dev_t
+{
+    i2c_master_bus_handle_t bus;
+    uint16_t address;
+};
+
+static uint8_t pca9685_registers[256];
+static esp_err_t forced_error = ESP_OK;
+static uint32_t transmit_count = 0;
+static pthread_mutex_t i2c_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+esp_err_t i2c_new_master_bus(const i2c_master_bus_config_t *bus_config, i2c_master_bus_handle_t *ret_bus_handle)
+{
+    if (bus_config == NULL || ret_bus_handle == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    struct i2c_master_bus_t *bus = calloc(1, sizeof(struct i2c_master_bus_t));
+    if (bus == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    bus->port = bus_config->i2c_port;
+    *ret_bus_handle = bus;
+    return ESP_OK;
+}
+
+esp_err_t i2c_del_master_bus(i2c_master_bus_handle_t bus_handle)
+{
+    free(bus_handle);
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_bus_add_device(i2c_master_bus_handle_t bus_handle, const i2c_device_config_t *dev_config,
+                                    i2c_master_dev_handle_t *ret_handle)
+{
+    if (bus_handle == NULL || dev_config == NULL || ret_handle == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    struct i2c_master_dev_t *dev = calloc(1, sizeof(struct i2c_master_dev_t));
+    if (dev == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    dev->bus = bus_handle;
+    dev->address = dev_config->device_address;
+    *ret_handle = dev;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_bus_rm_device(i2c_master_dev_handle_t handle)
+{
+    free(handle);
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_transmit(i2c_master_dev_handle_t i2c_dev, const uint8_t *write_buffer, size_t write_size,
+                              int xfer_timeout_ms)
+{
+    (void)xfer_timeout_ms;
+
+    if (i2c_dev == NULL || write_buffer == NULL || write_size == 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&i2c_mutex);
+    if (forced_error != ESP_OK)
+    {
+        esp_err_t err = forced_error;
+        pthread_mutex_unlock(&i2c_mutex);
+        return err;
+    }
+
+    uint8_t reg = write_buffer[0];
+    for (size_t i = 1; i < write_size; i++)
+    {
+        pca9685_registers[reg] = write_buffer[i];
+        if (pca9685_registers[PCA9685_MODE1] & PCA9685_MODE1_AI)
+        {
+            reg++;
+        }
+    }
+    transmit_count++;
+    pthread_mutex_unlock(&i2c_mutex);
+
+    hw_trace_record(HW_TRACE_I2C_WRITE, i2c_dev->address, 0, write_buffer, write_size);
+    return ESP_OK;
+}
+
+bool pca9685_sim_get_channel(uint8_t channel, pca9685_sim_channel_t *state)
+{
+    if (channel >= PCA9685_SIM_CHANNELS || state == NULL)
+    {
+        return false;
+    }
+
+    const uint8_t base = PCA9685_LED0_ON_L + 4 * channel;
+    pthread_mutex_lock(&i2c_mutex);
+    state->on = (uint16_t)(pca9685_registers[base] | (pca9685_registers[base + 1] << 8));
+    state->off = (uint16_t)(pca9685_registers[base + 2] | (pca9685_registers[base + 3] << 8));
+    pthread_mutex_unlock(&i2c_mutex);
+    return true;
+}
+
+uint8_t pca9685_sim_get_register(uint8_t reg)
+{
+    pthread_mutex_lock(&i2c_mutex);
+    uint8_t value = pca9685_registers[reg];
+    pthread_mutex_unlock(&i2c_mutex);
+    return value;
+}
+
+void i2c_sim_set_error(esp_err_t err)
+{
+    pthread_mutex_lock(&i2c_mutex);
+    forced_error = err;
+    pthread_mutex_unlock(&i2c_mutex);
+}
+
+uint32_t i2c_sim_get_transmit_count(void)
+{
+    pthread_mutex_lock(&i2c_mutex);
+    uint32_t count = transmit_count;
+    pthread_mutex_unlock(&i2c_mutex);
+    return count;
+}
@@ -0,0 +1,37 @@
+/**
+ * @file ds4-sim.h
+ * @brief Simulated DualShock 4 controller, replaces ds4-driver.c (Bluepad32) in the host build
+ *
+ * Implements the ds4-driver.h API. Reports are handed over exactly like the Bluepad32 platform callback
+ * does it (xQueueOverwrite into the one-slot ds4_input_queue), rumble and lightbar events end up in the
+ * hardware trace instead of the Bluetooth stack.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "ds4-driver.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Connects or disconnects the controller (DS4_CONNECTED event bit)
+ */
+void ds4_sim_set_connected(bool connected);
+
+/**
+ * @brief Sets the low battery state, the firmware cannot change the lightbar while it is set
+ */
+void ds4_sim_set_battery_low(bool low);
+
+/**
+ * @brief Hands one controller report to the firmware, overwrites a report that was not consumed yet
+ */
+void ds4_sim_send_input(const ds4_input_t *input);
+
+#ifdef __cplusplus
+}
+#endif
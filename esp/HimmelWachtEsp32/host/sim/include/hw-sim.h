@@ -0,0 +1,89 @@
+/**
+ * @file hw-sim.h
+ * @brief State of the simulated peripherals behind the driver shims
+ *
+ * GPIO pins keep their last level, the MCPWM generators output the duty of their comparator from the
+ * next period start on (mcpwm_sim_get_duty()), and the I2C bus forwards all writes to a PCA9685
+ * register model. The pulse counters count what a plant model
+ * (motor-plant-sim.h) or the test adds, and the ADC converts the channel voltages they set. Tests read the state here and the history from the hardware
+ * trace (hw-trace.h).
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "driver/gpio.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PCA9685_SIM_CHANNELS 16
+
+/**
+ * @brief Last level written to a pin, -1 if the pin was never written
+ */
+int gpio_sim_get_level(gpio_num_t gpio_num);
+
+/**
+ * @brief Duty in percent the MCPWM generator on gpio_num outputs now, 0 if there is none
+ *
+ * A compare value written with update_cmp_on_tez is not visible before the next timer empty event.
+ */
+float mcpwm_sim_get_duty(int gpio_num);
+
+/**
+ * @brief PWM frequency of the timer behind the MCPWM generator on gpio_num, 0 if there is none
+ */
+uint32_t mcpwm_sim_get_frequency(int gpio_num);
+
+/**
+ * @brief Output state of one PCA9685 channel (12 bit on/off counts)
+ */
+typedef struct
+{
+    uint16_t on;
+    uint16_t off;
+} pca9685_sim_channel_t;
+
+bool pca9685_sim_get_channel(uint8_t channel, pca9685_sim_channel_t *state);
+
+/**
+ * @brief Register value of the PCA9685 model (MODE1 = 0x00, PRE_SCALE = 0xFE)
+ */
+uint8_t pca9685_sim_get_register(uint8_t reg);
+
+/**
+ * @brief Makes every following I2C transmit fail with err (ESP_OK to recover), failed writes are not traced
+ */
+void i2c_sim_set_error(esp_err_t err);
+
+/**
+ * @brief Number of successful I2C transmits since start
+ */
+uint32_t i2c_sim_get_transmit_count(void);
+
+/**
+ * @brief Adds quadrature counts of an encoder to the pulse counter unit that counts edges of a_gpio_num
+ *
+ * Positive counts are a rotation with signal A leading B, the unit counts them up or down according to
+ * its channel actions. Units that are not started ignore them.
+ */
+void pcnt_sim_add_counts(int a_gpio_num, int counts);
+
+/**
+ * @brief Sets the input voltage of an ADC1 channel in mV, what the following conversions measure
+ */
+void adc_sim_set_voltage(int channel, int mv);
+
+/**
+ * @brief Conversions lost because the continuous mode ring was full since start
+ */
+uint32_t adc_sim_get_dropped(void);
+
+#ifdef __cplusplus
+}
+#endif
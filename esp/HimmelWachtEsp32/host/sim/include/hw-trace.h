@@ -0,0 +1,106 @@
+/**
+ * @file hw-trace.h
+ * @brief Timestamped record of every simulated hardware write of the host build
+ *
+ * The driver shims (GPIO, MCPWM, I2C), the DS4 and the MQTT simulation append one event per write to
+ * a ring buffer. The inputs fed into the simulation (controller reports, received MQTT messages) are
+ * recorded on the same timeline, so the latency from an input to the resulting hardware write can be
+ * read directly from the trace. Timestamps are esp_timer_get_time() microseconds.
+ *
+ * Thread-safe, the components write from their own tasks.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HW_TRACE_CAPACITY 65536 // events kept, older events are overwritten
+#define HW_TRACE_DATA_SIZE 8    // payload bytes kept per event
+#define HW_TRACE_ANY_TARGET 0xFFFF
+
+typedef enum
+{
+    // Hardware writes
+    HW_TRACE_GPIO_CONFIG,     // target: pin, value: mode
+    HW_TRACE_GPIO_LEVEL,      // target: pin, value: level
+    HW_TRACE_MCPWM_INIT,      // target: generator pin, value: frequency in Hz
+    HW_TRACE_MCPWM_DUTY,      // target: generator pin, value: duty in percent, data: time it takes effect (int64_t us)
+    HW_TRACE_I2C_WRITE,       // target: device address, data: bytes written
+    HW_TRACE_DS4_RUMBLE,      // value: duration in ms, data: start delay (u16), weak, strong magnitude
+    HW_TRACE_DS4_LIGHTBAR,    // data: r, g, b
+    HW_TRACE_MQTT_PUBLISH,    // data: payload (first HW_TRACE_DATA_SIZE bytes)
+    // Inputs
+    HW_TRACE_DS4_INPUT,       // controller report handed to the firmware
+    HW_TRACE_MQTT_RECEIVE,    // message delivered to the MQTT event handler
+    HW_TRACE_KIND_COUNT
+} hw_trace_kind_t;
+
+typedef struct
+{
+    int64_t time_us;
+    hw_trace_kind_t kind;
+    uint16_t target;
+    float value;
+    uint16_t len; // payload length, may exceed HW_TRACE_DATA_SIZE
+    uint8_t data[HW_TRACE_DATA_SIZE];
+} hw_trace_event_t;
+
+/**
+ * @brief Drops all events, the next event gets index 0
+ */
+void hw_trace_reset(void);
+
+/**
+ * @brief Appends an event with the current time
+ */
+void hw_trace_record(hw_trace_kind_t kind, uint16_t target, float value, const void *data, size_t len);
+
+/**
+ * @brief Number of events recorded since the last reset, including overwritten ones
+ */
+size_t hw_trace_count(void);
+
+/**
+ * @brief Event by index (0 = first after reset)
+ *
+ * @return false if the index was not recorded yet or has been overwritten
+ */
+bool hw_trace_get(size_t index, hw_trace_event_t *event);
+
+/**
+ * @brief Index of the first event of a kind and target (or HW_TRACE_ANY_TARGET) at or after start
+ *
+ * @return the index, or hw_trace_count() if there is none
+ */
+size_t hw_trace_find(size_t start, hw_trace_kind_t kind, uint16_t target);
+
+/**
+ * @brief Latest event of a kind and target (or HW_TRACE_ANY_TARGET)
+ *
+ * @return false if there is none in the buffer
+ */
+bool hw_trace_last(hw_trace_kind_t kind, uint16_t target, hw_trace_event_t *event);
+
+/**
+ * @brief Number of events of a kind and target (or HW_TRACE_ANY_TARGET) in the buffer
+ */
+size_t hw_trace_count_of(hw_trace_kind_t kind, uint16_t target);
+
+const char *hw_trace_kind_name(hw_trace_kind_t kind);
+
+/**
+ * @brief Writes the buffered events as CSV (time_us,kind,target,value,len,data)
+ */
+esp_err_t hw_trace_write_csv(const char *path);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,92 @@
+/**
+ * @file motor-plant-sim.h
+ * @brief DC motor and wheel model behind the simulated MCPWM, GPIO and pulse counter of the host build
+ *
+ * Each plant reads the duty of its MCPWM generator and the level of its direction pin, integrates the
+ * motor equations every millisecond and feeds the wheel rotation as quadrature counts to the pulse
+ * counter of its encoder (pcnt_sim_add_counts()). Averaged over a PWM period the H-bridge applies
+ * duty * supply_v (sign-magnitude with brake in the off phase):
+ *
+ *   current      i = (V - k * w) / R
+ *   acceleration J * dw/dt = k * i - b * w - load (against the rotation, holds the wheel at standstill)
+ *
+ * with the motor constant k (back EMF in V s/rad = torque in Nm/A) and all values at the wheel (gearbox
+ * included). Supply voltage and load can change while the plant runs, e.g. a sagging battery or a slope.
+ *
+ * Like the CS pin of the Pololu G2 the current sense output only measures during the drive phase of the
+ * PWM, so its RC-filtered voltage on the ADC channel (adc_sim_set_voltage()) is
+ *
+ *   sense_offset_mv + duty * |i| * sense_mv_per_a
+ */
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MOTOR_PLANT_SIM_MAX 4
+#define MOTOR_PLANT_SIM_STEP_US 1000
+
+typedef struct
+{
+    int pwm_gpio_num;        // MCPWM generator output
+    int dir_gpio_num;        // Level 1 = forward
+    int encoder_a_gpio_num;  // Pulse counter edge input of signal A, -1 without encoder
+    float counts_per_rev;    // Quadrature counts per wheel revolution
+    float supply_v;          // Battery voltage
+    float resistance_ohm;    // Armature resistance
+    float motor_constant;    // Back EMF in V s/rad, torque in Nm/A
+    float inertia_kgm2;      // Wheel, gearbox and the share of the vehicle mass
+    float viscous_nms;       // Speed proportional friction in Nm s/rad
+    float load_nm;           // Constant load torque against the rotation
+    int sense_adc_channel;   // ADC1 channel of the current sense output
+    float sense_mv_per_a;    // Current sense gain, 0 without current sense output
+    float sense_offset_mv;   // Current sense output at 0 A
+} motor_plant_sim_config_t;
+
+/**
+ * @brief Starts a plant at standstill, the simulation timer starts with the first plant
+ *
+ * @return Plant index, -1 if config is NULL or all MOTOR_PLANT_SIM_MAX plants are running
+ */
+int motor_plant_sim_start(const motor_plant_sim_config_t *config);
+
+/**
+ * @brief Stops all plants and the simulation timer
+ */
+void motor_plant_sim_stop_all(void);
+
+/**
+ * @brief Integrates the plants up to now, the pulse counters call it before a read
+ *
+ * The encoder counts are then as current as on the hardware, even if the simulation timer fired
+ * late.
+ */
+void motor_plant_sim_sync(void);
+
+void motor_plant_sim_set_supply(int plant, float supply_v);
+void motor_plant_sim_set_load(int plant, float load_nm);
+
+/**
+ * @brief Wheel speed in rad/s, positive = forward
+ */
+float motor_plant_sim_get_speed(int plant);
+
+/**
+ * @brief Motor current in A, positive = forward torque
+ */
+float motor_plant_sim_get_current(int plant);
+
+/**
+ * @brief Wheel speed at duty 100 % without load: supply_v * k / (k^2 + R * b)
+ */
+float motor_plant_sim_no_load_speed(int plant);
+
+#ifdef __cplusplus
+}
+#endif
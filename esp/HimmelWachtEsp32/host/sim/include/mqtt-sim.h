@@ -0,0 +1,66 @@
+/**
+ * @file mqtt-sim.h
+ * @brief Simulated MQTT broker behind the esp_mqtt_client shim of the host build
+ *
+ * One client (mqtt-stack creates one). The test decides when the client is connected and which messages
+ * arrive, the events run synchronously on the calling thread. Published and enqueued messages are kept
+ * for inspection and recorded in the hardware trace.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MQTT_SIM_TOPIC_SIZE 64
+#define MQTT_SIM_PAYLOAD_SIZE 128
+
+typedef struct
+{
+    int64_t time_us;
+    char topic[MQTT_SIM_TOPIC_SIZE];
+    uint8_t payload[MQTT_SIM_PAYLOAD_SIZE];
+    size_t len;
+} mqtt_sim_message_t;
+
+/**
+ * @brief Raises MQTT_EVENT_CONNECTED on the started client
+ *
+ * @return ESP_ERR_INVALID_STATE if no client was started
+ */
+esp_err_t mqtt_sim_connect(void);
+
+/**
+ * @brief Raises MQTT_EVENT_DISCONNECTED, subscriptions are dropped like after a clean session
+ */
+esp_err_t mqtt_sim_disconnect(void);
+
+/**
+ * @brief Delivers a message (MQTT_EVENT_DATA) if the client is connected and subscribed to the topic
+ *
+ * @return ESP_OK if delivered, ESP_ERR_NOT_FOUND if not subscribed, ESP_ERR_INVALID_STATE if not connected
+ */
+esp_err_t mqtt_sim_deliver(const char *topic, const void *payload, size_t len);
+
+/**
+ * @brief Number of messages published or enqueued by the client since start
+ */
+uint32_t mqtt_sim_get_published_count(void);
+
+/**
+ * @brief Latest message the client published on a topic
+ *
+ * @return false if nothing was published on the topic
+ */
+bool mqtt_sim_get_last_published(const char *topic, mqtt_sim_message_t *message);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,523 @@
+/**
+ * @file mcpwm.c
+ * @brief Simulated MCPWM groups of the host build (timer/operator/comparator/generator API)
+ *
+ * A running timer starts a period every period_ticks on the esp_timer time base. Comparators with
+ * update_cmp_on_tez keep a written value in the shadow register until the next period start, the
+ * others take it at once. Generators that go high on timer empty and low on a compare event output
+ * compare / period, every other action setup outputs 0.
+ */
+
+#include "driver/mcpwm_prelude.h"
+#include "hw-sim.h"
+#include "hw-trace.h"
+#include "esp_timer.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define MCPWM_SIM_COMPARATORS (SOC_MCPWM_OPERATORS_PER_GROUP * SOC_MCPWM_COMPARATORS_PER_OPERATOR)
+#define MCPWM_SIM_GENERATORS (SOC_MCPWM_OPERATORS_PER_GROUP * SOC_MCPWM_GENERATORS_PER_OPERATOR)
+
+struct mcpwm_timer_t
+{
+    bool in_use;
+    bool enabled;
+    bool running;
+    int group_id;
+    uint32_t resolution_hz;
+    uint32_t period_ticks;
+    int64_t start_ns; // Time of the first timer empty event
+};
+
+struct mcpwm_oper_t
+{
+    bool in_use;
+    int group_id;
+    struct mcpwm_timer_t *timer;
+};
+
+struct mcpwm_cmpr_t
+{
+    bool in_use;
+    bool update_on_tez;
+    struct mcpwm_oper_t *oper;
+    uint32_t active;   // Compare value the generator uses
+    uint32_t shadow;   // Value waiting for the next period start
+    int64_t shadow_us; // Time it takes effect, 0 if none waits
+};
+
+struct mcpwm_gen_t
+{
+    bool in_use;
+    struct mcpwm_oper_t *oper;
+    int gpio_num;
+    bool high_on_empty;
+    struct mcpwm_cmpr_t *low_on_compare;
+    int force_level; // -1 = not forced
+};
+
+typedef struct
+{
+    struct mcpwm_timer_t timers[SOC_MCPWM_TIMERS_PER_GROUP];
+    struct mcpwm_oper_t opers[SOC_MCPWM_OPERATORS_PER_GROUP];
+    struct mcpwm_cmpr_t cmprs[MCPWM_SIM_COMPARATORS];
+    struct mcpwm_gen_t gens[MCPWM_SIM_GENERATORS];
+} sim_group_t;
+
+static sim_group_t groups[SOC_MCPWM_GROUPS];
+static pthread_mutex_t mcpwm_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static bool valid_group(int group_id)
+{
+    return group_id >= 0 && group_id < SOC_MCPWM_GROUPS;
+}
+
+static uint32_t timer_frequency(const struct mcpwm_timer_t *timer)
+{
+    return timer == NULL || timer->period_ticks == 0 ? 0 : timer->resolution_hz / timer->period_ticks;
+}
+
+// Start of the next period after now_us, now_us itself if the timer does not run
+static int64_t next_empty_us(const struct mcpwm_timer_t *timer, int64_t now_us)
+{
+    if (timer == NULL || !timer->running)
+    {
+        return now_us;
+    }
+
+    int64_t period_ns = (int64_t)timer->period_ticks * 1000000000 / timer->resolution_hz;
+    int64_t periods = (now_us * 1000 - timer->start_ns) / period_ns + 1;
+    return (timer->start_ns + periods * period_ns + 999) / 1000;
+}
+
+// Moves a shadow value that is due into the active register, called with mcpwm_mutex held
+static void latch(struct mcpwm_cmpr_t *cmpr, int64_t now_us)
+{
+    if (cmpr->shadow_us != 0 && now_us >= cmpr->shadow_us)
+    {
+        cmpr->active = cmpr->shadow;
+        cmpr->shadow_us = 0;
+    }
+}
+
+static float output_duty(struct mcpwm_gen_t *gen, int64_t now_us)
+{
+    if (gen->force_level >= 0)
+    {
+        return gen->force_level ? 100.0f : 0.0f;
+    }
+
+    const struct mcpwm_timer_t *timer = gen->oper->timer;
+    if (!gen->high_on_empty || gen->low_on_compare == NULL || timer == NULL || !timer->running)
+    {
+        return 0;
+    }
+
+    latch(gen->low_on_compare, now_us);
+    uint32_t compare = gen->low_on_compare->active;
+    return compare >= timer->period_ticks ? 100.0f : 100.0f * compare / timer->period_ticks;
+}
+
+static struct mcpwm_gen_t *find_generator(int gpio_num)
+{
+    for (int g = 0; g < SOC_MCPWM_GROUPS; g++)
+    {
+        for (int i = 0; i < MCPWM_SIM_GENERATORS; i++)
+        {
+            if (groups[g].gens[i].in_use && groups[g].gens[i].gpio_num == gpio_num)
+            {
+                return &groups[g].gens[i];
+            }
+        }
+    }
+    return NULL;
+}
+
+esp_err_t mcpwm_new_timer(const mcpwm_timer_config_t *config, mcpwm_timer_handle_t *ret_timer)
+{
+    if (config == NULL || ret_timer == NULL || !valid_group(config->group_id) || config->resolution_hz == 0 ||
+        config->period_ticks < 2 || config->period_ticks > 65535 || config->count_mode != MCPWM_TIMER_COUNT_MODE_UP)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&mcpwm_mutex);
+    for (int i = 0; i < SOC_MCPWM_TIMERS_PER_GROUP; i++)
+    {
+        struct mcpwm_timer_t *timer = &groups[config->group_id].timers[i];
+        if (!timer->in_use)
+        {
+            *timer = (struct mcpwm_timer_t){
+                .in_use = true,
+                .group_id = config->group_id,
+                .resolution_hz = config->resolution_hz,
+                .period_ticks = config->period_ticks,
+            };
+            *ret_timer = timer;
+            pthread_mutex_unlock(&mcpwm_mutex);
+            return ESP_OK;
+        }
+    }
+    pthread_mutex_unlock(&mcpwm_mutex);
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t mcpwm_del_timer(mcpwm_timer_handle_t timer)
+{
+    if (timer == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&mcpwm_mutex);
+    esp_err_t ret = ESP_OK;
+    if (timer->enabled)
+    {
+        ret = ESP_ERR_INVALID_STATE;
+    }
+    for (int i = 0; i < SOC_MCPWM_OPERATORS_PER_GROUP; i++)
+    {
+        if (groups[timer->group_id].opers[i].in_use && groups[timer->group_id].opers[i].timer == timer)
+        {
+            ret = ESP_ERR_INVALID_STATE;
+        }
+    }
+    if (ret == ESP_OK)
+    {
+        timer->in_use = false;
+    }
+    pthread_mutex_unlock(&mcpwm_mutex);
+    return ret;
+}
+
+esp_err_t mcpwm_timer_enable(mcpwm_timer_handle_t timer)
+{
+    if (timer == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&mcpwm_mutex);
+    esp_err_t ret = timer->enabled ? ESP_ERR_INVALID_STATE : ESP_OK;
+    timer->enabled = true;
+    pthread_mutex_unlock(&mcpwm_mutex);
+    return ret;
+}
+
+esp_err_t mcpwm_timer_disable(mcpwm_timer_handle_t timer)
+{
+    if (timer == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&mcpwm_mutex);
+    esp_err_t ret = !timer->enabled || timer->running ? ESP_ERR_INVALID_STATE : ESP_OK;
+    if (ret == ESP_OK)
+    {
+        timer->enabled = false;
+    }
+    pthread_mutex_unlock(&mcpwm_mutex);
+    return ret;
+}
+
+esp_err_t mcpwm_timer_start_stop(mcpwm_timer_handle_t timer, mcpwm_timer_start_stop_cmd_t command)
+{
+    if (timer == NULL || command > MCPWM_TIMER_START_STOP_FULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&mcpwm_mutex);
+    esp_err_t ret = timer->enabled ? ESP_OK : ESP_ERR_INVALID_STATE;
+    if (ret == ESP_OK)
+    {
+        // Only free running and stopping are modelled, a stop takes effect at once
+        bool start = command == MCPWM_TIMER_START_NO_STOP;
+        if (start && !timer->running)
+        {
+            timer->start_ns = esp_timer_get_time() * 1000;
+        }
+        timer->running = start;
+    }
+    pthread_mutex_unlock(&mcpwm_mutex);
+    return ret;
+}
+
+esp_err_t mcpwm_new_operator(const mcpwm_operator_config_t *config, mcpwm_oper_handle_t *ret_oper)
+{
+    if (config == NULL || ret_oper == NULL || !valid_group(config->group_id))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&mcpwm_mutex);
+    for (int i = 0; i < SOC_MCPWM_OPERATORS_PER_GROUP; i++)
+    {
+        struct mcpwm_oper_t *oper = &groups[config->group_id].opers[i];
+        if (!oper->in_use)
+        {
+            *oper = (struct mcpwm_oper_t){.in_use = true, .group_id = config->group_id};
+            *ret_oper = oper;
+            pthread_mutex_unlock(&mcpwm_mutex);
+            return ESP_OK;
+        }
+    }
+    pthread_mutex_unlock(&mcpwm_mutex);
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t mcpwm_del_operator(mcpwm_oper_handle_t oper)
+{
+    if (oper == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&mcpwm_mutex);
+    esp_err_t ret = ESP_OK;
+    sim_group_t *group = &groups[oper->group_id];
+    for (int i = 0; i < MCPWM_SIM_COMPARATORS; i++)
+    {
+        if (group->cmprs[i].in_use && group->cmprs[i].oper == oper)
+        {
+            ret = ESP_ERR_INVALID_STATE;
+        }
+    }
+    for (int i = 0; i < MCPWM_SIM_GENERATORS; i++)
+    {
+        if (group->gens[i].in_use && group->gens[i].oper == oper)
+        {
+            ret = ESP_ERR_INVALID_STATE;
+        }
+    }
+    if (ret == ESP_OK)
+    {
+        oper->in_use = false;
+    }
+    pthread_mutex_unlock(&mcpwm_mutex);
+    return ret;
+}
+
+esp_err_t mcpwm_operator_connect_timer(mcpwm_oper_handle_t oper, mcpwm_timer_handle_t timer)
+{
+    if (oper == NULL || timer == NULL || oper->group_id != timer->group_id)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&mcpwm_mutex);
+    oper->timer = timer;
+    pthread_mutex_unlock(&mcpwm_mutex);
+    return ESP_OK;
+}
+
+esp_err_t mcpwm_new_comparator(mcpwm_oper_handle_t oper, const mcpwm_comparator_config_t *config, mcpwm_cmpr_handle_t *ret_cmpr)
+{
+    if (oper == NULL || config == NULL || ret_cmpr == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&mcpwm_mutex);
+    sim_group_t *group = &groups[oper->group_id];
+    int used = 0;
+    struct mcpwm_cmpr_t *free_cmpr = NULL;
+    for (int i = 0; i < MCPWM_SIM_COMPARATORS; i++)
+    {
+        if (group->cmprs[i].in_use && group->cmprs[i].oper == oper)
+        {
+            used++;
+        }
+        else if (!group->cmprs[i].in_use && free_cmpr == NULL)
+        {
+            free_cmpr = &group->cmprs[i];
+        }
+    }
+
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    if (used < SOC_MCPWM_COMPARATORS_PER_OPERATOR && free_cmpr != NULL)
+    {
+        *free_cmpr = (struct mcpwm_cmpr_t){.in_use = true, .update_on_tez = config->flags.update_cmp_on_tez, .oper = oper};
+        *ret_cmpr = free_cmpr;
+        ret = ESP_OK;
+    }
+    pthread_mutex_unlock(&mcpwm_mutex);
+    return ret;
+}
+
+esp_err_t mcpwm_del_comparator(mcpwm_cmpr_handle_t cmpr)
+{
+    if (cmpr == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&mcpwm_mutex);
+    cmpr->in_use = false;
+    pthread_mutex_unlock(&mcpwm_mutex);
+    return ESP_OK;
+}
+
+esp_err_t mcpwm_comparator_set_compare_value(mcpwm_cmpr_handle_t cmpr, uint32_t cmp_ticks)
+{
+    if (cmpr == NULL || cmpr->oper->timer == NULL || cmp_ticks > cmpr->oper->timer->period_ticks)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&mcpwm_mutex);
+    const struct mcpwm_timer_t *timer = cmpr->oper->timer;
+    int64_t now_us = esp_timer_get_time();
+    latch(cmpr, now_us);
+    int64_t apply_us = cmpr->update_on_tez ? next_empty_us(timer, now_us) : now_us;
+    if (apply_us > now_us)
+    {
+        cmpr->shadow = cmp_ticks;
+        cmpr->shadow_us = apply_us;
+    }
+    else
+    {
+        cmpr->active = cmp_ticks;
+        cmpr->shadow_us = 0;
+    }
+    float duty = 100.0f * cmp_ticks / timer->period_ticks;
+
+    int gpio_nums[MCPWM_SIM_GENERATORS];
+    int gpio_count = 0;
+    sim_group_t *group = &groups[cmpr->oper->group_id];
+    for (int i = 0; i < MCPWM_SIM_GENERATORS; i++)
+    {
+        if (group->gens[i].in_use && group->gens[i].low_on_compare == cmpr)
+        {
+            gpio_nums[gpio_count++] = group->gens[i].gpio_num;
+        }
+    }
+    pthread_mutex_unlock(&mcpwm_mutex);
+
+    for (int i = 0; i < gpio_count; i++)
+    {
+        hw_trace_record(HW_TRACE_MCPWM_DUTY, (uint16_t)gpio_nums[i], duty, &apply_us, sizeof(apply_us));
+    }
+    return ESP_OK;
+}
+
+esp_err_t mcpwm_new_generator(mcpwm_oper_handle_t oper, const mcpwm_generator_config_t *config, mcpwm_gen_handle_t *ret_gen)
+{
+    if (oper == NULL || config == NULL || ret_gen == NULL || config->gen_gpio_num < 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&mcpwm_mutex);
+    sim_group_t *group = &groups[oper->group_id];
+    int used = 0;
+    struct mcpwm_gen_t *free_gen = NULL;
+    for (int i = 0; i < MCPWM_SIM_GENERATORS; i++)
+    {
+        if (group->gens[i].in_use && group->gens[i].oper == oper)
+        {
+            used++;
+        }
+        else if (!group->gens[i].in_use && free_gen == NULL)
+        {
+            free_gen = &group->gens[i];
+        }
+    }
+
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    uint32_t frequency = 0;
+    if (used < SOC_MCPWM_GENERATORS_PER_OPERATOR && free_gen != NULL)
+    {
+        *free_gen = (struct mcpwm_gen_t){.in_use = true, .oper = oper, .gpio_num = config->gen_gpio_num, .force_level = -1};
+        *ret_gen = free_gen;
+        frequency = timer_frequency(oper->timer);
+        ret = ESP_OK;
+    }
+    pthread_mutex_unlock(&mcpwm_mutex);
+
+    if (ret == ESP_OK)
+    {
+        hw_trace_record(HW_TRACE_MCPWM_INIT, (uint16_t)config->gen_gpio_num, (float)frequency, NULL, 0);
+    }
+    return ret;
+}
+
+esp_err_t mcpwm_del_generator(mcpwm_gen_handle_t gen)
+{
+    if (gen == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&mcpwm_mutex);
+    gen->in_use = false;
+    pthread_mutex_unlock(&mcpwm_mutex);
+    return ESP_OK;
+}
+
+esp_err_t mcpwm_generator_set_action_on_timer_event(mcpwm_gen_handle_t gen, mcpwm_gen_timer_event_action_t ev_act)
+{
+    if (gen == NULL || ev_act.event >= MCPWM_TIMER_EVENT_INVALID)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&mcpwm_mutex);
+    if (ev_act.direction == MCPWM_TIMER_DIRECTION_UP && ev_act.event == MCPWM_TIMER_EVENT_EMPTY)
+    {
+        gen->high_on_empty = ev_act.action == MCPWM_GEN_ACTION_HIGH;
+    }
+    pthread_mutex_unlock(&mcpwm_mutex);
+    return ESP_OK;
+}
+
+esp_err_t mcpwm_generator_set_action_on_compare_event(mcpwm_gen_handle_t gen, mcpwm_gen_compare_event_action_t ev_act)
+{
+    if (gen == NULL || ev_act.comparator == NULL || ev_act.comparator->oper != gen->oper)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&mcpwm_mutex);
+    if (ev_act.direction == MCPWM_TIMER_DIRECTION_UP)
+    {
+        gen->low_on_compare = ev_act.action == MCPWM_GEN_ACTION_LOW ? ev_act.comparator : NULL;
+    }
+    pthread_mutex_unlock(&mcpwm_mutex);
+    return ESP_OK;
+}
+
+esp_err_t mcpwm_generator_set_force_level(mcpwm_gen_handle_t gen, int level, bool hold_on)
+{
+    if (gen == NULL || level < -1 || level > 1)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // A force without hold_on only lasts until the next timer event, the PWM output resumes then
+    pthread_mutex_lock(&mcpwm_mutex);
+    gen->force_level = hold_on ? level : -1;
+    pthread_mutex_unlock(&mcpwm_mutex);
+    return ESP_OK;
+}
+
+float mcpwm_sim_get_duty(int gpio_num)
+{
+    pthread_mutex_lock(&mcpwm_mutex);
+    struct mcpwm_gen_t *gen = find_generator(gpio_num);
+    float duty = gen != NULL ? output_duty(gen, esp_timer_get_time()) : 0;
+    pthread_mutex_unlock(&mcpwm_mutex);
+    return duty;
+}
+
+uint32_t mcpwm_sim_get_frequency(int gpio_num)
+{
+    pthread_mutex_lock(&mcpwm_mutex);
+    struct mcpwm_gen_t *gen = find_generator(gpio_num);
+    uint32_t frequency = gen != NULL ? timer_frequency(gen->oper->timer) : 0;
+    pthread_mutex_unlock(&mcpwm_mutex);
+    return frequency;
+}
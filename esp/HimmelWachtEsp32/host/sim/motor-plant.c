@@ -0,0 +1,237 @@
+/**
+ * @file motor-plant.c
+ * @brief DC motor plants of the host build, integrated on a periodic esp_timer
+ */
+
+#include "motor-plant-sim.h"
+#include "hw-sim.h"
+#include "esp_timer.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+
+typedef struct
+{
+    bool running;
+    motor_plant_sim_config_t config;
+    float speed;   // rad/s
+    float current; // A
+    float counts;  // Encoder counts not handed to the pulse counter yet
+} plant_t;
+
+static plant_t plants[MOTOR_PLANT_SIM_MAX];
+static pthread_mutex_t plant_mutex = PTHREAD_MUTEX_INITIALIZER;
+static esp_timer_handle_t plant_timer = NULL;
+static int64_t integrated_us; // Time the plants are integrated to
+
+static void step(plant_t *plant, float dt)
+{
+    const motor_plant_sim_config_t *config = &plant->config;
+
+    float duty = mcpwm_sim_get_duty(config->pwm_gpio_num) / 100.0f;
+    float direction = gpio_sim_get_level(config->dir_gpio_num) == 1 ? 1.0f : -1.0f;
+    float voltage = direction * duty * config->supply_v;
+
+    float current = (voltage - config->motor_constant * plant->speed) / config->resistance_ohm;
+    float torque = config->motor_constant * current - config->viscous_nms * plant->speed;
+    plant->current = current;
+    if (config->sense_mv_per_a > 0)
+    {
+        adc_sim_set_voltage(config->sense_adc_channel, (int)(config->sense_offset_mv + duty * fabsf(current) * config->sense_mv_per_a + 0.5f));
+    }
+
+    // The load acts against the rotation, at standstill it holds the wheel until the torque exceeds it
+    float moving = plant->speed;
+    if (moving == 0.0f)
+    {
+        if (fabsf(torque) <= config->load_nm)
+        {
+            return;
+        }
+        moving = torque;
+    }
+    torque -= moving > 0 ? config->load_nm : -config->load_nm;
+
+    // A zero crossing ends at standstill, the next step decides whether the wheel starts the other way
+    float speed = plant->speed + torque / config->inertia_kgm2 * dt;
+    if (plant->speed != 0.0f && (speed > 0) != (plant->speed > 0))
+    {
+        speed = 0.0f;
+    }
+    plant->speed = speed;
+
+    if (config->encoder_a_gpio_num >= 0)
+    {
+        plant->counts += plant->speed * dt * config->counts_per_rev / (2.0f * (float)M_PI);
+        int whole = (int)plant->counts;
+        if (whole != 0)
+        {
+            plant->counts -= (float)whole;
+            pcnt_sim_add_counts(config->encoder_a_gpio_num, whole);
+        }
+    }
+}
+
+// Integrate the elapsed time in fixed steps, called with plant_mutex held
+static void advance(void)
+{
+    int64_t now_us = esp_timer_get_time();
+    while (now_us - integrated_us >= MOTOR_PLANT_SIM_STEP_US)
+    {
+        for (int i = 0; i < MOTOR_PLANT_SIM_MAX; i++)
+        {
+            if (plants[i].running)
+            {
+                step(&plants[i], MOTOR_PLANT_SIM_STEP_US * 1e-6f);
+            }
+        }
+        integrated_us += MOTOR_PLANT_SIM_STEP_US;
+    }
+}
+
+// On the monotonic clock a late callback catches up, under simulated time it is never late
+static void plant_timer_callback(void *arg)
+{
+    (void)arg;
+    pthread_mutex_lock(&plant_mutex);
+    advance();
+    pthread_mutex_unlock(&plant_mutex);
+}
+
+int motor_plant_sim_start(const motor_plant_sim_config_t *config)
+{
+    if (config == NULL || config->resistance_ohm <= 0 || config->inertia_kgm2 <= 0)
+    {
+        return -1;
+    }
+
+    pthread_mutex_lock(&plant_mutex);
+    int index = -1;
+    for (int i = 0; i < MOTOR_PLANT_SIM_MAX; i++)
+    {
+        if (!plants[i].running)
+        {
+            plants[i] = (plant_t){.running = true, .config = *config};
+            index = i;
+            break;
+        }
+    }
+
+    if (index >= 0 && plant_timer == NULL)
+    {
+        const esp_timer_create_args_t timer_args = {
+            .callback = plant_timer_callback,
+            .name = "motor_plant_sim",
+            .skip_unhandled_events = true,
+        };
+        integrated_us = esp_timer_get_time();
+        if (esp_timer_create(&timer_args, &plant_timer) == ESP_OK &&
+            esp_timer_start_periodic(plant_timer, MOTOR_PLANT_SIM_STEP_US) != ESP_OK)
+        {
+            esp_timer_delete(plant_timer);
+            plant_timer = NULL;
+        }
+    }
+    pthread_mutex_unlock(&plant_mutex);
+    return index;
+}
+
+void motor_plant_sim_stop_all(void)
+{
+    pthread_mutex_lock(&plant_mutex);
+    for (int i = 0; i < MOTOR_PLANT_SIM_MAX; i++)
+    {
+        plants[i].running = false;
+    }
+    esp_timer_handle_t timer = plant_timer;
+    plant_timer = NULL;
+    pthread_mutex_unlock(&plant_mutex);
+
+    // Outside the mutex, the callback that may be running right now takes it
+    if (timer != NULL)
+    {
+        esp_timer_stop(timer);
+        esp_timer_delete(timer);
+    }
+}
+
+void motor_plant_sim_sync(void)
+{
+    pthread_mutex_lock(&plant_mutex);
+    if (plant_timer != NULL)
+    {
+        advance();
+    }
+    pthread_mutex_unlock(&plant_mutex);
+}
+
+static bool valid(int plant)
+{
+    return plant >= 0 && plant < MOTOR_PLANT_SIM_MAX;
+}
+
+void motor_plant_sim_set_supply(int plant, float supply_v)
+{
+    if (!valid(plant))
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&plant_mutex);
+    plants[plant].config.supply_v = supply_v;
+    pthread_mutex_unlock(&plant_mutex);
+}
+
+void motor_plant_sim_set_load(int plant, float load_nm)
+{
+    if (!valid(plant))
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&plant_mutex);
+    plants[plant].config.load_nm = load_nm;
+    pthread_mutex_unlock(&plant_mutex);
+}
+
+float motor_plant_sim_get_speed(int plant)
+{
+    if (!valid(plant))
+    {
+        return 0;
+    }
+
+    pthread_mutex_lock(&plant_mutex);
+    float speed = plants[plant].speed;
+    pthread_mutex_unlock(&plant_mutex);
+    return speed;
+}
+
+float motor_plant_sim_get_current(int plant)
+{
+    if (!valid(plant))
+    {
+        return 0;
+    }
+
+    pthread_mutex_lock(&plant_mutex);
+    float current = plants[plant].current;
+    pthread_mutex_unlock(&plant_mutex);
+    return current;
+}
+
+float motor_plant_sim_no_load_speed(int plant)
+{
+    if (!valid(plant))
+    {
+        return 0;
+    }
+
+    pthread_mutex_lock(&plant_mutex);
+    const motor_plant_sim_config_t *config = &plants[plant].config;
+    float k = config->motor_constant;
+    float speed = config->supply_v * k / (k * k + config->resistance_ohm * config->viscous_nms);
+    pthread_mutex_unlock(&plant_mutex);
+    return speed;
+}
@@ -0,0 +1,295 @@
+/**
+ * @file mqtt-client.c
+ * @brief esp_mqtt_client shim with a simulated broker for the host build
+ */
+
+#include "mqtt_client.h"
+#include "mqtt-sim.h"
+#include "hw-trace.h"
+#include "esp_timer.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_SUBSCRIPTIONS 8
+#define LAST_MESSAGES 8
+
+struct esp_mqtt_client
+{
+    esp_event_handler_t handler;
+    void *handler_arg;
+    bool started;
+    bool connected;
+    int next_msg_id;
+    char subscriptions[MAX_SUBSCRIPTIONS][MQTT_SIM_TOPIC_SIZE];
+    int subscription_count;
+};
+
+static struct esp_mqtt_client *active_client = NULL;
+static mqtt_sim_message_t last_messages[LAST_MESSAGES];
+static uint32_t published_count = 0;
+static pthread_mutex_t mqtt_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// The handler runs without the mutex held, it calls back into the client (subscribe)
+static void dispatch(struct esp_mqtt_client *client, esp_mqtt_event_t *event)
+{
+    event->client = client;
+    if (client->handler != NULL)
+    {
+        client->handler(client->handler_arg, "MQTT_EVENTS", event->event_id, event);
+    }
+}
+
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t *config)
+{
+    if (config == NULL || config->broker.address.uri == NULL)
+    {
+        return NULL;
+    }
+
+    struct esp_mqtt_client *client = calloc(1, sizeof(struct esp_mqtt_client));
+    if (client != NULL)
+    {
+        client->next_msg_id = 1;
+    }
+    return client;
+}
+
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event,
+                                         esp_event_handler_t event_handler, void *event_handler_arg)
+{
+    (void)event;
+    if (client == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    client->handler = event_handler;
+    client->handler_arg = event_handler_arg;
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client)
+{
+    if (client == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&mqtt_mutex);
+    if (client->started)
+    {
+        pthread_mutex_unlock(&mqtt_mutex);
+        return ESP_FAIL;
+    }
+    client->started = true;
+    active_client = client;
+    pthread_mutex_unlock(&mqtt_mutex);
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_stop(esp_mqtt_client_handle_t client)
+{
+    if (client == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&mqtt_mutex);
+    client->started = false;
+    client->connected = false;
+    client->subscription_count = 0;
+    if (active_client == client)
+    {
+        active_client = NULL;
+    }
+    pthread_mutex_unlock(&mqtt_mutex);
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_destroy(esp_mqtt_client_handle_t client)
+{
+    if (client == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_mqtt_client_stop(client);
+    free(client);
+    return ESP_OK;
+}
+
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t client, const char *topic, int qos)
+{
+    (void)qos;
+    if (client == NULL || topic == NULL)
+    {
+        return -1;
+    }
+
+    pthread_mutex_lock(&mqtt_mutex);
+    if (!client->connected || client->subscription_count == MAX_SUBSCRIPTIONS)
+    {
+        pthread_mutex_unlock(&mqtt_mutex);
+        return -1;
+    }
+    strncpy(client->subscriptions[client->subscription_count], topic, MQTT_SIM_TOPIC_SIZE - 1);
+    client->subscription_count++;
+    int msg_id = client->next_msg_id++;
+    pthread_mutex_unlock(&mqtt_mutex);
+    return msg_id;
+}
+
+static int store_message(esp_mqtt_client_handle_t client, const char *topic, const char *data, int len)
+{
+    if (client == NULL || topic == NULL || (data == NULL && len > 0))
+    {
+        return -1;
+    }
+    if (len == 0 && data != NULL)
+    {
+        len = (int)strlen(data);
+    }
+
+    mqtt_sim_message_t message = {.time_us = esp_timer_get_time(), .len = (size_t)len};
+    strncpy(message.topic, topic, MQTT_SIM_TOPIC_SIZE - 1);
+    memcpy(message.payload, data, len < MQTT_SIM_PAYLOAD_SIZE ? (size_t)len : MQTT_SIM_PAYLOAD_SIZE);
+
+    pthread_mutex_lock(&mqtt_mutex);
+    if (!client->started)
+    {
+        pthread_mutex_unlock(&mqtt_mutex);
+        return -1;
+    }
+    last_messages[published_count % LAST_MESSAGES] = message;
+    published_count++;
+    int msg_id = client->next_msg_id++;
+    pthread_mutex_unlock(&mqtt_mutex);
+
+    hw_trace_record(HW_TRACE_MQTT_PUBLISH, 0, 0, data, (size_t)len);
+    return msg_id;
+}
+
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char *topic, const char *data, int len, int qos, int retain)
+{
+    (void)qos;
+    (void)retain;
+    if (client == NULL || !client->connected)
+    {
+        return -1;
+    }
+    return store_message(client, topic, data, len);
+}
+
+int esp_mqtt_client_enqueue(esp_mqtt_client_handle_t client, const char *topic, const char *data, int len, int qos,
+                            int retain, bool store)
+{
+    (void)qos;
+    (void)retain;
+    (void)store;
+    return store_message(client, topic, data, len);
+}
+
+esp_err_t mqtt_sim_connect(void)
+{
+    pthread_mutex_lock(&mqtt_mutex);
+    struct esp_mqtt_client *client = active_client;
+    if (client == NULL)
+    {
+        pthread_mutex_unlock(&mqtt_mutex);
+        return ESP_ERR_INVALID_STATE;
+    }
+    client->connected = true;
+    pthread_mutex_unlock(&mqtt_mutex);
+
+    esp_mqtt_event_t event = {.event_id = MQTT_EVENT_CONNECTED, .msg_id = -1};
+    dispatch(client, &event);
+    return ESP_OK;
+}
+
+esp_err_t mqtt_sim_disconnect(void)
+{
+    pthread_mutex_lock(&mqtt_mutex);
+    struct esp_mqtt_client *client = active_client;
+    if (client == NULL || !client->connected)
+    {
+        pthread_mutex_unlock(&mqtt_mutex);
+        return ESP_ERR_INVALID_STATE;
+    }
+    client->connected = false;
+    client->subscription_count = 0;
+    pthread_mutex_unlock(&mqtt_mutex);
+
+    esp_mqtt_event_t event = {.event_id = MQTT_EVENT_DISCONNECTED, .msg_id = -1};
+    dispatch(client, &event);
+    return ESP_OK;
+}
+
+esp_err_t mqtt_sim_deliver(const char *topic, const void *payload, size_t len)
+{
+    pthread_mutex_lock(&mqtt_mutex);
+    struct esp_mqtt_client *client = active_client;
+    if (client == NULL || !client->connected)
+    {
+        pthread_mutex_unlock(&mqtt_mutex);
+        return ESP_ERR_INVALID_STATE;
+    }
+    bool subscribed = false;
+    for (int i = 0; i < client->subscription_count && !subscribed; i++)
+    {
+        subscribed = strcmp(client->subscriptions[i], topic) == 0;
+    }
+    int msg_id = client->next_msg_id++;
+    pthread_mutex_unlock(&mqtt_mutex);
+
+    if (!subscribed)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    hw_trace_record(HW_TRACE_MQTT_RECEIVE, 0, 0, payload, len);
+
+    // ESP-MQTT hands out pointers into its receive buffer, the data is not NUL terminated
+    char data[MQTT_SIM_PAYLOAD_SIZE];
+    char topic_copy[MQTT_SIM_TOPIC_SIZE];
+    size_t data_len = len < sizeof(data) ? len : sizeof(data);
+    memcpy(data, payload, data_len);
+    strncpy(topic_copy, topic, sizeof(topic_copy) - 1);
+    topic_copy[sizeof(topic_copy) - 1] = '\0';
+
+    esp_mqtt_event_t event = {
+        .event_id = MQTT_EVENT_DATA,
+        .data = data,
+        .data_len = (int)data_len,
+        .total_data_len = (int)data_len,
+        .topic = topic_copy,
+        .topic_len = (int)strlen(topic_copy),
+        .msg_id = msg_id};
+    dispatch(client, &event);
+    return ESP_OK;
+}
+
+uint32_t mqtt_sim_get_published_count(void)
+{
+    pthread_mutex_lock(&mqtt_mutex);
+    uint32_t count = published_count;
+    pthread_mutex_unlock(&mqtt_mutex);
+    return count;
+}
+
+bool mqtt_sim_get_last_published(const char *topic, mqtt_sim_message_t *message)
+{
+    bool found = false;
+    pthread_mutex_lock(&mqtt_mutex);
+    uint32_t available = published_count < LAST_MESSAGES ? published_count : LAST_MESSAGES;
+    for (uint32_t i = 0; i < available && !found; i++)
+    {
+        const mqtt_sim_message_t *candidate = &last_messages[(published_count - 1 - i) % LAST_MESSAGES];
+        if (strcmp(candidate->topic, topic) == 0)
+        {
+            *message = *candidate;
+            found = true;
+        }
+    }
+    pthread_mutex_unlock(&mqtt_mutex);
+    return found;
+}
@@ -0,0 +1,290 @@
+/**
+ * @file pcnt.c
+ * @brief Simulated pulse counter units of the host build
+ */
+
+#include "driver/pulse_cnt.h"
+#include "hw-sim.h"
+#include "motor-plant-sim.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define PCNT_SIM_UNITS 8
+#define PCNT_SIM_CHANNELS 2
+
+struct pcnt_chan_t
+{
+    bool in_use;
+    int edge_gpio_num;
+    int level_gpio_num;
+    pcnt_channel_edge_action_t pos_act;
+    pcnt_channel_edge_action_t neg_act;
+    pcnt_channel_level_action_t high_act;
+    pcnt_channel_level_action_t low_act;
+};
+
+struct pcnt_unit_t
+{
+    bool in_use;
+    bool enabled;
+    bool running;
+    pcnt_unit_config_t config;
+    int count;
+    struct pcnt_chan_t channels[PCNT_SIM_CHANNELS];
+};
+
+static struct pcnt_unit_t units[PCNT_SIM_UNITS];
+static pthread_mutex_t pcnt_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+esp_err_t pcnt_new_unit(const pcnt_unit_config_t *config, pcnt_unit_handle_t *ret_unit)
+{
+    if (config == NULL || ret_unit == NULL || config->low_limit >= 0 || config->high_limit <= 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&pcnt_mutex);
+    for (int i = 0; i < PCNT_SIM_UNITS; i++)
+    {
+        if (!units[i].in_use)
+        {
+            units[i] = (struct pcnt_unit_t){.in_use = true, .config = *config};
+            *ret_unit = &units[i];
+            pthread_mutex_unlock(&pcnt_mutex);
+            return ESP_OK;
+        }
+    }
+    pthread_mutex_unlock(&pcnt_mutex);
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t pcnt_del_unit(pcnt_unit_handle_t unit)
+{
+    if (unit == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&pcnt_mutex);
+    esp_err_t ret = ESP_OK;
+    if (unit->enabled || unit->channels[0].in_use || unit->channels[1].in_use)
+    {
+        ret = ESP_ERR_INVALID_STATE;
+    }
+    else
+    {
+        unit->in_use = false;
+    }
+    pthread_mutex_unlock(&pcnt_mutex);
+    return ret;
+}
+
+esp_err_t pcnt_unit_set_glitch_filter(pcnt_unit_handle_t unit, const pcnt_glitch_filter_config_t *config)
+{
+    // The filter runs on the 80 MHz APB clock with a 10 bit threshold
+    if (unit == NULL || (config != NULL && config->max_glitch_ns > 1023 * 1000 / 80))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t set_state(pcnt_unit_handle_t unit, bool *state, bool value, bool requires_enabled)
+{
+    if (unit == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&pcnt_mutex);
+    esp_err_t ret = ESP_OK;
+    if (requires_enabled && !unit->enabled)
+    {
+        ret = ESP_ERR_INVALID_STATE;
+    }
+    else
+    {
+        *state = value;
+    }
+    pthread_mutex_unlock(&pcnt_mutex);
+    return ret;
+}
+
+esp_err_t pcnt_unit_enable(pcnt_unit_handle_t unit)
+{
+    return set_state(unit, unit ? &unit->enabled : NULL, true, false);
+}
+
+esp_err_t pcnt_unit_disable(pcnt_unit_handle_t unit)
+{
+    if (unit != NULL && unit->running)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return set_state(unit, unit ? &unit->enabled : NULL, false, false);
+}
+
+esp_err_t pcnt_unit_start(pcnt_unit_handle_t unit)
+{
+    return set_state(unit, unit ? &unit->running : NULL, true, true);
+}
+
+esp_err_t pcnt_unit_stop(pcnt_unit_handle_t unit)
+{
+    return set_state(unit, unit ? &unit->running : NULL, false, true);
+}
+
+esp_err_t pcnt_unit_clear_count(pcnt_unit_handle_t unit)
+{
+    if (unit == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&pcnt_mutex);
+    unit->count = 0;
+    pthread_mutex_unlock(&pcnt_mutex);
+    return ESP_OK;
+}
+
+esp_err_t pcnt_unit_get_count(pcnt_unit_handle_t unit, int *value)
+{
+    if (unit == NULL || value == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Counts of the plants up to now (takes the plant lock, which adds counts under the pcnt lock)
+    motor_plant_sim_sync();
+
+    pthread_mutex_lock(&pcnt_mutex);
+    *value = unit->count;
+    pthread_mutex_unlock(&pcnt_mutex);
+    return ESP_OK;
+}
+
+esp_err_t pcnt_unit_add_watch_point(pcnt_unit_handle_t unit, int watch_point)
+{
+    if (unit == NULL || watch_point < unit->config.low_limit || watch_point > unit->config.high_limit)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
+
+esp_err_t pcnt_new_channel(pcnt_unit_handle_t unit, const pcnt_chan_config_t *config, pcnt_channel_handle_t *ret_chan)
+{
+    if (unit == NULL || config == NULL || ret_chan == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&pcnt_mutex);
+    for (int i = 0; i < PCNT_SIM_CHANNELS; i++)
+    {
+        if (!unit->channels[i].in_use)
+        {
+            unit->channels[i] = (struct pcnt_chan_t){
+                .in_use = true,
+                .edge_gpio_num = config->edge_gpio_num,
+                .level_gpio_num = config->level_gpio_num,
+            };
+            *ret_chan = &unit->channels[i];
+            pthread_mutex_unlock(&pcnt_mutex);
+            return ESP_OK;
+        }
+    }
+    pthread_mutex_unlock(&pcnt_mutex);
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t pcnt_del_channel(pcnt_channel_handle_t chan)
+{
+    if (chan == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&pcnt_mutex);
+    chan->in_use = false;
+    pthread_mutex_unlock(&pcnt_mutex);
+    return ESP_OK;
+}
+
+esp_err_t pcnt_channel_set_edge_action(pcnt_channel_handle_t chan, pcnt_channel_edge_action_t pos_act, pcnt_channel_edge_action_t neg_act)
+{
+    if (chan == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&pcnt_mutex);
+    chan->pos_act = pos_act;
+    chan->neg_act = neg_act;
+    pthread_mutex_unlock(&pcnt_mutex);
+    return ESP_OK;
+}
+
+esp_err_t pcnt_channel_set_level_action(pcnt_channel_handle_t chan, pcnt_channel_level_action_t high_act, pcnt_channel_level_action_t low_act)
+{
+    if (chan == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&pcnt_mutex);
+    chan->high_act = high_act;
+    chan->low_act = low_act;
+    pthread_mutex_unlock(&pcnt_mutex);
+    return ESP_OK;
+}
+
+// Count direction of the channel for a rising edge while the level input is low, i.e. for the
+// rotation in which its edge signal leads
+static int leading_edge_sign(const struct pcnt_chan_t *chan)
+{
+    int sign = chan->pos_act == PCNT_CHANNEL_EDGE_ACTION_INCREASE   ? 1
+               : chan->pos_act == PCNT_CHANNEL_EDGE_ACTION_DECREASE ? -1
+                                                                    : 0;
+    if (chan->low_act == PCNT_CHANNEL_LEVEL_ACTION_INVERSE)
+    {
+        sign = -sign;
+    }
+    else if (chan->low_act == PCNT_CHANNEL_LEVEL_ACTION_HOLD)
+    {
+        sign = 0;
+    }
+    return sign;
+}
+
+void pcnt_sim_add_counts(int a_gpio_num, int counts)
+{
+    pthread_mutex_lock(&pcnt_mutex);
+    for (int i = 0; i < PCNT_SIM_UNITS; i++)
+    {
+        struct pcnt_unit_t *unit = &units[i];
+        if (!unit->in_use || !unit->running)
+        {
+            continue;
+        }
+
+        for (int c = 0; c < PCNT_SIM_CHANNELS; c++)
+        {
+            const struct pcnt_chan_t *chan = &unit->channels[c];
+            if (!chan->in_use || chan->edge_gpio_num != a_gpio_num)
+            {
+                continue;
+            }
+
+            // Without accumulation the hardware counter restarts at 0 when it reaches a limit
+            unit->count += counts * leading_edge_sign(chan);
+            if (!unit->config.flags.accum_count)
+            {
+                unit->count %= unit->count >= 0 ? unit->config.high_limit : -unit->config.low_limit;
+            }
+        }
+    }
+    pthread_mutex_unlock(&pcnt_mutex);
+}
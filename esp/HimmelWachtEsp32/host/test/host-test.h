@@ -0,0 +1,67 @@
+/**
+ * @file host-test.h
+ * @brief Minimal check macros for the host tests
+ *
+ * A failed check prints the location and is counted, the test keeps running. main() ends with
+ * HOST_TEST_RESULT(), which is the exit code for ctest.
+ */
+
+#pragma once
+
+#include <math.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "esp_timer.h"
+#include "sim-clock.h"
+
+static int host_test_failures = 0;
+
+#define CHECK(condition) do {                                                              \
+        if (!(condition)) {                                                                \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition);  \
+            host_test_failures++;                                                          \
+        }                                                                                  \
+    } while (0)
+
+#define CHECK_EQ(expected, actual) do {                                                    \
+        long long expected_ = (long long)(expected);                                       \
+        long long actual_ = (long long)(actual);                                           \
+        if (expected_ != actual_) {                                                        \
+            fprintf(stderr, "%s:%d: CHECK_EQ failed: %s == %s (%lld != %lld)\n",           \
+                    __FILE__, __LINE__, #expected, #actual, expected_, actual_);           \
+            host_test_failures++;                                                          \
+        }                                                                                  \
+    } while (0)
+
+#define CHECK_NEAR(expected, actual, tolerance) do {                                       \
+        double expected_ = (double)(expected);                                             \
+        double actual_ = (double)(actual);                                                 \
+        if (fabs(expected_ - actual_) > (tolerance)) {                                     \
+            fprintf(stderr, "%s:%d: CHECK_NEAR failed: %s ~ %s (%g != %g)\n",              \
+                    __FILE__, __LINE__, #expected, #actual, expected_, actual_);           \
+            host_test_failures++;                                                          \
+        }                                                                                  \
+    } while (0)
+
+// Polls a condition written by another task, true if it held within timeout_ms (simulated ones while
+// the clock is simulated)
+#define WAIT_UNTIL(condition, timeout_ms) ({                                               \
+        int64_t deadline_ = esp_timer_get_time() + (int64_t)(timeout_ms) * 1000;           \
+        while (!(condition) && esp_timer_get_time() < deadline_) {                         \
+            if (sim_clock_enabled()) {                                                     \
+                sim_clock_advance(1000);                                                   \
+            } else {                                                                       \
+                usleep(1000);                                                              \
+            }                                                                              \
+        }                                                                                  \
+        (condition);                                                                       \
+    })
+
+#define RUN_TEST(test) do {                                                                \
+        int failures_before_ = host_test_failures;                                         \
+        test();                                                                            \
+        printf("%s %s\n", host_test_failures == failures_before_ ? "PASS" : "FAIL", #test); \
+    } while (0)
+
+#define HOST_TEST_RESULT() (host_test_failures == 0 ? 0 : 1)
@@ -0,0 +1,745 @@
+/**
+ * @file test-diff-drive.c
+ * @brief Joystick mixing of the differential drive and its task driving both motors
+ *
+ * The motors ignore target changes up to direction_hysteresis in the same direction (see
+ * motor_driver_set_speed()), so the outputs settle within the hysteresis around the target.
+ *
+ * The speed control runs against DC motor plants (motor-plant-sim.h) with a sagged battery and a load,
+ * once open loop and once on the encoders, and prints tracking error and settle time of both. A full
+ * speed start from standstill runs with and without the current limit on the simulated current sense.
+ * Stop and reversal from full speed run once on the ramp and once with the brake profile and print
+ * stop time, stop distance and reversal time of both.
+ */
+
+#include "diff-drive.h"
+#include "diff-drive-mix.h"
+#include "hw-sim.h"
+#include "hw-trace.h"
+#include "motor-plant-sim.h"
+#include "host-test.h"
+#include "trace_log.h"
+
+#include <IQmathLib.h>
+#include <string.h>
+
+#define LEFT_PWM_GPIO 27
+#define LEFT_DIR_GPIO 26
+#define RIGHT_PWM_GPIO 23
+#define RIGHT_DIR_GPIO 22
+#define HYSTERESIS 5
+#define LEFT_ENCODER_A_GPIO 34
+#define LEFT_ENCODER_B_GPIO 35
+#define RIGHT_ENCODER_A_GPIO 36
+#define RIGHT_ENCODER_B_GPIO 39
+#define LEFT_CS_CHANNEL ADC_CHANNEL_4
+#define RIGHT_CS_CHANNEL ADC_CHANNEL_5
+
+// Plant: 24 V gear motor with 1920 counts per wheel revolution, about 10500 counts/s without load
+#define COUNTS_PER_REV 1920.0f
+#define MAX_SPEED_CPS 10000
+
+static const diff_drive_config_t diff_drive_config = {
+    .max_input = 512,
+    .recovery_time_ms = 1000,
+    .task_priority = 0,
+    .task_stack_size = 4096,
+    .task_core_id = 0,
+    .loop_rate_hz = 100};
+
+static const motor_config_t left_motor_config = {
+    .mcpwm_group_id = 0,
+    .pwm_gpio_num = LEFT_PWM_GPIO,
+    .dir_gpio_num = LEFT_DIR_GPIO,
+    .pwm_frequency_hz = 20000,
+    .ramp_rate = 5,
+    .ramp_intervall_ms = 10,
+    .direction_hysteresis = HYSTERESIS,
+    .pwm_duty_limit = 100,
+    .mynr = 0};
+
+static const motor_config_t right_motor_config = {
+    .mcpwm_group_id = 0,
+    .pwm_gpio_num = RIGHT_PWM_GPIO,
+    .dir_gpio_num = RIGHT_DIR_GPIO,
+    .pwm_frequency_hz = 20000,
+    .ramp_rate = 5,
+    .ramp_intervall_ms = 10,
+    .direction_hysteresis = HYSTERESIS,
+    .pwm_duty_limit = 100,
+    .mynr = 1};
+
+static const motor_plant_sim_config_t left_plant_config = {
+    .pwm_gpio_num = LEFT_PWM_GPIO,
+    .dir_gpio_num = LEFT_DIR_GPIO,
+    .encoder_a_gpio_num = LEFT_ENCODER_A_GPIO,
+    .counts_per_rev = COUNTS_PER_REV,
+    .supply_v = 24.0f,
+    .resistance_ohm = 4.4f,
+    .motor_constant = 0.69f,
+    .inertia_kgm2 = 0.02f,
+    .viscous_nms = 0.001f,
+    .load_nm = 0.0f};
+
+static const diff_drive_speed_config_t speed_control_config = {
+    .enabled = true,
+    .left_encoder = {.a_gpio_num = LEFT_ENCODER_A_GPIO, .b_gpio_num = LEFT_ENCODER_B_GPIO, .glitch_filter_ns = 1000},
+    .right_encoder = {.a_gpio_num = RIGHT_ENCODER_A_GPIO, .b_gpio_num = RIGHT_ENCODER_B_GPIO, .glitch_filter_ns = 1000},
+    .max_speed_cps = MAX_SPEED_CPS,
+    .kp = 2 * 256,  // 2.0
+    .ki = 20 * 256, // 20 / s
+};
+
+// Pololu G2 24v13 current sense
+static const diff_drive_current_config_t current_sense_config = {
+    .enabled = true,
+    .sensor = {
+        .channels = {LEFT_CS_CHANNEL, RIGHT_CS_CHANNEL},
+        .atten = ADC_ATTEN_DB_12,
+        .sample_rate_hz = 20000,
+        .mv_per_a = 20,
+        .offset_mv = 50,
+        .filter_shift = 1,
+    },
+};
+
+static diff_drive_handle_t *drive = NULL;
+
+// calculate_speeds() of diff-drive.c before the mixing table (condensed), the reference for the table
+static void reference_speeds(int16_t x, int16_t y, int16_t max_input, float left_limit, float right_limit,
+                             float *left_speed, float *right_speed, motor_direction_t *left_dir,
+                             motor_direction_t *right_dir)
+{
+    const _iq IQ_ZERO = _IQ(0.0);
+    const _iq IQ_ONE = _IQ(1.0);
+    const _iq IQ_DEADBAND = _IQ(0.20);
+    const _iq IQ_SHARP_TURN_THRESHOLD = _IQ(0.7);
+    const _iq IQ_HUNDRED = _IQ(100.0);
+    const _iq IQ_FIFTY = _IQ(50.0);
+
+    if (x == 0 && y == 0)
+    {
+        *left_speed = *right_speed = 0.0f;
+        *left_dir = *right_dir = MOTOR_DIRECTION_STOP;
+        return;
+    }
+
+    _iq max_input_iq = _IQ((float)max_input);
+    _iq h_norm = _IQdiv(_IQ((float)x), max_input_iq);
+    _iq v_norm = _IQdiv(_IQ((float)y), max_input_iq);
+    h_norm = h_norm > IQ_ONE ? IQ_ONE : h_norm < -IQ_ONE ? -IQ_ONE : h_norm;
+    v_norm = v_norm > IQ_ONE ? IQ_ONE : v_norm < -IQ_ONE ? -IQ_ONE : v_norm;
+    if (_IQabs(h_norm) < IQ_DEADBAND)
+        h_norm = IQ_ZERO;
+    if (_IQabs(v_norm) < IQ_DEADBAND)
+        v_norm = IQ_ZERO;
+
+    _iq left = IQ_ZERO;
+    _iq right = IQ_ZERO;
+    if (v_norm == IQ_ZERO)
+    {
+        left = right = _IQmpy(_IQabs(h_norm), IQ_HUNDRED);
+        *left_dir = h_norm > IQ_ZERO ? MOTOR_DIRECTION_FORWARD : h_norm < IQ_ZERO ? MOTOR_DIRECTION_BACKWARD : MOTOR_DIRECTION_STOP;
+        *right_dir = h_norm > IQ_ZERO ? MOTOR_DIRECTION_BACKWARD : h_norm < IQ_ZERO ? MOTOR_DIRECTION_FORWARD : MOTOR_DIRECTION_STOP;
+    }
+    else
+    {
+        *left_dir = *right_dir = v_norm > IQ_ZERO ? MOTOR_DIRECTION_FORWARD : MOTOR_DIRECTION_BACKWARD;
+        _iq base_speed = _IQabs(v_norm);
+        _iq turn_factor = _IQabs(h_norm);
+        left = right = _IQmpy(base_speed, IQ_HUNDRED);
+        _iq *inner = h_norm > IQ_ZERO ? &right : &left;
+        motor_direction_t *inner_dir = h_norm > IQ_ZERO ? right_dir : left_dir;
+        if (h_norm != IQ_ZERO)
+        {
+            *inner = _IQmpy(_IQmpy(base_speed, (IQ_ONE - turn_factor)), IQ_HUNDRED);
+            if (turn_factor > IQ_SHARP_TURN_THRESHOLD)
+            {
+                *inner = _IQmpy(turn_factor, IQ_FIFTY);
+                *inner_dir = *inner_dir == MOTOR_DIRECTION_FORWARD ? MOTOR_DIRECTION_BACKWARD : MOTOR_DIRECTION_FORWARD;
+            }
+        }
+    }
+
+    left = left > IQ_HUNDRED ? IQ_HUNDRED : left < IQ_ZERO ? IQ_ZERO : left;
+    right = right > IQ_HUNDRED ? IQ_HUNDRED : right < IQ_ZERO ? IQ_ZERO : right;
+    *left_speed = _IQtoF(_IQmpy(_IQdiv(left, IQ_HUNDRED), _IQ(left_limit)));
+    *right_speed = _IQtoF(_IQmpy(_IQdiv(right, IQ_HUNDRED), _IQ(right_limit)));
+}
+
+static float signed_speed(float speed, motor_direction_t dir)
+{
+    return dir == MOTOR_DIRECTION_BACKWARD ? -speed : dir == MOTOR_DIRECTION_FORWARD ? speed : 0;
+}
+
+static float left_duty(void)
+{
+    return mcpwm_sim_get_duty(LEFT_PWM_GPIO);
+}
+
+static float right_duty(void)
+{
+    return mcpwm_sim_get_duty(RIGHT_PWM_GPIO);
+}
+
+static bool settled(float left, float right)
+{
+    return fabsf(left_duty() - left) <= HYSTERESIS && fabsf(right_duty() - right) <= HYSTERESIS;
+}
+
+static esp_err_t send(int16_t x, int16_t y)
+{
+    input_matrix_t matrix = {.x = (uint16_t)x, .y = (uint16_t)y};
+    return diff_drive_send_cmd(drive, &matrix);
+}
+
+static void test_mix_table(void)
+{
+    diff_drive_mixer_t mixer;
+    CHECK_EQ(ESP_ERR_INVALID_ARG, diff_drive_mixer_init(&mixer, 0));
+    CHECK_EQ(ESP_ERR_INVALID_ARG, diff_drive_mixer_init(NULL, 512));
+
+    // Every stick position up to beyond full deflection, for the main.c range and two odd ones
+    const int16_t max_inputs[] = {diff_drive_config.max_input, 100, 1000};
+    for (size_t i = 0; i < sizeof(max_inputs) / sizeof(max_inputs[0]); i++)
+    {
+        const int16_t max_input = max_inputs[i];
+        CHECK_EQ(ESP_OK, diff_drive_mixer_init(&mixer, max_input));
+
+        float max_error = 0;
+        int direction_mismatches = 0;
+        for (int x = -max_input - 20; x <= max_input + 20; x++)
+        {
+            for (int y = -max_input - 20; y <= max_input + 20; y++)
+            {
+                float left_ref, right_ref;
+                motor_direction_t left_dir, right_dir;
+                reference_speeds((int16_t)x, (int16_t)y, max_input, 100, 100, &left_ref, &right_ref, &left_dir, &right_dir);
+                diff_drive_mix_t mix = diff_drive_mix(&mixer, (int16_t)x, (int16_t)y);
+
+                float left = (float)mix.left / DIFF_DRIVE_MIX_OUTPUT_ONE;
+                float right = (float)mix.right / DIFF_DRIVE_MIX_OUTPUT_ONE;
+                max_error = fmaxf(max_error, fabsf(left - signed_speed(left_ref, left_dir)));
+                max_error = fmaxf(max_error, fabsf(right - signed_speed(right_ref, right_dir)));
+                direction_mismatches += (mix.left == 0) != (left_dir == MOTOR_DIRECTION_STOP);
+                direction_mismatches += (mix.right == 0) != (right_dir == MOTOR_DIRECTION_STOP);
+            }
+        }
+
+        // IQ15 rounding of the reference and the 1/256 % table unit
+        printf("mix table, max input %d: max deviation %.4f %% duty\n", max_input, max_error);
+        CHECK(max_error < 0.02f);
+        CHECK_EQ(0, direction_mismatches);
+    }
+}
+
+static void test_init(void)
+{
+    hw_trace_reset();
+    drive = diff_drive_init(&diff_drive_config, &left_motor_config, &right_motor_config);
+    CHECK(drive != NULL);
+    CHECK(drive->is_running);
+    CHECK_EQ(0, left_duty());
+    CHECK_EQ(0, right_duty());
+
+    CHECK(diff_drive_init(NULL, &left_motor_config, &right_motor_config) == NULL);
+    CHECK(diff_drive_init(&diff_drive_config, NULL, &right_motor_config) == NULL);
+
+    diff_drive_config_t invalid_rate = diff_drive_config;
+    invalid_rate.loop_rate_hz = 0;
+    CHECK(diff_drive_init(&invalid_rate, &left_motor_config, &right_motor_config) == NULL);
+    invalid_rate.loop_rate_hz = DIFF_DRIVE_MAX_LOOP_RATE_HZ + 1;
+    CHECK(diff_drive_init(&invalid_rate, &left_motor_config, &right_motor_config) == NULL);
+}
+
+static void test_forward(void)
+{
+    CHECK_EQ(ESP_OK, send(0, 512));
+    CHECK(WAIT_UNTIL(settled(100, 100), 2000));
+    CHECK_EQ(1, gpio_sim_get_level(LEFT_DIR_GPIO));
+    CHECK_EQ(1, gpio_sim_get_level(RIGHT_DIR_GPIO));
+}
+
+static void test_turn_right(void)
+{
+    // Half right: the inner wheel runs at half speed
+    CHECK_EQ(ESP_OK, send(256, 512));
+    CHECK(WAIT_UNTIL(settled(100, 50), 2000));
+    CHECK_EQ(1, gpio_sim_get_level(LEFT_DIR_GPIO));
+    CHECK_EQ(1, gpio_sim_get_level(RIGHT_DIR_GPIO));
+}
+
+static void test_spin_right(void)
+{
+    // No vertical input: rotate in place with opposing wheels
+    CHECK_EQ(ESP_OK, send(512, 0));
+    CHECK(WAIT_UNTIL(settled(100, 100) && gpio_sim_get_level(RIGHT_DIR_GPIO) == 0, 3000));
+    CHECK_EQ(1, gpio_sim_get_level(LEFT_DIR_GPIO));
+    CHECK_EQ(0, gpio_sim_get_level(RIGHT_DIR_GPIO));
+}
+
+static void test_backward_deadband(void)
+{
+    // Horizontal input inside the 20 % deadband is ignored
+    CHECK_EQ(ESP_OK, send(50, -256));
+    CHECK(WAIT_UNTIL(settled(50, 50) && gpio_sim_get_level(LEFT_DIR_GPIO) == 0, 3000));
+    CHECK_EQ(0, gpio_sim_get_level(LEFT_DIR_GPIO));
+    CHECK_EQ(0, gpio_sim_get_level(RIGHT_DIR_GPIO));
+}
+
+static void test_stop(void)
+{
+    CHECK_EQ(ESP_OK, send(0, 0));
+    CHECK(WAIT_UNTIL(settled(0, 0) && drive->left_motor->current_direction == MOTOR_DIRECTION_STOP &&
+                         drive->right_motor->current_direction == MOTOR_DIRECTION_STOP,
+                     2000));
+}
+
+static int64_t apply_time(const hw_trace_event_t *event)
+{
+    int64_t apply_us = 0;
+    memcpy(&apply_us, event->data, sizeof(apply_us));
+    return apply_us;
+}
+
+static void test_common_period_start(void)
+{
+    // Both motors share the timer of MCPWM group 0. On the simulated clock one loop iteration writes both
+    // compare values within one PWM period, both wait in the shadow register for the same period start.
+    sim_clock_enable();
+    size_t start = hw_trace_count();
+    CHECK_EQ(ESP_OK, send(0, 512));
+    CHECK(WAIT_UNTIL(settled(100, 100), 2000));
+
+    const int64_t period_us = 1000000 / left_motor_config.pwm_frequency_hz;
+    int pairs = 0;
+    hw_trace_event_t left;
+    hw_trace_event_t right;
+    for (size_t i = hw_trace_find(start, HW_TRACE_MCPWM_DUTY, LEFT_PWM_GPIO); hw_trace_get(i, &left);
+         i = hw_trace_find(i + 1, HW_TRACE_MCPWM_DUTY, LEFT_PWM_GPIO))
+    {
+        if (!hw_trace_get(hw_trace_find(i, HW_TRACE_MCPWM_DUTY, RIGHT_PWM_GPIO), &right) ||
+            right.time_us - left.time_us >= period_us)
+        {
+            continue;
+        }
+
+        CHECK(apply_time(&left) > left.time_us);
+        CHECK(apply_time(&left) - left.time_us <= period_us);
+        CHECK_EQ(apply_time(&left), apply_time(&right));
+        pairs++;
+    }
+    printf("left/right duty writes: %d pairs on the same period start\n", pairs);
+    CHECK(pairs >= 5);
+
+    CHECK_EQ(ESP_OK, send(0, 0));
+    CHECK(WAIT_UNTIL(settled(0, 0), 2000));
+    sim_clock_disable();
+}
+
+static void test_latest_wins(void)
+{
+    // A burst of commands the task has not taken yet: only the newest is applied
+    trace_log_clear();
+    for (int i = 0; i < 20; i++)
+    {
+        CHECK_EQ(ESP_OK, send(-512, (int16_t)(-512 + i * 10)));
+    }
+    CHECK(uxQueueMessagesWaiting(drive->cmd_mailbox) <= 1);
+    CHECK_EQ(ESP_OK, send(0, 512));
+    int64_t sent_us = esp_timer_get_time();
+
+    // Taken by the next loop iteration, not after the stale ones
+    CHECK(WAIT_UNTIL(drive->left_motor->target_direction == MOTOR_DIRECTION_FORWARD &&
+                         drive->right_motor->target_direction == MOTOR_DIRECTION_FORWARD &&
+                         drive->left_motor->target_pwm == 100,
+                     500));
+    CHECK(esp_timer_get_time() - sent_us < 50 * 1000);
+
+    // The trace log shows all commands sent, but only few taken
+    static trace_log_record_t records[TRACE_LOG_RECORDS];
+    uint32_t count = trace_log_snapshot(records, TRACE_LOG_RECORDS);
+    int sent = 0;
+    int received = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const char *fmt = trace_log_anchor + records[i].fmt_id;
+        sent += strcmp(fmt, "DIFF_DRIVE: Command sent to mailbox: left=%d, right=%d") == 0;
+        received += strcmp(fmt, "DIFF_DRIVE: Command received: left=%d, right=%d") == 0;
+    }
+    CHECK_EQ(21, sent);
+    CHECK(received >= 1 && received < sent);
+
+    CHECK(WAIT_UNTIL(settled(100, 100), 2000));
+}
+
+static void test_deadman(void)
+{
+    // No further command: the drive stops after recovery_time_ms on its own
+    CHECK(!drive->deadman_stopped);
+    CHECK(WAIT_UNTIL(drive->deadman_stopped, 3000));
+    int64_t tripped_us = esp_timer_get_time();
+    CHECK(tripped_us - drive->last_cmd_us >= (int64_t)diff_drive_config.recovery_time_ms * 1000 - 1000000 / diff_drive_config.loop_rate_hz);
+    CHECK(WAIT_UNTIL(settled(0, 0) && drive->left_motor->current_direction == MOTOR_DIRECTION_STOP &&
+                         drive->right_motor->current_direction == MOTOR_DIRECTION_STOP,
+                     2000));
+
+    // The next command takes over again
+    CHECK_EQ(ESP_OK, send(0, 256));
+    CHECK(WAIT_UNTIL(!drive->deadman_stopped && settled(50, 50), 2000));
+    CHECK_EQ(ESP_OK, send(0, 0));
+    CHECK(WAIT_UNTIL(settled(0, 0), 2000));
+}
+
+static void test_loop_stats(void)
+{
+    diff_drive_loop_stats_t stats;
+    CHECK_EQ(ESP_OK, diff_drive_get_loop_stats(drive, &stats, true));
+
+    // The loop keeps its rate while commands arrive at an unrelated rate
+    int64_t start_us = esp_timer_get_time();
+    for (int i = 0; i < 50; i++)
+    {
+        CHECK_EQ(ESP_OK, send(0, (int16_t)(i % 2 ? 512 : 256)));
+        usleep(7 * 1000);
+    }
+    int64_t elapsed_us = esp_timer_get_time() - start_us;
+    CHECK_EQ(ESP_OK, diff_drive_get_loop_stats(drive, &stats, false));
+
+    uint32_t expected = (uint32_t)(elapsed_us * diff_drive_config.loop_rate_hz / 1000000);
+    CHECK(stats.iterations >= expected * 8 / 10);
+    CHECK(stats.iterations <= expected + 2);
+    CHECK(stats.overruns <= stats.iterations / 10);
+    CHECK(stats.mean_jitter_us <= stats.max_jitter_us);
+    CHECK(stats.max_exec_us < 1000000 / diff_drive_config.loop_rate_hz);
+
+    CHECK_EQ(ESP_ERR_INVALID_ARG, diff_drive_get_loop_stats(NULL, &stats, false));
+    CHECK_EQ(ESP_ERR_INVALID_ARG, diff_drive_get_loop_stats(drive, NULL, false));
+}
+
+static void test_invalid_args(void)
+{
+    input_matrix_t matrix = {0};
+    CHECK_EQ(ESP_ERR_INVALID_ARG, diff_drive_send_cmd(NULL, &matrix));
+    CHECK_EQ(ESP_ERR_INVALID_ARG, diff_drive_send_cmd(drive, NULL));
+    CHECK_EQ(ESP_ERR_INVALID_ARG, diff_drive_deinit(NULL));
+}
+
+static void test_deinit(void)
+{
+    CHECK_EQ(ESP_OK, send(0, 512));
+    CHECK_EQ(ESP_OK, diff_drive_deinit(drive));
+    CHECK_EQ(0, left_duty());
+    CHECK_EQ(0, right_duty());
+
+    // The task is gone, nothing touches the motors anymore
+    size_t count = hw_trace_count_of(HW_TRACE_MCPWM_DUTY, HW_TRACE_ANY_TARGET);
+    usleep(100 * 1000);
+    CHECK_EQ(count, hw_trace_count_of(HW_TRACE_MCPWM_DUTY, HW_TRACE_ANY_TARGET));
+    drive = NULL;
+}
+
+typedef struct
+{
+    float error_percent; // Mean deviation from the setpoint in the last 500 ms
+    int settle_ms;       // Time until the speed stays within 5 % of the setpoint, -1 if it never does
+} step_response_t;
+
+// Speed step 0 -> 60 % of both wheels on a 22 V battery with a load of 0.5 Nm, on the simulated clock
+static step_response_t step_response(const diff_drive_config_t *config)
+{
+    const int duration_ms = 3000;
+    const int sample_ms = 10;
+    const float setpoint = 0.6f * MAX_SPEED_CPS * 2.0f * (float)M_PI / COUNTS_PER_REV;
+
+    step_response_t response = {.error_percent = 100, .settle_ms = -1};
+    sim_clock_enable();
+    drive = diff_drive_init(config, &left_motor_config, &right_motor_config);
+    CHECK(drive != NULL);
+    if (drive == NULL)
+    {
+        sim_clock_disable();
+        return response;
+    }
+
+    motor_plant_sim_config_t plant_config = left_plant_config;
+    plant_config.supply_v = 22.0f;
+    plant_config.load_nm = 0.5f;
+    int left = motor_plant_sim_start(&plant_config);
+    plant_config.pwm_gpio_num = RIGHT_PWM_GPIO;
+    plant_config.dir_gpio_num = RIGHT_DIR_GPIO;
+    plant_config.encoder_a_gpio_num = RIGHT_ENCODER_A_GPIO;
+    int right = motor_plant_sim_start(&plant_config);
+    CHECK(left >= 0 && right >= 0);
+
+    float error_sum = 0;
+    int error_samples = 0;
+    for (int t = 0; t < duration_ms; t += sample_ms)
+    {
+        // Repeated within recovery_time_ms, the deadman would stop the drive otherwise
+        if (t % 100 == 0)
+        {
+            CHECK_EQ(ESP_OK, send(0, (int16_t)(0.6f * diff_drive_config.max_input + 0.5f)));
+        }
+        sim_clock_advance(sample_ms * 1000);
+        motor_plant_sim_sync();
+
+        float error = fmaxf(fabsf(motor_plant_sim_get_speed(left) - setpoint), fabsf(motor_plant_sim_get_speed(right) - setpoint)) / setpoint;
+        if (error > 0.05f)
+        {
+            response.settle_ms = -1;
+        }
+        else if (response.settle_ms < 0)
+        {
+            response.settle_ms = t + sample_ms;
+        }
+        if (t >= duration_ms - 500)
+        {
+            error_sum += error;
+            error_samples++;
+        }
+    }
+    response.error_percent = 100 * error_sum / error_samples;
+
+    CHECK_EQ(ESP_OK, diff_drive_deinit(drive));
+    drive = NULL;
+    motor_plant_sim_stop_all();
+    sim_clock_disable();
+    return response;
+}
+
+static void test_speed_control(void)
+{
+    diff_drive_config_t closed_loop_config = diff_drive_config;
+    closed_loop_config.speed_control = speed_control_config;
+
+    step_response_t open_loop = step_response(&diff_drive_config);
+    step_response_t closed_loop = step_response(&closed_loop_config);
+    printf("speed step to 60 %%, 22 V, 0.5 Nm load: open loop error %.1f %% (settled %d ms), closed loop error %.1f %% (settled %d ms)\n",
+           open_loop.error_percent, open_loop.settle_ms, closed_loop.error_percent, closed_loop.settle_ms);
+
+    // Open loop the battery and the load slow the wheels down, the controller compensates both
+    CHECK(open_loop.error_percent > 10);
+    CHECK(closed_loop.error_percent < 2);
+    CHECK(closed_loop.settle_ms > 0 && closed_loop.settle_ms < 1000);
+
+    // Encoder validation
+    closed_loop_config.speed_control.max_speed_cps = closed_loop_config.loop_rate_hz - 1;
+    CHECK(diff_drive_init(&closed_loop_config, &left_motor_config, &right_motor_config) == NULL);
+    closed_loop_config.speed_control = speed_control_config;
+    closed_loop_config.speed_control.right_encoder.b_gpio_num = RIGHT_ENCODER_A_GPIO;
+    CHECK(diff_drive_init(&closed_loop_config, &left_motor_config, &right_motor_config) == NULL);
+}
+
+typedef struct
+{
+    float peak_a;   // Highest supply current of a motor (duty * motor current, what the CS pin measures)
+    int rise_ms;    // Time until both wheels reach 90 % of the no-load speed, -1 if they do not
+    uint32_t reported_ma; // Current of the left motor handed to the ramp at the end
+} start_response_t;
+
+// Full speed from standstill on 24 V without load
+static start_response_t start_response(uint16_t current_limit_ma)
+{
+    const int duration_ms = 1500;
+    const int sample_ms = 2;
+
+    start_response_t response = {.rise_ms = -1};
+    diff_drive_config_t config = diff_drive_config;
+    config.current_sense = current_sense_config;
+    motor_config_t left_config = left_motor_config;
+    motor_config_t right_config = right_motor_config;
+    left_config.current_limit_ma = current_limit_ma;
+    right_config.current_limit_ma = current_limit_ma;
+
+    motor_plant_sim_config_t plant_config = left_plant_config;
+    plant_config.sense_adc_channel = LEFT_CS_CHANNEL;
+    plant_config.sense_mv_per_a = 20;
+    plant_config.sense_offset_mv = 50;
+    int left = motor_plant_sim_start(&plant_config);
+    plant_config.pwm_gpio_num = RIGHT_PWM_GPIO;
+    plant_config.dir_gpio_num = RIGHT_DIR_GPIO;
+    plant_config.encoder_a_gpio_num = RIGHT_ENCODER_A_GPIO;
+    plant_config.sense_adc_channel = RIGHT_CS_CHANNEL;
+    int right = motor_plant_sim_start(&plant_config);
+    CHECK(left >= 0 && right >= 0);
+
+    drive = diff_drive_init(&config, &left_config, &right_config);
+    CHECK(drive != NULL);
+    if (drive == NULL)
+    {
+        motor_plant_sim_stop_all();
+        return response;
+    }
+
+    const float target = 0.9f * motor_plant_sim_no_load_speed(left);
+    int64_t start_us = esp_timer_get_time();
+    for (int t = 0; t < duration_ms; t += sample_ms)
+    {
+        if (t % 100 == 0)
+        {
+            CHECK_EQ(ESP_OK, send(0, 512));
+        }
+        int64_t wait_us = start_us + (int64_t)(t + sample_ms) * 1000 - esp_timer_get_time();
+        if (wait_us > 0)
+        {
+            usleep((useconds_t)wait_us);
+        }
+
+        motor_plant_sim_sync();
+        response.peak_a = fmaxf(response.peak_a, left_duty() / 100 * fabsf(motor_plant_sim_get_current(left)));
+        response.peak_a = fmaxf(response.peak_a, right_duty() / 100 * fabsf(motor_plant_sim_get_current(right)));
+        if (response.rise_ms < 0 && motor_plant_sim_get_speed(left) >= target && motor_plant_sim_get_speed(right) >= target)
+        {
+            response.rise_ms = t + sample_ms;
+        }
+    }
+    response.reported_ma = drive->left_motor->current_ma;
+
+    CHECK_EQ(ESP_OK, diff_drive_deinit(drive));
+    drive = NULL;
+    motor_plant_sim_stop_all();
+    return response;
+}
+
+static void test_current_limit(void)
+{
+    start_response_t unlimited = start_response(0);
+    start_response_t limited = start_response(1500);
+    printf("full speed start, 24 V: unlimited peak %.2f A (90 %% after %d ms), 1.5 A limit peak %.2f A (90 %% after %d ms)\n",
+           unlimited.peak_a, unlimited.rise_ms, limited.peak_a, limited.rise_ms);
+
+    // The limit caps the start current and still reaches full speed, only later
+    CHECK(unlimited.peak_a > 3.0f);
+    CHECK(limited.peak_a < 1.5f * 1.35f);
+    CHECK(unlimited.rise_ms > 0);
+    CHECK(limited.rise_ms > unlimited.rise_ms);
+
+    // The no-load current at full speed is measured as well
+    CHECK(limited.reported_ma > 0 && limited.reported_ma < 1500);
+
+    diff_drive_config_t invalid = diff_drive_config;
+    invalid.current_sense = current_sense_config;
+    invalid.current_sense.sensor.mv_per_a = 0;
+    CHECK(diff_drive_init(&invalid, &left_motor_config, &right_motor_config) == NULL);
+}
+
+typedef struct
+{
+    int stop_ms;     // Time from the stop command until both wheels are below 5 % of the no-load speed
+    float stop_rev;  // Wheel revolutions of the left wheel after the stop command
+    int reverse_ms;  // Time from the reversal command until both wheels reach 90 % backwards
+} stop_response_t;
+
+// Runs the drive on the command for duration_ms and returns the first time both wheels are within
+// band of speed (-1 if they never are), distance_rev receives the revolutions of the left wheel
+static int drive_until(int left, int right, int16_t y, int duration_ms, float speed, float band, float *distance_rev)
+{
+    const int sample_ms = 2;
+
+    int reached_ms = -1;
+    float distance = 0;
+    int64_t start_us = esp_timer_get_time();
+    for (int t = 0; t < duration_ms; t += sample_ms)
+    {
+        if (t % 100 == 0)
+        {
+            CHECK_EQ(ESP_OK, send(0, y));
+        }
+        int64_t wait_us = start_us + (int64_t)(t + sample_ms) * 1000 - esp_timer_get_time();
+        if (wait_us > 0)
+        {
+            usleep((useconds_t)wait_us);
+        }
+
+        motor_plant_sim_sync();
+        float left_speed = motor_plant_sim_get_speed(left);
+        float right_speed = motor_plant_sim_get_speed(right);
+        distance += left_speed * sample_ms * 1e-3f / (2.0f * (float)M_PI);
+        if (reached_ms < 0 && fabsf(left_speed - speed) <= band && fabsf(right_speed - speed) <= band)
+        {
+            reached_ms = t + sample_ms;
+        }
+    }
+
+    if (distance_rev != NULL)
+    {
+        *distance_rev = distance;
+    }
+    return reached_ms;
+}
+
+// Stop and reversal from full speed on 24 V without load
+static stop_response_t stop_response(uint16_t brake_time_ms, uint16_t brake_hold_ms)
+{
+    stop_response_t response = {.stop_ms = -1, .reverse_ms = -1};
+    motor_config_t left_config = left_motor_config;
+    motor_config_t right_config = right_motor_config;
+    left_config.brake_time_ms = right_config.brake_time_ms = brake_time_ms;
+    left_config.brake_hold_ms = right_config.brake_hold_ms = brake_hold_ms;
+
+    motor_plant_sim_config_t plant_config = left_plant_config;
+    int left = motor_plant_sim_start(&plant_config);
+    plant_config.pwm_gpio_num = RIGHT_PWM_GPIO;
+    plant_config.dir_gpio_num = RIGHT_DIR_GPIO;
+    plant_config.encoder_a_gpio_num = RIGHT_ENCODER_A_GPIO;
+    int right = motor_plant_sim_start(&plant_config);
+    CHECK(left >= 0 && right >= 0);
+
+    drive = diff_drive_init(&diff_drive_config, &left_config, &right_config);
+    CHECK(drive != NULL);
+    if (drive == NULL)
+    {
+        motor_plant_sim_stop_all();
+        return response;
+    }
+
+    const float no_load = motor_plant_sim_no_load_speed(left);
+    CHECK(drive_until(left, right, 512, 1500, no_load, 0.05f * no_load, NULL) > 0);
+    response.stop_ms = drive_until(left, right, 0, 1500, 0, 0.05f * no_load, &response.stop_rev);
+
+    CHECK(drive_until(left, right, 512, 1500, no_load, 0.05f * no_load, NULL) > 0);
+    response.reverse_ms = drive_until(left, right, -512, 1500, -no_load, 0.1f * no_load, NULL);
+
+    CHECK_EQ(ESP_OK, diff_drive_deinit(drive));
+    drive = NULL;
+    motor_plant_sim_stop_all();
+    return response;
+}
+
+static void test_brake(void)
+{
+    stop_response_t ramp = stop_response(0, 0);
+    stop_response_t brake = stop_response(50, 50);
+    printf("stop from full speed, 24 V: ramp %d ms / %.2f rev (reversal %d ms), brake 50 + 50 ms %d ms / %.2f rev "
+           "(reversal %d ms)\n",
+           ramp.stop_ms, ramp.stop_rev, ramp.reverse_ms, brake.stop_ms, brake.stop_rev, brake.reverse_ms);
+
+    // The brake profile shortens the stop, the reversal takes no longer than on the ramp
+    CHECK(ramp.stop_ms > 0 && brake.stop_ms > 0);
+    CHECK(brake.stop_ms < ramp.stop_ms);
+    CHECK(brake.stop_rev < ramp.stop_rev);
+    CHECK(ramp.reverse_ms > 0 && brake.reverse_ms > 0);
+    CHECK(brake.reverse_ms <= ramp.reverse_ms);
+}
+
+int main(void)
+{
+    RUN_TEST(test_mix_table);
+    RUN_TEST(test_init);
+    RUN_TEST(test_forward);
+    RUN_TEST(test_turn_right);
+    RUN_TEST(test_spin_right);
+    RUN_TEST(test_backward_deadband);
+    RUN_TEST(test_stop);
+    RUN_TEST(test_common_period_start);
+    RUN_TEST(test_latest_wins);
+    RUN_TEST(test_deadman);
+    RUN_TEST(test_loop_stats);
+    RUN_TEST(test_invalid_args);
+    RUN_TEST(test_deinit);
+    RUN_TEST(test_speed_control);
+    RUN_TEST(test_current_limit);
+    RUN_TEST(test_brake);
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,147 @@
+/**
+ * @file test-motor-current.c
+ * @brief Current sense of the motor drivers on the simulated ADC in continuous mode
+ */
+
+#include "motor-current.h"
+#include "hw-sim.h"
+#include "host-test.h"
+
+#define LEFT_CHANNEL ADC_CHANNEL_4
+#define RIGHT_CHANNEL ADC_CHANNEL_5
+
+// One LSB at 12 dB is 0.6 mV = 30 mA, the mean of a period averages the noise out
+#define CURRENT_TOLERANCE_MA 100
+
+static const motor_current_config_t sense_config = {
+    .channels = {LEFT_CHANNEL, RIGHT_CHANNEL},
+    .atten = ADC_ATTEN_DB_12,
+    .sample_rate_hz = 20000,
+    .mv_per_a = 20,
+    .offset_mv = 50,
+    .filter_shift = 2};
+
+static motor_current_handle_t *sense = NULL;
+
+static int32_t current(int channel)
+{
+    int32_t value = -1;
+    CHECK_EQ(ESP_OK, motor_current_get(sense, channel, &value));
+    return value;
+}
+
+// One drive loop period
+static void update(void)
+{
+    usleep(10000);
+    CHECK_EQ(ESP_OK, motor_current_update(sense));
+}
+
+static void test_init(void)
+{
+    CHECK(motor_current_init(NULL) == NULL);
+    motor_current_config_t invalid = sense_config;
+    invalid.channels[MOTOR_CURRENT_RIGHT] = LEFT_CHANNEL;
+    CHECK(motor_current_init(&invalid) == NULL);
+    invalid = sense_config;
+    invalid.mv_per_a = 0;
+    CHECK(motor_current_init(&invalid) == NULL);
+    invalid = sense_config;
+    invalid.sample_rate_hz = 1000;
+    CHECK(motor_current_init(&invalid) == NULL);
+
+    // 5 A left, 12.5 A right
+    adc_sim_set_voltage(LEFT_CHANNEL, 50 + 20 * 5);
+    adc_sim_set_voltage(RIGHT_CHANNEL, 50 + 250);
+    sense = motor_current_init(&sense_config);
+    CHECK(sense != NULL);
+    CHECK_EQ(0, current(MOTOR_CURRENT_LEFT));
+
+    // The ADC has one DMA controller
+    CHECK(motor_current_init(&sense_config) == NULL);
+}
+
+static void test_conversion(void)
+{
+    // The first update takes the mean without filtering
+    update();
+
+    CHECK_NEAR(5000, current(MOTOR_CURRENT_LEFT), CURRENT_TOLERANCE_MA);
+    CHECK_NEAR(12500, current(MOTOR_CURRENT_RIGHT), CURRENT_TOLERANCE_MA);
+}
+
+static void test_filter(void)
+{
+    // Step to 10 A: a quarter of the step per update, then settled
+    int32_t before = current(MOTOR_CURRENT_LEFT);
+    adc_sim_set_voltage(LEFT_CHANNEL, 50 + 200);
+    update();
+    CHECK_NEAR(before + (10000 - before) / 4, current(MOTOR_CURRENT_LEFT), CURRENT_TOLERANCE_MA);
+
+    for (int i = 0; i < 30; i++)
+    {
+        update();
+    }
+    CHECK_NEAR(10000, current(MOTOR_CURRENT_LEFT), CURRENT_TOLERANCE_MA);
+    CHECK_NEAR(12500, current(MOTOR_CURRENT_RIGHT), CURRENT_TOLERANCE_MA);
+}
+
+static void test_below_offset(void)
+{
+    // Offset tolerance of the CS output does not turn into a negative current
+    adc_sim_set_voltage(RIGHT_CHANNEL, 20);
+    for (int i = 0; i < 60; i++)
+    {
+        update();
+    }
+    CHECK_EQ(0, current(MOTOR_CURRENT_RIGHT));
+}
+
+static void test_missed_period(void)
+{
+    // A late update only sees the newest conversions, the value is still right
+    uint32_t dropped = adc_sim_get_dropped();
+    adc_sim_set_voltage(RIGHT_CHANNEL, 50 + 60);
+    usleep(200000);
+    CHECK_EQ(ESP_OK, motor_current_update(sense));
+    CHECK(adc_sim_get_dropped() > dropped);
+
+    for (int i = 0; i < 30; i++)
+    {
+        update();
+    }
+    CHECK_NEAR(3000, current(MOTOR_CURRENT_RIGHT), CURRENT_TOLERANCE_MA);
+}
+
+static void test_invalid_args(void)
+{
+    int32_t value = 0;
+    CHECK_EQ(ESP_ERR_INVALID_ARG, motor_current_update(NULL));
+    CHECK_EQ(ESP_ERR_INVALID_ARG, motor_current_get(NULL, MOTOR_CURRENT_LEFT, &value));
+    CHECK_EQ(ESP_ERR_INVALID_ARG, motor_current_get(sense, MOTOR_CURRENT_LEFT, NULL));
+    CHECK_EQ(ESP_ERR_INVALID_ARG, motor_current_get(sense, MOTOR_CURRENT_CHANNELS, &value));
+    CHECK_EQ(ESP_ERR_INVALID_ARG, motor_current_deinit(NULL));
+}
+
+static void test_deinit(void)
+{
+    CHECK_EQ(ESP_OK, motor_current_deinit(sense));
+    sense = NULL;
+
+    // The ADC is released
+    motor_current_handle_t *again = motor_current_init(&sense_config);
+    CHECK(again != NULL);
+    CHECK_EQ(ESP_OK, motor_current_deinit(again));
+}
+
+int main(void)
+{
+    RUN_TEST(test_init);
+    RUN_TEST(test_conversion);
+    RUN_TEST(test_filter);
+    RUN_TEST(test_below_offset);
+    RUN_TEST(test_missed_period);
+    RUN_TEST(test_invalid_args);
+    RUN_TEST(test_deinit);
+    return HOST_TEST_RESULT();
+}
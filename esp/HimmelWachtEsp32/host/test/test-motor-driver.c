@@ -0,0 +1,407 @@
+/**
+ * @file test-motor-driver.c
+ * @brief Ramp, direction change and limits of the motor driver on the simulated MCPWM
+ */
+
+#include "motor-driver.h"
+#include "hw-sim.h"
+#include "hw-trace.h"
+#include "host-test.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include <string.h>
+#include <unistd.h>
+
+#define PWM_GPIO 27
+#define DIR_GPIO 26
+#define PWM_PERIOD_US 50
+
+static const motor_config_t motor_config = {
+    .mcpwm_group_id = 0,
+    .pwm_gpio_num = PWM_GPIO,
+    .dir_gpio_num = DIR_GPIO,
+    .pwm_frequency_hz = 20000,
+    .ramp_rate = 5,
+    .ramp_intervall_ms = 10,
+    .direction_hysteresis = 5,
+    .pwm_duty_limit = 60,
+    .mynr = 0};
+
+static motor_handle_t *motor = NULL;
+
+// Duty at the pin once the period of the last compare write has ended
+static float pin_duty(int gpio_num)
+{
+    usleep(PWM_PERIOD_US);
+    return mcpwm_sim_get_duty(gpio_num);
+}
+
+static float duty(void)
+{
+    return pin_duty(PWM_GPIO);
+}
+
+static int64_t apply_time(const hw_trace_event_t *event)
+{
+    int64_t apply_us = 0;
+    memcpy(&apply_us, event->data, sizeof(apply_us));
+    return apply_us;
+}
+
+// Calls motor_driver_update() like the diff-drive task until the motor reached its target
+static bool update_until_settled(int timeout_ms)
+{
+    return WAIT_UNTIL(motor_driver_update(motor) == ESP_OK && !motor_driver_is_update_necessary(motor), timeout_ms);
+}
+
+static void test_init(void)
+{
+    hw_trace_reset();
+    motor = motor_driver_init(&motor_config);
+    CHECK(motor != NULL);
+    CHECK(motor->initialized);
+    CHECK_EQ(MOTOR_DIRECTION_STOP, motor->current_direction);
+
+    CHECK(hw_trace_count_of(HW_TRACE_GPIO_CONFIG, DIR_GPIO) == 1);
+    hw_trace_event_t event;
+    CHECK(hw_trace_last(HW_TRACE_MCPWM_INIT, PWM_GPIO, &event));
+    CHECK_EQ(20000, event.value);
+    CHECK_EQ(20000, mcpwm_sim_get_frequency(PWM_GPIO));
+    CHECK_EQ(0, duty());
+
+    CHECK(motor_driver_init(NULL) == NULL);
+    motor_config_t invalid = motor_config;
+    invalid.mcpwm_group_id = SOC_MCPWM_GROUPS;
+    CHECK(motor_driver_init(&invalid) == NULL);
+}
+
+static void test_ramp(void)
+{
+    size_t start = hw_trace_count();
+    int64_t start_us = esp_timer_get_time();
+    CHECK_EQ(ESP_OK, motor_driver_set_speed(motor, 50, MOTOR_DIRECTION_FORWARD));
+    CHECK(update_until_settled(2000));
+    int64_t elapsed_us = esp_timer_get_time() - start_us;
+
+    CHECK_EQ(50, duty());
+    CHECK_EQ(1, gpio_sim_get_level(DIR_GPIO));
+
+    // Never more than ramp_rate per ramp interval since the command
+    const int64_t interval_us = motor_config.ramp_intervall_ms * 1000;
+    float previous = 0;
+    hw_trace_event_t event;
+    for (size_t i = hw_trace_find(start, HW_TRACE_MCPWM_DUTY, PWM_GPIO); hw_trace_get(i, &event);
+         i = hw_trace_find(i + 1, HW_TRACE_MCPWM_DUTY, PWM_GPIO))
+    {
+        CHECK(event.value <= motor_config.ramp_rate * ((event.time_us - start_us) / interval_us + 1));
+        CHECK(event.value >= previous);
+        previous = event.value;
+    }
+    CHECK(elapsed_us >= (50 / motor_config.ramp_rate - 1) * interval_us);
+}
+
+static void test_direction_change(void)
+{
+    size_t start = hw_trace_count();
+    CHECK_EQ(ESP_OK, motor_driver_set_speed(motor, 30, MOTOR_DIRECTION_BACKWARD));
+    CHECK(update_until_settled(2000));
+    CHECK_EQ(30, duty());
+    CHECK_EQ(0, gpio_sim_get_level(DIR_GPIO));
+
+    // The direction pin only flips after the duty dropped into the hysteresis
+    size_t flip = start;
+    hw_trace_event_t event;
+    while (hw_trace_get(flip = hw_trace_find(flip, HW_TRACE_GPIO_LEVEL, DIR_GPIO), &event) && event.value != 0)
+    {
+        flip++;
+    }
+    CHECK(flip < hw_trace_count());
+    float duty_before_flip = 100;
+    for (size_t i = hw_trace_find(start, HW_TRACE_MCPWM_DUTY, PWM_GPIO); i < flip && hw_trace_get(i, &event);
+         i = hw_trace_find(i + 1, HW_TRACE_MCPWM_DUTY, PWM_GPIO))
+    {
+        duty_before_flip = event.value;
+    }
+    CHECK(duty_before_flip <= motor_config.direction_hysteresis);
+}
+
+static void test_hysteresis(void)
+{
+    // A change within the hysteresis is ignored, the motor stays at its duty
+    CHECK_EQ(ESP_OK, motor_driver_set_speed(motor, 30 + motor_config.direction_hysteresis, MOTOR_DIRECTION_BACKWARD));
+    CHECK(!motor_driver_is_update_necessary(motor));
+    CHECK_EQ(30, duty());
+    CHECK_EQ(ESP_ERR_INVALID_ARG, motor_driver_set_speed(motor, 30, (motor_direction_t)(MOTOR_DIRECTION_BRAKE + 1)));
+}
+
+static void test_s_curve(void)
+{
+    // Separate motor with jerk limit: 100 ms until the full acceleration of 5 % per 10 ms
+    motor_config_t s_curve_config = motor_config;
+    s_curve_config.pwm_gpio_num = 25;
+    s_curve_config.dir_gpio_num = 33;
+    s_curve_config.ramp_jerk_time_ms = 100;
+    motor_handle_t *s_curve = motor_driver_init(&s_curve_config);
+    CHECK(s_curve != NULL);
+    CHECK_EQ(s_curve->ramp.accel_limit / 10, s_curve->ramp.jerk_limit);
+
+    // Calculate the steps directly, without the timing of motor_driver_update()
+    CHECK_EQ(ESP_OK, motor_driver_set_speed(s_curve, 60, MOTOR_DIRECTION_FORWARD));
+    int32_t previous_accel = 0;
+    int steps = 0;
+    int full_accel_steps = 0;
+    while (motor_driver_is_update_necessary(s_curve) && steps < 100)
+    {
+        int32_t previous_velocity = s_curve->ramp.velocity;
+        s_curve->last_update_us = esp_timer_get_time() - s_curve_config.ramp_intervall_ms * 1000;
+        CHECK_EQ(ESP_OK, motor_driver_update(s_curve));
+        int32_t accel = s_curve->ramp.velocity - previous_velocity;
+
+        CHECK(accel >= 0);
+        CHECK(accel <= s_curve->ramp.accel_limit);
+        if (s_curve->ramp.velocity != s_curve->ramp.target)
+        {
+            CHECK(abs(accel - previous_accel) <= s_curve->ramp.jerk_limit);
+        }
+        full_accel_steps += accel == s_curve->ramp.accel_limit;
+        previous_accel = accel;
+        steps++;
+    }
+
+    // Reaches the target exactly, with rounded corners at both ends of the full acceleration phase
+    CHECK_EQ(60, pin_duty(25));
+    CHECK(full_accel_steps > 0);
+    CHECK(steps > 60 / s_curve_config.ramp_rate);
+    CHECK(steps <= 60 / s_curve_config.ramp_rate + 2 * s_curve_config.ramp_jerk_time_ms / s_curve_config.ramp_intervall_ms);
+
+    // A reversal passes through zero in the same profile and flips the direction pin there
+    CHECK_EQ(ESP_OK, motor_driver_set_speed(s_curve, 20, MOTOR_DIRECTION_BACKWARD));
+    bool flipped = false;
+    steps = 0;
+    while (motor_driver_is_update_necessary(s_curve) && steps < 200)
+    {
+        s_curve->last_update_us = esp_timer_get_time() - s_curve_config.ramp_intervall_ms * 1000;
+        CHECK_EQ(ESP_OK, motor_driver_update(s_curve));
+        if (!flipped && gpio_sim_get_level(33) == 0)
+        {
+            flipped = true;
+            CHECK(pin_duty(25) <= s_curve_config.ramp_rate);
+        }
+        steps++;
+    }
+    CHECK(flipped);
+    CHECK_EQ(20, pin_duty(25));
+    CHECK_EQ(MOTOR_DIRECTION_BACKWARD, s_curve->current_direction);
+
+    CHECK_EQ(ESP_OK, motor_driver_deinit(s_curve));
+}
+
+static void test_period_boundary(void)
+{
+    // A second motor of the group runs on the same timer, a different PWM frequency cannot share it
+    motor_config_t other_config = motor_config;
+    other_config.pwm_gpio_num = 25;
+    other_config.dir_gpio_num = 33;
+    other_config.pwm_frequency_hz = 25000;
+    CHECK(motor_driver_init(&other_config) == NULL);
+    other_config.pwm_frequency_hz = motor_config.pwm_frequency_hz;
+    motor_handle_t *other = motor_driver_init(&other_config);
+    CHECK(other != NULL);
+    CHECK(other->timer == motor->timer);
+
+    // Both writes wait in the shadow register and take effect on a period start of the shared timer
+    size_t start = hw_trace_count();
+    CHECK_EQ(ESP_OK, motor_driver_emergency_stop(motor));
+    CHECK_EQ(ESP_OK, motor_driver_set_speed(other, 40, MOTOR_DIRECTION_FORWARD));
+    other->last_update_us = esp_timer_get_time() - other_config.ramp_intervall_ms * 1000;
+    CHECK_EQ(ESP_OK, motor_driver_update(other));
+
+    hw_trace_event_t stop;
+    hw_trace_event_t run;
+    CHECK(hw_trace_get(hw_trace_find(start, HW_TRACE_MCPWM_DUTY, PWM_GPIO), &stop));
+    CHECK(hw_trace_get(hw_trace_find(start, HW_TRACE_MCPWM_DUTY, 25), &run));
+    CHECK_EQ(0, stop.value);
+    CHECK_EQ(motor_config.ramp_rate, run.value);
+    CHECK(apply_time(&stop) > stop.time_us && apply_time(&stop) <= stop.time_us + PWM_PERIOD_US);
+    CHECK(apply_time(&run) > run.time_us && apply_time(&run) <= run.time_us + PWM_PERIOD_US);
+    CHECK_EQ(0, (apply_time(&run) - apply_time(&stop)) % PWM_PERIOD_US);
+    CHECK_EQ(motor_config.ramp_rate, pin_duty(25));
+
+    // The timer keeps running for the remaining motor
+    CHECK_EQ(ESP_OK, motor_driver_deinit(other));
+    CHECK_EQ(20000, mcpwm_sim_get_frequency(PWM_GPIO));
+}
+
+static void test_duty_limit(void)
+{
+    CHECK_EQ(ESP_OK, motor_driver_set_speed(motor, 100, MOTOR_DIRECTION_BACKWARD));
+    CHECK(update_until_settled(3000));
+    // The ramp ends at the duty limit, a later stop starts decelerating right away
+    CHECK_EQ(60, motor->current_pwm);
+    CHECK_EQ(60, duty());
+}
+
+static void test_current_limit(void)
+{
+    // Without current_limit_ma the current is only stored
+    CHECK_EQ(ESP_OK, motor_driver_set_current(motor, 9999));
+    CHECK_EQ(9999, motor->current_ma);
+    CHECK_EQ(motor->ramp.accel_limit, motor->ramp.drive_limit);
+    CHECK_EQ(ESP_ERR_INVALID_ARG, motor_driver_set_current(NULL, 0));
+
+    motor_config_t limited_config = motor_config;
+    limited_config.pwm_gpio_num = 25;
+    limited_config.dir_gpio_num = 33;
+    limited_config.current_limit_ma = 4000;
+    motor_handle_t *limited = motor_driver_init(&limited_config);
+    CHECK(limited != NULL);
+    if (limited == NULL)
+    {
+        return;
+    }
+
+    // Above the band nothing starts, at standstill there is nothing to reduce either
+    CHECK_EQ(ESP_OK, motor_driver_set_speed(limited, 50, MOTOR_DIRECTION_FORWARD));
+    CHECK_EQ(ESP_OK, motor_driver_set_current(limited, 5000));
+    int64_t start_us = esp_timer_get_time();
+    while (esp_timer_get_time() - start_us < 50 * 1000)
+    {
+        motor_driver_update(limited);
+        usleep(1000);
+    }
+    CHECK_EQ(0, pin_duty(25));
+
+    // Half way into the band: half the ramp rate. Each duty write moves by at most half a ramp step per
+    // interval since the previous write (one step for the first), plus the compare resolution.
+    const int64_t interval_us = motor_config.ramp_intervall_ms * 1000;
+    CHECK_EQ(ESP_OK, motor_driver_set_current(limited, 3500));
+    CHECK_EQ(limited->ramp.accel_limit / 2, limited->ramp.drive_limit);
+    size_t start = hw_trace_count();
+    CHECK(WAIT_UNTIL(motor_driver_update(limited) == ESP_OK && !motor_driver_is_update_necessary(limited), 2000));
+    hw_trace_event_t event;
+    float previous = 0;
+    int64_t previous_us = 0;
+    int writes = 0;
+    for (size_t i = hw_trace_find(start, HW_TRACE_MCPWM_DUTY, 25); hw_trace_get(i, &event);
+         i = hw_trace_find(i + 1, HW_TRACE_MCPWM_DUTY, 25))
+    {
+        int64_t steps = writes == 0 ? 1 : (event.time_us - previous_us + interval_us / 2) / interval_us;
+        CHECK(event.value - previous <= motor_config.ramp_rate / 2.0f * (steps > 1 ? steps : 1) + 0.2f);
+        previous = event.value;
+        previous_us = event.time_us;
+        writes++;
+    }
+    CHECK(writes > 0);
+    CHECK_EQ(50, pin_duty(25));
+
+    // Above the limit the duty drops although the target stays
+    CHECK_EQ(ESP_OK, motor_driver_set_current(limited, 4500));
+    start_us = esp_timer_get_time();
+    while (esp_timer_get_time() - start_us < 50 * 1000)
+    {
+        motor_driver_update(limited);
+        usleep(1000);
+    }
+    CHECK(pin_duty(25) < 50);
+    CHECK_EQ(1, gpio_sim_get_level(33));
+
+    // The current is back down: on to the target
+    CHECK_EQ(ESP_OK, motor_driver_set_current(limited, 0));
+    CHECK(WAIT_UNTIL(motor_driver_update(limited) == ESP_OK && !motor_driver_is_update_necessary(limited), 2000));
+    CHECK_EQ(50, pin_duty(25));
+
+    CHECK_EQ(ESP_OK, motor_driver_deinit(limited));
+}
+
+static void test_brake(void)
+{
+    // Without brake_time_ms an explicit brake drops the duty at once, the direction pin stays
+    CHECK_EQ(ESP_OK, motor_driver_set_speed(motor, 0, MOTOR_DIRECTION_BRAKE));
+    CHECK(update_until_settled(100));
+    CHECK_EQ(MOTOR_DIRECTION_BRAKE, motor->current_direction);
+    CHECK_EQ(0, duty());
+    CHECK_EQ(0, gpio_sim_get_level(DIR_GPIO));
+
+    motor_config_t brake_config = motor_config;
+    brake_config.pwm_gpio_num = 25;
+    brake_config.dir_gpio_num = 33;
+    brake_config.brake_time_ms = 50;
+    brake_config.brake_hold_ms = 40;
+    motor_handle_t *braked = motor_driver_init(&brake_config);
+    CHECK(braked != NULL);
+    if (braked == NULL)
+    {
+        return;
+    }
+
+    CHECK_EQ(ESP_OK, motor_driver_set_speed(braked, 60, MOTOR_DIRECTION_FORWARD));
+    CHECK(WAIT_UNTIL(motor_driver_update(braked) == ESP_OK && !motor_driver_is_update_necessary(braked), 2000));
+
+    // Reversal: down to 0 within brake_time_ms, held for brake_hold_ms, then the pin flips
+    size_t start = hw_trace_count();
+    int64_t start_us = esp_timer_get_time();
+    CHECK_EQ(ESP_OK, motor_driver_set_speed(braked, 30, MOTOR_DIRECTION_BACKWARD));
+    CHECK(WAIT_UNTIL(motor_driver_update(braked) == ESP_OK && !motor_driver_is_update_necessary(braked), 2000));
+    CHECK_EQ(30, pin_duty(25));
+    CHECK_EQ(0, gpio_sim_get_level(33));
+
+    const int64_t interval_us = brake_config.ramp_intervall_ms * 1000;
+    hw_trace_event_t event;
+    int64_t zero_us = 0;
+    for (size_t i = hw_trace_find(start, HW_TRACE_MCPWM_DUTY, 25); zero_us == 0 && hw_trace_get(i, &event);
+         i = hw_trace_find(i + 1, HW_TRACE_MCPWM_DUTY, 25))
+    {
+        zero_us = event.value == 0 ? event.time_us : 0;
+    }
+    CHECK(hw_trace_last(HW_TRACE_GPIO_LEVEL, 33, &event));
+    int64_t flip_us = event.time_us;
+    CHECK(zero_us > 0);
+    CHECK(zero_us - start_us <= brake_config.brake_time_ms * 1000 + interval_us);
+    CHECK(flip_us - zero_us >= brake_config.brake_hold_ms * 1000 - interval_us);
+    CHECK(flip_us - start_us <= (brake_config.brake_time_ms + brake_config.brake_hold_ms) * 1000 + 2 * interval_us);
+
+    // Back in the direction of the motion ends the profile, the ramp takes over
+    CHECK_EQ(ESP_OK, motor_driver_set_speed(braked, 0, MOTOR_DIRECTION_STOP));
+    CHECK(braked->ramp.braking);
+    CHECK_EQ(ESP_OK, motor_driver_set_speed(braked, 30, MOTOR_DIRECTION_BACKWARD));
+    CHECK(!braked->ramp.braking);
+
+    CHECK_EQ(ESP_OK, motor_driver_deinit(braked));
+}
+
+static void test_emergency_stop(void)
+{
+    CHECK_EQ(ESP_OK, motor_driver_emergency_stop(motor));
+    CHECK_EQ(0, duty());
+    CHECK_EQ(ESP_ERR_INVALID_ARG, motor_driver_emergency_stop(NULL));
+    CHECK_EQ(ESP_ERR_INVALID_ARG, motor_driver_set_speed(NULL, 10, MOTOR_DIRECTION_FORWARD));
+    CHECK_EQ(ESP_ERR_INVALID_ARG, motor_driver_update(NULL));
+}
+
+static void test_deinit(void)
+{
+    CHECK_EQ(ESP_OK, motor_driver_set_speed(motor, 40, MOTOR_DIRECTION_FORWARD));
+    WAIT_UNTIL(motor_driver_update(motor) == ESP_OK && duty() > 0, 500);
+    CHECK_EQ(ESP_OK, motor_driver_deinit(motor));
+    CHECK_EQ(0, duty());
+    CHECK_EQ(ESP_ERR_INVALID_ARG, motor_driver_deinit(NULL));
+    motor = NULL;
+}
+
+int main(void)
+{
+    RUN_TEST(test_init);
+    RUN_TEST(test_ramp);
+    RUN_TEST(test_direction_change);
+    RUN_TEST(test_hysteresis);
+    RUN_TEST(test_s_curve);
+    RUN_TEST(test_period_boundary);
+    RUN_TEST(test_duty_limit);
+    RUN_TEST(test_current_limit);
+    RUN_TEST(test_brake);
+    RUN_TEST(test_emergency_stop);
+    RUN_TEST(test_deinit);
+    return HOST_TEST_RESULT();
+}
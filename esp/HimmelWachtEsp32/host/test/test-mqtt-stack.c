@@ -0,0 +1,208 @@
+/**
+ * @file test-mqtt-stack.c
+ * @brief Turret commands and telemetry of the MQTT stack against the simulated broker
+ */
+
+#include "mqtt-stack.h"
+#include "mqtt-sim.h"
+#include "host-test.h"
+
+#include <string.h>
+
+#define CMD_TOPIC "vehicle/turret/cmd"
+#define TELEMETRY_TOPIC "vehicle/turret/telemetry"
+
+static const mqtt_config_t mqtt_config = {
+    .broker_uri = "mqtt://127.0.0.1:1883",
+    .topic = CMD_TOPIC,
+    .telemetry_topic = TELEMETRY_TOPIC,
+    .client_id = "host_test",
+    .keepalive = 60,
+    .network_timeout_ms = 5000,
+    .reconnect_timeout_ms = 5000,
+    .queue_timeout_ticks = 1};
+
+static void deliver_binary(int16_t x_centideg, int16_t y_centideg, bool fire, uint16_t seq)
+{
+    turret_command_frame_t frame = {
+        .flags = fire ? TURRET_COMMAND_FLAG_FIRE : 0,
+        .seq = seq,
+        .timestamp_ms = 1000,
+        .x_centideg = x_centideg,
+        .y_centideg = y_centideg};
+    uint8_t payload[TURRET_COMMAND_FRAME_SIZE];
+    turret_protocol_encode_command(&frame, payload);
+    CHECK_EQ(ESP_OK, mqtt_sim_deliver(CMD_TOPIC, payload, sizeof(payload)));
+}
+
+static void drain(void)
+{
+    mqtt_turret_cmd_t cmd;
+    while (mqtt_stack_get_turret_command(&cmd) == ESP_OK)
+    {
+    }
+}
+
+static void test_init(void)
+{
+    CHECK_EQ(ESP_ERR_INVALID_ARG, mqtt_stack_init(NULL));
+    CHECK_EQ(ESP_OK, mqtt_stack_init(&mqtt_config));
+    CHECK(!mqtt_stack_is_connected());
+
+    turret_telemetry_frame_t frame = {0};
+    CHECK_EQ(ESP_ERR_INVALID_STATE, mqtt_stack_publish_telemetry(&frame));
+
+    CHECK_EQ(ESP_OK, mqtt_sim_connect());
+    CHECK(mqtt_stack_is_connected());
+    CHECK(get_discard_command_status());
+}
+
+static void test_discard_by_default(void)
+{
+    deliver_binary(1000, 1000, false, 1);
+    mqtt_turret_cmd_t cmd;
+    CHECK_EQ(ESP_ERR_TIMEOUT, mqtt_stack_get_turret_command(&cmd));
+    CHECK_EQ(ESP_ERR_INVALID_ARG, mqtt_stack_get_turret_command(NULL));
+}
+
+static void test_binary_command(void)
+{
+    set_discard_command_status(false);
+    deliver_binary(1234, -50, true, 0x1234);
+
+    mqtt_turret_cmd_t cmd = {0};
+    CHECK_EQ(ESP_OK, mqtt_stack_get_turret_command(&cmd));
+    CHECK_EQ(12, cmd.platform_x_angle);
+    CHECK_EQ(-1, cmd.platform_y_angle);
+    CHECK(cmd.fire_command);
+    CHECK_EQ(0x1234, cmd.seq);
+}
+
+static void test_json_command(void)
+{
+    const char *json = "{\"platform_x_angle\": -30, \"platform_y_angle\": 45, \"fire_command\": false}";
+    CHECK_EQ(ESP_OK, mqtt_sim_deliver(CMD_TOPIC, json, strlen(json)));
+
+    mqtt_turret_cmd_t cmd = {.seq = 99};
+    CHECK_EQ(ESP_OK, mqtt_stack_get_turret_command(&cmd));
+    CHECK_EQ(-30, cmd.platform_x_angle);
+    CHECK_EQ(45, cmd.platform_y_angle);
+    CHECK(!cmd.fire_command);
+    CHECK_EQ(0, cmd.seq);
+
+    // Missing field
+    const char *incomplete = "{\"platform_x_angle\": -30}";
+    CHECK_EQ(ESP_OK, mqtt_sim_deliver(CMD_TOPIC, incomplete, strlen(incomplete)));
+    CHECK_EQ(ESP_ERR_TIMEOUT, mqtt_stack_get_turret_command(&cmd));
+}
+
+static void test_corrupt_frame(void)
+{
+    turret_command_frame_t frame = {.seq = 5, .x_centideg = 100};
+    uint8_t payload[TURRET_COMMAND_FRAME_SIZE];
+    turret_protocol_encode_command(&frame, payload);
+    payload[5] ^= 0x01;
+    CHECK_EQ(ESP_OK, mqtt_sim_deliver(CMD_TOPIC, payload, sizeof(payload)));
+
+    mqtt_turret_cmd_t cmd;
+    CHECK_EQ(ESP_ERR_TIMEOUT, mqtt_stack_get_turret_command(&cmd));
+}
+
+static void test_queue_full(void)
+{
+    uint16_t dropped_before = mqtt_stack_get_dropped_commands();
+    for (uint16_t seq = 1; seq <= 7; seq++)
+    {
+        deliver_binary(0, 0, false, seq);
+    }
+    CHECK_EQ(2, mqtt_stack_get_dropped_commands() - dropped_before);
+
+    // The oldest commands are kept
+    mqtt_turret_cmd_t cmd;
+    for (uint16_t seq = 1; seq <= 5; seq++)
+    {
+        CHECK_EQ(ESP_OK, mqtt_stack_get_turret_command(&cmd));
+        CHECK_EQ(seq, cmd.seq);
+    }
+    CHECK_EQ(ESP_ERR_TIMEOUT, mqtt_stack_get_turret_command(&cmd));
+
+    // Switching back to discarding empties the queue
+    deliver_binary(0, 0, false, 8);
+    set_discard_command_status(true);
+    CHECK_EQ(ESP_ERR_TIMEOUT, mqtt_stack_get_turret_command(&cmd));
+    set_discard_command_status(false);
+    drain();
+}
+
+// Field by field, the struct has padding bytes that memcmp would compare as well
+static void check_telemetry_equal(const turret_telemetry_frame_t *expected, const turret_telemetry_frame_t *actual)
+{
+    CHECK_EQ(expected->flags, actual->flags);
+    CHECK_EQ(expected->seq, actual->seq);
+    CHECK_EQ(expected->timestamp_ms, actual->timestamp_ms);
+    CHECK_EQ(expected->x_centideg, actual->x_centideg);
+    CHECK_EQ(expected->y_centideg, actual->y_centideg);
+    CHECK_EQ(expected->last_cmd_seq, actual->last_cmd_seq);
+    CHECK_EQ(expected->left_duty, actual->left_duty);
+    CHECK_EQ(expected->right_duty, actual->right_duty);
+    CHECK_EQ(expected->left_current_ma, actual->left_current_ma);
+    CHECK_EQ(expected->right_current_ma, actual->right_current_ma);
+    CHECK_EQ(expected->dropped_cmds, actual->dropped_cmds);
+}
+
+static void test_telemetry(void)
+{
+    turret_telemetry_frame_t frame = {
+        .flags = TURRET_TELEMETRY_FLAG_AUTOMATIC,
+        .seq = 3,
+        .timestamp_ms = 4000,
+        .x_centideg = -1500,
+        .y_centideg = 4800,
+        .last_cmd_seq = 42,
+        .left_duty = 50,
+        .right_duty = -50};
+    uint32_t published_before = mqtt_sim_get_published_count();
+    CHECK_EQ(ESP_OK, mqtt_stack_publish_telemetry(&frame));
+    CHECK_EQ(published_before + 1, mqtt_sim_get_published_count());
+
+    mqtt_sim_message_t message;
+    CHECK(mqtt_sim_get_last_published(TELEMETRY_TOPIC, &message));
+    CHECK_EQ(TURRET_TELEMETRY_FRAME_SIZE, message.len);
+
+    turret_telemetry_frame_t decoded = {0};
+    CHECK_EQ(TURRET_PROTOCOL_OK, turret_protocol_decode_telemetry(message.payload, message.len, &decoded));
+    check_telemetry_equal(&frame, &decoded);
+
+    CHECK_EQ(ESP_ERR_INVALID_ARG, mqtt_stack_publish_telemetry(NULL));
+}
+
+static void test_disconnect(void)
+{
+    CHECK_EQ(ESP_OK, mqtt_sim_disconnect());
+    CHECK(!mqtt_stack_is_connected());
+    turret_telemetry_frame_t frame = {0};
+    CHECK_EQ(ESP_ERR_INVALID_STATE, mqtt_stack_publish_telemetry(&frame));
+
+    // Resubscribes after the reconnect
+    CHECK_EQ(ESP_OK, mqtt_sim_connect());
+    deliver_binary(500, 500, false, 77);
+    mqtt_turret_cmd_t cmd;
+    CHECK_EQ(ESP_OK, mqtt_stack_get_turret_command(&cmd));
+    CHECK_EQ(77, cmd.seq);
+
+    CHECK_EQ(ESP_OK, mqtt_stack_deinit());
+    CHECK_EQ(ESP_ERR_INVALID_STATE, mqtt_stack_deinit());
+}
+
+int main(void)
+{
+    RUN_TEST(test_init);
+    RUN_TEST(test_discard_by_default);
+    RUN_TEST(test_binary_command);
+    RUN_TEST(test_json_command);
+    RUN_TEST(test_corrupt_frame);
+    RUN_TEST(test_queue_full);
+    RUN_TEST(test_telemetry);
+    RUN_TEST(test_disconnect);
+    return HOST_TEST_RESULT();
+}
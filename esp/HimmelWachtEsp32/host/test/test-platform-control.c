@@ -0,0 +1,130 @@
+/**
+ * @file test-platform-control.c
+ * @brief Platform servo angles as PCA9685 channel outputs, with the configuration of main.c
+ */
+
+#include "platform-control.h"
+#include "hw-sim.h"
+#include "hw-trace.h"
+#include "host-test.h"
+
+#include <stdlib.h>
+
+#define X_CHANNEL 2
+#define Y_CHANNEL 1
+
+static platform_config_t platform_cfg = {
+    .pwm_board_config = {
+        .device_address = 0x40,
+        .freq = 50,
+        .i2c_port = 0,
+        .sda_port = 18,
+        .scl_port = 19,
+        .internal_pullup = true},
+    .platform_x_channel = X_CHANNEL,
+    .platform_x_start_angle = 0,
+    .platform_x_left_stop_angle = -90,
+    .platform_x_right_stop_angle = 90,
+    .platform_y_channel = Y_CHANNEL,
+    .platform_y_start_angle = 48,
+    .platform_y_left_stop_angle = 0,
+    .platform_y_right_stop_angle = 80};
+
+// Off count of an angle: 2 counts per degree and 3 for every third degree, 335 is the center
+static uint16_t expected_off(int angle)
+{
+    int magnitude = abs(angle);
+    int three_steps = magnitude / 3;
+    int two_steps = magnitude - three_steps;
+    int steps = two_steps * 2 + three_steps * 3;
+    return (uint16_t)(335 + (angle < 0 ? -steps : steps));
+}
+
+static uint16_t channel_off(uint8_t channel)
+{
+    pca9685_sim_channel_t state = {0};
+    CHECK(pca9685_sim_get_channel(channel, &state));
+    CHECK_EQ(0, state.on);
+    return state.off;
+}
+
+static void test_init(void)
+{
+    hw_trace_reset();
+    CHECK_EQ(ESP_OK, platform_init(&platform_cfg));
+
+    // 25 MHz / (4096 * 50 Hz) - 1
+    CHECK_EQ(121, pca9685_sim_get_register(0xFE));
+    // Awake, auto increment
+    CHECK_EQ(0x20, pca9685_sim_get_register(0x00) & 0x30);
+
+    CHECK_EQ(335, channel_off(X_CHANNEL));
+    CHECK_EQ(expected_off(48), channel_off(Y_CHANNEL));
+    CHECK(hw_trace_count_of(HW_TRACE_I2C_WRITE, 0x40) >= 6);
+}
+
+static void test_angles(void)
+{
+    for (int angle = -90; angle <= 90; angle++)
+    {
+        int8_t result = 0;
+        CHECK_EQ(ESP_OK, platform_x_set_angle((int8_t)angle, &result));
+        CHECK_EQ(angle, result);
+        CHECK_EQ(expected_off(angle), channel_off(X_CHANNEL));
+    }
+
+    // The precalculated end positions match the formula
+    CHECK_EQ(125, expected_off(-90));
+    CHECK_EQ(545, expected_off(90));
+}
+
+static void test_stop_angles(void)
+{
+    int8_t result = 0;
+    CHECK_EQ(ESP_OK, platform_x_set_angle(-100, &result));
+    CHECK_EQ(-90, result);
+    CHECK_EQ(125, channel_off(X_CHANNEL));
+
+    CHECK_EQ(ESP_OK, platform_y_set_angle(90, &result));
+    CHECK_EQ(80, result);
+    CHECK_EQ(expected_off(80), channel_off(Y_CHANNEL));
+
+    CHECK_EQ(ESP_OK, platform_y_set_angle(-10, &result));
+    CHECK_EQ(0, result);
+    CHECK_EQ(335, channel_off(Y_CHANNEL));
+}
+
+static void test_reset(void)
+{
+    int8_t x = 0;
+    int8_t y = 0;
+    platform_x_set_angle(45, NULL);
+    platform_y_set_angle(10, NULL);
+    CHECK_EQ(ESP_OK, platform_reset(&x, &y));
+    CHECK_EQ(0, x);
+    CHECK_EQ(48, y);
+    CHECK_EQ(335, channel_off(X_CHANNEL));
+    CHECK_EQ(expected_off(48), channel_off(Y_CHANNEL));
+}
+
+static void test_i2c_error(void)
+{
+    i2c_sim_set_error(ESP_ERR_TIMEOUT);
+    CHECK(platform_x_set_angle(30, NULL) != ESP_OK);
+    CHECK(platform_reset(NULL, NULL) != ESP_OK);
+    CHECK_EQ(335, channel_off(X_CHANNEL));
+
+    i2c_sim_set_error(ESP_OK);
+    CHECK_EQ(ESP_OK, platform_x_set_angle(30, NULL));
+    CHECK_EQ(expected_off(30), channel_off(X_CHANNEL));
+}
+
+int main(void)
+{
+    RUN_TEST(test_init);
+    RUN_TEST(test_angles);
+    RUN_TEST(test_stop_angles);
+    RUN_TEST(test_reset);
+    RUN_TEST(test_i2c_error);
+    return HOST_TEST_RESULT();
+}
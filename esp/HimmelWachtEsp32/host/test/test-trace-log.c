@@ -0,0 +1,192 @@
+/**
+ * @file test-trace-log.c
+ * @brief Records of the deferred trace log, from several threads and over the end of the ring
+ *
+ * With --dump <file> the test writes a set of records as trace_log_dump() lines on stdout and the same
+ * messages formatted by printf into <file>, the trace-log-decode test compares them with what
+ * trace_decode.py renders from the ELF of this executable.
+ */
+
+#include "trace_log.h"
+#include "host-test.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#define TAG "TEST"
+#define THREADS 4
+#define RECORDS_PER_THREAD 20000
+
+static trace_log_record_t records[TRACE_LOG_RECORDS];
+static int finished; // Writer threads done
+
+static const char *format_of(const trace_log_record_t *record)
+{
+    return trace_log_anchor + record->fmt_id;
+}
+
+static void test_record(void)
+{
+    trace_log_clear();
+    CHECK_EQ(0, trace_log_snapshot(records, TRACE_LOG_RECORDS));
+
+    TRACE_LOG(TAG, "int %d unsigned %u hex %x", -5, 7u, 0xabc);
+    CHECK_EQ(1, trace_log_snapshot(records, TRACE_LOG_RECORDS));
+    CHECK(strcmp("TEST: int %d unsigned %u hex %x", format_of(&records[0])) == 0);
+    CHECK_EQ(0xfffffffbu, records[0].args[0]);
+    CHECK_EQ(7, records[0].args[1]);
+    CHECK_EQ(0xabc, records[0].args[2]);
+    CHECK_EQ(0, records[0].args[3]);
+
+    // Without arguments as well
+    TRACE_LOG(TAG, "no arguments");
+    CHECK_EQ(2, trace_log_snapshot(records, TRACE_LOG_RECORDS));
+    CHECK(strcmp("TEST: no arguments", format_of(&records[1])) == 0);
+    CHECK(records[1].time_us >= records[0].time_us);
+}
+
+static void test_float(void)
+{
+    trace_log_clear();
+    float duty = 42.5f;
+    double limit = 0.1;
+    TRACE_LOG(TAG, "duty %.2f limit %f", duty, limit);
+    CHECK_EQ(1, trace_log_snapshot(records, TRACE_LOG_RECORDS));
+
+    float stored[2];
+    memcpy(&stored[0], &records[0].args[0], sizeof(float));
+    memcpy(&stored[1], &records[0].args[1], sizeof(float));
+    CHECK_EQ(42.5f, stored[0]);
+    CHECK_EQ(0.1f, stored[1]);
+}
+
+static void test_wrap(void)
+{
+    // The ring keeps the newest records, oldest first
+    trace_log_clear();
+    for (int i = 0; i < TRACE_LOG_RECORDS + 10; i++)
+    {
+        TRACE_LOG(TAG, "record %d", i);
+    }
+    CHECK_EQ(TRACE_LOG_RECORDS, trace_log_snapshot(records, TRACE_LOG_RECORDS));
+    CHECK_EQ(10, records[0].args[0]);
+    CHECK_EQ(TRACE_LOG_RECORDS + 9, records[TRACE_LOG_RECORDS - 1].args[0]);
+
+    // A smaller buffer takes the oldest
+    CHECK_EQ(5, trace_log_snapshot(records, 5));
+    CHECK_EQ(10, records[0].args[0]);
+    CHECK_EQ(0, trace_log_snapshot(NULL, 5));
+}
+
+static void *writer(void *arg)
+{
+    uint32_t thread = (uint32_t)(uintptr_t)arg;
+    for (uint32_t i = 0; i < RECORDS_PER_THREAD; i++)
+    {
+        TRACE_LOG(TAG, "thread %u record %u check %u", thread, i, thread ^ i);
+    }
+    __atomic_add_fetch(&finished, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+static void test_threads(void)
+{
+    trace_log_clear();
+    finished = 0;
+    pthread_t threads[THREADS];
+    for (uintptr_t t = 0; t < THREADS; t++)
+    {
+        CHECK_EQ(0, pthread_create(&threads[t], NULL, writer, (void *)t));
+    }
+
+    // Snapshots while the threads write only return complete records. At least one snapshot with records,
+    // the writers may be done before the first one.
+    uint32_t snapshots = 0;
+    uint32_t torn = 0;
+    while (__atomic_load_n(&finished, __ATOMIC_ACQUIRE) < THREADS || snapshots == 0)
+    {
+        uint32_t count = trace_log_snapshot(records, TRACE_LOG_RECORDS);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            torn += records[i].args[2] != (records[i].args[0] ^ records[i].args[1]);
+        }
+        snapshots += count > 0;
+    }
+    for (int t = 0; t < THREADS; t++)
+    {
+        pthread_join(threads[t], NULL);
+    }
+    CHECK_EQ(0, torn);
+    CHECK(snapshots > 0);
+
+    // No record is torn or written twice: the ring ends with the last records of every thread, each
+    // thread's records in order. A writer lapped while preempted drops its record, under load the ring
+    // may have a few gaps.
+    uint32_t count = trace_log_snapshot(records, TRACE_LOG_RECORDS);
+    CHECK(count > TRACE_LOG_RECORDS / 2);
+    int64_t last[THREADS] = {-1, -1, -1, -1};
+    bool ordered = true;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t thread = records[i].args[0];
+        CHECK(thread < THREADS);
+        if (thread >= THREADS)
+        {
+            break;
+        }
+        CHECK_EQ(thread ^ records[i].args[1], records[i].args[2]);
+        ordered &= records[i].args[1] > last[thread];
+        last[thread] = records[i].args[1];
+        if (i > 0)
+        {
+            ordered &= records[i].seq > records[i - 1].seq;
+        }
+    }
+    CHECK(ordered);
+}
+
+// Records for the decoder and the messages printf renders from them
+#define TRACE_AND_PRINT(file, fmt, ...)                 \
+    do                                                  \
+    {                                                   \
+        TRACE_LOG(TAG, fmt, ##__VA_ARGS__);             \
+        fprintf(file, TAG ": " fmt "\n", ##__VA_ARGS__); \
+    } while (0)
+
+static int dump(const char *expected_path)
+{
+    FILE *expected = fopen(expected_path, "w");
+    if (expected == NULL)
+    {
+        perror(expected_path);
+        return 1;
+    }
+
+    trace_log_clear();
+    TRACE_AND_PRINT(expected, "Command received: left=%d, right=%d", -15350, 15350);
+    TRACE_AND_PRINT(expected, "Instance %d: %lu step(s), velocity %ld, accel %ld, target %ld", 1, 3ul, -6553600l, 0l,
+                    -6553600l);
+    TRACE_AND_PRINT(expected, "Current PWM: %.2f, limit %5.1f %%", 42.5f, 100.0);
+    TRACE_AND_PRINT(expected, "%e %g %x %X", 1.25, 0.0001f, 0xdeadu, 0xbeefu);
+    TRACE_AND_PRINT(expected, "%o %c %hd %hhu %-4d|%04x", 8u, 'A', (short)-2, (unsigned char)200, 7, 0x1f);
+    TRACE_AND_PRINT(expected, "no arguments");
+    fclose(expected);
+
+    trace_log_dump();
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc == 3 && strcmp(argv[1], "--dump") == 0)
+    {
+        return dump(argv[2]);
+    }
+
+    RUN_TEST(test_record);
+    RUN_TEST(test_float);
+    RUN_TEST(test_wrap);
+    RUN_TEST(test_threads);
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,147 @@
+/**
+ * @file test-turret-protocol.c
+ * @brief Frame encoding of turret-protocol.h against reference frames of turret_protocol.py
+ */
+
+#include "turret-protocol.h"
+#include "host-test.h"
+
+#include <string.h>
+
+// turret_protocol.encode_command(CommandFrame(12.34, -0.5, True, 0x1234, 0x89ABCDEF))
+static const uint8_t PYTHON_COMMAND[TURRET_COMMAND_FRAME_SIZE] = {
+    0xA5, 0x01, 0x01, 0x01, 0x34, 0x12, 0xEF, 0xCD, 0xAB, 0x89, 0xD2, 0x04, 0xCE, 0xFF, 0xB5, 0xC1};
+
+// turret_protocol.encode_command(CommandFrame(0.125, -0.625, False, 0x0102, 1000)): both angles lie exactly on
+// half a step, rounded half away from zero like std::round() in turret-protocol.hpp
+static const uint8_t PYTHON_HALF_STEP_COMMAND[TURRET_COMMAND_FRAME_SIZE] = {
+    0xA5, 0x01, 0x01, 0x00, 0x02, 0x01, 0xE8, 0x03, 0x00, 0x00, 0x0D, 0x00, 0xC1, 0xFF, 0xD2, 0x22};
+
+// turret_protocol.encode_telemetry(TelemetryFrame(-45.0, 30.25, True, 7, 123456, 0x1234, -100, 55, 1500, 2500, 3))
+static const uint8_t PYTHON_TELEMETRY[TURRET_TELEMETRY_FRAME_SIZE] = {
+    0xA5, 0x01, 0x02, 0x01, 0x07, 0x00, 0x40, 0xE2, 0x01, 0x00, 0x6C, 0xEE, 0xD1, 0x0B,
+    0x34, 0x12, 0x9C, 0x37, 0xDC, 0x05, 0xC4, 0x09, 0x03, 0x00, 0x10, 0xC6};
+
+static void test_crc_check_value(void)
+{
+    CHECK_EQ(0x29B1, turret_protocol_crc16((const uint8_t *)"123456789", 9));
+}
+
+static void test_command_matches_python(void)
+{
+    turret_command_frame_t frame = {
+        .flags = TURRET_COMMAND_FLAG_FIRE,
+        .seq = 0x1234,
+        .timestamp_ms = 0x89ABCDEF,
+        .x_centideg = 1234,
+        .y_centideg = -50};
+    uint8_t out[TURRET_COMMAND_FRAME_SIZE];
+    turret_protocol_encode_command(&frame, out);
+    CHECK(memcmp(out, PYTHON_COMMAND, sizeof(out)) == 0);
+
+    turret_command_frame_t decoded;
+    CHECK_EQ(TURRET_PROTOCOL_OK, turret_protocol_decode_command(PYTHON_COMMAND, sizeof(PYTHON_COMMAND), &decoded));
+    CHECK_EQ(frame.flags, decoded.flags);
+    CHECK_EQ(frame.seq, decoded.seq);
+    CHECK_EQ(frame.timestamp_ms, decoded.timestamp_ms);
+    CHECK_EQ(frame.x_centideg, decoded.x_centideg);
+    CHECK_EQ(frame.y_centideg, decoded.y_centideg);
+}
+
+static void test_half_step_rounding_matches_python(void)
+{
+    turret_command_frame_t frame = {
+        .seq = 0x0102,
+        .timestamp_ms = 1000,
+        .x_centideg = (int16_t)lround(0.125 * 100),
+        .y_centideg = (int16_t)lround(-0.625 * 100)};
+    CHECK_EQ(13, frame.x_centideg);
+    CHECK_EQ(-63, frame.y_centideg);
+
+    uint8_t out[TURRET_COMMAND_FRAME_SIZE];
+    turret_protocol_encode_command(&frame, out);
+    CHECK(memcmp(out, PYTHON_HALF_STEP_COMMAND, sizeof(out)) == 0);
+}
+
+// Field by field, the struct has padding bytes that memcmp would compare as well
+static void check_telemetry_equal(const turret_telemetry_frame_t *expected, const turret_telemetry_frame_t *actual)
+{
+    CHECK_EQ(expected->flags, actual->flags);
+    CHECK_EQ(expected->seq, actual->seq);
+    CHECK_EQ(expected->timestamp_ms, actual->timestamp_ms);
+    CHECK_EQ(expected->x_centideg, actual->x_centideg);
+    CHECK_EQ(expected->y_centideg, actual->y_centideg);
+    CHECK_EQ(expected->last_cmd_seq, actual->last_cmd_seq);
+    CHECK_EQ(expected->left_duty, actual->left_duty);
+    CHECK_EQ(expected->right_duty, actual->right_duty);
+    CHECK_EQ(expected->left_current_ma, actual->left_current_ma);
+    CHECK_EQ(expected->right_current_ma, actual->right_current_ma);
+    CHECK_EQ(expected->dropped_cmds, actual->dropped_cmds);
+}
+
+static void test_telemetry_matches_python(void)
+{
+    turret_telemetry_frame_t frame = {
+        .flags = TURRET_TELEMETRY_FLAG_AUTOMATIC,
+        .seq = 7,
+        .timestamp_ms = 123456,
+        .x_centideg = -4500,
+        .y_centideg = 3025,
+        .last_cmd_seq = 0x1234,
+        .left_duty = -100,
+        .right_duty = 55,
+        .left_current_ma = 1500,
+        .right_current_ma = 2500,
+        .dropped_cmds = 3};
+    uint8_t out[TURRET_TELEMETRY_FRAME_SIZE];
+    turret_protocol_encode_telemetry(&frame, out);
+    CHECK(memcmp(out, PYTHON_TELEMETRY, sizeof(out)) == 0);
+
+    turret_telemetry_frame_t decoded = {0};
+    CHECK_EQ(TURRET_PROTOCOL_OK, turret_protocol_decode_telemetry(PYTHON_TELEMETRY, sizeof(PYTHON_TELEMETRY), &decoded));
+    check_telemetry_equal(&frame, &decoded);
+}
+
+static void test_rejects_corrupt_frames(void)
+{
+    turret_command_frame_t frame;
+    uint8_t data[TURRET_COMMAND_FRAME_SIZE];
+
+    memcpy(data, PYTHON_COMMAND, sizeof(data));
+    data[0] = '{';
+    CHECK_EQ(TURRET_PROTOCOL_ERR_MAGIC, turret_protocol_decode_command(data, sizeof(data), &frame));
+
+    memcpy(data, PYTHON_COMMAND, sizeof(data));
+    data[1] = TURRET_PROTOCOL_VERSION + 1;
+    CHECK_EQ(TURRET_PROTOCOL_ERR_VERSION, turret_protocol_decode_command(data, sizeof(data), &frame));
+
+    CHECK_EQ(TURRET_PROTOCOL_ERR_TYPE, turret_protocol_decode_command(PYTHON_TELEMETRY, sizeof(PYTHON_TELEMETRY), &frame));
+    CHECK_EQ(TURRET_PROTOCOL_ERR_LENGTH, turret_protocol_decode_command(PYTHON_COMMAND, sizeof(PYTHON_COMMAND) - 1, &frame));
+    CHECK_EQ(TURRET_PROTOCOL_ERR_LENGTH, turret_protocol_decode_command(NULL, 0, &frame));
+
+    // Every single bit flip in the payload is caught by the CRC
+    for (size_t bit = 3 * 8; bit < (TURRET_COMMAND_FRAME_SIZE - 2) * 8; bit++)
+    {
+        memcpy(data, PYTHON_COMMAND, sizeof(data));
+        data[bit / 8] ^= (uint8_t)(1 << (bit % 8));
+        CHECK_EQ(TURRET_PROTOCOL_ERR_CRC, turret_protocol_decode_command(data, sizeof(data), &frame));
+    }
+}
+
+static void test_is_binary(void)
+{
+    CHECK(turret_protocol_is_binary(PYTHON_COMMAND, sizeof(PYTHON_COMMAND)));
+    CHECK(!turret_protocol_is_binary((const uint8_t *)"{\"a\":1}", 7));
+    CHECK(!turret_protocol_is_binary(PYTHON_COMMAND, 0));
+}
+
+int main(void)
+{
+    RUN_TEST(test_crc_check_value);
+    RUN_TEST(test_command_matches_python);
+    RUN_TEST(test_half_step_rounding_matches_python);
+    RUN_TEST(test_telemetry_matches_python);
+    RUN_TEST(test_rejects_corrupt_frames);
+    RUN_TEST(test_is_binary);
+    return HOST_TEST_RESULT();
+}
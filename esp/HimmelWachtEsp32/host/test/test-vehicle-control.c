@@ -0,0 +1,322 @@
+/**
+ * @file test-vehicle-control.c
+ * @brief The complete firmware (configuration of main.c) driven by a simulated controller and broker
+ *
+ * The scenarios run in order on one vehicle and build on each other's state.
+ */
+
+#include "vehicle-control.h"
+#include "platform-control.h"
+#include "fire-control.h"
+#include "mqtt-stack.h"
+#include "ds4-sim.h"
+#include "ds4-common.h"
+#include "mqtt-sim.h"
+#include "hw-sim.h"
+#include "hw-trace.h"
+#include "host-test.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define CMD_TOPIC "vehicle/turret/cmd"
+#define TELEMETRY_TOPIC "vehicle/turret/telemetry"
+
+#define GUN_ARM_CHANNEL 0
+#define FLYWHEEL_GPIO 5
+#define X_CHANNEL 2
+#define Y_CHANNEL 1
+#define LEFT_PWM_GPIO 27
+#define LEFT_DIR_GPIO 26
+#define RIGHT_PWM_GPIO 23
+#define RIGHT_DIR_GPIO 22
+
+#define INPUT_PERIOD_US (1000000 / 60)
+
+static diff_drive_handle_t *diff_drive = NULL;
+
+// Off count of a platform angle, see platform_set_angle()
+static uint16_t expected_off(int angle)
+{
+    int magnitude = abs(angle);
+    int three_steps = magnitude / 3;
+    int two_steps = magnitude - three_steps;
+    int steps = two_steps * 2 + three_steps * 3;
+    return (uint16_t)(335 + (angle < 0 ? -steps : steps));
+}
+
+static uint16_t channel_off(uint8_t channel)
+{
+    pca9685_sim_channel_t state = {0};
+    pca9685_sim_get_channel(channel, &state);
+    return state.off;
+}
+
+// Sends the same report at the controller rate of 60 Hz
+static void hold_input(const ds4_input_t *input, int duration_ms)
+{
+    int64_t end = esp_timer_get_time() + (int64_t)duration_ms * 1000;
+    while (esp_timer_get_time() < end)
+    {
+        ds4_sim_send_input(input);
+        usleep(INPUT_PERIOD_US);
+    }
+}
+
+static void test_init(void)
+{
+    hw_trace_reset();
+
+    mqtt_config_t mqtt_config = {
+        .broker_uri = "mqtt://127.0.0.1:1883",
+        .topic = CMD_TOPIC,
+        .telemetry_topic = TELEMETRY_TOPIC,
+        .client_id = "host_test",
+        .keepalive = 60,
+        .network_timeout_ms = 5000,
+        .reconnect_timeout_ms = 5000,
+        .queue_timeout_ticks = 0};
+    CHECK_EQ(ESP_OK, mqtt_stack_init(&mqtt_config));
+    CHECK_EQ(ESP_OK, mqtt_sim_connect());
+
+    platform_config_t platform_cfg = {
+        .pwm_board_config = {
+            .device_address = 0x40,
+            .freq = 50,
+            .i2c_port = 0,
+            .sda_port = 18,
+            .scl_port = 19,
+            .internal_pullup = true},
+        .platform_x_channel = X_CHANNEL,
+        .platform_x_start_angle = 0,
+        .platform_x_left_stop_angle = -90,
+        .platform_x_right_stop_angle = 90,
+        .platform_y_channel = Y_CHANNEL,
+        .platform_y_start_angle = 48,
+        .platform_y_left_stop_angle = 0,
+        .platform_y_right_stop_angle = 80};
+    CHECK_EQ(ESP_OK, platform_init(&platform_cfg));
+
+    fire_control_config_t fire_control_cfg = {
+        .gun_arm_channel = GUN_ARM_CHANNEL,
+        .flywheel_control_gpio_port = FLYWHEEL_GPIO,
+        .run_on_core = 1};
+    CHECK_EQ(ESP_OK, fire_control_init(&fire_control_cfg));
+
+    motor_config_t left_motor_config = {
+        .mcpwm_group_id = 0,
+        .pwm_gpio_num = LEFT_PWM_GPIO,
+        .dir_gpio_num = LEFT_DIR_GPIO,
+        .pwm_frequency_hz = 20000,
+        .ramp_rate = 5,
+        .ramp_intervall_ms = 10,
+        .direction_hysteresis = 5,
+        .pwm_duty_limit = 100,
+        .mynr = 0};
+    motor_config_t right_motor_config = left_motor_config;
+    right_motor_config.pwm_gpio_num = RIGHT_PWM_GPIO;
+    right_motor_config.dir_gpio_num = RIGHT_DIR_GPIO;
+    right_motor_config.mynr = 1;
+
+    diff_drive_config_t diff_drive_config = {
+        .max_input = 512,
+        .recovery_time_ms = 1000,
+        .task_priority = 0,
+        .task_stack_size = 4096,
+        .task_core_id = 0,
+        .loop_rate_hz = 100,
+        .current_sense = {
+            .enabled = true,
+            .sensor = {
+                .channels = {ADC_CHANNEL_4, ADC_CHANNEL_5},
+                .atten = ADC_ATTEN_DB_12,
+                .sample_rate_hz = 20000,
+                .mv_per_a = 20,
+                .offset_mv = 50,
+                .filter_shift = 2,
+            },
+        }};
+    diff_drive = diff_drive_init(&diff_drive_config, &left_motor_config, &right_motor_config);
+    CHECK(diff_drive != NULL);
+
+    CHECK_EQ(ESP_OK, ds4_init());
+    ds4_sim_set_connected(true);
+
+    // Shorter button hold than main.c to keep the test fast
+    vehicle_control_config_t vehicle_control_cfg = {
+        .button_hold_threshold_us = 100000,
+        .max_deg_per_sec_x = 300,
+        .max_deg_per_sec_y = 150,
+        .input_processing_freq_hz = 60,
+        .deadzone_x = 30,
+        .deadzone_y = 100,
+        .deadzone_drive_update = 10,
+        .telemetry_period_ms = 50,
+        .core = 1};
+    CHECK_EQ(ESP_ERR_INVALID_ARG, vehicle_control_init(NULL, diff_drive));
+    CHECK_EQ(ESP_OK, vehicle_control_init(&vehicle_control_cfg, diff_drive));
+
+    CHECK_EQ(expected_off(0), channel_off(X_CHANNEL));
+    CHECK_EQ(expected_off(48), channel_off(Y_CHANNEL));
+    CHECK_EQ(400, channel_off(GUN_ARM_CHANNEL));
+    CHECK_EQ(0, gpio_sim_get_level(FLYWHEEL_GPIO));
+}
+
+static void test_manual_platform(void)
+{
+    // Right stick to the right turns the platform (negative x angle), the stick drives the speed
+    ds4_input_t input = {.rightStickX = 512};
+    hold_input(&input, 300);
+    uint16_t off = channel_off(X_CHANNEL);
+    CHECK(off < expected_off(-20));
+
+    // Neutral stick holds the position
+    ds4_input_t neutral = {0};
+    hold_input(&neutral, 100);
+    uint16_t held = channel_off(X_CHANNEL);
+    hold_input(&neutral, 100);
+    CHECK_EQ(held, channel_off(X_CHANNEL));
+
+    // Manual lightbar color
+    hw_trace_event_t event;
+    CHECK(hw_trace_last(HW_TRACE_DS4_LIGHTBAR, HW_TRACE_ANY_TARGET, &event));
+    CHECK_EQ(80, event.data[0]);
+    CHECK_EQ(200, event.data[1]);
+    CHECK_EQ(120, event.data[2]);
+}
+
+static void test_manual_fire(void)
+{
+    size_t start = hw_trace_count();
+    ds4_input_t fire = {.rightTrigger = 1023};
+    hold_input(&fire, 50);
+    ds4_input_t neutral = {0};
+    hold_input(&neutral, 50);
+
+    CHECK(WAIT_UNTIL(hw_trace_find(start, HW_TRACE_GPIO_LEVEL, FLYWHEEL_GPIO) < hw_trace_count(), 200));
+    CHECK(WAIT_UNTIL(channel_off(GUN_ARM_CHANNEL) == 240, 1000));
+    CHECK_EQ(1, gpio_sim_get_level(FLYWHEEL_GPIO));
+    CHECK(WAIT_UNTIL(channel_off(GUN_ARM_CHANNEL) == 400, 1000));
+    CHECK_EQ(0, gpio_sim_get_level(FLYWHEEL_GPIO));
+
+    // One shot per trigger pull: flywheel on and off once
+    usleep(300 * 1000);
+    size_t flywheel_writes = 0;
+    for (size_t i = hw_trace_find(start, HW_TRACE_GPIO_LEVEL, FLYWHEEL_GPIO); i < hw_trace_count();
+         i = hw_trace_find(i + 1, HW_TRACE_GPIO_LEVEL, FLYWHEEL_GPIO))
+    {
+        flywheel_writes++;
+    }
+    CHECK_EQ(2, flywheel_writes);
+}
+
+static void test_mode_change(void)
+{
+    CHECK(get_discard_command_status());
+
+    // Hold dpad up + cross longer than the threshold
+    ds4_input_t change = {.dpad = DPAD_UP_MASK, .buttons = BUTTON_CROSS_MASK};
+    hold_input(&change, 250);
+    ds4_input_t neutral = {0};
+    hold_input(&neutral, 50);
+
+    CHECK(!get_discard_command_status());
+    hw_trace_event_t event;
+    CHECK(hw_trace_last(HW_TRACE_DS4_LIGHTBAR, HW_TRACE_ANY_TARGET, &event));
+    CHECK_EQ(255, event.data[0]);
+    CHECK_EQ(180, event.data[1]);
+    CHECK_EQ(80, event.data[2]);
+
+    // The platform starts from its start position
+    CHECK_EQ(expected_off(0), channel_off(X_CHANNEL));
+    CHECK_EQ(expected_off(48), channel_off(Y_CHANNEL));
+}
+
+static void test_mqtt_command(void)
+{
+    turret_command_frame_t frame = {.seq = 42, .timestamp_ms = 1, .x_centideg = 3000, .y_centideg = 2000};
+    uint8_t payload[TURRET_COMMAND_FRAME_SIZE];
+    turret_protocol_encode_command(&frame, payload);
+    CHECK_EQ(ESP_OK, mqtt_sim_deliver(CMD_TOPIC, payload, sizeof(payload)));
+
+    // Commands are applied on the next controller report
+    ds4_input_t neutral = {0};
+    hold_input(&neutral, 150);
+    CHECK_EQ(expected_off(30), channel_off(X_CHANNEL));
+    CHECK_EQ(expected_off(20), channel_off(Y_CHANNEL));
+
+    mqtt_sim_message_t message;
+    CHECK(mqtt_sim_get_last_published(TELEMETRY_TOPIC, &message));
+    turret_telemetry_frame_t telemetry;
+    CHECK_EQ(TURRET_PROTOCOL_OK, turret_protocol_decode_telemetry(message.payload, message.len, &telemetry));
+    CHECK_EQ(42, telemetry.last_cmd_seq);
+    CHECK(telemetry.flags & TURRET_TELEMETRY_FLAG_AUTOMATIC);
+    CHECK_EQ(3000, telemetry.x_centideg);
+    CHECK_EQ(2000, telemetry.y_centideg);
+
+    // The right stick does not move the platform in automatic mode
+    ds4_input_t stick = {.rightStickX = 512};
+    hold_input(&stick, 150);
+    CHECK_EQ(expected_off(30), channel_off(X_CHANNEL));
+}
+
+static void test_drive(void)
+{
+    // Left stick forward (the controller reports up as negative)
+    ds4_input_t forward = {.leftStickY = -512};
+    hold_input(&forward, 300);
+    CHECK(WAIT_UNTIL(mcpwm_sim_get_duty(LEFT_PWM_GPIO) >= 90 &&
+                         mcpwm_sim_get_duty(RIGHT_PWM_GPIO) >= 90,
+                     1000));
+    CHECK_EQ(1, gpio_sim_get_level(LEFT_DIR_GPIO));
+    CHECK_EQ(1, gpio_sim_get_level(RIGHT_DIR_GPIO));
+
+    // Telemetry reports the signed duty and the currents of the CS pins (3 A left, 1 A right)
+    adc_sim_set_voltage(ADC_CHANNEL_4, 50 + 60);
+    adc_sim_set_voltage(ADC_CHANNEL_5, 50 + 20);
+    hold_input(&forward, 400);
+    mqtt_sim_message_t message;
+    turret_telemetry_frame_t telemetry;
+    CHECK(mqtt_sim_get_last_published(TELEMETRY_TOPIC, &message));
+    CHECK_EQ(TURRET_PROTOCOL_OK, turret_protocol_decode_telemetry(message.payload, message.len, &telemetry));
+    CHECK(telemetry.left_duty >= 90);
+    CHECK(telemetry.right_duty >= 90);
+    CHECK_NEAR(3000, telemetry.left_current_ma, 150);
+    CHECK_NEAR(1000, telemetry.right_current_ma, 150);
+
+    // Releasing the stick stops the vehicle
+    ds4_input_t neutral = {0};
+    hold_input(&neutral, 100);
+    CHECK(WAIT_UNTIL(diff_drive->left_motor->current_direction == MOTOR_DIRECTION_STOP &&
+                         diff_drive->right_motor->current_direction == MOTOR_DIRECTION_STOP,
+                     1000));
+}
+
+static void test_drive_deadman(void)
+{
+    // A held stick keeps the vehicle moving past the deadman time of the drive
+    ds4_input_t forward = {.leftStickY = -512};
+    hold_input(&forward, 1500);
+    CHECK(!diff_drive->deadman_stopped);
+    CHECK(mcpwm_sim_get_duty(LEFT_PWM_GPIO) >= 90);
+
+    // Controller lost while driving: the drive stops on its own
+    ds4_sim_set_connected(false);
+    CHECK(WAIT_UNTIL(diff_drive->deadman_stopped, 2000));
+    CHECK(WAIT_UNTIL(diff_drive->left_motor->current_direction == MOTOR_DIRECTION_STOP &&
+                         diff_drive->right_motor->current_direction == MOTOR_DIRECTION_STOP,
+                     1000));
+    ds4_sim_set_connected(true);
+}
+
+int main(void)
+{
+    RUN_TEST(test_init);
+    RUN_TEST(test_manual_platform);
+    RUN_TEST(test_manual_fire);
+    RUN_TEST(test_mode_change);
+    RUN_TEST(test_mqtt_command);
+    RUN_TEST(test_drive);
+    RUN_TEST(test_drive_deadman);
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,144 @@
+/**
+ * @file test-wheel-encoder.c
+ * @brief Quadrature counting of the wheel encoder on the simulated pulse counter
+ */
+
+#include "wheel-encoder.h"
+#include "hw-sim.h"
+#include "host-test.h"
+
+#define A_GPIO 34
+#define B_GPIO 35
+
+static const wheel_encoder_config_t encoder_config = {
+    .a_gpio_num = A_GPIO,
+    .b_gpio_num = B_GPIO,
+    .glitch_filter_ns = 1000,
+    .reverse = false};
+
+static wheel_encoder_handle_t *encoder = NULL;
+
+static int32_t count(void)
+{
+    int32_t value = 0;
+    CHECK_EQ(ESP_OK, wheel_encoder_get_count(encoder, &value));
+    return value;
+}
+
+static void test_init(void)
+{
+    encoder = wheel_encoder_init(&encoder_config);
+    CHECK(encoder != NULL);
+    CHECK_EQ(0, count());
+
+    CHECK(wheel_encoder_init(NULL) == NULL);
+    wheel_encoder_config_t invalid = encoder_config;
+    invalid.b_gpio_num = A_GPIO;
+    CHECK(wheel_encoder_init(&invalid) == NULL);
+    invalid.b_gpio_num = -1;
+    CHECK(wheel_encoder_init(&invalid) == NULL);
+    invalid = encoder_config;
+    invalid.glitch_filter_ns = 20000;
+    CHECK(wheel_encoder_init(&invalid) == NULL);
+}
+
+static void test_direction(void)
+{
+    // A leading B counts up, the other way down
+    pcnt_sim_add_counts(A_GPIO, 100);
+    CHECK_EQ(100, count());
+    pcnt_sim_add_counts(A_GPIO, -30);
+    CHECK_EQ(70, count());
+}
+
+static void test_delta(void)
+{
+    int32_t delta = 0;
+    CHECK_EQ(ESP_OK, wheel_encoder_get_delta(encoder, &delta));
+    CHECK_EQ(70, delta);
+    CHECK_EQ(ESP_OK, wheel_encoder_get_delta(encoder, &delta));
+    CHECK_EQ(0, delta);
+
+    pcnt_sim_add_counts(A_GPIO, -500);
+    CHECK_EQ(ESP_OK, wheel_encoder_get_delta(encoder, &delta));
+    CHECK_EQ(-500, delta);
+}
+
+static void test_beyond_hardware_limit(void)
+{
+    // The 16 bit hardware counter is extended, the count keeps growing
+    int32_t start = count();
+    for (int i = 0; i < 10; i++)
+    {
+        pcnt_sim_add_counts(A_GPIO, 10000);
+    }
+    CHECK_EQ(start + 100000, count());
+
+    int32_t delta = 0;
+    CHECK_EQ(ESP_OK, wheel_encoder_get_delta(encoder, &delta));
+    CHECK_EQ(100000, delta);
+}
+
+static void test_reverse(void)
+{
+    // Mirrored mounting: driving forward counts down, so reverse swaps the signals
+    wheel_encoder_config_t mirrored_config = encoder_config;
+    mirrored_config.a_gpio_num = 36;
+    mirrored_config.b_gpio_num = 39;
+    mirrored_config.reverse = true;
+    wheel_encoder_handle_t *mirrored = wheel_encoder_init(&mirrored_config);
+    CHECK(mirrored != NULL);
+
+    int32_t before = count();
+    pcnt_sim_add_counts(36, 40);
+    int32_t value = 0;
+    CHECK_EQ(ESP_OK, wheel_encoder_get_count(mirrored, &value));
+    CHECK_EQ(-40, value);
+    CHECK_EQ(before, count());
+
+    CHECK_EQ(ESP_OK, wheel_encoder_deinit(mirrored));
+}
+
+static void test_invalid_args(void)
+{
+    int32_t value = 0;
+    CHECK_EQ(ESP_ERR_INVALID_ARG, wheel_encoder_get_count(NULL, &value));
+    CHECK_EQ(ESP_ERR_INVALID_ARG, wheel_encoder_get_count(encoder, NULL));
+    CHECK_EQ(ESP_ERR_INVALID_ARG, wheel_encoder_get_delta(NULL, &value));
+    CHECK_EQ(ESP_ERR_INVALID_ARG, wheel_encoder_get_delta(encoder, NULL));
+    CHECK_EQ(ESP_ERR_INVALID_ARG, wheel_encoder_deinit(NULL));
+}
+
+static void test_deinit(void)
+{
+    CHECK_EQ(ESP_OK, wheel_encoder_deinit(encoder));
+    encoder = NULL;
+
+    // Units are released: all eight can be taken again
+    wheel_encoder_handle_t *encoders[8];
+    for (int i = 0; i < 8; i++)
+    {
+        wheel_encoder_config_t config = encoder_config;
+        config.a_gpio_num = 2 * i;
+        config.b_gpio_num = 2 * i + 1;
+        encoders[i] = wheel_encoder_init(&config);
+        CHECK(encoders[i] != NULL);
+    }
+    CHECK(wheel_encoder_init(&encoder_config) == NULL);
+    for (int i = 0; i < 8; i++)
+    {
+        CHECK_EQ(ESP_OK, wheel_encoder_deinit(encoders[i]));
+    }
+}
+
+int main(void)
+{
+    RUN_TEST(test_init);
+    RUN_TEST(test_direction);
+    RUN_TEST(test_delta);
+    RUN_TEST(test_beyond_hardware_limit);
+    RUN_TEST(test_reverse);
+    RUN_TEST(test_invalid_args);
+    RUN_TEST(test_deinit);
+    return HOST_TEST_RESULT();
+}
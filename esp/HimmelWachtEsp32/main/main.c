@@ -19,6 +19,16 @@
 #define LEFT_MOTOR_PWM_GPIO 27
 #define LEFT_MOTOR_DIR_GPIO 26
 
+// Wheel encoders (input-only pins), used when speed control is enabled
+#define RIGHT_ENCODER_A_GPIO 36
+#define RIGHT_ENCODER_B_GPIO 39
+#define LEFT_ENCODER_A_GPIO 34
+#define LEFT_ENCODER_B_GPIO 35
+
+// Current sense (CS) outputs of the motor drivers, GPIO 32 / 33 = ADC1 channel 4 / 5
+#define LEFT_MOTOR_CS_ADC_CHANNEL ADC_CHANNEL_4
+#define RIGHT_MOTOR_CS_ADC_CHANNEL ADC_CHANNEL_5
+
 #define MAX_INPUT_VALUE 512
 
 // Enter the Wi-Fi credentials here
@@ -54,6 +64,7 @@ void app_main(void){
     mqtt_config_t mqtt_config = {
         .broker_uri = "mqtt://172.16.3.105:1883",  // Broker IP
         .topic = "vehicle/turret/cmd",               // Configurable topic
+        .telemetry_topic = "vehicle/turret/telemetry", // Binary telemetry frames
         .client_id = "esp32_vehicle_01",             // Unique client ID
         .keepalive = 60,                              // Keep alive interval
         .network_timeout_ms = 5000,          // Network timeout in milliseconds
@@ -99,44 +110,63 @@ void app_main(void){
 
     // Left motor configuration
     motor_config_t left_motor_config = {
-        .mcpwm_unit = MCPWM_UNIT_0,
-        .timer_num = MCPWM_TIMER_0,
-        .generator = MCPWM_OPR_A,
-        .pwm_signal = MCPWM0A,
+        .mcpwm_group_id = 0,
         .pwm_gpio_num = LEFT_MOTOR_PWM_GPIO,
         .dir_gpio_num = LEFT_MOTOR_DIR_GPIO,
         .pwm_frequency_hz = 20000,
         .ramp_rate = 5,            // Adjust as needed
         .ramp_intervall_ms = 10,   // Adjust as needed
+        .ramp_jerk_time_ms = 50,   // S-curve: full acceleration after 50 ms
+        .brake_time_ms = 50,       // Stop / reversal: short brake after at most 50 ms
+        .brake_hold_ms = 50,       // then 50 ms short brake before driving the other way
         .direction_hysteresis = 5, // Adjust as needed
         .pwm_duty_limit = 100,
+        .current_limit_ma = 10000, // Only with current sensing
         .mynr = 0};
 
     // Right motor configuration
     motor_config_t right_motor_config = {
-        .mcpwm_unit = MCPWM_UNIT_0,
-        .timer_num = MCPWM_TIMER_1,
-        .generator = MCPWM_OPR_A,
-        .pwm_signal = MCPWM1A,
+        .mcpwm_group_id = 0,
         .pwm_gpio_num = RIGHT_MOTOR_PWM_GPIO,
         .dir_gpio_num = RIGHT_MOTOR_DIR_GPIO,
         .pwm_frequency_hz = 20000,
         .ramp_rate = 5,            // Adjust as needed
         .ramp_intervall_ms = 10,   // Adjust as needed
+        .ramp_jerk_time_ms = 50,   // S-curve: full acceleration after 50 ms
+        .brake_time_ms = 50,       // Stop / reversal: short brake after at most 50 ms
+        .brake_hold_ms = 50,       // then 50 ms short brake before driving the other way
         .direction_hysteresis = 5, // Adjust as needed
         .pwm_duty_limit = 100,
+        .current_limit_ma = 10000, // Only with current sensing
         .mynr = 1};
 
     // Differential drive configuration
     diff_drive_config_t diff_drive_config = {
         .max_input = MAX_INPUT_VALUE,
-        .cmd_queue_size = 10,
         .recovery_time_ms = 1000,
         .task_priority = 0,
         .task_stack_size = 4096,
         .task_core_id = 0,
-        .task_delay_ms = 50,
-        .queue_timout_ms = 10,
+        .loop_rate_hz = 100,       // One iteration per motor ramp interval
+        .speed_control = {
+            .enabled = false,      // Open loop until encoders are fitted
+            .left_encoder = {.a_gpio_num = LEFT_ENCODER_A_GPIO, .b_gpio_num = LEFT_ENCODER_B_GPIO, .glitch_filter_ns = 1000},
+            .right_encoder = {.a_gpio_num = RIGHT_ENCODER_A_GPIO, .b_gpio_num = RIGHT_ENCODER_B_GPIO, .glitch_filter_ns = 1000, .reverse = true},
+            .max_speed_cps = 10000, // Measure: counts/s at full duty on the stand
+            .kp = 2 * 256,          // 2.0
+            .ki = 20 * 256,         // 20 / s
+        },
+        .current_sense = {
+            .enabled = false,      // Until the CS pins are wired
+            .sensor = {
+                .channels = {LEFT_MOTOR_CS_ADC_CHANNEL, RIGHT_MOTOR_CS_ADC_CHANNEL},
+                .atten = ADC_ATTEN_DB_12,
+                .sample_rate_hz = 20000,
+                .mv_per_a = 20,    // Pololu G2 24v13
+                .offset_mv = 50,
+                .filter_shift = 2, // 40 ms at 100 Hz
+            },
+        },
     };
 
     // Configuration for vehicle control interface
@@ -148,6 +178,7 @@ void app_main(void){
         .deadzone_x = 30,
         .deadzone_y = 100,
         .deadzone_drive_update = 10,
+        .telemetry_period_ms = 100,
         .core = 1};
 
     // Initialize platform
@@ -41,21 +41,16 @@ static const char *TAG = "DIFF_DRIVE_TEST";
 // Differential drive configuration
 static diff_drive_config_t diff_drive_config = {
     .max_input = MAX_INPUT_VALUE,
-    .cmd_queue_size = 10,
     .recovery_time_ms = 1000,
     .task_priority = 10,
     .task_stack_size = 4096,
     .task_core_id = 0,
-    .task_delay_ms = 20,
-    .queue_timout_ms = 50,
+    .loop_rate_hz = 50,
 };
 
 // Left motor configuration
 static motor_config_t left_motor_config = {
-    .mcpwm_unit = MCPWM_UNIT_0,
-    .timer_num = MCPWM_TIMER_0,
-    .generator = MCPWM_OPR_A,
-    .pwm_signal = MCPWM0A,
+    .mcpwm_group_id = 0,
     .pwm_gpio_num = LEFT_MOTOR_PWM_GPIO,
     .dir_gpio_num = LEFT_MOTOR_DIR_GPIO,
     .fault_gpio_num = LEFT_MOTOR_FAULT_GPIO,
@@ -69,10 +64,7 @@ static motor_config_t left_motor_config = {
 
 // Right motor configuration 
 static motor_config_t right_motor_config = {
-    .mcpwm_unit = MCPWM_UNIT_0,
-    .timer_num = MCPWM_TIMER_1,
-    .generator = MCPWM_OPR_A,
-    .pwm_signal = MCPWM1A,
+    .mcpwm_group_id = 0,
     .pwm_gpio_num = RIGHT_MOTOR_PWM_GPIO,
     .dir_gpio_num = RIGHT_MOTOR_DIR_GPIO,
     .fault_gpio_num = RIGHT_MOTOR_FAULT_GPIO,
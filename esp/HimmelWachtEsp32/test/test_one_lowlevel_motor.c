@@ -74,10 +74,7 @@ static void test_motor_init_deinit(void)
 
     // Test with valid configuration
     motor_config_t config = {
-        .mcpwm_unit = MCPWM_UNIT_0,
-        .timer_num = MCPWM_TIMER_0,
-        .generator = MCPWM_OPR_A,
-        .pwm_signal = MCPWM0A,
+        .mcpwm_group_id = 0,
         .pwm_gpio_num = TEST_PWM_GPIO,
         .dir_gpio_num = TEST_DIR_GPIO,
         .fault_gpio_num = TEST_FAULT_GPIO,
@@ -127,10 +124,7 @@ static void test_motor_speed_control(void)
     ESP_LOGI(TAG, "--- Test 2: Motor Speed Control ---");
 
     motor_config_t config = {
-        .mcpwm_unit = MCPWM_UNIT_0,
-        .timer_num = MCPWM_TIMER_0,
-        .generator = MCPWM_OPR_A,
-        .pwm_signal = MCPWM0A,
+        .mcpwm_group_id = 0,
         .pwm_gpio_num = TEST_PWM_GPIO,
         .dir_gpio_num = TEST_DIR_GPIO,
         .fault_gpio_num = TEST_FAULT_GPIO,
@@ -186,10 +180,7 @@ static void test_motor_direction_change(void)
     ESP_LOGI(TAG, "--- Test 3: Motor Direction Change ---");
 
     motor_config_t config = {
-        .mcpwm_unit = MCPWM_UNIT_0,
-        .timer_num = MCPWM_TIMER_0,
-        .generator = MCPWM_OPR_A,
-        .pwm_signal = MCPWM0A,
+        .mcpwm_group_id = 0,
         .pwm_gpio_num = TEST_PWM_GPIO,
         .dir_gpio_num = TEST_DIR_GPIO,
         .fault_gpio_num = TEST_FAULT_GPIO,
@@ -254,10 +245,7 @@ static void test_motor_ramping(void)
     ESP_LOGI(TAG, "--- Test 4: Motor Ramping Behavior ---");
 
     motor_config_t config = {
-        .mcpwm_unit = MCPWM_UNIT_0,
-        .timer_num = MCPWM_TIMER_0,
-        .generator = MCPWM_OPR_A,
-        .pwm_signal = MCPWM0A,
+        .mcpwm_group_id = 0,
         .pwm_gpio_num = TEST_PWM_GPIO,
         .dir_gpio_num = TEST_DIR_GPIO,
         .fault_gpio_num = TEST_FAULT_GPIO,
@@ -307,10 +295,7 @@ static void test_motor_fault_handling(void)
     ESP_LOGI(TAG, "--- Test 5: Motor Fault Handling ---");
 
     motor_config_t config = {
-        .mcpwm_unit = MCPWM_UNIT_0,
-        .timer_num = MCPWM_TIMER_0,
-        .generator = MCPWM_OPR_A,
-        .pwm_signal = MCPWM0A,
+        .mcpwm_group_id = 0,
         .pwm_gpio_num = TEST_PWM_GPIO,
         .dir_gpio_num = TEST_DIR_GPIO,
         .fault_gpio_num = TEST_FAULT_GPIO,
@@ -374,10 +359,7 @@ static void test_motor_continuous_operation(void)
     ESP_LOGI(TAG, "--- Test 6: Continuous Operation ---");
 
     motor_config_t config = {
-        .mcpwm_unit = MCPWM_UNIT_0,
-        .timer_num = MCPWM_TIMER_0,
-        .generator = MCPWM_OPR_A,
-        .pwm_signal = MCPWM0A,
+        .mcpwm_group_id = 0,
         .pwm_gpio_num = TEST_PWM_GPIO,
         .dir_gpio_num = TEST_DIR_GPIO,
         .fault_gpio_num = TEST_FAULT_GPIO,
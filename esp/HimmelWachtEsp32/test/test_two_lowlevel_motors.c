@@ -48,10 +48,7 @@ static void test_task(void *pvParameters)
 
     // Init LEFT motor
     motor_config_t left_config = {
-        .mcpwm_unit = MCPWM_UNIT_0,
-        .timer_num = MCPWM_TIMER_0,
-        .generator = MCPWM_OPR_A,
-        .pwm_signal = MCPWM0A,
+        .mcpwm_group_id = 0,
         .pwm_gpio_num = LEFT_MOTOR_PWM_GPIO,
         .dir_gpio_num = LEFT_MOTOR_DIR_GPIO,
         .fault_gpio_num = LEFT_MOTOR_FAULT_GPIO,
@@ -71,10 +68,7 @@ static void test_task(void *pvParameters)
 
     // Init RIGHT motor
     motor_config_t right_config = {
-        .mcpwm_unit = MCPWM_UNIT_0,  // Use a different MCPWM unit if available
-        .timer_num = MCPWM_TIMER_1,
-        .generator = MCPWM_OPR_A,
-        .pwm_signal = MCPWM1A,
+        .mcpwm_group_id = 0,
         .pwm_gpio_num = RIGHT_MOTOR_PWM_GPIO,
         .dir_gpio_num = RIGHT_MOTOR_DIR_GPIO,
         .fault_gpio_num = RIGHT_MOTOR_FAULT_GPIO,
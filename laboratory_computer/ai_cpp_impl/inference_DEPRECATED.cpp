@@ -5,6 +5,12 @@
 #include <array>
 #include <fstream>
 #include <sstream>
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <memory_resource>
+#include <string_view>
+#include <type_traits>
 
 // Definiere Konstanten für die Modelleingabe
 #define DEST_WIDTH 640
@@ -12,29 +18,141 @@
 #define CHANNELS 3
 #define BATCH_SIZE 1
 #define CONF_THRESHOLD 0.4
+#define NMS_THRESHOLD 0.4
 
 #define ORIG_WIDTH 640
 #define ORIG_HEIGHT 480
 
+// Größe der Frame-Arena, reicht für Postprocessing und Debug-Ausgaben eines Frames mit 300 Detektionen
+#define FRAME_ARENA_BYTES (512 * 1024)
+
 using namespace std;
 using namespace cv;
 
 // Hilfsfunktion zum Schreiben von Debugging-Informationen in eine Datei
-void debugLog(const std::string& message) {
+void debugLog(std::string_view message) {
     static std::ofstream log_file("debug_log.txt", std::ios::app);
     log_file << message << std::endl;
     log_file.flush(); // Sofortiges Schreiben in die Datei erzwingen
     std::cout << message << std::endl; // Auch auf der Konsole ausgeben
 }
 
+// Per-Frame-Arena: alle temporären Container eines Frames (Boxen, Konfidenzen, NMS-Indizes, Log-Texte)
+// holen ihren Speicher aus einem einmal reservierten Puffer. Eine Allokation ist ein Zeiger-Inkrement,
+// Freigaben sind No-Ops und reset() setzt den Zeiger in O(1) zurück - kein malloc/free mehr in der Schleife.
+// Reicht der Puffer nicht, wird beim Heap nachgefordert und das beim nächsten reset() gemeldet.
+class FrameArena {
+public:
+    explicit FrameArena(size_t bytes)
+        : buffer(bytes), overflow(std::pmr::new_delete_resource()), resource(buffer.data(), buffer.size(), &overflow) {}
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    std::pmr::memory_resource* get() { return &resource; }
+
+    // Erst aufrufen, wenn kein Objekt des vorherigen Frames mehr lebt
+    void reset() {
+        if (overflow.bytes > 0) {
+            debugLog("Warnung: Frame-Arena übergelaufen, " + std::to_string(overflow.bytes) +
+                " Bytes vom Heap, FRAME_ARENA_BYTES erhöhen");
+            overflow.bytes = 0;
+        }
+        resource.release();
+    }
+
+private:
+    // Reicht Anforderungen an den Heap weiter und zählt sie
+    class OverflowResource : public std::pmr::memory_resource {
+    public:
+        explicit OverflowResource(std::pmr::memory_resource* upstream) : upstream(upstream) {}
+        size_t bytes = 0;
+
+    private:
+        void* do_allocate(size_t size, size_t alignment) override {
+            bytes += size;
+            return upstream->allocate(size, alignment);
+        }
+        void do_deallocate(void* p, size_t size, size_t alignment) override {
+            upstream->deallocate(p, size, alignment);
+        }
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+
+        std::pmr::memory_resource* upstream;
+    };
+
+    std::vector<std::byte> buffer;
+    OverflowResource overflow;
+    std::pmr::monotonic_buffer_resource resource;
+};
+
+// Ersatz für std::to_string und std::stringstream in der Frame-Schleife: hängt Text und Zahlen
+// ohne eigene Allokation an einen String aus der Arena an
+inline void appendText(std::pmr::string& out, std::string_view text) {
+    out.append(text);
+}
+
+template <typename T, std::enable_if_t<std::is_arithmetic_v<T>, int> = 0>
+void appendText(std::pmr::string& out, T value) {
+    char digits[32];
+    std::to_chars_result result;
+    if constexpr (std::is_floating_point_v<T>) {
+        result = std::to_chars(digits, digits + sizeof(digits), value, std::chars_format::general, 6);
+    }
+    else {
+        result = std::to_chars(digits, digits + sizeof(digits), value);
+    }
+    out.append(digits, result.ptr);
+}
+
+template <typename... Parts>
+std::pmr::string arenaText(std::pmr::memory_resource* arena, const Parts&... parts) {
+    std::pmr::string out(arena);
+    (appendText(out, parts), ...);
+    return out;
+}
+
+// Greedy Non-Maximum Suppression wie cv::dnn::NMSBoxes (eta = 1, ohne top_k), aber auf Arena-Containern -
+// NMSBoxes verlangt std::vector für Ein- und Ausgabe
+std::pmr::vector<int> nmsBoxes(const std::pmr::vector<cv::Rect>& boxes, const std::pmr::vector<float>& scores,
+    float score_threshold, float nms_threshold, std::pmr::memory_resource* arena) {
+    std::pmr::vector<int> order(arena);
+    order.reserve(boxes.size());
+    for (int i = 0; i < static_cast<int>(boxes.size()); ++i) {
+        if (scores[i] > score_threshold) order.push_back(i);
+    }
+
+    // Absteigend nach Konfidenz, bei Gleichstand nach Index (wie stable_sort, das aber einen Heap-Puffer anlegt)
+    std::sort(order.begin(), order.end(), [&scores](int a, int b) {
+        return scores[a] > scores[b] || (scores[a] == scores[b] && a < b);
+    });
+
+    std::pmr::vector<int> keep(arena);
+    keep.reserve(order.size());
+    for (int idx : order) {
+        bool suppressed = false;
+        for (int kept : keep) {
+            float intersection = static_cast<float>((boxes[idx] & boxes[kept]).area());
+            float union_area = static_cast<float>(boxes[idx].area() + boxes[kept].area()) - intersection;
+            if (union_area > 0 && intersection / union_area > nms_threshold) {
+                suppressed = true;
+                break;
+            }
+        }
+        if (!suppressed) keep.push_back(idx);
+    }
+    return keep;
+}
+
 // Vorverarbeitung des Bildes für das Modell
-cv::Mat preprocess(const cv::Mat& image) {
+cv::Mat preprocess(const cv::Mat& image, std::pmr::memory_resource* arena) {
     try {
         debugLog("Starte Vorverarbeitung des Bildes");
 
         // Debug: Original-Bildabmessungen und -typ ausgeben
-        debugLog("Original-Bild: " + std::to_string(image.cols) + "x" + std::to_string(image.rows) +
-            ", Typ: " + std::to_string(image.type()));
+        debugLog(arenaText(arena, "Original-Bild: ", image.cols, "x", image.rows, ", Typ: ", image.type()));
 
         // Erstelle ein leeres Bild mit dem korrekten Seitenverhältnis und fülle es mit Schwarz
         float aspect_ratio = static_cast<float>(DEST_WIDTH) / DEST_HEIGHT;
@@ -54,8 +172,8 @@ cv::Mat preprocess(const cv::Mat& image) {
         cv::resize(cropped, resized_image, Size(DEST_WIDTH, DEST_HEIGHT));
 
         // Debug: Größe nach Resize
-        debugLog("Nach Resize: " + std::to_string(resized_image.cols) + "x" + std::to_string(resized_image.rows) +
-            ", Typ: " + std::to_string(resized_image.type()));
+        debugLog(arenaText(arena, "Nach Resize: ", resized_image.cols, "x", resized_image.rows,
+            ", Typ: ", resized_image.type()));
 
         // Wichtig: Normalisierung auf 0-1 und BGR zu RGB konvertieren
         cv::Mat float_image;
@@ -66,7 +184,7 @@ cv::Mat preprocess(const cv::Mat& image) {
         cv::cvtColor(float_image, rgb_image, cv::COLOR_BGR2RGB);
 
         // Debug: Typ nach Konvertierung
-        debugLog("Nach Konvertierung: Typ: " + std::to_string(rgb_image.type()));
+        debugLog(arenaText(arena, "Nach Konvertierung: Typ: ", rgb_image.type()));
 
         debugLog("Vorverarbeitung des Bildes abgeschlossen");
         return rgb_image;
@@ -77,8 +195,8 @@ cv::Mat preprocess(const cv::Mat& image) {
     }
 }
 
-// OpenCV Mat zu ONNX-Tensor konvertieren
-std::vector<float> matToVector(const cv::Mat& image) {
+// OpenCV Mat zu ONNX-Tensor konvertieren, tensor_values wird über alle Frames wiederverwendet
+void matToVector(const cv::Mat& image, std::vector<float>& tensor_values, std::pmr::memory_resource* arena) {
     try {
         debugLog("Starte Konvertierung von Mat zu Vector");
 
@@ -89,7 +207,7 @@ std::vector<float> matToVector(const cv::Mat& image) {
         }
 
         // Konvertiere HWC zu CHW (Höhe, Breite, Kanal zu Kanal, Höhe, Breite)
-        std::vector<float> tensor_values(BATCH_SIZE * CHANNELS * DEST_HEIGHT * DEST_WIDTH);
+        tensor_values.resize(BATCH_SIZE * CHANNELS * DEST_HEIGHT * DEST_WIDTH);
 
         // Zähler für Debug-Zwecke
         int valid_values = 0;
@@ -116,11 +234,9 @@ std::vector<float> matToVector(const cv::Mat& image) {
             }
         }
 
-        debugLog("Tensor-Werte: Min=" + std::to_string(min_val) + ", Max=" + std::to_string(max_val) +
-            ", Gültige Werte: " + std::to_string(valid_values));
+        debugLog(arenaText(arena, "Tensor-Werte: Min=", min_val, ", Max=", max_val,
+            ", Gültige Werte: ", valid_values));
         debugLog("Mat zu Vector Konvertierung abgeschlossen");
-
-        return tensor_values;
     }
     catch (const std::exception& e) {
         debugLog("Fehler bei der Mat-zu-Vector-Konvertierung: " + std::string(e.what()));
@@ -129,29 +245,29 @@ std::vector<float> matToVector(const cv::Mat& image) {
 }
 
 // Erstellt einen ONNX-Tensor aus einem Vektor von float-Werten
-Ort::Value createTensorFromVector(const std::vector<float>& tensor_values, Ort::MemoryInfo& memory_info) {
+Ort::Value createTensorFromVector(const std::vector<float>& tensor_values, Ort::MemoryInfo& memory_info,
+    std::pmr::memory_resource* arena) {
     try {
         debugLog("Erstelle ONNX-Tensor aus Vector");
 
-        // Definiere Tensor-Form (NCHW-Format)
-        std::vector<int64_t> input_shape = { BATCH_SIZE, CHANNELS, DEST_HEIGHT, DEST_WIDTH };
+        // Definiere Tensor-Form (NCHW-Format), CreateTensor kopiert die Form
+        std::array<int64_t, 4> input_shape = { BATCH_SIZE, CHANNELS, DEST_HEIGHT, DEST_WIDTH };
 
         // Debug: Tensor-Form ausgeben
-        std::stringstream shape_str;
-        shape_str << "Tensor-Shape: [";
+        std::pmr::string shape_str(arena);
+        appendText(shape_str, "Tensor-Shape: [");
         for (size_t i = 0; i < input_shape.size(); ++i) {
-            shape_str << input_shape[i];
-            if (i < input_shape.size() - 1) shape_str << ", ";
+            appendText(shape_str, input_shape[i]);
+            if (i < input_shape.size() - 1) appendText(shape_str, ", ");
         }
-        shape_str << "]";
-        debugLog(shape_str.str());
+        appendText(shape_str, "]");
+        debugLog(shape_str);
 
         // Überprüfe die Größe des Vektors
         size_t expected_size = BATCH_SIZE * CHANNELS * DEST_HEIGHT * DEST_WIDTH;
         if (tensor_values.size() != expected_size) {
-            debugLog("Fehler: Tensor-Vektor hat falsche Größe. Ist: " +
-                std::to_string(tensor_values.size()) + ", Erwartet: " +
-                std::to_string(expected_size));
+            debugLog(arenaText(arena, "Fehler: Tensor-Vektor hat falsche Größe. Ist: ",
+                tensor_values.size(), ", Erwartet: ", expected_size));
         }
 
         // Erstelle und gib den ONNX-Tensor zurück
@@ -303,6 +419,15 @@ int main() {
 
             Ort::MemoryInfo memory_info = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
 
+            // Speicher, der über alle Frames wiederverwendet wird: Eingabetensor, Label-Text für putText
+            // (cv::String ist std::string und kann nicht aus der Arena kommen) und die Frame-Arena
+            std::vector<float> tensor_values;
+            tensor_values.reserve(BATCH_SIZE * CHANNELS * DEST_HEIGHT * DEST_WIDTH);
+            std::string label;
+            label.reserve(64);
+            FrameArena frame_arena(FRAME_ARENA_BYTES);
+            std::pmr::memory_resource* arena = frame_arena.get();
+
             // 5. SCHRITT - Einzelne Frames verarbeiten
             int frame_count = 0;
             while (vid_capture.isOpened()) { // Beschränke auf 5 Frames für Debugging
@@ -315,15 +440,15 @@ int main() {
                 }
 
                 frame_count++;
-                debugLog("Frame " + std::to_string(frame_count) + " gelesen");
+                debugLog(arenaText(arena, "Frame ", frame_count, " gelesen"));
 
                 // Zeige den Originalframe an (optional)
                 cv::imshow("Original Frame", frame);
 
                 try {
                     // 6. SCHRITT - Bild vorverarbeiten
-                    cv::Mat preprocessed_frame = preprocess(frame);
-                    debugLog("Vorverarbeitung für Frame " + std::to_string(frame_count) + " abgeschlossen");
+                    cv::Mat preprocessed_frame = preprocess(frame, arena);
+                    debugLog(arenaText(arena, "Vorverarbeitung für Frame ", frame_count, " abgeschlossen"));
 
                     // Zeige vorverarbeiteten Frame an (optional)
                     cv::Mat display_preprocessed;
@@ -333,33 +458,33 @@ int main() {
                     if (key == 'q') break;
 
                     // 7. SCHRITT - Tensor erstellen - jetzt in zwei Schritten
-                    std::vector<float> tensor_values = matToVector(preprocessed_frame);
-                    Ort::Value input_tensor = createTensorFromVector(tensor_values, memory_info);
-                    debugLog("Tensor für Frame " + std::to_string(frame_count) + " erstellt");
+                    matToVector(preprocessed_frame, tensor_values, arena);
+                    Ort::Value input_tensor = createTensorFromVector(tensor_values, memory_info, arena);
+                    debugLog(arenaText(arena, "Tensor für Frame ", frame_count, " erstellt"));
 
                     // 8. SCHRITT - Modellinferenz durchführen
-                    debugLog("Starte Inferenz für Frame " + std::to_string(frame_count));
-                    debugLog("Input Namen: " + std::string(input_names[0]));
-                    debugLog("Output Namen: " + std::string(output_names[0]));
+                    debugLog(arenaText(arena, "Starte Inferenz für Frame ", frame_count));
+                    debugLog(arenaText(arena, "Input Namen: ", input_names[0]));
+                    debugLog(arenaText(arena, "Output Namen: ", output_names[0]));
 
                     // Versuche die Inferenz mit erhöhtem Timeout
                     try {
                         Ort::RunOptions run_options;
                         debugLog("Führe Inferenz aus...");
                         auto output_tensors = session.Run(run_options, input_names, &input_tensor, 1, output_names, 1);
-                        debugLog("Inferenz für Frame " + std::to_string(frame_count) + " erfolgreich abgeschlossen");
+                        debugLog(arenaText(arena, "Inferenz für Frame ", frame_count, " erfolgreich abgeschlossen"));
 
                         // Überprüfe die Ausgabe
                         auto tensor_info = output_tensors[0].GetTensorTypeAndShapeInfo();
                         auto output_shape = tensor_info.GetShape();
-                        std::stringstream ss2;
-                        ss2 << "Output Shape: [";
+                        std::pmr::string ss2(arena);
+                        appendText(ss2, "Output Shape: [");
                         for (size_t j = 0; j < output_shape.size(); ++j) {
-                            ss2 << output_shape[j];
-                            if (j < output_shape.size() - 1) ss2 << ", ";
+                            appendText(ss2, output_shape[j]);
+                            if (j < output_shape.size() - 1) appendText(ss2, ", ");
                         }
-                        ss2 << "]";
-                        debugLog(ss2.str());
+                        appendText(ss2, "]");
+                        debugLog(ss2);
 
 						// Bounding Boxen extrahieren
 						// Hier wird angenommen, dass die Ausgabe ein Vektor von Bounding Boxen ist
@@ -369,22 +494,25 @@ int main() {
                         
 						debugLog("Extrahiere Bounding Boxen aus der Modellausgabe");
 
-                        std::stringstream ss;
-						ss << "Rohwerte: [";
+                        // Einmal in passender Größe anlegen, Wachstum würde in der Arena Reste liegen lassen
+                        std::pmr::string ss(arena);
+                        ss.reserve(16 + output_shape[1] * 5 * 16);
+						appendText(ss, "Rohwerte: [");
                         for (size_t i = 0; i < output_shape[1]; ++i) {
-                            ss << output_data[i * 6 + 0] << ", " <<
-                                output_data[i * 6 + 1] << ", " <<
-                                output_data[i * 6 + 2] << ", " <<
-                                output_data[i * 6 + 3] << ", " <<
-                                output_data[i * 6 + 4];
-                            if (i < output_shape[1] - 1) ss << "; ";
+                            for (size_t k = 0; k < 5; ++k) {
+                                appendText(ss, output_data[i * 6 + k]);
+                                if (k < 4) appendText(ss, ", ");
+                            }
+                            if (i < output_shape[1] - 1) appendText(ss, "; ");
                         };
-						ss << "]";
-						debugLog(ss.str());
+						appendText(ss, "]");
+						debugLog(ss);
 
 
-						std::vector<cv::Rect> boxes;
-						std::vector<float> confidences;
+						std::pmr::vector<cv::Rect> boxes(arena);
+						std::pmr::vector<float> confidences(arena);
+                        boxes.reserve(output_shape[1]);
+                        confidences.reserve(output_shape[1]);
                         for (size_t i = 0; i < output_shape[1]; ++i) {
                             // Rohwerte aus der Modellausgabe
                             float x1 = output_data[i * 6 + 0];
@@ -394,10 +522,7 @@ int main() {
                             float confidence = output_data[i * 6 + 4];
 
                             // Debug: Rohwerte ausgeben
-                            debugLog("Rohwerte: x1=" + std::to_string(x1) +
-                                ", y1=" + std::to_string(y1) +
-                                ", x2=" + std::to_string(x2) +
-                                ", y2=" + std::to_string(y2));
+                            debugLog(arenaText(arena, "Rohwerte: x1=", x1, ", y1=", y1, ", x2=", x2, ", y2=", y2));
 
                             // Skalierung der Koordinaten auf die Bilddimensionen
                             float scale_x = static_cast<float>(frame.cols) / 640;
@@ -415,10 +540,7 @@ int main() {
                             y2 = std::max(0.0f, std::min(y2, static_cast<float>(frame.rows - 1)));
 
                             // Debug: Skalierte und validierte Werte ausgeben
-                            debugLog("Skalierte Werte: x1=" + std::to_string(x1) +
-                                ", y1=" + std::to_string(y1) +
-                                ", x2=" + std::to_string(x2) +
-                                ", y2=" + std::to_string(y2));
+                            debugLog(arenaText(arena, "Skalierte Werte: x1=", x1, ", y1=", y1, ", x2=", x2, ", y2=", y2));
 
                             // Bounding Box und Konfidenz speichern, wenn der Schwellenwert überschritten wird
                             if (confidence > CONF_THRESHOLD) {
@@ -430,13 +552,12 @@ int main() {
 						debugLog("Bounding Boxen extrahiert");
 						// Zeichne die Bounding Boxen auf dem Originalbild
                         // Optional: Non-Maximum Suppression (NMS) anwenden
-                        std::vector<int> indices;
-                        cv::dnn::NMSBoxes(boxes, confidences, CONF_THRESHOLD, 0.4, indices);
+                        std::pmr::vector<int> indices = nmsBoxes(boxes, confidences, CONF_THRESHOLD, NMS_THRESHOLD, arena);
 
                         // Zeichne die gefilterten Bounding Boxen auf das Bild
                         for (int idx : indices) {
                             cv::rectangle(frame, boxes[idx], cv::Scalar(0, 255, 0), 2);
-                            std::string label = "Confidence: " + std::to_string(confidences[idx]);
+                            label.assign(arenaText(arena, "Confidence: ", confidences[idx]));
                             cv::putText(frame, label, cv::Point(boxes[idx].x, boxes[idx].y - 10),
                                 cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(0, 255, 0), 1);
                         }
@@ -444,15 +565,11 @@ int main() {
 						cv::imshow("Detected Objects", frame);
 						int key = waitKey(1); // 10ms warten
 						if (key == 'q') break;
-						debugLog("Inferenz und Post-Processing für Frame " + std::to_string(frame_count) + " abgeschlossen");
+						debugLog(arenaText(arena, "Inferenz und Post-Processing für Frame ", frame_count, " abgeschlossen"));
 						// Optional: Ausgabe der Bounding Boxen in die Konsole
 						for (size_t i = 0; i < boxes.size(); ++i) {
-							debugLog("Box " + std::to_string(i) + ": " +
-								std::to_string(boxes[i].x) + ", " +
-								std::to_string(boxes[i].y) + ", " +
-								std::to_string(boxes[i].width) + ", " +
-								std::to_string(boxes[i].height) + ", " +
-								std::to_string(confidences[i]));
+							debugLog(arenaText(arena, "Box ", i, ": ", boxes[i].x, ", ", boxes[i].y, ", ",
+								boxes[i].width, ", ", boxes[i].height, ", ", confidences[i]));
 						}
 
 
@@ -470,7 +587,10 @@ int main() {
                     debugLog("Allgemeiner Fehler bei Frame " + std::to_string(frame_count) + ": " + std::string(e.what()));
                 }
 
-                debugLog("Frame " + std::to_string(frame_count) + " Verarbeitung abgeschlossen");
+                debugLog(arenaText(arena, "Frame ", frame_count, " Verarbeitung abgeschlossen"));
+
+                // Alle Container und Texte des Frames sind hier zerstört, Arena für den nächsten Frame zurücksetzen
+                frame_arena.reset();
             }
         }
         catch (const Ort::Exception& e) {
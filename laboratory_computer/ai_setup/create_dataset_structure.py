@@ -5,7 +5,7 @@ import shutil
 # This script create the structure for the dataset and splits 
 # the dataset into 3 subcategories: train, val, test
 # each subcategorie has 2 directories: images and labels
-# For now only jpg images are supported. 
+# Supported image formats: jpg and png (e.g. recorded by the dataset recorder).
 # Images without labels need to be deletet manually, will be logged in terminal for 
 # easy search & delete.
 
@@ -26,7 +26,7 @@ val_ratio = 0.2
 test_ratio = 0.1
 
 # Get all image files
-images = [f for f in os.listdir(input_dir) if f.endswith(('.jpg'))]
+images = [f for f in os.listdir(input_dir) if f.endswith(('.jpg', '.png'))]
 random.shuffle(images)
 
 # Split dataset
@@ -0,0 +1,115 @@
+import argparse
+from pathlib import Path
+
+import numpy as np
+import onnx
+from onnx import TensorProto, helper, numpy_helper
+from ultralytics import YOLO
+
+
+# ************************************** SOURCES  **************************************
+# ONNX NonMaxSuppression: https://onnx.ai/onnx/operators/onnx__NonMaxSuppression.html
+# Ultralytics export: https://docs.ultralytics.com/modes/export/
+
+# ************************************** DOCUMENTATION **************************************
+# Exports a trained YOLO model to ONNX and appends the postprocessing to the graph, so the model
+# returns final boxes and ONNX Runtime can optimize decode + NMS together with the network.
+#
+# Raw ultralytics head:   output0     [1, 4 + classes, anchors]   (cx, cy, w, h, class scores...)
+# Appended subgraph:      transpose -> split boxes / scores -> max score + class per anchor
+#                         -> NonMaxSuppression (class agnostic, center_point_box=1)
+#                         -> gather selected anchors -> cxcywh to xyxy
+# Fused output:           detections  [N, 6]                  (x1, y1, x2, y2, conf, class), N <= max_det
+#
+# Coordinates are in model input pixels (letterboxed square), see Inference_Scripts/onnx_detector.py.
+# The standard ONNX NonMaxSuppression op is used instead of the TensorRT EfficientNMS plugin, so the
+# exported model runs on every ORT execution provider (CPU, CUDA, TensorRT).
+#
+# Usage:
+#   python export_onnx_nms.py --weights ../models/YOLOv11n_NEW/weights/best.pt --imgsz 640
+# writes best.onnx (raw head, for the application-side decode) and best_nms.onnx (fused) next to the weights.
+# Several input sizes (adaptive resolution in the receiver, ONNX input sizes are fixed):
+#   python export_onnx_nms.py --weights ../models/YOLOv11n_NEW/weights/best.pt --imgsz 320 480 640
+# writes best_320.onnx / best_320_nms.onnx, best_480.onnx / ... for every size.
+
+OPSET = 17  # ReduceMax still takes axes as attribute, NonMaxSuppression needs >= 11
+
+
+def append_nms(model, conf, iou, max_det):
+    graph = model.graph
+    head = graph.output[0].name
+    dims = graph.output[0].type.tensor_type.shape.dim
+    num_classes = dims[1].dim_value - 4
+
+    def const(name, values, dtype):
+        graph.initializer.append(numpy_helper.from_array(np.asarray(values, dtype=dtype), name))
+        return name
+
+    nodes = [
+        # [1, 4 + nc, A] -> [1, A, 4 + nc]
+        helper.make_node("Transpose", [head], ["nms_pred"], perm=[0, 2, 1]),
+        helper.make_node("Slice", ["nms_pred", const("nms_box_start", [0], np.int64), const("nms_box_end", [4], np.int64),
+                                   const("nms_last_axis", [2], np.int64)], ["nms_boxes_cxcywh"]),
+        helper.make_node("Slice", ["nms_pred", "nms_box_end", const("nms_score_end", [4 + num_classes], np.int64),
+                                   "nms_last_axis"], ["nms_class_scores"]),
+
+        # Class agnostic: best class per anchor, like agnostic_nms=True in the receiver
+        helper.make_node("ReduceMax", ["nms_class_scores"], ["nms_scores"], axes=[2], keepdims=1),                  # [1, A, 1]
+        helper.make_node("ArgMax", ["nms_class_scores"], ["nms_class_index"], axis=2, keepdims=1),                  # [1, A, 1]
+        helper.make_node("Cast", ["nms_class_index"], ["nms_classes"], to=TensorProto.FLOAT),
+        helper.make_node("Transpose", ["nms_scores"], ["nms_scores_per_class"], perm=[0, 2, 1]),                    # [1, 1, A]
+
+        helper.make_node("NonMaxSuppression",
+                         ["nms_boxes_cxcywh", "nms_scores_per_class",
+                          const("nms_max_det", [max_det], np.int64),
+                          const("nms_iou", [iou], np.float32),
+                          const("nms_conf", [conf], np.float32)],
+                         ["nms_selected"], center_point_box=1),                                                     # [N, 3]
+        helper.make_node("Gather", ["nms_selected", const("nms_anchor_column", 2, np.int64)], ["nms_anchor"], axis=1),  # [N]
+
+        # cxcywh -> xyxy
+        helper.make_node("Squeeze", ["nms_boxes_cxcywh", const("nms_batch_axis", [0], np.int64)], ["nms_boxes_all"]),   # [A, 4]
+        helper.make_node("Gather", ["nms_boxes_all", "nms_anchor"], ["nms_boxes_sel"], axis=0),                     # [N, 4]
+        helper.make_node("Slice", ["nms_boxes_sel", "nms_box_start", const("nms_xy_end", [2], np.int64),
+                                   const("nms_col_axis", [1], np.int64)], ["nms_xy"]),
+        helper.make_node("Slice", ["nms_boxes_sel", "nms_xy_end", "nms_box_end", "nms_col_axis"], ["nms_wh"]),
+        helper.make_node("Mul", ["nms_wh", const("nms_half", 0.5, np.float32)], ["nms_half_wh"]),
+        helper.make_node("Sub", ["nms_xy", "nms_half_wh"], ["nms_xy1"]),
+        helper.make_node("Add", ["nms_xy", "nms_half_wh"], ["nms_xy2"]),
+
+        helper.make_node("Squeeze", ["nms_scores", "nms_batch_axis"], ["nms_scores_all"]),                          # [A, 1]
+        helper.make_node("Gather", ["nms_scores_all", "nms_anchor"], ["nms_conf_sel"], axis=0),                     # [N, 1]
+        helper.make_node("Squeeze", ["nms_classes", "nms_batch_axis"], ["nms_classes_all"]),                        # [A, 1]
+        helper.make_node("Gather", ["nms_classes_all", "nms_anchor"], ["nms_class_sel"], axis=0),                   # [N, 1]
+
+        helper.make_node("Concat", ["nms_xy1", "nms_xy2", "nms_conf_sel", "nms_class_sel"], ["detections"], axis=1),
+    ]
+    graph.node.extend(nodes)
+
+    del graph.output[:]
+    graph.output.append(helper.make_tensor_value_info("detections", TensorProto.FLOAT, ["num_detections", 6]))
+
+    onnx.checker.check_model(model)
+    return model
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Export YOLO weights to ONNX with decode and NMS fused into the graph.")
+    parser.add_argument("--weights", required=True, help="Path to the trained .pt weights")
+    parser.add_argument("--imgsz", type=int, nargs="+", default=[640], help="Square input size(s) of the exported model")
+    parser.add_argument("--conf", type=float, default=0.25, help="Confidence threshold baked into the NMS node")
+    parser.add_argument("--iou", type=float, default=0.5, help="IoU threshold baked into the NMS node")
+    parser.add_argument("--max-det", type=int, default=10, help="Maximum number of returned detections (the receiver tracks several)")
+    args = parser.parse_args()
+
+    for imgsz in args.imgsz:
+        # Static batch 1 / static input size, lets ORT fold shapes of the whole graph
+        raw_path = Path(YOLO(args.weights).export(format="onnx", imgsz=imgsz, opset=OPSET, simplify=True, dynamic=False))
+        if len(args.imgsz) > 1:
+            raw_path = raw_path.replace(raw_path.with_name(f"{raw_path.stem}_{imgsz}.onnx"))
+        print(f"Raw head exported to {raw_path}")
+
+        fused = append_nms(onnx.load(str(raw_path)), args.conf, args.iou, args.max_det)
+        fused_path = raw_path.with_name(f"{raw_path.stem}_nms.onnx")
+        onnx.save(fused, str(fused_path))
+        print(f"Fused model (imgsz {imgsz}, conf {args.conf}, iou {args.iou}, max_det {args.max_det}) written to {fused_path}")
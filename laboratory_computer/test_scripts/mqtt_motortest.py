@@ -1,6 +1,10 @@
+import sys
+from pathlib import Path
 import paho.mqtt.client as mqtt
 import argparse
-import json
+
+sys.path.append(str(Path(__file__).resolve().parents[1] / "webRTC_inference" / "Inference_Scripts"))
+from turret_protocol import CommandEncoder, PROTOCOLS
 
 def str2bool(v):
     if isinstance(v, bool):
@@ -16,6 +20,7 @@ parser = argparse.ArgumentParser(description="Send turret commands via MQTT.")
 parser.add_argument("--x_angle", type=int, required=True, help="Platform X angle")
 parser.add_argument("--y_angle", type=int, required=True, help="Platform Y angle")
 parser.add_argument("--fire", type=str2bool, required=True, help="Fire command (True/False)")
+parser.add_argument("--protocol", choices=PROTOCOLS, default="binary", help="Command format (json for older ESP firmware)")
 args = parser.parse_args()
 
 
@@ -25,15 +30,11 @@ client.connect("127.0.0.1", 1883, 60)
 
 
 # Payload from parsed arguments
-payload = {
-    "platform_x_angle": args.x_angle,
-    "platform_y_angle": args.y_angle,
-    "fire_command": args.fire
-}
+payload = CommandEncoder(args.protocol).encode(args.x_angle, args.y_angle, fire=args.fire)
 
 # Function to publish message
 def publish():
-    client.publish("vehicle/turret/cmd", json.dumps(payload))
+    client.publish("vehicle/turret/cmd", payload)
 
 
 publish()
@@ -0,0 +1,266 @@
+/*  Simulation bench for the visual servo controller, tunes gains without the vehicle.
+
+    Models the complete loop of receiver_inference.py at 1 ms resolution:
+      - plant:      MG996R platform servo, command applied after a dead time, slew rate limited,
+                    followed by a first-order lag (platform inertia)
+      - camera:     frames at `fps`, each measurement of the camera-relative target angle becomes
+                    available `delay` ms after capture (camera, encoder, network, inference), plus noise
+      - estimator:  same as world_tracker.py: the nominal turret model (dead time + inertia as delay, slew)
+                    undoes the camera motion, a constant-velocity Kalman filter tracks the target in world angles
+      - controller: VisualServoController, updated on every arriving measurement
+
+    Scenarios (pan axis): 20 deg step, 30 deg/s ramp, 15 deg / 0.5 Hz sine
+    Metrics: rise time (10-90 %), settle time (within +-1 deg for good), overshoot, RMS / max tracking error
+
+    Usage: servo_sim [--kp 4] [--ki 0.5] [--kd 0.1] [--kff 0.3] [--max-rate 300] [--delay 120] [--fps 30]
+                     [--noise 0.3] [--accel 60] [--scenario step|ramp|sine|all] [--trace]
+*/
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "visual_servo.h"
+
+struct SimConfig
+{
+    AxisGains gains = defaultPanGains();
+    float delayMs = 120.0f;        // capture -> measurement available
+    float fps = 30.0f;
+    float noiseDeg = 0.3f;         // measurement noise (1 sigma)
+    float accelStd = 60.0f;        // process noise of the target filter, WorldTargetFilter accel_std_deg_s2
+    float deadTimeMs = 30.0f;      // command -> servo starts moving (MQTT, ESP, I2C)
+    float slewDegS = 300.0f;       // MG996R ~0.2 s / 60 deg
+    float lagMs = 40.0f;           // platform inertia
+    float durationS = 4.0f;
+    std::string scenario = "all";
+};
+
+struct Metrics
+{
+    float riseS = NAN;
+    float settleS = NAN;
+    float overshootPct = 0.0f;
+    float rmsDeg = 0.0f;
+    float maxDeg = 0.0f;
+};
+
+static float targetAngle(const std::string &scenario, float t)
+{
+    const float start = 0.5f;
+    if (t < start)
+        return 0.0f;
+    if (scenario == "step")
+        return 20.0f;
+    if (scenario == "ramp")
+        return std::fmin(30.0f * (t - start), 60.0f);
+    return 15.0f * std::sin(2.0f * static_cast<float>(M_PI) * 0.5f * (t - start));
+}
+
+// Nominal turret model of the estimator, commands are (effective time, angle)
+static float modelAngle(const std::deque<std::pair<float, float>> &commands, float slew, float t)
+{
+    float angle = 0.0f, target = 0.0f, time = 0.0f;
+    for (const auto &command : commands)
+    {
+        if (command.first > t)
+            break;
+        float step = slew * (command.first - time);
+        angle += std::fmax(-step, std::fmin(step, target - angle));
+        target = command.second;
+        time = command.first;
+    }
+    float step = slew * (t - time);
+    return angle + std::fmax(-step, std::fmin(step, target - angle));
+}
+
+static Metrics runScenario(const SimConfig &cfg, const std::string &scenario, bool printTrace)
+{
+    const float dt = 0.001f;
+    const float frameDt = 1.0f / cfg.fps;
+    const float start = 0.5f;
+
+    VisualServoController controller;
+    controller.setGains(VisualServoController::PAN, cfg.gains);
+    controller.reset(0.0f, 48.0f);
+
+    std::mt19937 rng(42);
+    std::normal_distribution<float> noise(0.0f, cfg.noiseDeg);
+
+    float servoTarget = 0.0f, servoSlewed = 0.0f, plant = 0.0f;
+    std::deque<std::pair<float, float>> sentCommands;     // (time applied at the servo, angle)
+    std::deque<std::pair<float, float>> modelCommands;    // same for the estimator
+    std::deque<std::pair<float, float>> measurements;     // (capture time, relative angle)
+
+    float nextFrame = 0.0f, lastUpdate = -1.0f;
+    float worldAngle = 0.0f, worldRate = 0.0f, worldTime = -1.0f;
+    float P[2][2] = {{0.0f, 0.0f}, {0.0f, 0.0f}};
+
+    Metrics m;
+    float peak = 0.0f, sumSq = 0.0f;
+    int samples = 0;
+    float lastOutside = start;
+
+    for (float t = 0.0f; t < cfg.durationS; t += dt)
+    {
+        float target = targetAngle(scenario, t);
+
+        // Plant
+        while (!sentCommands.empty() && sentCommands.front().first <= t)
+        {
+            servoTarget = sentCommands.front().second;
+            sentCommands.pop_front();
+        }
+        float step = cfg.slewDegS * dt;
+        servoSlewed += std::fmax(-step, std::fmin(step, servoTarget - servoSlewed));
+        plant += (servoSlewed - plant) * dt / (cfg.lagMs / 1000.0f + dt);
+
+        // Camera
+        if (t >= nextFrame)
+        {
+            measurements.emplace_back(t, target - plant + noise(rng));
+            nextFrame += frameDt;
+        }
+
+        // Measurement arrives -> estimator + controller, like one iteration of run_track
+        while (!measurements.empty() && measurements.front().first + cfg.delayMs / 1000.0f <= t)
+        {
+            float capture = measurements.front().first;
+            float world = measurements.front().second + modelAngle(modelCommands, cfg.slewDegS, capture);
+            measurements.pop_front();
+
+            if (worldTime < 0.0f)
+            {
+                worldAngle = world;
+                P[0][0] = cfg.noiseDeg * cfg.noiseDeg;
+                P[1][1] = 100.0f * 100.0f;
+            }
+            else
+            {
+                // Constant velocity Kalman filter, same model as WorldTargetFilter
+                float h = capture - worldTime;
+                worldAngle += worldRate * h;
+                float q = cfg.accelStd * cfg.accelStd;
+                float p00 = P[0][0] + h * (P[1][0] + P[0][1]) + h * h * P[1][1] + q * h * h * h * h / 4.0f;
+                float p01 = P[0][1] + h * P[1][1] + q * h * h * h / 2.0f;
+                float p11 = P[1][1] + q * h * h;
+                float s = p00 + cfg.noiseDeg * cfg.noiseDeg;
+                float k0 = p00 / s, k1 = p01 / s;
+                float residual = world - worldAngle;
+                worldAngle += k0 * residual;
+                worldRate += k1 * residual;
+                P[0][0] = (1.0f - k0) * p00;
+                P[0][1] = P[1][0] = (1.0f - k0) * p01;
+                P[1][1] = p11 - k1 * p01;
+            }
+            worldTime = capture;
+
+            // Compare where target and turret will be once the new command takes effect, commands
+            // still in flight are already part of the model (Smith predictor)
+            float effective = t + (cfg.deadTimeMs + cfg.lagMs) / 1000.0f;
+            float predictedTarget = worldAngle + worldRate * (effective - worldTime);
+            float error = predictedTarget - modelAngle(modelCommands, cfg.slewDegS, effective);
+            float updateDt = lastUpdate < 0.0f ? frameDt : t - lastUpdate;
+            lastUpdate = t;
+
+            float pan, tilt;
+            controller.update(error, 0.0f, worldRate, 0.0f, updateDt, pan, tilt);
+            sentCommands.emplace_back(t + cfg.deadTimeMs / 1000.0f, pan);
+            modelCommands.emplace_back(effective, pan);
+        }
+
+        // Metrics
+        if (t >= start)
+        {
+            float err = target - plant;
+            sumSq += err * err;
+            samples++;
+            m.maxDeg = std::fmax(m.maxDeg, std::fabs(err));
+            if (std::fabs(err) > 1.0f)
+                lastOutside = t;
+            if (scenario == "step")
+            {
+                peak = std::fmax(peak, plant);
+                if (std::isnan(m.riseS) && plant >= 0.9f * target)
+                    m.riseS = t - start;
+            }
+        }
+
+        if (printTrace && std::fmod(t, 0.01f) < dt)
+            std::printf("%.3f,%.3f,%.3f\n", t, target, plant);
+    }
+
+    m.rmsDeg = std::sqrt(sumSq / std::fmax(samples, 1));
+    if (lastOutside < cfg.durationS - 0.5f)
+        m.settleS = lastOutside - start;
+    if (scenario == "step")
+        m.overshootPct = std::fmax(0.0f, (peak - 20.0f) / 20.0f * 100.0f);
+    return m;
+}
+
+static bool parseFloat(int &i, int argc, char **argv, const char *name, float &value)
+{
+    if (std::strcmp(argv[i], name) != 0 || i + 1 >= argc)
+        return false;
+    value = std::strtof(argv[++i], nullptr);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    SimConfig cfg;
+    bool trace = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (parseFloat(i, argc, argv, "--kp", cfg.gains.kp) || parseFloat(i, argc, argv, "--ki", cfg.gains.ki) ||
+            parseFloat(i, argc, argv, "--kd", cfg.gains.kd) || parseFloat(i, argc, argv, "--kff", cfg.gains.kff) ||
+            parseFloat(i, argc, argv, "--max-rate", cfg.gains.max_rate) ||
+            parseFloat(i, argc, argv, "--delay", cfg.delayMs) || parseFloat(i, argc, argv, "--fps", cfg.fps) ||
+            parseFloat(i, argc, argv, "--noise", cfg.noiseDeg) || parseFloat(i, argc, argv, "--accel", cfg.accelStd))
+            continue;
+        if (std::strcmp(argv[i], "--scenario") == 0 && i + 1 < argc)
+            cfg.scenario = argv[++i];
+        else if (std::strcmp(argv[i], "--trace") == 0)
+            trace = true;
+        else
+        {
+            std::fprintf(stderr, "Unknown argument %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    if (!validGains(cfg.gains))
+    {
+        std::fprintf(stderr, "Invalid gains, max_rate must be > 0 and all values finite\n");
+        return 1;
+    }
+
+    std::vector<std::string> scenarios;
+    if (cfg.scenario == "all")
+        scenarios = {"step", "ramp", "sine"};
+    else
+        scenarios = {cfg.scenario};
+
+    if (!trace)
+    {
+        std::printf("kp %.2f ki %.2f kd %.2f kff %.2f max_rate %.0f deg/s | delay %.0f ms, %.0f FPS, noise %.2f deg\n",
+                    cfg.gains.kp, cfg.gains.ki, cfg.gains.kd, cfg.gains.kff, cfg.gains.max_rate,
+                    cfg.delayMs, cfg.fps, cfg.noiseDeg);
+        std::printf("%-6s %10s %10s %10s %10s %10s\n", "", "rise s", "settle s", "overshoot", "rms deg", "max deg");
+    }
+
+    for (const auto &scenario : scenarios)
+    {
+        Metrics m = runScenario(cfg, scenario, trace);
+        if (!trace)
+            std::printf("%-6s %10.3f %10.3f %9.1f%% %10.2f %10.2f\n", scenario.c_str(), m.riseS, m.settleS,
+                        m.overshootPct, m.rmsDeg, m.maxDeg);
+    }
+    return 0;
+}
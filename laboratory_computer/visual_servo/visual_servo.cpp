@@ -0,0 +1,149 @@
+#include "visual_servo.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Derivative low pass, the error is noisy at camera rate (detection jitter of a few pixels)
+static const float DERIVATIVE_TAU = 0.05f;
+
+AxisGains defaultPanGains()
+{
+    // Tuned with servo_sim (MG996R slew model, 30 FPS, 120 ms camera + processing delay):
+    // a higher kp / kff tracks moving targets closer but overshoots more on sudden jumps
+    return AxisGains{4.0f, 0.5f, 0.1f, 0.3f, 300.0f, 10.0f, -90.0f, 90.0f};
+}
+
+AxisGains defaultTiltGains()
+{
+    return AxisGains{4.0f, 0.5f, 0.1f, 0.3f, 150.0f, 10.0f, 0.0f, 80.0f};
+}
+
+bool validGains(const AxisGains &gains)
+{
+    const float values[] = {gains.kp, gains.ki, gains.kd, gains.kff, gains.max_rate, gains.i_limit, gains.min_angle, gains.max_angle};
+    for (float value : values)
+    {
+        if (!std::isfinite(value))
+            return false;
+    }
+    // std::clamp needs lo <= hi, a rate limit of 0 would freeze the output
+    return gains.min_angle <= gains.max_angle && gains.max_rate > 0.0f && gains.i_limit >= 0.0f;
+}
+
+AxisController::AxisController()
+{
+    gains = defaultPanGains();
+    reset(0.0f);
+}
+
+bool AxisController::setGains(const AxisGains &newGains)
+{
+    if (!validGains(newGains))
+        return false;
+
+    gains = newGains;
+    integral = std::clamp(integral, -gains.i_limit, gains.i_limit);
+    command = std::clamp(command, gains.min_angle, gains.max_angle);
+    return true;
+}
+
+void AxisController::reset(float newCommand)
+{
+    command = newCommand;
+    integral = 0.0f;
+    prevError = 0.0f;
+    filteredDerivative = 0.0f;
+    hasPrevError = false;
+}
+
+float AxisController::update(float error, float targetRate, float dt)
+{
+    if (dt <= 0.0f)
+        return command;
+
+    if (hasPrevError)
+    {
+        float alpha = dt / (DERIVATIVE_TAU + dt);
+        filteredDerivative += alpha * ((error - prevError) / dt - filteredDerivative);
+    }
+    prevError = error;
+    hasPrevError = true;
+
+    float unclamped = gains.kp * error + gains.ki * integral + gains.kd * filteredDerivative + gains.kff * targetRate;
+    float rate = std::clamp(unclamped, -gains.max_rate, gains.max_rate);
+    float next = command + rate * dt;
+    float limited = std::clamp(next, gains.min_angle, gains.max_angle);
+
+    // Anti-windup: only integrate if the output is not saturated in the direction of the error
+    bool saturatedHigh = (rate != unclamped && unclamped > 0.0f) || (limited != next && next > limited);
+    bool saturatedLow = (rate != unclamped && unclamped < 0.0f) || (limited != next && next < limited);
+    if (!(saturatedHigh && error > 0.0f) && !(saturatedLow && error < 0.0f))
+        integral = std::clamp(integral + error * dt, -gains.i_limit, gains.i_limit);
+
+    command = limited;
+    return command;
+}
+
+VisualServoController::VisualServoController()
+{
+    axes[PAN].setGains(defaultPanGains());
+    axes[TILT].setGains(defaultTiltGains());
+    reset(0.0f, 48.0f);
+}
+
+void VisualServoController::reset(float pan, float tilt)
+{
+    axes[PAN].reset(pan);
+    axes[TILT].reset(tilt);
+}
+
+void VisualServoController::update(float panError, float tiltError, float panRate, float tiltRate, float dt,
+                                   float &panOut, float &tiltOut)
+{
+    panOut = axes[PAN].update(panError, panRate, dt);
+    tiltOut = axes[TILT].update(tiltError, tiltRate, dt);
+}
+
+// ************************************** C API **************************************
+
+static bool validAxis(int axis)
+{
+    return axis == VisualServoController::PAN || axis == VisualServoController::TILT;
+}
+
+VisualServoController *vs_create()
+{
+    return new VisualServoController();
+}
+
+void vs_destroy(VisualServoController *controller)
+{
+    delete controller;
+}
+
+int vs_set_gains(VisualServoController *controller, int axis, const AxisGains *gains)
+{
+    if (!controller || !gains || !validAxis(axis))
+        return -1;
+    return controller->setGains(static_cast<VisualServoController::Axis>(axis), *gains) ? 0 : -1;
+}
+
+void vs_get_gains(const VisualServoController *controller, int axis, AxisGains *gains)
+{
+    if (controller && gains && validAxis(axis))
+        *gains = controller->getGains(static_cast<VisualServoController::Axis>(axis));
+}
+
+void vs_reset(VisualServoController *controller, float pan, float tilt)
+{
+    if (controller)
+        controller->reset(pan, tilt);
+}
+
+void vs_update(VisualServoController *controller, float panError, float tiltError,
+               float panRate, float tiltRate, float dt, float *panOut, float *tiltOut)
+{
+    if (!controller || !panOut || !tiltOut)
+        return;
+    controller->update(panError, tiltError, panRate, tiltRate, dt, *panOut, *tiltOut);
+}
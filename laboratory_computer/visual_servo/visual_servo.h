@@ -0,0 +1,88 @@
+/*  Closed-loop visual servo controller for the turret platform (pan / tilt).
+
+    Runs once per camera frame on the angular error between the tracked target and the
+    estimated actual turret direction (both in turret-base degrees, see world_tracker.py):
+
+        rate    = kp * e + ki * integral(e) + kd * de/dt + kff * target_rate
+        command = command + clamp(rate, +-max_rate) * dt,   clamped to [min_angle, max_angle]
+
+    The controller output is the absolute angle sent to the platform. Integration stops
+    while the output is rate limited or at an angle limit and the error would push it further
+    (conditional integration anti-windup), the integral itself is clamped to +-i_limit.
+
+    Gains can be changed at any time, the C API below is used from Python via ctypes. Gains that are
+    not finite, an empty angle range, max_rate <= 0 or i_limit < 0 are rejected, the controller keeps
+    the gains it had.
+*/
+
+#pragma once
+
+struct AxisGains
+{
+    float kp;         // 1/s, rate per degree of error
+    float ki;         // 1/s^2
+    float kd;         // rate per (degree / s) of error change
+    float kff;        // feedforward of the target angular rate, 1.0 = full
+    float max_rate;   // deg/s, output rate limit
+    float i_limit;    // deg*s, integral clamp
+    float min_angle;  // deg
+    float max_angle;  // deg
+};
+
+class AxisController
+{
+public:
+    AxisController();
+
+    bool setGains(const AxisGains &gains);
+    const AxisGains &getGains() const { return gains; }
+
+    void reset(float command);
+    float update(float error, float targetRate, float dt);
+    float getCommand() const { return command; }
+
+private:
+    AxisGains gains;
+
+    float command;
+    float integral;
+    float prevError;
+    float filteredDerivative;
+    bool hasPrevError;
+};
+
+class VisualServoController
+{
+public:
+    enum Axis { PAN = 0, TILT = 1 };
+
+    VisualServoController();
+
+    bool setGains(Axis axis, const AxisGains &gains) { return axes[axis].setGains(gains); }
+    const AxisGains &getGains(Axis axis) const { return axes[axis].getGains(); }
+
+    void reset(float pan, float tilt);
+    void update(float panError, float tiltError, float panRate, float tiltRate, float dt, float &panOut, float &tiltOut);
+
+private:
+    AxisController axes[2];
+};
+
+AxisGains defaultPanGains();
+AxisGains defaultTiltGains();
+bool validGains(const AxisGains &gains);
+
+#ifdef _WIN32
+#define VS_API extern "C" __declspec(dllexport)
+#else
+#define VS_API extern "C" __attribute__((visibility("default")))
+#endif
+
+VS_API VisualServoController *vs_create();
+VS_API void vs_destroy(VisualServoController *controller);
+// 0 if the gains are applied, -1 for invalid arguments or gains
+VS_API int vs_set_gains(VisualServoController *controller, int axis, const AxisGains *gains);
+VS_API void vs_get_gains(const VisualServoController *controller, int axis, AxisGains *gains);
+VS_API void vs_reset(VisualServoController *controller, float pan, float tilt);
+VS_API void vs_update(VisualServoController *controller, float panError, float tiltError,
+                      float panRate, float tiltRate, float dt, float *panOut, float *tiltOut);
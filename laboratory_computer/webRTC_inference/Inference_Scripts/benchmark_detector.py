@@ -0,0 +1,123 @@
+import argparse
+
+import cv2
+import numpy as np
+
+from onnx_detector import MultiResolutionDetector, OnnxDetector
+from resolution_selector import ResolutionSelector
+
+
+# ************************************** DOCUMENTATION **************************************
+# Compares the fused ONNX model (decode + NMS in the graph) with the raw head + application-side
+# decode on the same video. Both models must come from the same export (ai_setup/export_onnx_nms.py).
+#
+#   python benchmark_detector.py --raw ../../models/YOLOv11n_NEW/weights/best.onnx \
+#                                --fused ../../models/YOLOv11n_NEW/weights/best_nms.onnx --video Test_video.mp4
+#
+# Reports mean / p50 / p95 per stage in ms and how often both variants agree (same detection count,
+# IoU >= 0.9 of the best box).
+#
+# --adaptive additionally runs the fused model with per-frame input size selection (resolution_selector.py)
+# over all sizes it was exported at (export_onnx_nms.py --imgsz 320 480 640) and reports the time spent at each
+# size and how often it still finds the target that the largest size finds (best box, IoU >= 0.5).
+
+WARMUP_FRAMES = 20
+
+
+def iou(a, b):
+    x1, y1 = max(a[0], b[0]), max(a[1], b[1])
+    x2, y2 = min(a[2], b[2]), min(a[3], b[3])
+    inter = max(0.0, x2 - x1) * max(0.0, y2 - y1)
+    union = (a[2] - a[0]) * (a[3] - a[1]) + (b[2] - b[0]) * (b[3] - b[1]) - inter
+    return inter / union if union > 0 else 0.0
+
+
+def summarize(name, timings):
+    print(f"\n{name}")
+    for stage in ("preprocess", "inference", "postprocess", "total"):
+        values = np.asarray(timings[stage])
+        print(f"  {stage:<12} mean {values.mean():7.3f}  p50 {np.percentile(values, 50):7.3f}  p95 {np.percentile(values, 95):7.3f} ms")
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Benchmark fused ONNX postprocessing against application-side decode.")
+    parser.add_argument("--raw", required=True, help="ONNX model with the raw head (output0)")
+    parser.add_argument("--fused", required=True, help="ONNX model with fused decode + NMS (detections)")
+    parser.add_argument("--video", default="Test_video.mp4", help="Video to run both models on")
+    parser.add_argument("--conf", type=float, default=0.25, help="Confidence threshold of the application-side decode")
+    parser.add_argument("--iou", type=float, default=0.5, help="IoU threshold of the application-side decode")
+    parser.add_argument("--max-det", type=int, default=10, help="Detections kept by the application-side decode, as baked into the fused export")
+    parser.add_argument("--adaptive", action="store_true", help="Also benchmark input size selection over the exported sizes")
+    args = parser.parse_args()
+
+    adaptive = fixed_size = selector = None
+    if args.adaptive:
+        adaptive = MultiResolutionDetector(args.fused)
+        selector = ResolutionSelector(adaptive.sizes)
+        fixed_size = adaptive.sizes[-1]
+        fixed = ResolutionSelector([fixed_size])
+        target = None
+        found = found_adaptive = 0
+
+    detectors = {
+        "application-side decode": OnnxDetector(args.raw, conf=args.conf, iou=args.iou, max_det=args.max_det),
+        "fused decode + NMS": OnnxDetector(args.fused),
+    }
+    if detectors["application-side decode"].fused or not detectors["fused decode + NMS"].fused:
+        raise SystemExit("--raw must be the plain export and --fused the *_nms.onnx export")
+    timings = {name: {stage: [] for stage in ("preprocess", "inference", "postprocess", "total")} for name in detectors}
+
+    cap = cv2.VideoCapture(args.video)
+    if not cap.isOpened():
+        raise SystemExit(f"Cannot open {args.video}")
+
+    frames = agree = 0
+    while True:
+        ret, frame = cap.read()
+        if not ret:
+            break
+
+        outputs = {}
+        for name, detector in detectors.items():
+            outputs[name] = detector(frame)
+            if frames >= WARMUP_FRAMES:
+                for stage, value in detector.speed.items():
+                    timings[name][stage].append(value)
+                timings[name]["total"].append(sum(detector.speed.values()))
+
+        raw, fused = outputs.values()
+        if len(raw) == len(fused) and (len(raw) == 0 or iou(raw[0], fused[0]) >= 0.9):
+            agree += 1
+
+        if adaptive is not None:
+            # The most confident detection of the previous frame stands in for the tracked target
+            imgsz = selector.select(target[:4] if target is not None else None,
+                                    target[4] if target is not None else 0.0, frame.shape)
+            detections = adaptive(frame, imgsz)
+            adaptive_ms = sum(adaptive.speed.values())
+            reference = adaptive(frame, fixed_size)
+            if frames >= WARMUP_FRAMES:
+                selector.record(imgsz, adaptive_ms / 1000)
+                fixed.record(fixed_size, sum(adaptive.speed.values()) / 1000)
+                if len(reference):
+                    found += 1
+                    best = reference[np.argmax(reference[:, 4])]
+                    found_adaptive += any(iou(best, d) >= 0.5 for d in detections)
+            target = detections[np.argmax(detections[:, 4])] if len(detections) else None
+        frames += 1
+
+    cap.release()
+    if frames <= WARMUP_FRAMES:
+        raise SystemExit("Video too short for a benchmark")
+
+    print(f"{frames} frames ({WARMUP_FRAMES} warm-up frames excluded), providers {detectors['fused decode + NMS'].session.get_providers()}")
+    for name in detectors:
+        summarize(name, timings[name])
+    print(f"\nDetections agree on {agree}/{frames} frames ({agree / frames:.1%})")
+
+    if adaptive is not None:
+        print(f"\nAdaptive input size {adaptive.sizes}, time per size:\n{selector.report()}")
+        adaptive_s, fixed_s = sum(selector.seconds.values()), sum(fixed.seconds.values())
+        print(f"Detector time {adaptive_s:.2f} s adaptive vs {fixed_s:.2f} s fixed at {fixed_size} ({adaptive_s / max(fixed_s, 1e-9):.1%})")
+        print(f"Target found by the fixed size also found adaptively on {found_adaptive}/{found} frames "
+              f"({found_adaptive / max(found, 1):.1%})")
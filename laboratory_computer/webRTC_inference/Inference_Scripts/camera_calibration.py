@@ -0,0 +1,221 @@
+import argparse
+import glob
+import math
+
+import cv2
+import numpy as np
+from loguru import logger
+
+
+# ************************************** SOURCES  **************************************
+# Camera calibration: https://docs.opencv.org/4.x/dc/dbb/tutorial_py_calibration.html
+# Fixed point remap maps: https://docs.opencv.org/4.x/da/d54/group__imgproc__transform.html#ga7dfb72c9cf9780a347fbe3d1c47e5d5a
+
+# ************************************** DOCUMENTATION **************************************
+# The Camera Module 3 has a wide lens with noticeable barrel distortion, a linear degrees-per-pixel
+# factor is therefore off by several degrees towards the image edges.
+#
+# UndistortPreprocessor builds everything once at start-up, per model input size (and once more per
+# frame resolution that differs from the calibrated one, with the calibration rescaled to it):
+#   - a fixed point remap table (CV_16SC2 + CV_16UC1) that undistorts, scales and letterboxes the
+#     decoded frame straight into the square model input, so undistortion costs no extra full-frame pass
+#   - a lookup table that maps every pixel of the model input to (pan, tilt) angles in degrees
+#     relative to the optical axis, using the ideal pinhole model of the undistorted image
+#
+# Calibration file (OpenCV FileStorage YAML) is created by running this script on chessboard images:
+#   python camera_calibration.py --images "calib/*.jpg" --board 9x6 --square 25 --output camera_calibration.yml
+
+LETTERBOX_COLOR = (114, 114, 114)  # same padding value as the ultralytics letterbox
+
+
+class CameraCalibration:
+    def __init__(self, camera_matrix, dist_coeffs, image_size):
+        self.camera_matrix = np.asarray(camera_matrix, dtype=np.float64)
+        self.dist_coeffs = np.asarray(dist_coeffs, dtype=np.float64).reshape(-1, 1)
+        self.image_size = tuple(int(v) for v in image_size)  # (width, height)
+
+    @classmethod
+    def load(cls, path):
+        fs = cv2.FileStorage(str(path), cv2.FILE_STORAGE_READ)
+        if not fs.isOpened():
+            raise FileNotFoundError(f"Unable to open calibration file {path}")
+        try:
+            camera_matrix = fs.getNode("camera_matrix").mat()
+            dist_coeffs = fs.getNode("distortion_coefficients").mat()
+            image_size = (int(fs.getNode("image_width").real()), int(fs.getNode("image_height").real()))
+        finally:
+            fs.release()
+        if camera_matrix is None or dist_coeffs is None:
+            raise ValueError(f"Calibration file {path} is missing camera_matrix or distortion_coefficients")
+        return cls(camera_matrix, dist_coeffs, image_size)
+
+    def save(self, path):
+        fs = cv2.FileStorage(str(path), cv2.FILE_STORAGE_WRITE)
+        fs.write("image_width", self.image_size[0])
+        fs.write("image_height", self.image_size[1])
+        fs.write("camera_matrix", self.camera_matrix)
+        fs.write("distortion_coefficients", self.dist_coeffs)
+        fs.release()
+
+    def scaled(self, image_size):
+        """
+        The same calibration for frames of another resolution of the same sensor mode. A different aspect ratio
+        means a different crop of the sensor, the calibration does not apply to it.
+        """
+        w, h = image_size
+        sx, sy = w / self.image_size[0], h / self.image_size[1]
+        if abs(sx / sy - 1.0) > 0.01:
+            raise ValueError(f"Frame size {w}x{h} does not match the aspect ratio of the calibration "
+                             f"({self.image_size[0]}x{self.image_size[1]}), recalibrate for this camera mode")
+        camera_matrix = self.camera_matrix.copy()
+        camera_matrix[0, :] *= sx
+        camera_matrix[1, :] *= sy
+        return CameraCalibration(camera_matrix, self.dist_coeffs, image_size)
+
+
+class UndistortPreprocessor:
+    def __init__(self, calibration, input_sizes):
+        self.input_sizes = sorted(set(input_sizes))
+        # Tables per frame size, frames of another resolution than the calibration get their own (see __call__)
+        self.tables_by_frame = {calibration.image_size: (calibration, self._build(calibration))}
+        self.calibration, self.tables = self.tables_by_frame[calibration.image_size]
+        logger.info(f"Undistortion tables built for input sizes {self.input_sizes}")
+
+    def _build(self, calibration):
+        tables = {}
+
+        # Undistorted virtual camera that keeps only valid pixels (alpha=0)
+        w, h = calibration.image_size
+        ideal_matrix, _ = cv2.getOptimalNewCameraMatrix(calibration.camera_matrix, calibration.dist_coeffs, (w, h), 0)
+
+        for size in self.input_sizes:
+            # Scale the virtual camera into the square input and center it (letterbox)
+            scale = size / max(w, h)
+            pad_x = (size - w * scale) / 2
+            pad_y = (size - h * scale) / 2
+            matrix = ideal_matrix.copy()
+            matrix[0, 0] *= scale
+            matrix[1, 1] *= scale
+            matrix[0, 2] = matrix[0, 2] * scale + pad_x
+            matrix[1, 2] = matrix[1, 2] * scale + pad_y
+
+            map1, map2 = cv2.initUndistortRectifyMap(
+                calibration.camera_matrix, calibration.dist_coeffs, None, matrix, (size, size), cv2.CV_16SC2)
+
+            # Pan / tilt of the ray through every pixel of the undistorted input
+            u = (np.arange(size, dtype=np.float32) - matrix[0, 2]) / matrix[0, 0]
+            v = (np.arange(size, dtype=np.float32) - matrix[1, 2]) / matrix[1, 1]
+            x_n, y_n = np.meshgrid(u, v)
+            pan = np.degrees(np.arctan(x_n))
+            tilt = np.degrees(np.arctan2(-y_n, np.sqrt(1.0 + x_n * x_n)))
+            angles = np.dstack((pan, tilt)).astype(np.float32)
+
+            tables[size] = (map1, map2, matrix, AngleLut(angles))
+        return tables
+
+    def _select_frame_size(self, frame_size):
+        """Switch to the tables of another frame resolution, rescaling the calibration once per resolution"""
+        if frame_size not in self.tables_by_frame:
+            base = next(iter(self.tables_by_frame.values()))[0]
+            calibration = base.scaled(frame_size)
+            logger.warning(f"Frame size {frame_size[0]}x{frame_size[1]} differs from the calibration "
+                           f"({base.image_size[0]}x{base.image_size[1]}), using the rescaled calibration")
+            self.tables_by_frame[frame_size] = (calibration, self._build(calibration))
+        self.calibration, self.tables = self.tables_by_frame[frame_size]
+
+    def __call__(self, frame, size):
+        """
+        Undistort + resize + letterbox the frame into the square model input in a single remap pass.
+        A frame of another resolution than the calibration switches all tables (angle lookup, to_frame) to the
+        rescaled calibration, a frame of another aspect ratio raises ValueError.
+        """
+        h, w = frame.shape[:2]
+        if (w, h) != self.calibration.image_size:
+            self._select_frame_size((w, h))
+        map1, map2, _, _ = self.tables[size]
+        return cv2.remap(frame, map1, map2, cv2.INTER_LINEAR, borderMode=cv2.BORDER_CONSTANT, borderValue=LETTERBOX_COLOR)
+
+    def center(self, size):
+        """Pixel of the optical axis in the model input"""
+        matrix = self.tables[size][2]
+        return int(round(matrix[0, 2])), int(round(matrix[1, 2]))
+
+    def angle_lut(self, size):
+        """Pixel -> angle lookup table of the given input size"""
+        return self.tables[size][3]
+
+    def to_frame(self, size, points):
+        """Map model input pixels back to pixels of the distorted camera frame (e.g. for the web overlay)"""
+        matrix = self.tables[size][2]
+        points = np.asarray(points, dtype=np.float64).reshape(-1, 2)
+        rays = np.column_stack(((points[:, 0] - matrix[0, 2]) / matrix[0, 0],
+                                (points[:, 1] - matrix[1, 2]) / matrix[1, 1],
+                                np.ones(len(points))))
+        projected, _ = cv2.projectPoints(rays, np.zeros(3), np.zeros(3),
+                                         self.calibration.camera_matrix, self.calibration.dist_coeffs)
+        return projected.reshape(-1, 2)
+
+
+class AngleLut:
+    def __init__(self, angles):
+        self.angles = angles
+        self.max_y = angles.shape[0] - 1
+        self.max_x = angles.shape[1] - 1
+
+    def __call__(self, x_pixel, y_pixel):
+        """Camera relative (horizontal, vertical) angle in degrees, right and up are positive"""
+        x = min(max(int(x_pixel), 0), self.max_x)
+        y = min(max(int(y_pixel), 0), self.max_y)
+        pan, tilt = self.angles[y, x]
+        return float(pan), float(tilt)
+
+
+# ************************************** CALIBRATION **************************************
+
+def calibrate(image_paths, board, square_mm):
+    cols, rows = board
+    object_grid = np.zeros((rows * cols, 3), np.float32)
+    object_grid[:, :2] = np.mgrid[0:cols, 0:rows].T.reshape(-1, 2) * square_mm
+
+    object_points, image_points = [], []
+    image_size = None
+    criteria = (cv2.TERM_CRITERIA_EPS + cv2.TERM_CRITERIA_MAX_ITER, 30, 0.001)
+
+    for path in image_paths:
+        gray = cv2.imread(path, cv2.IMREAD_GRAYSCALE)
+        if gray is None:
+            logger.warning(f"Unable to read {path}")
+            continue
+        image_size = gray.shape[::-1]
+        found, corners = cv2.findChessboardCorners(gray, (cols, rows), None)
+        if not found:
+            logger.warning(f"No chessboard found in {path}")
+            continue
+        object_points.append(object_grid)
+        image_points.append(cv2.cornerSubPix(gray, corners, (11, 11), (-1, -1), criteria))
+
+    if len(object_points) < 5:
+        raise RuntimeError(f"Only {len(object_points)} usable images, at least 5 are needed")
+
+    rms, camera_matrix, dist_coeffs, _, _ = cv2.calibrateCamera(object_points, image_points, image_size, None, None)
+    logger.info(f"Calibrated with {len(object_points)} images, RMS reprojection error {rms:.3f} px")
+
+    fov_h = 2 * math.degrees(math.atan(image_size[0] / (2 * camera_matrix[0, 0])))
+    fov_v = 2 * math.degrees(math.atan(image_size[1] / (2 * camera_matrix[1, 1])))
+    logger.info(f"Pinhole FOV: horizontal {fov_h:.1f}°, vertical {fov_v:.1f}°")
+
+    return CameraCalibration(camera_matrix, dist_coeffs, image_size)
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Calibrate the camera from chessboard images.")
+    parser.add_argument("--images", required=True, help="Glob pattern of the calibration images")
+    parser.add_argument("--board", default="9x6", help="Inner corners of the chessboard, COLSxROWS")
+    parser.add_argument("--square", type=float, default=25.0, help="Size of a chessboard square in mm")
+    parser.add_argument("--output", default="camera_calibration.yml", help="Output calibration file")
+    args = parser.parse_args()
+
+    board = tuple(int(v) for v in args.board.lower().split("x"))
+    calibration = calibrate(sorted(glob.glob(args.images)), board, args.square)
+    calibration.save(args.output)
+    logger.info(f"Calibration written to {args.output}")
@@ -0,0 +1,157 @@
+import time
+
+import cv2
+import numpy as np
+
+
+# ************************************** SOURCES  **************************************
+# MOG2 background subtraction: https://docs.opencv.org/4.x/d1/dc5/tutorial_background_subtraction.html
+# Connected components: https://docs.opencv.org/4.x/d3/dc0/group__imgproc__shape.html#ga107a78bf7cd25dec05fb4dfc5c9e765f
+
+# ************************************** DOCUMENTATION **************************************
+# Two-stage cascade in front of the YOLO model. The glider moves against a mostly static indoor
+# background, so a cheap first stage proposes candidate regions and YOLO only runs on crops of those:
+#
+#   stage 1  grayscale + INTER_AREA downsample (1/4 per axis -> 1/16 of the pixels), MOG2 background
+#            subtraction, morphological opening and connected components. All of these are vectorized
+#            (SSE/AVX/NEON) inside OpenCV, stage 1 costs ~1 ms on the lab PC and a few ms on the Pi 5.
+#   stage 2  YOLO on a square crop around each candidate (plus the target: the box the tracker predicts for the
+#            locked track or else the most confident last detection, a hovering glider is absorbed into the
+#            background after a while) at the small crop input size.
+#            Frames without any candidate skip inference entirely.
+#
+# A full-frame pass runs
+#   - every `full_frame_interval` inferred frames as a safety net for missed candidates
+#   - while the background model is not initialized yet
+#   - when stage 1 returns more than `max_candidates` regions (lighting change, people walking by)
+#     or a region larger than a crop
+#   - for `settle_frames` frames after the turret moved, because a moving camera invalidates the
+#     background. Unless a target is being followed: then only the crop around its predicted box is
+#     searched, the turret moves on almost every frame while it follows. Afterwards the background
+#     model is re-learned from scratch
+#
+# Detections are Nx6 arrays (x1, y1, x2, y2, conf, class) in frame pixels, see receiver_inference.detect.
+
+
+class CascadeDetector:
+    def __init__(self, downscale=4, crop_size=320, full_frame_interval=15, max_candidates=3, min_area=4,
+                 settle_frames=10, history=300, var_threshold=25):
+        self.downscale = downscale
+        self.crop_size = crop_size
+        self.full_frame_interval = full_frame_interval
+        self.max_candidates = max_candidates
+        self.min_area = min_area  # in downsampled pixels
+        self.settle_frames = settle_frames
+
+        self.background = cv2.createBackgroundSubtractorMOG2(history=history, varThreshold=var_threshold, detectShadows=False)
+        self.kernel = cv2.getStructuringElement(cv2.MORPH_ELLIPSE, (3, 3))
+        self.small = None
+        self.gray = None
+
+        self.frames_since_full = full_frame_interval
+        self.frames_since_motion = settle_frames
+        self.relearn = True
+        self.last_box = None
+
+        # Statistics: how many inferred frames ran full-frame / on crops / not at all
+        self.counts = {"full": 0, "crops": 0, "skipped": 0}
+
+    def camera_moved(self):
+        """Call whenever a new turret command was sent, the background is invalid until the camera settled"""
+        self.frames_since_motion = 0
+        self.relearn = True
+
+    def candidates(self, frame):
+        """Candidate regions (x1, y1, x2, y2) in frame pixels from background subtraction"""
+        h, w = frame.shape[:2]
+        size = (w // self.downscale, h // self.downscale)
+        self.small = cv2.resize(frame, size, dst=self.small, interpolation=cv2.INTER_AREA)
+        self.gray = cv2.cvtColor(self.small, cv2.COLOR_BGR2GRAY, dst=self.gray)
+
+        # Learning rate 1 re-initializes the model from this frame
+        mask = self.background.apply(self.gray, learningRate=1.0 if self.relearn else -1)
+        self.relearn = False
+        mask = cv2.morphologyEx(mask, cv2.MORPH_OPEN, self.kernel)
+        mask = cv2.dilate(mask, self.kernel, iterations=2)
+
+        count, _, stats, _ = cv2.connectedComponentsWithStats(mask, connectivity=8)
+        blobs = [stats[i] for i in range(1, count) if stats[i, cv2.CC_STAT_AREA] >= self.min_area]
+        blobs.sort(key=lambda s: s[cv2.CC_STAT_AREA], reverse=True)
+
+        s = self.downscale
+        return [(x * s, y * s, (x + bw) * s, (y + bh) * s) for x, y, bw, bh, _ in blobs]
+
+    def __call__(self, frame, detect, imgsz, force_full=False, predicted_box=None):
+        """
+        Run the cascade on one frame.
+
+        detect: callable(image, imgsz) -> (Nx6 detections in image pixels, stage times in ms)
+        imgsz:  model input size of the full-frame pass
+        predicted_box: (x1, y1, x2, y2) where the tracker expects the target in this frame, None without a target
+        Returns detections in frame pixels, the summed stage times and the mode ("full", "crops", "skipped").
+        """
+        t0 = time.perf_counter()
+        regions = self.candidates(frame)
+        speed = {"candidates": (time.perf_counter() - t0) * 1000}
+
+        settling = self.frames_since_motion < self.settle_frames
+        self.frames_since_motion += 1
+        if settling:
+            # Keep re-learning until the camera stands still, the foreground mask is meaningless meanwhile.
+            # A target that is being followed is still found in the crop around its predicted position.
+            self.relearn = True
+            regions = []
+
+        # Regions larger than a crop (glider close to the camera) need the full frame as well
+        too_large = any(x2 - x1 > self.crop_size or y2 - y1 > self.crop_size for x1, y1, x2, y2 in regions)
+        target_box = predicted_box if predicted_box is not None else self.last_box
+        full = (force_full or (settling and target_box is None) or too_large or self.frames_since_full >= self.full_frame_interval
+                or len(regions) > self.max_candidates)
+
+        if full:
+            self.frames_since_full = 0
+            detections, stage = detect(frame, imgsz)
+            speed.update(stage)
+            mode = "full"
+        else:
+            self.frames_since_full += 1
+            if target_box is not None:
+                regions.append(target_box)
+
+            results = []
+            for x0, y0 in self._crop_origins(frame.shape, regions):
+                crop = frame[y0:y0 + self.crop_size, x0:x0 + self.crop_size]
+                found, stage = detect(crop, self.crop_size)
+                for key, value in stage.items():
+                    speed[key] = speed.get(key, 0.0) + value
+                if len(found):
+                    found = found.copy()
+                    found[:, [0, 2]] += x0
+                    found[:, [1, 3]] += y0
+                    results.append(found)
+
+            detections = np.concatenate(results) if results else np.zeros((0, 6), dtype=np.float32)
+            mode = "crops" if regions else "skipped"
+
+        if len(detections) > 1 and mode != "full":
+            # The same target can show up in overlapping crops
+            boxes = np.column_stack((detections[:, :2], detections[:, 2:4] - detections[:, :2]))
+            keep = np.asarray(cv2.dnn.NMSBoxes(boxes.tolist(), detections[:, 4].tolist(), 0.0, 0.5), dtype=np.int64).reshape(-1)
+            detections = detections[keep]
+        self.last_box = tuple(detections[np.argmax(detections[:, 4]), :4]) if len(detections) else None
+
+        self.counts[mode] += 1
+        return detections, speed, mode
+
+    def _crop_origins(self, shape, regions):
+        """Top left corners of the crops, one per region, shifted inside the frame; duplicates removed"""
+        h, w = shape[:2]
+        half = self.crop_size // 2
+        origins = []
+        for x1, y1, x2, y2 in regions:
+            cx, cy = int((x1 + x2) / 2), int((y1 + y2) / 2)
+            x0 = min(max(cx - half, 0), max(w - self.crop_size, 0))
+            y0 = min(max(cy - half, 0), max(h - self.crop_size, 0))
+            if all(abs(x0 - ox) > half or abs(y0 - oy) > half for ox, oy in origins):
+                origins.append((x0, y0))
+        return origins
@@ -0,0 +1,150 @@
+import queue
+import threading
+import time
+from datetime import datetime
+from pathlib import Path
+
+import cv2
+from loguru import logger
+
+
+# ************************************** DOCUMENTATION **************************************
+# Collects hard examples (misses and low-confidence hits) for retraining with ai_setup/model_train.py
+# without stalling the inference loop:
+#   - submit() never blocks: frames are dropped when the rate limit, the disk quota or the bounded
+#     queue would be exceeded
+#   - JPEG/PNG encoding and file writes run on a pool of background threads
+#
+# The recordings are candidates, not training data: misses have no labels at all and the boxes of
+# low-confidence hits are the model's own guesses. Every frame has to be reviewed and labeled before it
+# goes into ai_setup/create_dataset_structure.py, which skips images without a label file.
+#
+# Output directory layout:
+#   <name>.jpg|png          recorded frame, no label file next to it until it is reviewed
+#   prelabels/<name>.txt    pre-labels of a low-confidence hit in YOLO format ("class cx cy w h" per box,
+#                           normalized), to be corrected and moved next to the image. Misses have none.
+#   to_label.txt            frames waiting for review (one image path per line)
+#   reasons.csv             image, reason, timestamp, max confidence
+
+class DatasetRecorder:
+    def __init__(self, output_dir, image_format="jpg", max_rate_hz=2.0, burst=5, max_disk_mb=2048,
+                 queue_size=8, workers=2, jpeg_quality=95):
+        if image_format not in ("jpg", "png"):
+            raise ValueError(f"Unsupported image format {image_format}")
+
+        self.output_dir = Path(output_dir)
+        self.prelabel_dir = self.output_dir / "prelabels"
+        self.prelabel_dir.mkdir(parents=True, exist_ok=True)
+        self.image_format = image_format
+        self.encode_params = [cv2.IMWRITE_JPEG_QUALITY, jpeg_quality] if image_format == "jpg" else [cv2.IMWRITE_PNG_COMPRESSION, 1]
+
+        # Token bucket rate limit
+        self.max_rate_hz = max_rate_hz
+        self.burst = burst
+        self.tokens = float(burst)
+        self.last_refill = time.monotonic()
+
+        # Disk quota, existing recordings count against it
+        self.max_disk_bytes = int(max_disk_mb * 1024 * 1024)
+        self.disk_bytes = sum(f.stat().st_size for f in self.output_dir.rglob("*") if f.is_file())
+
+        self.queue = queue.Queue(maxsize=queue_size)
+        self.index_lock = threading.Lock()
+        self.sequence = 0
+
+        # Statistics
+        self.recorded = 0
+        self.dropped_rate = 0
+        self.dropped_queue = 0
+        self.dropped_quota = 0
+
+        self.workers = [threading.Thread(target=self._worker, name=f"recorder_{i}", daemon=True) for i in range(workers)]
+        for worker in self.workers:
+            worker.start()
+
+        logger.info(f"Dataset recorder writing to {self.output_dir} ({self.disk_bytes / 1e6:.1f} MB already used)")
+
+    def submit(self, frame, boxes, reason):
+        """
+        Queue a frame for recording. Never blocks.
+
+        frame: BGR image, copied only if it is accepted
+        boxes: iterable of (class, cx, cy, w, h, conf) with normalized coordinates, written as pre-labels,
+               empty for a miss
+        reason: short tag written to reasons.csv, e.g. "miss" or "low_confidence"
+        Returns True if the frame was accepted.
+        """
+        if self.disk_bytes >= self.max_disk_bytes:
+            self.dropped_quota += 1
+            return False
+
+        now = time.monotonic()
+        self.tokens = min(self.burst, self.tokens + (now - self.last_refill) * self.max_rate_hz)
+        self.last_refill = now
+        if self.tokens < 1.0:
+            self.dropped_rate += 1
+            return False
+
+        if self.queue.full():
+            self.dropped_queue += 1
+            return False
+
+        self.tokens -= 1.0
+        self.sequence += 1
+        name = f"{datetime.now():%Y%m%d_%H%M%S}_{self.sequence:06d}_{reason}"
+        try:
+            self.queue.put_nowait((name, frame.copy(), list(boxes), reason, time.time()))
+        except queue.Full:
+            self.dropped_queue += 1
+            return False
+        return True
+
+    def close(self, timeout=5.0):
+        """Write out everything still queued and stop the workers"""
+        for _ in self.workers:
+            self.queue.put((None, None, None, None, None))
+        for worker in self.workers:
+            worker.join(timeout)
+        logger.info(f"Dataset recorder closed: {self.stats()}")
+
+    def stats(self):
+        return {
+            "recorded": self.recorded,
+            "queued": self.queue.qsize(),
+            "dropped_rate": self.dropped_rate,
+            "dropped_queue": self.dropped_queue,
+            "dropped_quota": self.dropped_quota,
+            "disk_mb": round(self.disk_bytes / 1e6, 1),
+        }
+
+    def _worker(self):
+        while True:
+            name, frame, boxes, reason, timestamp = self.queue.get()
+            if name is None:
+                break
+            try:
+                self._write(name, frame, boxes, reason, timestamp)
+            except Exception as e:
+                logger.error(f"Dataset recorder failed to write {name}: {e}")
+
+    def _write(self, name, frame, boxes, reason, timestamp):
+        ok, encoded = cv2.imencode(f".{self.image_format}", frame, self.encode_params)
+        if not ok:
+            logger.error(f"Dataset recorder failed to encode {name}")
+            return
+
+        image_path = self.output_dir / f"{name}.{self.image_format}"
+        labels = "".join(f"{int(c)} {cx:.6f} {cy:.6f} {w:.6f} {h:.6f}\n" for c, cx, cy, w, h, _ in boxes)
+        max_conf = max((conf for *_, conf in boxes), default=0.0)
+
+        image_path.write_bytes(encoded.tobytes())
+        if labels:
+            (self.prelabel_dir / f"{name}.txt").write_text(labels)
+
+        with self.index_lock:
+            with open(self.output_dir / "to_label.txt", "a") as to_label:
+                to_label.write(f"{image_path.resolve()}\n")
+            with open(self.output_dir / "reasons.csv", "a") as reasons:
+                reasons.write(f"{image_path.name},{reason},{timestamp:.3f},{max_conf:.3f}\n")
+            self.disk_bytes += len(encoded) + len(labels)
+            self.recorded += 1
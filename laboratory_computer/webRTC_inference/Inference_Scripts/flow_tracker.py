@@ -0,0 +1,110 @@
+import cv2
+import numpy as np
+
+
+# ************************************** SOURCES  **************************************
+# Lucas-Kanade optical flow: https://docs.opencv.org/4.x/d4/dee/tutorial_optical_flow.html
+# Forward-backward error: Kalal et al., "Forward-Backward Error: Automatic Detection of Tracking Failures", ICPR 2010
+
+# ************************************** DOCUMENTATION **************************************
+# Follows the target between detector runs with sparse pyramidal Lucas-Kanade optical flow:
+#   - reset(): picks Shi-Tomasi corners inside the (slightly shrunk) detection box
+#   - update(): tracks them into the next frame, checks every point by tracking it back again
+#     (forward-backward error) and moves / scales the box by the median point motion
+# The median makes the estimate robust against points on the background that slipped into the box.
+# When too few points survive the tracker reports the target as lost, the next detection re-anchors it.
+#
+# Cost is a small fraction of an inference (~0.5-2 ms for 30 points, depending on the frame size), so the
+# turret setpoint stream gets camera-rate target positions even when detection runs at a few FPS.
+
+
+class FlowTracker:
+    def __init__(self, max_corners=30, window=21, levels=3, fb_threshold=1.0, min_points=5, max_lost_frames=30):
+        self.max_corners = max_corners
+        self.lk_params = dict(winSize=(window, window), maxLevel=levels,
+                              criteria=(cv2.TERM_CRITERIA_EPS | cv2.TERM_CRITERIA_COUNT, 20, 0.03))
+        self.fb_threshold = fb_threshold
+        self.min_points = min_points
+        self.max_lost_frames = max_lost_frames  # give up after this many frames without a fresh detection
+
+        self.prev_gray = None
+        self.points = None
+        self.box = None
+        self.frames_since_detection = 0
+
+    @property
+    def active(self):
+        return self.box is not None
+
+    def reset(self, gray, box):
+        """Re-anchor on a fresh detection box (x1, y1, x2, y2); box None stops tracking"""
+        self.prev_gray = gray
+        self.box = None
+        self.points = None
+        self.frames_since_detection = 0
+        if box is None:
+            return
+
+        points = self._features(gray, box)
+        if points is not None and len(points) >= self.min_points:
+            self.box = tuple(float(v) for v in box)
+            self.points = points
+
+    def update(self, gray):
+        """Track into the next frame. Returns the estimated box (x1, y1, x2, y2) or None if the target was lost."""
+        if self.box is None or gray.shape != self.prev_gray.shape:
+            # Nothing to track, or the input size changed (governor switch)
+            self.reset(gray, None)
+            return None
+
+        self.frames_since_detection += 1
+        forward, status_f, _ = cv2.calcOpticalFlowPyrLK(self.prev_gray, gray, self.points, None, **self.lk_params)
+        backward, status_b, _ = cv2.calcOpticalFlowPyrLK(gray, self.prev_gray, forward, None, **self.lk_params)
+        self.prev_gray = gray
+
+        fb_error = np.linalg.norm((self.points - backward).reshape(-1, 2), axis=1)
+        good = (status_f.ravel() == 1) & (status_b.ravel() == 1) & (fb_error < self.fb_threshold)
+        if good.sum() < self.min_points or self.frames_since_detection > self.max_lost_frames:
+            self.box = None
+            self.points = None
+            return None
+
+        old = self.points.reshape(-1, 2)[good]
+        new = forward.reshape(-1, 2)[good]
+        dx, dy = np.median(new - old, axis=0)
+
+        # Scale change from the median ratio of pairwise point distances (target approaching / receding)
+        i, j = np.triu_indices(len(old), k=1)
+        old_dist = np.linalg.norm(old[i] - old[j], axis=1)
+        new_dist = np.linalg.norm(new[i] - new[j], axis=1)
+        valid = old_dist > 1e-3
+        scale = float(np.median(new_dist[valid] / old_dist[valid])) if valid.any() else 1.0
+
+        x1, y1, x2, y2 = self.box
+        cx, cy = (x1 + x2) / 2 + dx, (y1 + y2) / 2 + dy
+        half_w, half_h = (x2 - x1) * scale / 2, (y2 - y1) * scale / 2
+        self.box = (cx - half_w, cy - half_h, cx + half_w, cy + half_h)
+        self.points = new.reshape(-1, 1, 2)
+
+        # Top up the feature set when too many points were dropped
+        if len(self.points) < self.max_corners // 2:
+            points = self._features(gray, self.box)
+            if points is not None and len(points) > len(self.points):
+                self.points = points
+
+        return self.box
+
+    def _features(self, gray, box):
+        h, w = gray.shape[:2]
+        x1, y1, x2, y2 = box
+        # Shrink by 10 % per side, the border of a detection box is mostly background
+        mx, my = (x2 - x1) * 0.1, (y2 - y1) * 0.1
+        x1, y1 = int(max(x1 + mx, 0)), int(max(y1 + my, 0))
+        x2, y2 = int(min(x2 - mx, w)), int(min(y2 - my, h))
+        if x2 - x1 < 3 or y2 - y1 < 3:
+            return None
+
+        mask = np.zeros(gray.shape[:2], dtype=np.uint8)
+        mask[y1:y2, x1:x2] = 255
+        points = cv2.goodFeaturesToTrack(gray, self.max_corners, qualityLevel=0.01, minDistance=3, mask=mask)
+        return None if points is None else points.astype(np.float32)
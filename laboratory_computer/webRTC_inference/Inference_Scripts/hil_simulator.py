@@ -0,0 +1,360 @@
+import argparse
+import asyncio
+import math
+import threading
+import time
+from collections import deque
+
+import cv2
+import numpy as np
+import paho.mqtt.client as mqtt
+
+import receiver_inference as receiver
+from turret_protocol import ProtocolError, decode_command_payload, esp_degrees
+from world_tracker import TurretModel
+
+
+# ************************************** DOCUMENTATION **************************************
+# Hardware-in-the-loop style simulator of the complete aiming chain on Linux, without the vehicle:
+#
+#   synthetic camera  renders a glider flying a scripted trajectory (world pan / tilt angles) into 1280x1080
+#                     frames as seen from the moving turret (linear FOV model of ServoTracker, textured panorama
+#                     as background so optical flow and background subtraction see camera motion)
+#   receiver          the unmodified run_track() loop of receiver_inference.py: governor, detector, SORT,
+#                     flow, world filter, visual servo controller, publishes vehicle/turret/cmd
+#   MQTT              a local broker (mosquitto -c ../../mosquitto/mosquitto.conf), the simulator subscribes to
+#                     vehicle/turret/cmd like the ESP
+#   ESP turret logic  vehicle-control.c: the turret task runs at the DS4 input rate (60 Hz) and takes one command
+#                     per iteration from a 5-entry queue (new commands are dropped when it is full),
+#                     stop angles x -90..90, y 0..80, x is mirrored (the receiver publishes -pan)
+#   servos            MG996R ~200 ms per 60 deg (300 deg/s), PWM update after half a 50 Hz period on average
+#
+# The detector is either the real model of the governor ladder (optionally with --sprite, a cut-out glider
+# image with alpha channel, the drawn silhouette is not what the model was trained on) or --oracle: the
+# ground-truth box with pixel noise, misses and a fixed inference time, which isolates the rest of the chain.
+#
+# Report:
+#   hit rate          share of frames in which the boresight was within the target's angular radius
+#   aim error         angle between boresight and target at capture time
+#   track rate        share of frames after which the receiver had a target
+#   latency           capture -> command received at the "ESP" (receiver + MQTT),
+#                     command received -> applied (ESP queue / loop), capture -> servo starts moving
+#
+#   python hil_simulator.py --oracle --scenario circle --duration 30
+#   python hil_simulator.py --sprite glider.png --scenario pass --csv run.csv
+
+WIDTH, HEIGHT = 1280, 1080
+CMD_TOPIC = "vehicle/turret/cmd"
+
+
+def circle(t):
+    """Glider circling in front of the vehicle, distance changes with the loop"""
+    phase = 2 * math.pi * t / 8.0
+    return 25.0 * math.sin(phase), 50.0 + 8.0 * math.sin(2 * phase), 6.0 + 2.0 * math.cos(phase)
+
+
+def fly_by(t):
+    """Straight passes from left to right at 12 deg/s"""
+    pan = -40.0 + (t * 12.0) % 80.0
+    return pan, 55.0 - 0.1 * pan, 5.0
+
+
+def dart(t):
+    """Sudden position changes every 2.5 s (step responses)"""
+    rng = np.random.default_rng(int(t / 2.5))
+    return float(rng.uniform(-30, 30)), float(rng.uniform(40, 65)), 6.0
+
+
+SCENARIOS = {"circle": circle, "pass": fly_by, "dart": dart}
+
+
+class Renderer:
+    def __init__(self, hfov=60.3, vfov=50.9, sprite=None, seed=1):
+        self.dpp_h = hfov / WIDTH
+        self.dpp_v = vfov / HEIGHT
+        self.hfov, self.vfov = hfov, vfov
+
+        # Panorama covering the whole turret range plus half a field of view
+        self.pan_min, self.tilt_max = -90.0 - hfov, 80.0 + vfov
+        pano_w = int((180.0 + 2 * hfov) / self.dpp_h)
+        pano_h = int((80.0 + 2 * vfov) / self.dpp_v)
+        rng = np.random.default_rng(seed)
+        noise = rng.integers(0, 255, (pano_h // 48, pano_w // 48), dtype=np.uint8)
+        texture = cv2.cvtColor(cv2.resize(noise, (pano_w, pano_h), interpolation=cv2.INTER_CUBIC), cv2.COLOR_GRAY2BGR)
+        gradient = np.ascontiguousarray(np.broadcast_to(np.linspace(190, 90, pano_h, dtype=np.uint8)[:, None, None], texture.shape))
+        self.panorama = cv2.addWeighted(texture, 0.3, gradient, 0.7, 0)
+
+        self.sprite = None
+        if sprite:
+            self.sprite = cv2.imread(sprite, cv2.IMREAD_UNCHANGED)
+            if self.sprite is None or self.sprite.shape[2] != 4:
+                raise SystemExit(f"{sprite} must be an image with alpha channel")
+
+    def render(self, turret, target):
+        """Frame seen from turret (pan, tilt) and the ground-truth box of target (pan, tilt, wingspan) or None"""
+        x0 = int(round((turret[0] - self.hfov / 2 - self.pan_min) / self.dpp_h))
+        y0 = int(round((self.tilt_max - turret[1] - self.vfov / 2) / self.dpp_v))
+        frame = self.panorama[y0:y0 + HEIGHT, x0:x0 + WIDTH].copy()
+
+        cx = WIDTH / 2 + (target[0] - turret[0]) / self.dpp_h
+        cy = HEIGHT / 2 - (target[1] - turret[1]) / self.dpp_v
+        span = target[2] / self.dpp_h
+        box = self._draw_sprite(frame, cx, cy, span) if self.sprite is not None else self._draw_glider(frame, cx, cy, span)
+
+        x1, y1, x2, y2 = max(box[0], 0), max(box[1], 0), min(box[2], WIDTH), min(box[3], HEIGHT)
+        visible = x2 - x1 > 4 and y2 - y1 > 4
+        return frame, (x1, y1, x2, y2) if visible else None
+
+    def _draw_glider(self, frame, cx, cy, span):
+        # Top view silhouette: wings, fuselage, tail (relative to the wingspan)
+        wing = np.array([[-0.5, 0.0], [0.5, 0.0], [0.45, 0.08], [-0.45, 0.08]])
+        fuselage = np.array([[-0.03, -0.25], [0.03, -0.25], [0.02, 0.55], [-0.02, 0.55]])
+        tail = np.array([[-0.15, 0.5], [0.15, 0.5], [0.13, 0.56], [-0.13, 0.56]])
+        points = []
+        for shape, color in ((wing, (245, 245, 245)), (fuselage, (40, 40, 200)), (tail, (245, 245, 245))):
+            poly = np.round(shape * span + (cx, cy)).astype(np.int32)
+            cv2.fillPoly(frame, [poly], color, lineType=cv2.LINE_AA)
+            points.append(poly)
+        points = np.concatenate(points)
+        return (*points.min(axis=0), *points.max(axis=0))
+
+    def _draw_sprite(self, frame, cx, cy, span):
+        scale = span / self.sprite.shape[1]
+        w, h = max(1, int(self.sprite.shape[1] * scale)), max(1, int(self.sprite.shape[0] * scale))
+        sprite = cv2.resize(self.sprite, (w, h), interpolation=cv2.INTER_AREA)
+        x1, y1 = int(cx - w / 2), int(cy - h / 2)
+
+        # Paste the visible part, alpha blended
+        fx1, fy1, fx2, fy2 = max(x1, 0), max(y1, 0), min(x1 + w, WIDTH), min(y1 + h, HEIGHT)
+        if fx2 > fx1 and fy2 > fy1:
+            part = sprite[fy1 - y1:fy2 - y1, fx1 - x1:fx2 - x1]
+            alpha = part[:, :, 3:4].astype(np.float32) / 255
+            region = frame[fy1:fy2, fx1:fx2]
+            region[:] = (alpha * part[:, :, :3] + (1 - alpha) * region).astype(np.uint8)
+        return x1, y1, x1 + w, y1 + h
+
+
+class EspTurret:
+    """Turret task of vehicle-control.c and the platform servos"""
+    def __init__(self, loop_hz=60.0, queue_size=5, pwm_delay_s=0.01, rate_deg_s=300.0):
+        self.model = TurretModel(start=(0.0, 48.0), rate_deg_s=(rate_deg_s, rate_deg_s), dead_time_s=pwm_delay_s, horizon_s=5.0)
+        self.loop_s = 1.0 / loop_hz
+        self.queue_size = queue_size
+        self.queue = deque()
+        self.lock = threading.Lock()
+        self.next_tick = None
+
+        self.dropped = 0
+        self.invalid = 0
+        self.applied = []   # (capture, arrival, applied) of every command
+
+    def receive(self, capture, arrival, payload):
+        """MQTT callback thread, capture is the capture time of the frame the command was computed from"""
+        try:
+            command = decode_command_payload(payload)
+        except ProtocolError:
+            self.invalid += 1
+            return
+        self._advance(arrival)
+        with self.lock:
+            if len(self.queue) >= self.queue_size:
+                self.dropped += 1
+                return
+            self.queue.append((capture, arrival, esp_degrees(command.x_deg), esp_degrees(command.y_deg)))
+
+    def angle_at(self, t):
+        """Actual turret (pan, tilt) in receiver coordinates"""
+        self._advance(t)
+        with self.lock:
+            return self.model.angle_at(t)
+
+    def _advance(self, t):
+        """Run the turret task up to time t (frames are rendered for past capture times, the history is kept)"""
+        with self.lock:
+            if self.next_tick is None:
+                self.next_tick = t
+                self.model.reset(t, 0.0, 48.0)
+            while self.next_tick <= t:
+                if self.queue and self.queue[0][1] <= self.next_tick:
+                    capture, arrival, x, y = self.queue.popleft()
+                    # Stop angles of main.c, x is mirrored by the receiver
+                    pan, tilt = -max(-90, min(90, x)), max(0, min(80, y))
+                    self.model.command(self.next_tick, pan, tilt)
+                    self.applied.append((capture, arrival, self.next_tick))
+                self.next_tick += self.loop_s
+
+
+class SimFrame:
+    def __init__(self, image, capture_time):
+        self.image = image
+        self.time = capture_time
+
+    def to_ndarray(self, format="bgr24"):
+        return self.image
+
+
+class SyntheticTrack:
+    """Video track for run_track(): frames at a fixed rate, available camera_latency after capture"""
+    def __init__(self, sim, fps, duration_s, camera_latency_s, max_queue=3):
+        self.sim = sim
+        self.frame_s = 1.0 / fps
+        self.duration_s = duration_s
+        self.camera_latency_s = camera_latency_s
+        self.max_queue = max_queue
+        self.start = None
+        self.index = 0
+        self.skipped = 0
+
+    async def recv(self):
+        now = time.perf_counter()
+        if self.start is None:
+            self.start = now
+        self.sim.after_frame()
+
+        # A slow receiver drops frames like the decoder / jitter buffer would
+        behind = int((now - self.camera_latency_s - self.start) / self.frame_s) - self.index
+        if behind > self.max_queue:
+            self.skipped += behind - self.max_queue
+            self.index += behind - self.max_queue
+
+        capture = self.start + self.index * self.frame_s
+        self.index += 1
+        if capture - self.start > self.duration_s:
+            return None
+        await asyncio.sleep(max(0.0, capture + self.camera_latency_s - time.perf_counter()))
+        return SimFrame(self.sim.capture(capture), capture)
+
+    async def stop(self):
+        pass
+
+
+class Simulator:
+    def __init__(self, args):
+        self.scenario = SCENARIOS[args.scenario]
+        self.renderer = Renderer(sprite=args.sprite)
+        self.esp = EspTurret(loop_hz=args.esp_hz)
+        self.rng = np.random.default_rng(args.seed)
+        self.args = args
+
+        self.start = None
+        self.truth = None           # ground-truth box of the frame the receiver is processing
+        self.processing = None      # capture time of that frame
+        self.samples = []           # (time, aim error, target radius, tracked after processing, target, turret)
+
+    def capture(self, t):
+        if self.start is None:
+            self.start = t
+        target = self.scenario(t - self.start)
+        turret = self.esp.angle_at(t)
+        frame, self.truth = self.renderer.render(turret, target)
+        self.processing = t
+
+        error = math.hypot(target[0] - turret[0], target[1] - turret[1])
+        self.samples.append([t - self.start, error, target[2] / 2, False, target, turret])
+        return frame
+
+    def after_frame(self):
+        """Called before the next frame is handed out: did the receiver have a target after the last one?"""
+        if self.samples:
+            self.samples[-1][3] = receiver.bb_w > 0
+
+    def on_command(self, client, userdata, msg):
+        # run_track processes one frame at a time, a command belongs to the frame handed out last
+        if self.processing is not None:
+            self.esp.receive(self.processing, time.perf_counter(), msg.payload)
+
+    def oracle_detect(self, model, frame, imgsz):
+        """Ground truth with pixel noise, misses and a fixed inference time instead of the model"""
+        t0 = time.perf_counter()
+        detections = np.zeros((0, 6), dtype=np.float32)
+        if self.truth is not None and self.rng.random() >= self.args.oracle_miss:
+            box = np.asarray(self.truth, dtype=np.float32) + self.rng.normal(0, self.args.oracle_noise, 4)
+            conf = min(0.99, max(receiver.AIM_CONF, self.rng.normal(0.95, 0.02)))
+            detections = np.array([[*box, conf, 0.0]], dtype=np.float32)
+        time.sleep(max(0.0, self.args.oracle_ms / 1000 - (time.perf_counter() - t0)))
+        return detections, {"preprocess": 0.0, "inference": (time.perf_counter() - t0) * 1000, "postprocess": 0.0}
+
+    def report(self, track):
+        warmup = self.args.warmup
+        samples = [s for s in self.samples if s[0] >= warmup]
+        if not samples:
+            raise SystemExit("No frames after the warm-up")
+        errors = np.array([s[1] for s in samples])
+        hits = np.array([s[1] <= s[2] for s in samples])
+        tracked = np.array([s[3] for s in samples])
+
+        applied = np.array([a for a in self.esp.applied if a[0] - self.start >= warmup]).reshape(-1, 3) * 1000
+        dead_ms = self.esp.model.dead_time_s * 1000
+
+        print(f"\n{len(samples)} frames after {warmup:.0f} s warm-up, {track.skipped} dropped by the receiver being slow, "
+              f"{'oracle' if self.args.oracle else 'model'} detector, scenario {self.args.scenario}")
+        print(f"  hit rate    {hits.mean():7.1%}   (boresight within the target's angular radius)")
+        print(f"  track rate  {tracked.mean():7.1%}   (receiver had a target after the frame)")
+        summarize("aim error", errors, "deg")
+        summarize("capture -> command", applied[:, 1] - applied[:, 0], "ms")
+        summarize("command -> applied", applied[:, 2] - applied[:, 1], "ms")
+        summarize("capture -> motion", applied[:, 2] + dead_ms - applied[:, 0], "ms")
+        print(f"  {len(applied)} commands applied, {self.esp.dropped} dropped (ESP queue full), {self.esp.invalid} invalid")
+
+        if self.args.csv:
+            with open(self.args.csv, "w") as f:
+                f.write("t,error_deg,radius_deg,tracked,target_pan,target_tilt,turret_pan,turret_tilt\n")
+                for t, error, radius, tracked_frame, target, turret in self.samples:
+                    f.write(f"{t:.4f},{error:.3f},{radius:.3f},{int(tracked_frame)},{target[0]:.3f},{target[1]:.3f},"
+                            f"{turret[0]:.3f},{turret[1]:.3f}\n")
+            print(f"  trace written to {self.args.csv}")
+
+
+def summarize(name, values, unit):
+    if len(values) == 0:
+        print(f"  {name:<20} no samples")
+        return
+    print(f"  {name:<20} mean {np.mean(values):7.2f}  p50 {np.percentile(values, 50):7.2f}  "
+          f"p95 {np.percentile(values, 95):7.2f}  max {np.max(values):7.2f} {unit}")
+
+
+async def main(args):
+    sim = Simulator(args)
+
+    # The synthetic camera follows the linear FOV model, no undistortion
+    receiver.undistort = None
+    receiver.servo_tracker.angle_lut = None
+    if args.oracle:
+        # The cascade would run the detector on crops, the oracle only knows full frames
+        receiver.detect = sim.oracle_detect
+        receiver.cascade = None
+    receiver.setup(load_models=not args.oracle, record=False)
+
+    esp_client = mqtt.Client(callback_api_version=mqtt.CallbackAPIVersion.VERSION2)
+    esp_client.on_connect = lambda client, userdata, flags, reason_code, properties: client.subscribe(CMD_TOPIC)
+    esp_client.on_message = sim.on_command
+    esp_client.connect("127.0.0.1", 1883, 60)
+    esp_client.loop_start()
+
+    track = SyntheticTrack(sim, args.fps, args.duration, args.camera_latency / 1000)
+    await receiver.run_track(track, show=args.show)
+
+    esp_client.loop_stop()
+    receiver.client.loop_stop()
+    sim.report(track)
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Simulate camera, receiver, MQTT, ESP turret logic and servos end to end.")
+    parser.add_argument("--scenario", choices=sorted(SCENARIOS), default="circle", help="Glider trajectory")
+    parser.add_argument("--duration", type=float, default=30.0, help="Simulated seconds")
+    parser.add_argument("--warmup", type=float, default=2.0, help="Seconds excluded from the statistics")
+    parser.add_argument("--fps", type=float, default=30.0, help="Camera frame rate")
+    parser.add_argument("--camera-latency", type=float, default=receiver.CAMERA_LATENCY_MS, help="Capture -> frame available (ms)")
+    parser.add_argument("--esp-hz", type=float, default=60.0, help="Turret task rate of the ESP (DS4 input rate)")
+    parser.add_argument("--oracle", action="store_true", help="Ground-truth detector instead of the model")
+    parser.add_argument("--oracle-ms", type=float, default=15.0, help="Inference time of the oracle detector")
+    parser.add_argument("--oracle-noise", type=float, default=2.0, help="Box corner noise of the oracle detector (px)")
+    parser.add_argument("--oracle-miss", type=float, default=0.05, help="Miss probability of the oracle detector")
+    parser.add_argument("--sprite", help="Glider image with alpha channel instead of the drawn silhouette")
+    parser.add_argument("--seed", type=int, default=0, help="Seed of the oracle noise")
+    parser.add_argument("--csv", help="Write the per-frame trace to this file")
+    parser.add_argument("--show", action="store_true", help="Show the receiver window")
+    args = parser.parse_args()
+
+    asyncio.run(main(args))
@@ -0,0 +1,152 @@
+from collections import deque
+from dataclasses import dataclass
+from pathlib import Path
+import time
+
+from loguru import logger
+
+
+# ************************************** DOCUMENTATION **************************************
+# The governor keeps the end-to-end latency of the inference loop inside a budget by stepping
+# through a ladder of pipeline configurations (model, input size, frame skip).
+# Level 0 is the most accurate / most expensive configuration, the last level the cheapest one.
+#
+# Measured on Test_video.mp4 (see util/Screenshot/Timing_Summary.txt):
+#   lab PC (CUDA)  ~55 FPS inference only
+#   RPI5   (CPU)   ~3.8 FPS inference only
+#
+# Hysteresis:
+#   - step down (cheaper) when the windowed mean latency exceeds the target
+#   - step up (more accurate) only when the mean latency is below target * UPGRADE_RATIO
+#   - after every switch the governor holds the level for `hold_frames` frames and clears its window
+#   - a level that had to be left because of overload is retried only after a back-off that doubles
+#     with every failed attempt (capped at MAX_BACKOFF_FRAMES), this prevents oscillation
+
+
+MODELS_DIR = Path(__file__).resolve().parents[2] / "models"
+
+
+@dataclass(frozen=True)
+class PipelineConfig:
+    model_path: str     # path to the YOLO weights
+    imgsz: int          # inference input size (square)
+    skip: int = 1       # run inference on every n-th frame only
+
+    @property
+    def name(self):
+        return f"{Path(self.model_path).parent.parent.name}@{self.imgsz}/skip{self.skip}"
+
+
+def _weights(model_dir):
+    # The fused ONNX export (ai_setup/export_onnx_nms.py) runs decode + NMS in ORT, preferred once it exists
+    weights = MODELS_DIR / model_dir / "weights"
+    if any(weights.glob("best*_nms.onnx")):
+        return str(weights / "best_nms.onnx")
+    return str(weights / "best.pt")
+
+
+# Ordered from most expensive to cheapest (GFLOPs: v8s 28.6, v11s 21.5, v8n 8.7, v11n 6.5)
+DEFAULT_LADDER = (
+    PipelineConfig(_weights("YOLOv8s_NEW"), 640),
+    PipelineConfig(_weights("YOLOv11s_NEW"), 640),
+    PipelineConfig(_weights("YOLOv8n_NEW"), 640),
+    PipelineConfig(_weights("YOLOv11n_NEW"), 640),
+    PipelineConfig(_weights("YOLOv11n_NEW"), 480),
+    PipelineConfig(_weights("YOLOv11n_NEW"), 320),
+    PipelineConfig(_weights("YOLOv11n_NEW"), 320, skip=2),
+    PipelineConfig(_weights("YOLOv11n_NEW"), 320, skip=3),
+)
+
+
+class LatencyGovernor:
+    UPGRADE_RATIO = 0.6
+    MAX_BACKOFF_FRAMES = 1800
+
+    def __init__(self, target_ms, ladder=DEFAULT_LADDER, window=30, hold_frames=60, start_level=None):
+        if not ladder:
+            raise ValueError("ladder must contain at least one configuration")
+
+        self.target_ms = target_ms
+        self.ladder = tuple(ladder)
+        self.window = deque(maxlen=window)
+        self.hold_frames = hold_frames
+
+        # Start on the cheapest level and let the governor climb, unless told otherwise
+        self.level = len(self.ladder) - 1 if start_level is None else start_level
+        self.frames_at_level = 0
+        self.backoff_frames = [hold_frames] * len(self.ladder)
+        self.stage_sums = {}
+        self.stage_frames = 0
+
+    @property
+    def current(self):
+        """Currently active pipeline configuration"""
+        return self.ladder[self.level]
+
+    def should_infer(self, frame_index):
+        """True if inference has to run on this frame with the current skip ratio"""
+        return frame_index % self.current.skip == 0
+
+    def record(self, stage_ms, latency_ms=None):
+        """
+        Feed the measured stage times (ms) of one frame.
+        latency_ms is the end-to-end latency of that frame, defaults to the sum of all stages.
+        Returns True if the configuration was switched.
+        """
+        if latency_ms is None:
+            latency_ms = sum(stage_ms.values())
+
+        for stage, value in stage_ms.items():
+            self.stage_sums[stage] = self.stage_sums.get(stage, 0.0) + value
+        self.stage_frames += 1
+
+        self.window.append(latency_ms)
+        self.frames_at_level += 1
+
+        if self.frames_at_level < self.hold_frames or len(self.window) < self.window.maxlen:
+            return False
+
+        mean_ms = sum(self.window) / len(self.window)
+
+        if mean_ms > self.target_ms and self.level < len(self.ladder) - 1:
+            # Make the next attempt on this level wait longer
+            self.backoff_frames[self.level] = min(self.backoff_frames[self.level] * 2, self.MAX_BACKOFF_FRAMES)
+            reason = f"mean latency {mean_ms:.1f} ms > target {self.target_ms:.1f} ms"
+            return self._switch(self.level + 1, reason)
+
+        if (mean_ms < self.target_ms * self.UPGRADE_RATIO and self.level > 0
+                and self.frames_at_level >= self.backoff_frames[self.level - 1]):
+            reason = f"mean latency {mean_ms:.1f} ms < {self.UPGRADE_RATIO:.0%} of target {self.target_ms:.1f} ms"
+            return self._switch(self.level - 1, reason)
+
+        return False
+
+    def _switch(self, level, reason):
+        old = self.current
+        self.level = level
+        self.frames_at_level = 0
+        self.window.clear()
+
+        stages = ", ".join(f"{k}={v / max(1, self.stage_frames):.1f}" for k, v in self.stage_sums.items())
+        self.stage_sums = {}
+        self.stage_frames = 0
+        logger.info(f"Governor: {old.name} -> {self.current.name} ({reason}; stage means ms: {stages})")
+        return True
+
+
+class FrameLag:
+    """
+    Estimates how long a frame waited before processing started by comparing the stream
+    presentation timestamps with the wall clock. The smallest observed offset is used as baseline,
+    so the result is the queueing delay on top of the network / decoder latency.
+    """
+    def __init__(self):
+        self.min_offset = None
+
+    def update(self, frame_time):
+        if frame_time is None:
+            return 0.0
+        offset = time.perf_counter() - frame_time
+        if self.min_offset is None or offset < self.min_offset:
+            self.min_offset = offset
+        return (offset - self.min_offset) * 1000.0
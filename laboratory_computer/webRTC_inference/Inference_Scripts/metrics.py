@@ -0,0 +1,274 @@
+import threading
+import time
+from bisect import bisect_left
+from collections import deque
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+from loguru import logger
+
+
+# ************************************** SOURCES  **************************************
+# Prometheus text exposition format: https://prometheus.io/docs/instrumenting/exposition_formats/
+
+# ************************************** DOCUMENTATION **************************************
+# Minimal Prometheus metrics for the inference service, scraped from http://<lab pc>:METRICS_PORT/metrics
+# next to the mediamtx metrics of the Pi.
+#
+# No locks anywhere on the hot path: every metric (or histogram series) has exactly one writer thread,
+# updates are plain int / float additions and list element increments (atomic under the GIL).
+# The HTTP server runs on its own thread and only reads, so a scrape never blocks or slows the inference
+# loop. A scrape taken in the middle of an observation may see a histogram count that is one ahead of
+# its buckets, which Prometheus tolerates (the next scrape is consistent again).
+#
+# Gauges can be backed by a callable that is evaluated at scrape time (e.g. queue sizes), so values that
+# already exist elsewhere are not copied on every frame.
+
+# Seconds, 1 ms .. 1 s, covers single stages as well as the end-to-end latency
+LATENCY_BUCKETS = (0.001, 0.002, 0.005, 0.01, 0.015, 0.02, 0.03, 0.05, 0.075, 0.1, 0.15, 0.2, 0.3, 0.5, 1.0)
+
+
+def _labels(names, values):
+    if not names:
+        return ""
+    pairs = ",".join(f'{name}="{value}"' for name, value in zip(names, values))
+    return "{" + pairs + "}"
+
+
+def _number(value):
+    return repr(float(value)) if value not in (float("inf"), float("-inf")) else ("+Inf" if value > 0 else "-Inf")
+
+
+class Metric:
+    kind = None
+
+    def __init__(self, name, help_text, labelnames=()):
+        self.name = name
+        self.help = help_text
+        self.labelnames = tuple(labelnames)
+        self.series = {}
+
+    def labels(self, *values):
+        """Child series for the label values, created on first use (keep the label sets small and fixed)"""
+        series = self.series.get(values)
+        if series is None:
+            series = self.series.setdefault(values, self._new_series())
+        return series
+
+    def render(self):
+        lines = [f"# HELP {self.name} {self.help}", f"# TYPE {self.name} {self.kind}"]
+        for values, series in list(self.series.items()):
+            lines.extend(self._render_series(_labels(self.labelnames, values), series))
+        return lines
+
+
+class _Value:
+    __slots__ = ("value", "function")
+
+    def __init__(self):
+        self.value = 0.0
+        self.function = None
+
+    def inc(self, amount=1.0):
+        self.value += amount
+
+    def set(self, value):
+        self.value = value
+
+    def set_function(self, function):
+        """Evaluate function() at scrape time instead of storing a value"""
+        self.function = function
+
+    def get(self):
+        return self.function() if self.function is not None else self.value
+
+
+class Counter(Metric):
+    kind = "counter"
+
+    def _new_series(self):
+        return _Value()
+
+    def inc(self, amount=1.0):
+        self.labels().inc(amount)
+
+    def _render_series(self, labels, series):
+        return [f"{self.name}{labels} {_number(series.get())}"]
+
+
+class Gauge(Counter):
+    kind = "gauge"
+
+    def set(self, value):
+        self.labels().set(value)
+
+    def set_function(self, function):
+        self.labels().set_function(function)
+
+
+class _Buckets:
+    __slots__ = ("bounds", "counts", "sum", "count")
+
+    def __init__(self, bounds):
+        self.bounds = bounds
+        self.counts = [0] * (len(bounds) + 1)
+        self.sum = 0.0
+        self.count = 0
+
+    def observe(self, value):
+        self.counts[bisect_left(self.bounds, value)] += 1
+        self.sum += value
+        self.count += 1
+
+
+class Histogram(Metric):
+    kind = "histogram"
+
+    def __init__(self, name, help_text, labelnames=(), buckets=LATENCY_BUCKETS):
+        super().__init__(name, help_text, labelnames)
+        self.buckets = tuple(sorted(buckets))
+
+    def _new_series(self):
+        return _Buckets(self.buckets)
+
+    def observe(self, value):
+        self.labels().observe(value)
+
+    def _render_series(self, labels, series):
+        counts, total, count = list(series.counts), series.sum, series.count
+        lines = []
+        cumulative = 0
+        inner = labels[1:-1] + "," if labels else ""
+        for bound, bucket in zip(self.buckets + (float("inf"),), counts):
+            cumulative += bucket
+            lines.append(f'{self.name}_bucket{{{inner}le="{_number(bound)}"}} {cumulative}')
+        lines.append(f"{self.name}_sum{labels} {_number(total)}")
+        lines.append(f"{self.name}_count{labels} {count}")
+        return lines
+
+
+class Registry:
+    def __init__(self):
+        self.metrics = []
+
+    def add(self, metric):
+        self.metrics.append(metric)
+        return metric
+
+    def counter(self, name, help_text, labelnames=()):
+        return self.add(Counter(name, help_text, labelnames))
+
+    def gauge(self, name, help_text, labelnames=()):
+        return self.add(Gauge(name, help_text, labelnames))
+
+    def histogram(self, name, help_text, labelnames=(), buckets=LATENCY_BUCKETS):
+        return self.add(Histogram(name, help_text, labelnames, buckets))
+
+    def render(self):
+        lines = []
+        for metric in self.metrics:
+            try:
+                lines.extend(metric.render())
+            except Exception as e:
+                # A failing gauge callback must not break the whole scrape
+                logger.warning(f"Metrics: rendering {metric.name} failed: {e}")
+        return "\n".join(lines) + "\n"
+
+    def serve(self, port, host="0.0.0.0"):
+        """Serve /metrics on a daemon thread"""
+        registry = self
+
+        class Handler(BaseHTTPRequestHandler):
+            def do_GET(self):
+                if self.path.split("?")[0] != "/metrics":
+                    self.send_error(404)
+                    return
+                body = registry.render().encode()
+                self.send_response(200)
+                self.send_header("Content-Type", "text/plain; version=0.0.4; charset=utf-8")
+                self.send_header("Content-Length", str(len(body)))
+                self.end_headers()
+                self.wfile.write(body)
+
+            def log_message(self, format, *args):
+                pass
+
+        server = ThreadingHTTPServer((host, port), Handler)
+        threading.Thread(target=server.serve_forever, name="metrics_http", daemon=True).start()
+        logger.info(f"Metrics served at http://{host}:{port}/metrics")
+        return server
+
+
+class FrameRate:
+    """Frames per second over a sliding one second window (single writer)"""
+    def __init__(self, window_s=1.0):
+        self.window_s = window_s
+        self.start = None
+        self.frames = 0
+        self.fps = 0.0
+
+    def tick(self, now=None):
+        now = time.perf_counter() if now is None else now
+        if self.start is None:
+            self.start = now
+        self.frames += 1
+        if now - self.start >= self.window_s:
+            self.fps = self.frames / (now - self.start)
+            self.start, self.frames = now, 0
+        return self.fps
+
+
+class FrameDrops:
+    """Frames lost before the receiver (network, decoder), from gaps in the stream timestamps"""
+    def __init__(self, tolerance=1.5):
+        self.tolerance = tolerance
+        self.last_time = None
+        self.interval = None
+
+    def update(self, frame_time):
+        """Returns the number of frames missing before this one"""
+        if frame_time is None:
+            return 0
+        dropped = 0
+        if self.last_time is not None:
+            gap = frame_time - self.last_time
+            if gap > 0:
+                # Smallest gap seen is the nominal frame interval
+                self.interval = gap if self.interval is None else min(self.interval, gap)
+                if gap > self.interval * self.tolerance:
+                    dropped = int(round(gap / self.interval)) - 1
+        self.last_time = frame_time
+        return dropped
+
+
+class PublishTimer:
+    """
+    MQTT publish latency: publish() call -> paho on_publish (message handed to the socket for QoS 0,
+    PUBACK for QoS 1). on_publish runs on the paho network thread and may fire before publish() returned,
+    it only queues (mid, time). The publishing thread matches the completions in drain() and is the only
+    writer of the histogram and the pending messages.
+    """
+    def __init__(self, histogram):
+        self.histogram = histogram
+        self.pending = {}
+        self.completed = deque()
+
+    def publish(self, client, topic, payload, qos=0):
+        t0 = time.perf_counter()
+        info = client.publish(topic, payload, qos=qos)
+        if len(self.pending) > 1000:
+            # Messages lost while disconnected never get an on_publish
+            self.pending.clear()
+        self.pending[info.mid] = t0
+        self.drain()
+        return info
+
+    def on_publish(self, client, userdata, mid, reason_code=None, properties=None):
+        self.completed.append((mid, time.perf_counter()))
+
+    def drain(self):
+        """Observe the completed publishes, call on the publishing thread (publish() does, the frame loop as well)"""
+        while self.completed:
+            mid, done = self.completed.popleft()
+            t0 = self.pending.pop(mid, None)
+            if t0 is not None:
+                self.histogram.observe(done - t0)
@@ -0,0 +1,143 @@
+import os
+import threading
+import time
+from pathlib import Path
+
+from loguru import logger
+
+from onnx_detector import resolution_variants
+
+
+# ************************************** DOCUMENTATION **************************************
+# Hot reload of detector models without interrupting the inference loop.
+#
+#   - a watcher thread polls the modification time of every model file (for ONNX models including all
+#     exported input sizes); a file counts as changed once its mtime and size were stable for
+#     `settle_s` seconds, so a model that is still being copied / exported is not loaded half-written
+#   - reload() requests a reload explicitly (receiver: MQTT topic vehicle/detector/reload)
+#   - a loader thread builds and warms up the new model with the given `build` callable while the
+#     inference loop keeps running on the old one
+#   - swap() is called by the inference loop between two frames and exchanges the finished models in
+#     the models dict (a plain assignment, nothing blocks the frame), the old model is released afterwards
+#
+# If loading or warm-up fails, the old model stays active and the error is logged.
+
+
+def model_files(model_path):
+    """All files of a model: the path itself and, for ONNX models, every exported input size"""
+    path = Path(model_path)
+    if path.suffix != ".onnx":
+        return [path]
+    return list(dict.fromkeys([path, *resolution_variants(path).values()]))
+
+
+class ModelReloader:
+    def __init__(self, model_paths, build, poll_s=1.0, settle_s=2.0):
+        """
+        model_paths: paths to watch, the keys of the receiver's models dict
+        build:       callable(model_path) -> loaded and warmed-up model, runs on the loader thread
+        """
+        self.model_paths = list(dict.fromkeys(model_paths))
+        self.build = build
+        self.poll_s = poll_s
+        self.settle_s = settle_s
+
+        self.requests = set()
+        self.ready = {}
+        self.lock = threading.Lock()
+        self.wakeup = threading.Event()
+        self.stopped = threading.Event()
+
+        self.stamps = {path: self._stamp(path) for path in self.model_paths}
+        self.changed_at = {}
+
+        self.swaps = 0
+        self.failures = 0
+
+        self.threads = [threading.Thread(target=self._watch, name="model_watch", daemon=True),
+                        threading.Thread(target=self._load, name="model_load", daemon=True)]
+        for thread in self.threads:
+            thread.start()
+
+    def reload(self, model_path=None):
+        """Request a reload of one model or, without a path, of all models. Thread safe."""
+        paths = self.model_paths if model_path is None else [model_path]
+        unknown = [p for p in paths if p not in self.model_paths]
+        if unknown:
+            raise ValueError(f"Unknown model {unknown[0]}")
+        with self.lock:
+            self.requests.update(paths)
+        self.wakeup.set()
+
+    def swap(self, models):
+        """
+        Exchange every finished model in the models dict, call between frames.
+        Returns the list of swapped model paths (empty in almost every frame).
+        """
+        if not self.ready:
+            return []
+        with self.lock:
+            ready, self.ready = self.ready, {}
+
+        old = []
+        for path, model in ready.items():
+            old.append(models.get(path))
+            models[path] = model
+            self.swaps += 1
+            logger.info(f"Model reload: swapped in {path}")
+
+        # Dropping the last reference releases the old sessions / weights right here (reference counting),
+        # an explicit gc.collect() would stall the frame
+        del old
+        return list(ready)
+
+    def close(self):
+        self.stopped.set()
+        self.wakeup.set()
+
+    def _stamp(self, model_path):
+        stamps = []
+        for path in model_files(model_path):
+            try:
+                stat = os.stat(path)
+                stamps.append((str(path), stat.st_mtime_ns, stat.st_size))
+            except OSError:
+                pass
+        return tuple(sorted(stamps))
+
+    def _watch(self):
+        while not self.stopped.wait(self.poll_s):
+            now = time.monotonic()
+            for path in self.model_paths:
+                stamp = self._stamp(path)
+                if stamp != self.stamps[path]:
+                    # Still being written, wait until it is stable
+                    self.stamps[path] = stamp
+                    self.changed_at[path] = now
+                elif path in self.changed_at and now - self.changed_at[path] >= self.settle_s:
+                    del self.changed_at[path]
+                    logger.info(f"Model reload: {path} changed on disk")
+                    with self.lock:
+                        self.requests.add(path)
+                    self.wakeup.set()
+
+    def _load(self):
+        while True:
+            self.wakeup.wait()
+            self.wakeup.clear()
+            if self.stopped.is_set():
+                return
+
+            with self.lock:
+                requests, self.requests = self.requests, set()
+            for path in requests:
+                t0 = time.perf_counter()
+                try:
+                    model = self.build(path)
+                except Exception as e:
+                    self.failures += 1
+                    logger.error(f"Model reload: loading {path} failed, keeping the active model: {e}")
+                    continue
+                with self.lock:
+                    self.ready[path] = model
+                logger.info(f"Model reload: {path} loaded and warmed up in {time.perf_counter() - t0:.1f} s")
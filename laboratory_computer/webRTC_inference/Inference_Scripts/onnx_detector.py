@@ -0,0 +1,136 @@
+import re
+import time
+from pathlib import Path
+
+import cv2
+import numpy as np
+import onnxruntime as ort
+
+
+# ************************************** DOCUMENTATION **************************************
+# ONNX Runtime detector for models exported with ai_setup/export_onnx_nms.py.
+#
+# Two model variants are supported and detected by the name of the first output:
+#   detections  fused model, decode + NMS run inside the ORT graph -> only rescaling in Python
+#   output0     raw ultralytics head, decode + confidence filter + NMS run here with numpy / OpenCV
+#               (the application-side decode the fused model replaces, kept for benchmarking)
+#
+# __call__ returns an Nx6 float32 array (x1, y1, x2, y2, conf, class) in pixels of the given frame,
+# the same layout as ultralytics `results[0].boxes.data`. Stage times of the last call are in `speed`
+# (ms, same keys as ultralytics: preprocess, inference, postprocess).
+#
+# MultiResolutionDetector bundles the exports of one model at several input sizes (export_onnx_nms.py
+# --imgsz 320 480 640 writes best_320_nms.onnx, best_480_nms.onnx, ...), ONNX models have a fixed input size.
+
+LETTERBOX_COLOR = (114, 114, 114)
+
+
+class OnnxDetector:
+    def __init__(self, model_path, conf=0.25, iou=0.5, max_det=1, providers=None):
+        if providers is None:
+            providers = [p for p in ("TensorrtExecutionProvider", "CUDAExecutionProvider", "CPUExecutionProvider")
+                         if p in ort.get_available_providers()]
+
+        options = ort.SessionOptions()
+        options.graph_optimization_level = ort.GraphOptimizationLevel.ORT_ENABLE_ALL
+        self.session = ort.InferenceSession(str(model_path), options, providers=providers)
+
+        model_input = self.session.get_inputs()[0]
+        self.input_name = model_input.name
+        self.imgsz = int(model_input.shape[2])
+        self.output_name = self.session.get_outputs()[0].name
+        self.fused = self.output_name == "detections"
+
+        # Only used by the application-side decode, the fused model has them baked in
+        self.conf = conf
+        self.iou = iou
+        self.max_det = max_det
+
+        self.input = np.empty((1, 3, self.imgsz, self.imgsz), dtype=np.float32)
+        self.speed = {}
+
+    def __call__(self, frame):
+        t0 = time.perf_counter()
+        scale, pad_x, pad_y = self._preprocess(frame)
+        t1 = time.perf_counter()
+        output = self.session.run([self.output_name], {self.input_name: self.input})[0]
+        t2 = time.perf_counter()
+
+        detections = output if self.fused else self._decode(output)
+        detections = detections.astype(np.float32, copy=True)
+        # Letterboxed model input -> frame pixels
+        detections[:, [0, 2]] = (detections[:, [0, 2]] - pad_x) / scale
+        detections[:, [1, 3]] = (detections[:, [1, 3]] - pad_y) / scale
+        t3 = time.perf_counter()
+
+        self.speed = {"preprocess": (t1 - t0) * 1000, "inference": (t2 - t1) * 1000, "postprocess": (t3 - t2) * 1000}
+        return detections
+
+    def _preprocess(self, frame):
+        """Letterbox into the square input, BGR -> RGB, HWC -> CHW, 0..1 into the preallocated input tensor"""
+        h, w = frame.shape[:2]
+        if h == self.imgsz and w == self.imgsz:
+            # Already letterboxed, e.g. by the undistortion remap
+            scale, pad_x, pad_y = 1.0, 0, 0
+            image = frame
+        else:
+            scale = self.imgsz / max(h, w)
+            new_w, new_h = int(round(w * scale)), int(round(h * scale))
+            pad_x, pad_y = (self.imgsz - new_w) // 2, (self.imgsz - new_h) // 2
+            image = cv2.resize(frame, (new_w, new_h), interpolation=cv2.INTER_LINEAR)
+            image = cv2.copyMakeBorder(image, pad_y, self.imgsz - new_h - pad_y, pad_x, self.imgsz - new_w - pad_x,
+                                       cv2.BORDER_CONSTANT, value=LETTERBOX_COLOR)
+
+        blob = cv2.dnn.blobFromImage(image, 1 / 255.0, swapRB=True)
+        np.copyto(self.input, blob)
+        return scale, pad_x, pad_y
+
+    def _decode(self, output):
+        """Application-side decode of the raw head [1, 4 + classes, anchors] (class agnostic NMS)"""
+        pred = output[0].T
+        class_scores = pred[:, 4:]
+        classes = class_scores.argmax(axis=1)
+        scores = class_scores[np.arange(len(pred)), classes]
+
+        keep = scores >= self.conf
+        pred, scores, classes = pred[keep], scores[keep], classes[keep]
+        if len(pred) == 0:
+            return np.zeros((0, 6), dtype=np.float32)
+
+        # cx, cy, w, h -> x, y, w, h for NMSBoxes
+        boxes = pred[:, :4].copy()
+        boxes[:, 0] -= boxes[:, 2] / 2
+        boxes[:, 1] -= boxes[:, 3] / 2
+        # top_k of NMSBoxes limits the candidates before suppression, not the result
+        indices = np.asarray(cv2.dnn.NMSBoxes(boxes.tolist(), scores.tolist(), self.conf, self.iou),
+                             dtype=np.int64).reshape(-1)[:self.max_det]
+
+        selected = boxes[indices]
+        return np.column_stack((selected[:, 0], selected[:, 1],
+                                selected[:, 0] + selected[:, 2], selected[:, 1] + selected[:, 3],
+                                scores[indices], classes[indices])).astype(np.float32)
+
+
+def resolution_variants(model_path):
+    """{input size: path} of all exports of the model, e.g. best_nms.onnx -> best_320_nms.onnx, best_480_nms.onnx, ..."""
+    path = Path(model_path)
+    stem, _, suffix = re.fullmatch(r"(.*?)(_\d+)?(_nms)?", path.stem).groups()
+    suffix = suffix or ""
+    pattern = re.compile(rf"{re.escape(stem)}_(\d+){suffix}\.onnx")
+    variants = {int(m.group(1)): p for p in path.parent.glob("*.onnx") if (m := pattern.fullmatch(p.name))}
+    return variants or {None: path}
+
+
+class MultiResolutionDetector:
+    def __init__(self, model_path, **kwargs):
+        detectors = [OnnxDetector(path, **kwargs) for path in resolution_variants(model_path).values()]
+        self.detectors = {detector.imgsz: detector for detector in detectors}
+        self.sizes = tuple(sorted(self.detectors))
+        self.speed = {}
+
+    def __call__(self, frame, imgsz):
+        """Runs the smallest export with an input of at least imgsz (the largest one if there is none)"""
+        detector = self.detectors[next((s for s in self.sizes if s >= imgsz), self.sizes[-1])]
+        detections = detector(frame)
+        self.speed = detector.speed
+        return detections
@@ -2,7 +2,8 @@ import re
 import asyncio
 import aiohttp
 import os
-os.add_dll_directory("C:/Program Files/gstreamer/1.0/msvc_x86_64/bin")
+if os.name == "nt":
+    os.add_dll_directory("C:/Program Files/gstreamer/1.0/msvc_x86_64/bin")
 import cv2
 import time
 import numpy as np
@@ -17,6 +18,20 @@ from loguru import logger
 from aiortc import RTCPeerConnection, RTCConfiguration, RTCIceServer, RTCSessionDescription
 import logging
 import math
+from pathlib import Path
+from latency_governor import LatencyGovernor, FrameLag
+from camera_calibration import CameraCalibration, UndistortPreprocessor
+from dataset_recorder import DatasetRecorder
+from onnx_detector import MultiResolutionDetector
+from cascade_detector import CascadeDetector
+from flow_tracker import FlowTracker
+from sort_tracker import SortTracker
+from world_tracker import TurretModel, WorldTargetFilter
+from visual_servo import VisualServo
+from resolution_selector import ResolutionSelector
+from model_reloader import ModelReloader
+from metrics import Registry, FrameRate, FrameDrops, PublishTimer
+from turret_protocol import CommandEncoder, ProtocolError, decode_telemetry
 
 
 # ************************************** SOURCES  **************************************
@@ -44,9 +59,23 @@ class ServoTracker:
         self.VERTICAL_FOV = 50.9
         self.IMAGE_WIDTH = 1280
         self.IMAGE_HEIGHT = 1080
+
+        # Calibrated pixel -> angle lookup table, linear FOV approximation is used if not set
+        self.angle_lut = None
+
+        # Target tracking in turret-base coordinates, undoes the camera motion of the moving turret
+        self.turret = TurretModel(start=(self.current_x_angle, self.current_y_angle))
+        self.world = WorldTargetFilter()
+
+        # Closed-loop controller (C++), runs on every frame with a target
+        self.controller = VisualServo(self.current_x_angle, self.current_y_angle)
+        self.last_control = None
     
     def calculate_camera_relative_angles(self, x_pixel, y_pixel):
         """Calculate angles relative to current camera center"""
+        if self.angle_lut is not None:
+            return self.angle_lut(x_pixel, y_pixel)
+
         degrees_per_pixel_h = self.HORIZONTAL_FOV / self.IMAGE_WIDTH
         degrees_per_pixel_v = self.VERTICAL_FOV / self.IMAGE_HEIGHT
         
@@ -56,24 +85,39 @@ class ServoTracker:
         
         return horizontal_angle, vertical_angle
     
-    def update_servo_position(self, x_pixel, y_pixel):
-        """Update absolute servo positions based on camera detection"""
-        
-        # Get camera-relative angles
+    def observe(self, x_pixel, y_pixel, capture_time):
+        """Feed a target pixel of a frame captured at capture_time (perf_counter seconds)"""
         rel_horizontal, rel_vertical = self.calculate_camera_relative_angles(x_pixel, y_pixel)
-        
-        # Convert to absolute servo positions
-        new_x_angle = self.current_x_angle + rel_horizontal
-        new_y_angle = self.current_y_angle + rel_vertical
-        
-        # Apply servo limits
-        new_x_angle = max(-90, min(90, new_x_angle))
-        new_y_angle = max(0, min(80, new_y_angle))
-        
+
+        # Where the turret actually pointed when the frame was taken, not the last command
+        turret_x, turret_y = self.turret.angle_at(capture_time)
+        self.world.update(capture_time, turret_x + rel_horizontal, turret_y + rel_vertical)
+
+    def update_servo_position(self, now):
+        """One controller step towards the tracked target, recorded as command sent at now"""
+        # Compare target and turret at the time a command sent now takes effect, so commands
+        # still in flight are not issued twice (Smith predictor)
+        effective = now + self.turret.dead_time_s
+        target_x, target_y = self.world.predict(effective)
+        turret_x, turret_y = self.turret.angle_at(effective)
+        rate_x, rate_y = self.world.rate
+
+        # After a pause continue from the last command instead of integrating the whole gap
+        if self.last_control is None or now - self.last_control > 0.5:
+            self.controller.reset(self.current_x_angle, self.current_y_angle)
+            dt = 1 / 30
+        else:
+            dt = now - self.last_control
+        self.last_control = now
+
+        # Servo limits, rate limit and anti-windup are part of the controller
+        new_x_angle, new_y_angle = self.controller.update(target_x - turret_x, target_y - turret_y, rate_x, rate_y, dt)
+        logger.debug(f"error: {target_x - turret_x:.1f}, {target_y - turret_y:.1f} -> command {new_x_angle:.1f}, {new_y_angle:.1f}")
 
         # Update current positions
         self.current_x_angle = new_x_angle
         self.current_y_angle = new_y_angle
+        self.turret.command(now, new_x_angle, new_y_angle)
         
         return new_x_angle, new_y_angle
     
@@ -81,10 +125,13 @@ class ServoTracker:
         """Get current absolute servo positions"""
         return self.current_x_angle, self.current_y_angle
     
-    def reset_to_zero(self):
+    def reset_to_zero(self, now):
         """Reset to zero position"""
         self.current_x_angle = 0
         self.current_y_angle = 48
+        self.turret.command(now, self.current_x_angle, self.current_y_angle)
+        self.world.reset()
+        self.last_control = None
 
 servo_tracker = ServoTracker()
 
@@ -96,21 +143,216 @@ x_angle, y_angle = 0, 48
 abs_h, abs_v = 0, 0
 bb_x, bb_y, bb_w, bb_h = 0, 0, 0, 0
 clients = set()
-counter = 0
 bb_counter = 0
+last_command = None
+
+# End-to-end latency budget (frame arrival -> turret command) the governor tries to keep
+LATENCY_TARGET_MS = 150
+
+# Camera calibration created with camera_calibration.py, optional
+CALIBRATION_FILE = Path(__file__).with_name("camera_calibration.yml")
+
+# Confidence needed to aim at a detection, detections between RECORD_CONF and AIM_CONF are hard examples
+AIM_CONF = 0.9
+RECORD_CONF = 0.25
+
+# Several detections per frame are tracked with persistent IDs, aiming locks onto one of them
+MAX_DETECTIONS = 10
 
-old_center = [0,0]
+# Hard example recording for retraining (None disables it)
+RECORD_DIR = Path(__file__).with_name("hard_examples")
+RECORD_MISS_WINDOW = 30  # frames after the last hit in which a frame without hit counts as a miss
+
+# Glass-to-receiver latency of a frame that did not wait in the queue (camera, encoder, network, decoder).
+# Capture time = arrival - queueing delay - this, used to look up where the turret pointed.
+CAMERA_LATENCY_MS = 80
+
+# Background subtraction cascade: YOLO only runs on crops of this size around moving blobs (None disables it)
+CASCADE_CROP_SIZE = 320
+
+# Detector input sizes chosen per frame by target size (.pt weights), ONNX models use the sizes they were exported at.
+# The governor's input size is the upper limit.
+INPUT_SIZES = (320, 480, 640)
 
 # ************************************** AI MODEL SETUP **************************************
 logging.getLogger('ultralytics').setLevel(logging.ERROR)
 device = 'cuda' if torch.cuda.is_available() else 'cpu'
 print(f"Using device: {device}")
-model = YOLO('best.pt').to(device)
-model.eval()
+
+# Load every model of the governor ladder up front and warm up each input size,
+# so switching configurations never stalls the stream with a cold start
+governor = LatencyGovernor(LATENCY_TARGET_MS)
+
+# Undistortion is fused into preprocessing: one remap from the decoded frame into a square frame of one fixed
+# size, the largest input of the ladder. Tracks, flow and cascade boxes keep their coordinates when the governor
+# changes the input size, the detector only scales that frame down to its input.
+TRACKING_SIZE = max(cfg.imgsz for cfg in governor.ladder)
+undistort = None
+if CALIBRATION_FILE.exists():
+    undistort = UndistortPreprocessor(CameraCalibration.load(CALIBRATION_FILE), [TRACKING_SIZE])
+else:
+    logger.warning(f"No camera calibration at {CALIBRATION_FILE}, using linear degrees-per-pixel conversion")
+
+def load_model(model_path):
+    # *_nms.onnx models (ai_setup/export_onnx_nms.py) return final boxes, decode + NMS run inside ORT.
+    # All exported input sizes of the model are loaded.
+    if model_path.endswith(".onnx"):
+        return MultiResolutionDetector(model_path, conf=RECORD_CONF, iou=0.5, max_det=MAX_DETECTIONS)
+    model = YOLO(model_path).to(device)
+    model.eval()
+    return model
+
+def detect(model, frame, imgsz):
+    """Nx6 array (x1, y1, x2, y2, conf, class) in frame pixels and the stage times in ms"""
+    if isinstance(model, MultiResolutionDetector):
+        return model(frame, imgsz), model.speed
+    results = model(frame, device=device, imgsz=imgsz, conf=RECORD_CONF, iou=0.5, agnostic_nms=True, max_det=MAX_DETECTIONS, verbose=False)
+    return results[0].boxes.data.cpu().numpy(), results[0].speed
+
+def model_sizes(model):
+    return getattr(model, "sizes", INPUT_SIZES)
+
+def warm_up(model_path):
+    """Load a model and run every input size it can be used with (governor levels, resolution selection, cascade crops)"""
+    model = load_model(model_path)
+    warmup_frame = np.zeros((1080, 1280, 3), dtype=np.uint8)
+    for cfg in governor.ladder:
+        if cfg.model_path != model_path:
+            continue
+        warmup_input = undistort(warmup_frame, TRACKING_SIZE) if undistort else warmup_frame
+        for imgsz in model_sizes(model):
+            if imgsz <= cfg.imgsz or imgsz == model_sizes(model)[0]:
+                detect(model, warmup_input, imgsz)
+    if CASCADE_CROP_SIZE:
+        detect(model, np.zeros((CASCADE_CROP_SIZE, CASCADE_CROP_SIZE, 3), dtype=np.uint8), CASCADE_CROP_SIZE)
+    return model
+
+# Filled by setup()
+models = {}
+selectors = {}
+reloader = None
+recorder = None
+
+# Persistent target IDs, and target estimates between detector runs (skipped frames)
+sort_tracker = SortTracker()
+flow = FlowTracker()
+
+cascade = CascadeDetector(crop_size=CASCADE_CROP_SIZE) if CASCADE_CROP_SIZE else None
+
+# ************************************** METRICS **************************************
+# Prometheus endpoint http://<lab pc>:METRICS_PORT/metrics, served on its own thread (see metrics.py)
+METRICS_PORT = 9108
+
+registry = Registry()
+m_frames = registry.counter("himmelwacht_frames_total", "Frames processed by the inference loop")
+m_fps = registry.gauge("himmelwacht_fps", "Processed frames per second over the last second")
+m_stage = registry.histogram("himmelwacht_stage_latency_seconds", "Duration of one pipeline stage per frame", ("stage",))
+m_latency = registry.histogram("himmelwacht_end_to_end_latency_seconds", "Frame arrival -> processing done, including queueing")
+m_queue_delay = registry.histogram("himmelwacht_frame_queue_delay_seconds", "Time a frame waited before processing started")
+m_queue = registry.gauge("himmelwacht_queue_depth", "Items waiting in a queue", ("queue",))
+m_dropped = registry.counter("himmelwacht_dropped_frames_total", "Frames lost before / by the receiver", ("reason",))
+m_skips = registry.counter("himmelwacht_inference_skips_total", "Frames without a detector run", ("reason",))
+m_publish = registry.histogram("himmelwacht_mqtt_publish_latency_seconds", "publish() -> message handed to the broker connection")
+m_commands = registry.counter("himmelwacht_turret_commands_total", "Turret commands published")
+m_level = registry.gauge("himmelwacht_governor_level", "Active governor level (0 = most accurate)")
+m_imgsz = registry.gauge("himmelwacht_input_size_pixels", "Detector input size of the last inferred frame")
+m_locked = registry.gauge("himmelwacht_target_locked", "1 while aiming follows a locked track")
+m_turret = registry.gauge("himmelwacht_turret_angle_degrees", "Platform angle applied by the ESP (telemetry)", ("axis",))
+m_drive = registry.gauge("himmelwacht_drive_duty_percent", "Drive motor duty reported by the ESP, negative = backward", ("side",))
+m_esp_dropped = registry.gauge("himmelwacht_esp_dropped_commands", "Turret commands dropped by the ESP since boot (wraps at 65536)")
+m_cmd_lag = registry.gauge("himmelwacht_esp_command_lag", "Commands sent but not yet applied by the ESP at the last telemetry frame")
+
+m_level.set_function(lambda: governor.level)
+m_queue.labels("recorder").set_function(lambda: recorder.queue.qsize() if recorder is not None else 0)
+for reason in ("rate", "queue", "quota"):
+    # Hard example recorder drops (bound to the attribute name, evaluated at scrape time)
+    m_dropped.labels(f"recorder_{reason}").set_function(lambda r=reason: getattr(recorder, f"dropped_{r}", 0))
+publish_timer = PublishTimer(m_publish)
 
 # ************************************** MQTT SETUP **************************************
+# Turret commands are binary frames (turret_protocol.py), "json" for ESP firmware without the binary protocol
+TURRET_PROTOCOL = "binary"
+TURRET_TOPIC = "vehicle/turret/cmd"
+TELEMETRY_TOPIC = "vehicle/turret/telemetry"
+command_encoder = CommandEncoder(TURRET_PROTOCOL)
+
+# Controller gains can be tuned at runtime, e.g.
+#   mosquitto_pub -t vehicle/turret/gains -m '{"axis": "pan", "kp": 5, "kff": 0.5}'
+GAINS_TOPIC = "vehicle/turret/gains"
+
+# Model reload, empty payload reloads every model of the governor ladder, otherwise the given model path
+#   mosquitto_pub -t vehicle/detector/reload -n
+RELOAD_TOPIC = "vehicle/detector/reload"
+
+def on_connect(client, userdata, flags, reason_code, properties):
+    client.subscribe(GAINS_TOPIC)
+    client.subscribe(RELOAD_TOPIC)
+    client.subscribe(TELEMETRY_TOPIC)
+
+def on_telemetry(payload):
+    try:
+        telemetry = decode_telemetry(payload)
+    except ProtocolError as e:
+        logger.warning(f"Invalid telemetry frame: {e}")
+        return
+    m_turret.labels("x").set(telemetry.x_deg)
+    m_turret.labels("y").set(telemetry.y_deg)
+    m_drive.labels("left").set(telemetry.left_duty)
+    m_drive.labels("right").set(telemetry.right_duty)
+    m_esp_dropped.set(telemetry.dropped_cmds)
+    if TURRET_PROTOCOL == "binary" and telemetry.automatic:
+        # Last seq sent vs last seq the turret task applied
+        m_cmd_lag.set((command_encoder.seq - 1 - telemetry.last_cmd_seq) & 0xFFFF)
+
+def on_message(client, userdata, msg):
+    if msg.topic == TELEMETRY_TOPIC:
+        on_telemetry(msg.payload)
+        return
+    if msg.topic == RELOAD_TOPIC:
+        if reloader is None:
+            logger.warning("Model reload requested, but no models are loaded")
+            return
+        try:
+            reloader.reload(msg.payload.decode() or None)
+        except ValueError as e:
+            logger.warning(f"Invalid reload request: {e}")
+        return
+    try:
+        gains = json.loads(msg.payload)
+        servo_tracker.controller.set_gains(gains.pop("axis"), **gains)
+    except (ValueError, KeyError, TypeError) as e:
+        logger.warning(f"Invalid gains message {msg.payload!r}: {e}")
+
 client = mqtt.Client(callback_api_version=mqtt.CallbackAPIVersion.VERSION2)
-client.connect("127.0.0.1", 1883, 60)
+client.on_connect = on_connect
+client.on_message = on_message
+client.on_publish = publish_timer.on_publish
+
+def setup(load_models=True, record=True):
+    """
+    Load and warm up the models of the governor ladder, start model reload and hard example recording,
+    connect to the MQTT broker. load_models=False leaves the models as None, for a replaced detect()
+    (hil_simulator.py oracle detector).
+    """
+    global reloader, recorder
+    for cfg in governor.ladder:
+        if cfg.model_path not in models:
+            models[cfg.model_path] = warm_up(cfg.model_path) if load_models else None
+            selectors[cfg.model_path] = ResolutionSelector(model_sizes(models[cfg.model_path]))
+    logger.info(f"Governor starts with {governor.current.name}, target {LATENCY_TARGET_MS} ms")
+
+    # Retrained models are picked up while the stream keeps running: changed files on disk or MQTT reload command,
+    # the new model is loaded and warmed up in the background and swapped in between two frames
+    if load_models:
+        reloader = ModelReloader(models.keys(), warm_up)
+
+    if record and RECORD_DIR:
+        recorder = DatasetRecorder(RECORD_DIR)
+
+    client.connect("127.0.0.1", 1883, 60)
+    client.loop_start()
+
+    registry.serve(METRICS_PORT)
 
 # ************************************** MISC **************************************
 
@@ -190,85 +432,188 @@ print(f"Vertical servo angle: {v_angle:.1f}°")
 
 # ************************************** FUNCTIONS **************************************
 
-async def run_track(track):
+async def run_track(track, show=True):
+    """Inference loop on a video track (anything with async recv() returning frames with .time and .to_ndarray())"""
     global bb_x, bb_y, bb_w, bb_h
     global x_angle, y_angle
-    global counter, bb_counter
-    global old_center
+    global bb_counter, last_command
+    global undistort
     print("Track started")
-    initial = True  # Start with True, not False
+    frame_index = 0
+    frame_lag = FrameLag()
+    frame_rate = FrameRate()
+    frame_drops = FrameDrops()
+    detections = None
+    target = None
+    frames_since_hit = RECORD_MISS_WINDOW
     
     while True:
         frame = await track.recv()
    
         if frame is None:
             break
+
+        t_start = time.perf_counter()
+        queue_ms = frame_lag.update(frame.time)
+        m_dropped.labels("stream").inc(frame_drops.update(frame.time))
+        stage_ms = {}
+        cfg = governor.current
+
+        # Reloaded models take over between two frames
+        for model_path in (reloader.swap(models) if reloader is not None else []):
+            if model_sizes(models[model_path]) != selectors[model_path].sizes:
+                selectors[model_path] = ResolutionSelector(model_sizes(models[model_path]))
             
-        # Convert to OpenCV BGR
-        frame = cv2.cvtColor(frame.to_ndarray(format="rgb24"), cv2.COLOR_RGB2BGR)
-        results = model(frame, device=device, conf=0.9, iou=0.5, agnostic_nms=True, max_det = 1)
-        annotated = results[0].plot()
-        img = cv2.circle(annotated,(640,450), 5, (0,255,0), 3)
-        boxes = results[0].boxes
+        # Convert to OpenCV BGR (directly in the decoder's color conversion)
+        frame = frame.to_ndarray(format="bgr24")
+        if undistort is not None:
+            # Undistort + letterbox into the tracking frame, detections and angles then live in that space.
+            # Another resolution than the calibration is rescaled, another aspect ratio cannot be corrected.
+            try:
+                frame = undistort(frame, TRACKING_SIZE)
+                servo_tracker.angle_lut = undistort.angle_lut(TRACKING_SIZE)
+            except ValueError as e:
+                logger.error(f"{e}, undistortion disabled")
+                undistort = None
+                servo_tracker.angle_lut = None
+        stage_ms["convert"] = (time.perf_counter() - t_start) * 1000
+
+        # Depending on the skip ratio only every n-th frame is inferred, optical flow covers the others
+        inferred = governor.should_infer(frame_index) or detections is None
+        frame_index += 1
+        if inferred:
+            model = models[cfg.model_path]
+
+            # Input size by the size of the target tracked up to the last frame, capped by the governor
+            selector = selectors[cfg.model_path]
+            tracked = target is not None and target.time_since_update < cfg.skip
+            imgsz = selector.select(target.box if tracked else None, target.conf if tracked else 0.0, frame.shape, cfg.imgsz)
+
+            mode = "full"
+            if cascade is not None:
+                # While the turret follows a target the crop around its SORT prediction replaces the full frame
+                detections, speed, mode = cascade(frame, lambda image, size: detect(model, image, size), imgsz,
+                                                  predicted_box=sort_tracker.predicted_box(sort_tracker.locked_id))
+            else:
+                detections, speed = detect(model, frame, imgsz)
+            stage_ms.update(speed)  # (candidates), preprocess, inference, postprocess
+
+            # Crop passes run at the cascade's crop size, only full-frame passes count for the selected size
+            if mode == "full":
+                selector.record(imgsz, sum(v for k, v in speed.items() if k != "candidates") / 1000)
+            elif mode == "skipped":
+                m_skips.labels("cascade").inc()
+            m_imgsz.set(imgsz)
+        else:
+            m_skips.labels("governor").inc()
+
+        t_post = time.perf_counter()
+        if inferred:
+            # Only confident detections are used for aiming
+            hits = detections[detections[:, 4] >= AIM_CONF]
+            frames_since_hit = 0 if len(hits) > 0 else frames_since_hit + 1
+
+            # Hard examples for review: low-confidence hits with their boxes as pre-labels and misses shortly
+            # after the target was seen. Must happen before drawing, which draws into the frame.
+            if recorder is not None:
+                candidates = detections[(detections[:, 4] >= RECORD_CONF) & (detections[:, 4] < AIM_CONF)]
+                if len(hits) == 0 and len(candidates) > 0:
+                    h, w = frame.shape[:2]
+                    prelabels = [(int(c), (x1 + x2) / 2 / w, (y1 + y2) / 2 / h, (x2 - x1) / w, (y2 - y1) / h, float(conf))
+                                 for x1, y1, x2, y2, conf, c in candidates.tolist()]
+                    recorder.submit(frame, prelabels, "low_confidence")
+                elif len(hits) == 0 and 0 < frames_since_hit <= RECORD_MISS_WINDOW:
+                    recorder.submit(frame, [], "miss")
+
+        # Every detection is associated to a track, aiming follows the locked track ID only
+        if inferred:
+            sort_tracker.update(detections)
+        else:
+            sort_tracker.predict()
+        target = sort_tracker.target(AIM_CONF)
+
+        # Optical flow follows the locked target between detector runs, every inferred frame re-anchors it
+        aim_box = None
+        if inferred:
+            if target is not None and target.time_since_update == 0:
+                aim_box = target.box
+                flow.reset(cv2.cvtColor(frame, cv2.COLOR_BGR2GRAY), aim_box)
+            else:
+                flow.reset(None, None)
+        elif flow.active:
+            aim_box = flow.update(cv2.cvtColor(frame, cv2.COLOR_BGR2GRAY))
+
+        for sort_track in sort_tracker.tracks:
+            if sort_track.time_since_update == 0 and sort_track.hits >= sort_tracker.min_hits:
+                x1, y1, x2, y2 = map(int, sort_track.box)
+                color = (0, 0, 255) if sort_track.id == sort_tracker.locked_id else (255, 0, 0)
+                cv2.rectangle(frame, (x1, y1), (x2, y2), color, 2)
+                cv2.putText(frame, f"#{sort_track.id} {sort_track.conf:.2f}", (x1, y1 - 5), cv2.FONT_HERSHEY_SIMPLEX, 0.6, color, 2)
+        if aim_box is not None and not inferred:
+            x1, y1, x2, y2 = map(int, aim_box)
+            cv2.rectangle(frame, (x1, y1), (x2, y2), (0, 255, 255), 2)
+        img = cv2.circle(frame, undistort.center(TRACKING_SIZE) if undistort else (640,450), 5, (0,255,0), 3)
         
-        if boxes is not None and len(boxes) > 0:
+        if aim_box is not None:
             # Reset bb_counter since we found a target
             bb_counter = 0
             
-            for i, box in enumerate(boxes):
-                coords = box.xyxy[0].cpu().numpy()
-                x1, y1, x2, y2 = map(int, coords)
-                
-                bb_x = x1
-                bb_y = y1
-                bb_w = x2 - x1
-                bb_h = y2 - y1
-                center_x = (x1 + x2) / 2
-                center_y = (y1 + y2) / 2
-                
-                # Always reset counter when limit is reached
-                if counter % 7 == 0:
-                    counter = 0
-                   
-                    # Check conditions: initial run OR movement within bounds
-                    movement_within_bounds = (initial or 
-                                            (abs(center_x - old_center[0]) < 250 or 
-                                             abs(center_y - old_center[1]) < 250))
-                    
-                    if movement_within_bounds:
-                        # Store previous values and clear initial flag
-                        old_center = [center_x, center_y]
-                        initial = False
-                       
-                        rel_h, rel_v = servo_tracker.calculate_camera_relative_angles(center_x, center_y)
-                        logger.debug(f"rel_h: {rel_h}, rel_v: {rel_v}")
-                       
-                        if abs(rel_h) >= 7 or abs(rel_v) >= 7:
-                            logger.debug(f"rel_h: {rel_h}, rel_v: {rel_v}")
-                            abs_h, abs_v = servo_tracker.update_servo_position(center_x, center_y)
-                            logger.debug(f"abs_h: {abs_h}, abs_v: {abs_v}")
-                            payload = {
-                                "platform_x_angle": int(abs_h * -1),
-                                "platform_y_angle": int(abs_v),
-                                "fire_command": False
-                            }
-                            client.publish("vehicle/turret/cmd", json.dumps(payload))
-                    else:
-                        logger.debug(f"Skipping frame - large movement detected: dx={abs(center_x - old_center[0])}, dy={abs(center_y - old_center[1])}")
+            x1, y1, x2, y2 = map(int, aim_box)
+            center_x = (x1 + x2) / 2
+            center_y = (y1 + y2) / 2
+
+            # The web overlay is drawn on the original (distorted) camera stream
+            if undistort is not None:
+                (x1, y1), (x2, y2) = undistort.to_frame(TRACKING_SIZE, [(x1, y1), (x2, y2)]).astype(int)
+            
+            bb_x = x1
+            bb_y = y1
+            bb_w = x2 - x1
+            bb_h = y2 - y1
+            
+            # Every target position is filtered in turret-base coordinates
+            capture_time = t_start - (queue_ms + CAMERA_LATENCY_MS) / 1000
+            servo_tracker.observe(center_x, center_y, capture_time)
+
+            # Closed loop on every frame, only changed (integer) angles are published
+            abs_h, abs_v = servo_tracker.update_servo_position(time.perf_counter())
+            command = (int(abs_h * -1), int(abs_v))
+            if command != last_command:
+                last_command = command
+                payload = command_encoder.encode(command[0], command[1], fire=False)
+                publish_timer.publish(client, TURRET_TOPIC, payload)
+                m_commands.inc()
+                if cascade is not None:
+                    cascade.camera_moved()
         else:
-            # No target detected
-            bb_x = bb_y = bb_w = bb_h = 0
-            bb_counter = bb_counter + 1
+            # No target detected (skipped frames count as misses if the last inferred frame was one)
+            if inferred:
+                bb_x = bb_y = bb_w = bb_h = 0
+            if bb_w == 0:
+                bb_counter = bb_counter + 1
            
-        cv2.imshow("Annotated", img)
-        if cv2.waitKey(1) & 0xFF == ord('q'):
-            await track.stop()
-            break
+        if show:
+            cv2.imshow("Annotated", img)
+            if cv2.waitKey(1) & 0xFF == ord('q'):
+                await track.stop()
+                break
+
+        # Feed the governor with this frame's timings, end-to-end = waiting time + processing time
+        stage_ms["track_publish_display"] = (time.perf_counter() - t_post) * 1000
+        latency_ms = queue_ms + (time.perf_counter() - t_start) * 1000
+        governor.record(stage_ms, latency_ms=latency_ms)
+
+        m_frames.inc()
+        m_fps.set(frame_rate.tick())
+        for stage, value in stage_ms.items():
+            m_stage.labels(stage).observe(value / 1000)
+        m_latency.observe(latency_ms / 1000)
+        m_queue_delay.observe(queue_ms / 1000)
+        m_queue.labels("frames").set(round(queue_ms / 1000 * frame_rate.fps))
+        m_locked.set(int(sort_tracker.locked_id is not None))
+        publish_timer.drain()
             
         await asyncio.sleep(0.01)
-        
-        # Increment command counter
-        counter = counter + 1
        
         # Reset platform if no target detected for 5 seconds (150 frames at ~30fps)
         if bb_counter % 150 == 0 and bb_counter > 0:
@@ -278,19 +623,27 @@ async def run_track(track):
             # Reset platform to home position
             abs_h = 0
             abs_v = 48
-            payload = {
-                "platform_x_angle": int(abs_h),
-                "platform_y_angle": int(abs_v),
-                "fire_command": False
-            }
-            client.publish("vehicle/turret/cmd", json.dumps(payload))
+            payload = command_encoder.encode(int(abs_h), int(abs_v), fire=False)
+            publish_timer.publish(client, TURRET_TOPIC, payload)
+            m_commands.inc()
+            last_command = (int(abs_h), int(abs_v))
+            if cascade is not None:
+                cascade.camera_moved()
             
             # CRITICAL FIX: Update servo_tracker's internal position to match the reset
-            servo_tracker.reset_to_zero()
+            servo_tracker.reset_to_zero(time.perf_counter())
             
-            # Reset tracking state
-            initial = True
-            old_center = [640, 450]  # Reset to center of frame or known safe position
+            # Reset tracking state, lock onto whatever target shows up next
+            sort_tracker.unlock()
+
+    if reloader is not None:
+        reloader.close()
+    if recorder is not None:
+        recorder.close()
+    if cascade is not None:
+        logger.info(f"Cascade passes: {cascade.counts}")
+    for model_path, selector in selectors.items():
+        logger.info(f"Time per input size, {Path(model_path).parent.parent.name}:\n{selector.report()}")
             
 async def websocket_handler(websocket):
     logger.info("WebSocket client connected")
@@ -367,4 +720,5 @@ async def main():
     )
 
 if __name__ == "__main__":
+    setup()
     asyncio.run(main())
\ No newline at end of file
@@ -0,0 +1,120 @@
+from loguru import logger
+
+
+# ************************************** DOCUMENTATION **************************************
+# Chooses the detector input size per frame from the tracked target's apparent size and confidence.
+# A large, close glider is detected just as well at 320 as at 640 (~4x fewer pixels, ~3x faster),
+# a small, distant one needs the full resolution. Sizes are the square model input sizes that are
+# available (ONNX: one export per size, see ai_setup/export_onnx_nms.py; .pt weights take any size).
+#
+# The apparent size is the shorter box side scaled into the model input: side * size / longest frame side.
+# YOLO's finest detection grid has stride 8, below ~32 input pixels recall drops quickly.
+#
+# Hysteresis rules:
+#   - no target (search mode), or the target was lost for `lost_frames` frames: largest allowed size at once
+#   - step up at once when the target is smaller than `min_px` at the current size or its confidence
+#     drops below `up_conf`: to the smallest size that shows it with at least `target_px` (at least one step)
+#   - step down only one size at a time, when the next smaller size still shows the target with at least
+#     `target_px * (1 + down_margin)` and the confidence is at least `down_conf`, for `down_frames`
+#     consecutive frames, and not within `hold_frames` frames after the last switch
+#   - the governor's input size is the upper limit, the selector never exceeds what the latency budget allows
+#
+# The gap between min_px and target_px * (1 + down_margin), and up_conf / down_conf prevent oscillation:
+# a step down ends well above the step-up threshold.
+#
+# Time accounting: record() adds the measured detector time of every inferred frame to its size,
+# report() returns frames and time spent per size (logged by the receiver on quit, printed by the benchmark).
+
+
+class ResolutionSelector:
+    def __init__(self, sizes=(320, 480, 640), min_px=32, target_px=48, down_margin=0.25,
+                 up_conf=0.85, down_conf=0.92, down_frames=15, hold_frames=10, lost_frames=5):
+        if not sizes:
+            raise ValueError("sizes must contain at least one input size")
+
+        self.sizes = tuple(sorted(set(sizes)))
+        self.min_px = min_px
+        self.target_px = target_px
+        self.down_margin = down_margin
+        self.up_conf = up_conf
+        self.down_conf = down_conf
+        self.down_frames = down_frames
+        self.hold_frames = hold_frames
+        self.lost_frames = lost_frames
+
+        self.current = self.sizes[-1]
+        self.frames_since_switch = 0
+        self.down_votes = 0
+        self.frames_lost = lost_frames
+
+        self.frames = {size: 0 for size in self.sizes}
+        self.seconds = {size: 0.0 for size in self.sizes}
+
+    def select(self, box, conf, frame_shape, max_size=None):
+        """
+        Input size for the next detector run.
+
+        box:        (x1, y1, x2, y2) of the tracked target in frame pixels, None if there is no target
+        conf:       its last detection confidence
+        max_size:   upper limit (governor), the smallest available size is always allowed
+        """
+        allowed = [s for s in self.sizes if max_size is None or s <= max_size] or [self.sizes[0]]
+        self.frames_since_switch += 1
+
+        if box is None:
+            self.frames_lost += 1
+            self.down_votes = 0
+            if self.frames_lost >= self.lost_frames:
+                return self._switch(allowed[-1], "search")
+            return self._switch(min(self.current, allowed[-1]), "cap")
+        self.frames_lost = 0
+
+        longest = max(frame_shape[:2])
+        side = min(box[2] - box[0], box[3] - box[1])
+        apparent = lambda size: side * size / longest
+
+        current = self.current if self.current in allowed else allowed[-1]
+        index = allowed.index(current)
+
+        if apparent(current) < self.min_px or conf < self.up_conf:
+            self.down_votes = 0
+            larger = [s for s in allowed[index + 1:] if apparent(s) >= self.target_px]
+            if index + 1 < len(allowed):
+                size = larger[0] if larger else allowed[-1]
+                return self._switch(size, f"target {apparent(current):.0f} px, conf {conf:.2f}")
+            return self._switch(current, "cap")
+
+        if index > 0 and apparent(allowed[index - 1]) >= self.target_px * (1 + self.down_margin) and conf >= self.down_conf:
+            self.down_votes += 1
+        else:
+            self.down_votes = 0
+
+        if self.down_votes >= self.down_frames and self.frames_since_switch >= self.hold_frames:
+            self.down_votes = 0
+            return self._switch(allowed[index - 1], f"target {apparent(allowed[index - 1]):.0f} px at the smaller size")
+        return self._switch(current, "cap")
+
+    def record(self, size, seconds):
+        """Detector time of one inferred frame at the given input size"""
+        self.frames[size] = self.frames.get(size, 0) + 1
+        self.seconds[size] = self.seconds.get(size, 0.0) + seconds
+
+    def report(self):
+        total_frames = max(1, sum(self.frames.values()))
+        total_seconds = max(1e-9, sum(self.seconds.values()))
+        lines = []
+        for size in sorted(self.frames):
+            frames, seconds = self.frames[size], self.seconds[size]
+            mean_ms = seconds / frames * 1000 if frames else 0.0
+            lines.append(f"{size:>4}: {frames:6d} frames ({frames / total_frames:6.1%}), {seconds:8.2f} s detector time "
+                         f"({seconds / total_seconds:6.1%}), {mean_ms:6.2f} ms/frame")
+        return "\n".join(lines)
+
+    def _switch(self, size, reason):
+        if size != self.current:
+            if reason != "cap":
+                logger.debug(f"Resolution: {self.current} -> {size} ({reason})")
+            self.current = size
+            self.frames_since_switch = 0
+            self.down_votes = 0
+        return size
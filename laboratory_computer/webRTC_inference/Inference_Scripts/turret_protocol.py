@@ -0,0 +1,179 @@
+import json
+import math
+import struct
+import time
+from dataclasses import dataclass
+
+
+# ************************************** SOURCES  **************************************
+# CRC-16/CCITT-FALSE: https://reveng.sourceforge.io/crc-catalogue/16.htm (CRC-16/IBM-3740)
+
+# ************************************** DOCUMENTATION **************************************
+# Binary turret command / telemetry frames, Python side of
+# esp/HimmelWachtEsp32/components/interfaces/turret-protocol/include/turret-protocol.h (layout is defined there).
+#
+#   command   lab -> ESP, vehicle/turret/cmd, 16 bytes: angles in 0.01 degrees, fire flag, seq, sender time
+#   telemetry ESP -> lab, vehicle/turret/telemetry, 26 bytes: applied angles, last applied command seq,
+#             drive duty and current, dropped commands
+#
+# Little-endian, fixed size, CRC-16/CCITT-FALSE over everything but the CRC itself. The first byte (MAGIC)
+# can never start a JSON document, so the ESP accepts both formats during the migration.
+#
+# CommandEncoder numbers the commands of one sender and produces either format (PROTOCOLS), the receiver,
+# the simulator and the MQTT test script use it. decode_command_payload() reads both formats.
+
+MAGIC = 0xA5
+VERSION = 1
+
+FRAME_COMMAND = 0x01
+FRAME_TELEMETRY = 0x02
+
+COMMAND_FLAG_FIRE = 0x01
+TELEMETRY_FLAG_AUTOMATIC = 0x01
+
+PROTOCOLS = ("binary", "json")
+
+_COMMAND = struct.Struct("<BBBBHIhh")
+_TELEMETRY = struct.Struct("<BBBBHIhhHbbHHH")
+_CRC = struct.Struct("<H")
+
+COMMAND_FRAME_SIZE = _COMMAND.size + _CRC.size
+TELEMETRY_FRAME_SIZE = _TELEMETRY.size + _CRC.size
+
+
+def _crc_table():
+    table = []
+    for byte in range(256):
+        crc = byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+        table.append(crc & 0xFFFF)
+    return table
+
+
+_CRC_TABLE = _crc_table()
+
+
+def crc16(data):
+    """CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF), crc16(b"123456789") == 0x29B1"""
+    crc = 0xFFFF
+    for byte in data:
+        crc = ((crc << 8) & 0xFFFF) ^ _CRC_TABLE[(crc >> 8) ^ byte]
+    return crc
+
+
+class ProtocolError(ValueError):
+    pass
+
+
+@dataclass
+class CommandFrame:
+    x_deg: float
+    y_deg: float
+    fire: bool = False
+    seq: int = 0
+    timestamp_ms: int = 0
+
+
+@dataclass
+class TelemetryFrame:
+    x_deg: float
+    y_deg: float
+    automatic: bool = False
+    seq: int = 0
+    timestamp_ms: int = 0
+    last_cmd_seq: int = 0
+    left_duty: int = 0
+    right_duty: int = 0
+    left_current_ma: int = 0
+    right_current_ma: int = 0
+    dropped_cmds: int = 0
+
+
+def _centideg(degrees):
+    # Half away from zero like std::round() in turret-protocol.hpp, round() would round half to even
+    centideg = int(math.copysign(math.floor(abs(degrees) * 100 + 0.5), degrees))
+    return max(-32768, min(32767, centideg))
+
+
+def _seal(body):
+    return body + _CRC.pack(crc16(body))
+
+
+def _open(data, frame_type, size):
+    data = bytes(data)
+    if len(data) < 3:
+        raise ProtocolError("wrong length")
+    if data[0] != MAGIC:
+        raise ProtocolError("wrong magic byte")
+    if data[1] != VERSION:
+        raise ProtocolError(f"unsupported version {data[1]}")
+    if data[2] != frame_type:
+        raise ProtocolError(f"wrong frame type {data[2]}")
+    if len(data) != size:
+        raise ProtocolError(f"wrong length {len(data)}, expected {size}")
+    if crc16(data[:-2]) != _CRC.unpack_from(data, size - 2)[0]:
+        raise ProtocolError("CRC mismatch")
+    return data
+
+
+def encode_command(frame):
+    flags = COMMAND_FLAG_FIRE if frame.fire else 0
+    return _seal(_COMMAND.pack(MAGIC, VERSION, FRAME_COMMAND, flags, frame.seq & 0xFFFF,
+                               frame.timestamp_ms & 0xFFFFFFFF, _centideg(frame.x_deg), _centideg(frame.y_deg)))
+
+
+def decode_command(data):
+    _, _, _, flags, seq, timestamp_ms, x, y = _COMMAND.unpack_from(_open(data, FRAME_COMMAND, COMMAND_FRAME_SIZE))
+    return CommandFrame(x / 100, y / 100, bool(flags & COMMAND_FLAG_FIRE), seq, timestamp_ms)
+
+
+def encode_telemetry(frame):
+    flags = TELEMETRY_FLAG_AUTOMATIC if frame.automatic else 0
+    return _seal(_TELEMETRY.pack(MAGIC, VERSION, FRAME_TELEMETRY, flags, frame.seq & 0xFFFF,
+                                 frame.timestamp_ms & 0xFFFFFFFF, _centideg(frame.x_deg), _centideg(frame.y_deg),
+                                 frame.last_cmd_seq & 0xFFFF, frame.left_duty, frame.right_duty,
+                                 frame.left_current_ma, frame.right_current_ma, frame.dropped_cmds & 0xFFFF))
+
+
+def decode_telemetry(data):
+    (_, _, _, flags, seq, timestamp_ms, x, y, last_cmd_seq, left_duty, right_duty,
+     left_ma, right_ma, dropped) = _TELEMETRY.unpack_from(_open(data, FRAME_TELEMETRY, TELEMETRY_FRAME_SIZE))
+    return TelemetryFrame(x / 100, y / 100, bool(flags & TELEMETRY_FLAG_AUTOMATIC), seq, timestamp_ms,
+                          last_cmd_seq, left_duty, right_duty, left_ma, right_ma, dropped)
+
+
+def esp_degrees(degrees):
+    """Whole degrees the ESP applies for a commanded angle (rounded half away from zero, like mqtt-stack.c)"""
+    centideg = _centideg(degrees)
+    return max(-128, min(127, int((centideg + (50 if centideg >= 0 else -50)) / 100)))
+
+
+def decode_command_payload(payload):
+    """Command from either format (binary by magic byte, JSON otherwise), raises ProtocolError"""
+    if payload and payload[0] == MAGIC:
+        return decode_command(payload)
+    try:
+        command = json.loads(payload)
+        return CommandFrame(command["platform_x_angle"], command["platform_y_angle"], bool(command["fire_command"]))
+    except (ValueError, KeyError, TypeError) as e:
+        raise ProtocolError(f"invalid JSON command: {e}") from e
+
+
+class CommandEncoder:
+    """Builds the payloads of one command sender, seq counts up, timestamp is ms since the encoder was created"""
+    def __init__(self, protocol="binary"):
+        if protocol not in PROTOCOLS:
+            raise ValueError(f"protocol must be one of {PROTOCOLS}")
+        self.protocol = protocol
+        self.seq = 0
+        self.start = time.monotonic()
+
+    def encode(self, x_deg, y_deg, fire=False):
+        if self.protocol == "json":
+            # The JSON format only carries whole degrees
+            return json.dumps({"platform_x_angle": int(x_deg), "platform_y_angle": int(y_deg), "fire_command": bool(fire)})
+
+        frame = CommandFrame(x_deg, y_deg, fire, self.seq, int((time.monotonic() - self.start) * 1000))
+        self.seq = (self.seq + 1) & 0xFFFF
+        return encode_command(frame)
@@ -0,0 +1,100 @@
+import ctypes
+import os
+import sys
+import threading
+from pathlib import Path
+
+from loguru import logger
+
+
+# ************************************** DOCUMENTATION **************************************
+# ctypes binding of the C++ visual servo controller in laboratory_computer/visual_servo
+# (PID + target rate feedforward, output rate limit, anti-windup), build it first:
+#   cmake -S ../../visual_servo -B ../../visual_servo/build && cmake --build ../../visual_servo/build --config Release
+# The library path can be overridden with the VISUAL_SERVO_LIB environment variable.
+#
+# Gains are tunable at runtime: set_gains() may be called from any thread (e.g. the MQTT callback),
+# the new gains are applied at the beginning of the next update(). The controller rejects invalid
+# gains (not finite, min_angle > max_angle, max_rate <= 0, i_limit < 0) and keeps the previous ones.
+
+BUILD_DIR = Path(__file__).resolve().parents[2] / "visual_servo" / "build"
+AXES = {"pan": 0, "tilt": 1}
+
+
+class AxisGains(ctypes.Structure):
+    _fields_ = [(name, ctypes.c_float) for name in
+                ("kp", "ki", "kd", "kff", "max_rate", "i_limit", "min_angle", "max_angle")]
+
+    def as_dict(self):
+        return {name: round(getattr(self, name), 4) for name, _ in self._fields_}
+
+
+def _library_path():
+    if "VISUAL_SERVO_LIB" in os.environ:
+        return Path(os.environ["VISUAL_SERVO_LIB"])
+    name = "visual_servo.dll" if sys.platform == "win32" else "libvisual_servo.so"
+    candidates = [BUILD_DIR / "Release" / name, BUILD_DIR / name]
+    return next((path for path in candidates if path.exists()), candidates[-1])
+
+
+class VisualServo:
+    def __init__(self, pan=0.0, tilt=48.0):
+        path = _library_path()
+        self.lib = ctypes.CDLL(str(path))
+        self.lib.vs_create.restype = ctypes.c_void_p
+        self.lib.vs_destroy.argtypes = [ctypes.c_void_p]
+        self.lib.vs_set_gains.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.POINTER(AxisGains)]
+        self.lib.vs_set_gains.restype = ctypes.c_int
+        self.lib.vs_get_gains.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.POINTER(AxisGains)]
+        self.lib.vs_reset.argtypes = [ctypes.c_void_p, ctypes.c_float, ctypes.c_float]
+        self.lib.vs_update.argtypes = [ctypes.c_void_p] + [ctypes.c_float] * 5 + [ctypes.POINTER(ctypes.c_float)] * 2
+
+        self.handle = self.lib.vs_create()
+        self.pan_out = ctypes.c_float()
+        self.tilt_out = ctypes.c_float()
+        self.pending = {}
+        self.pending_lock = threading.Lock()
+        self.reset(pan, tilt)
+        logger.info(f"Visual servo controller loaded from {path}: pan {self.gains('pan')}, tilt {self.gains('tilt')}")
+
+    def __del__(self):
+        if getattr(self, "handle", None):
+            self.lib.vs_destroy(self.handle)
+            self.handle = None
+
+    def gains(self, axis):
+        gains = AxisGains()
+        self.lib.vs_get_gains(self.handle, AXES[axis], ctypes.byref(gains))
+        return gains.as_dict()
+
+    def set_gains(self, axis, **values):
+        """Thread safe, unknown names raise ValueError, omitted gains keep their value"""
+        if axis not in AXES:
+            raise ValueError(f"Unknown axis {axis}")
+        unknown = set(values) - {name for name, _ in AxisGains._fields_}
+        if unknown:
+            raise ValueError(f"Unknown gains {sorted(unknown)}")
+        with self.pending_lock:
+            self.pending.setdefault(axis, {}).update({k: float(v) for k, v in values.items()})
+
+    def reset(self, pan, tilt):
+        self.lib.vs_reset(self.handle, pan, tilt)
+
+    def update(self, pan_error, tilt_error, pan_rate, tilt_rate, dt):
+        """One control step, returns the absolute (pan, tilt) command in degrees"""
+        if self.pending:
+            with self.pending_lock:
+                pending, self.pending = self.pending, {}
+            for axis, values in pending.items():
+                gains = AxisGains()
+                self.lib.vs_get_gains(self.handle, AXES[axis], ctypes.byref(gains))
+                for name, value in values.items():
+                    setattr(gains, name, value)
+                if self.lib.vs_set_gains(self.handle, AXES[axis], ctypes.byref(gains)) != 0:
+                    logger.warning(f"Visual servo {axis} gains rejected, keeping {self.gains(axis)}: {gains.as_dict()}")
+                    continue
+                logger.info(f"Visual servo {axis} gains: {gains.as_dict()}")
+
+        self.lib.vs_update(self.handle, pan_error, tilt_error, pan_rate, tilt_rate, dt,
+                           ctypes.byref(self.pan_out), ctypes.byref(self.tilt_out))
+        return self.pan_out.value, self.tilt_out.value
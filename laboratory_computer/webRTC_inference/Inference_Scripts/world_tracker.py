@@ -0,0 +1,132 @@
+from collections import deque
+
+import numpy as np
+
+
+# ************************************** DOCUMENTATION **************************************
+# The camera sits on the turret, so a target pixel only says where the target is relative to
+# wherever the turret pointed when the frame was captured. Adding it to the last *commanded*
+# angle is wrong while the servos are still moving and makes the turret oscillate.
+#
+# TurretModel estimates the actual platform angle at any point in time from the timestamped
+# command history: every command takes effect after a dead time (MQTT + ESP + I2C ~30 ms, plus
+# ~40 ms platform inertia approximated as delay) and the servos move towards it with their
+# maximum slew rate (MG996R ~0.2 s / 60 deg under load).
+# The PCA9685 servos give no position feedback, the model is the best available estimate.
+#
+# WorldTargetFilter tracks the target in turret-base coordinates (pan / tilt in degrees,
+# same convention as ServoTracker: pan positive to the right, tilt 48 = level) with a
+# constant-velocity Kalman filter on measurements
+#     world angle = turret angle at capture time + camera-relative angle of the target pixel
+# and predicts it to the time the next command is sent.
+#
+# All times are time.perf_counter() seconds.
+
+
+class TurretModel:
+    def __init__(self, start=(0.0, 48.0), rate_deg_s=(300.0, 300.0), dead_time_s=0.07, horizon_s=2.0):
+        self.rate = np.asarray(rate_deg_s, dtype=np.float64)
+        self.dead_time_s = dead_time_s
+        self.horizon_s = horizon_s  # commands older than this are folded into the base state
+
+        self.base_time = None
+        self.base_angle = np.asarray(start, dtype=np.float64)
+        self.base_target = self.base_angle.copy()
+        self.commands = deque()  # (effective time, target angles)
+
+    def command(self, t, pan, tilt):
+        """Record a command sent at time t"""
+        if self.base_time is None:
+            self.base_time = t
+        self.commands.append((t + self.dead_time_s, np.array([pan, tilt], dtype=np.float64)))
+
+        # Fold old commands into the base state, keeps angle_at() O(recent commands)
+        while len(self.commands) > 1 and self.commands[1][0] < t - self.horizon_s:
+            effective, target = self.commands.popleft()
+            self.base_angle = self._slew(self.base_angle, self.base_target, effective - self.base_time)
+            self.base_target = target
+            self.base_time = effective
+
+    def reset(self, t, pan, tilt):
+        """Platform was moved to a known position (e.g. homing), forget the history"""
+        self.commands.clear()
+        self.base_time = t
+        self.base_angle = np.array([pan, tilt], dtype=np.float64)
+        self.base_target = self.base_angle.copy()
+
+    def angle_at(self, t):
+        """Estimated actual (pan, tilt) at time t"""
+        if self.base_time is None:
+            return tuple(self.base_angle)
+
+        angle, target, time = self.base_angle, self.base_target, self.base_time
+        for effective, command in self.commands:
+            if effective > t:
+                break
+            angle = self._slew(angle, target, effective - time)
+            target, time = command, effective
+        angle = self._slew(angle, target, t - time)
+        return float(angle[0]), float(angle[1])
+
+    def _slew(self, angle, target, dt):
+        step = self.rate * max(dt, 0.0)
+        return angle + np.clip(target - angle, -step, step)
+
+
+class WorldTargetFilter:
+    def __init__(self, measurement_std_deg=0.5, accel_std_deg_s2=60.0, reset_after_s=1.0):
+        self.r = measurement_std_deg ** 2
+        self.q = accel_std_deg_s2 ** 2
+        self.reset_after_s = reset_after_s  # a gap this long starts a new track
+
+        self.t = None
+        self.x = np.zeros(4)  # pan, tilt, pan rate, tilt rate
+        self.P = np.eye(4)
+
+    @property
+    def initialized(self):
+        return self.t is not None
+
+    @property
+    def rate(self):
+        """Target angular rate (pan, tilt) in deg/s"""
+        return float(self.x[2]), float(self.x[3])
+
+    def reset(self):
+        self.t = None
+
+    def update(self, t, pan, tilt):
+        """Fuse a world-frame measurement taken at time t (measurements may arrive slightly out of order)"""
+        z = np.array([pan, tilt])
+        if self.t is None or t - self.t > self.reset_after_s:
+            self.t = t
+            self.x = np.array([pan, tilt, 0.0, 0.0])
+            self.P = np.diag([self.r, self.r, 100.0 ** 2, 100.0 ** 2])
+            return
+
+        dt = max(t - self.t, 0.0)
+        self.x, self.P = self._predict(dt)
+        self.t = max(t, self.t)
+
+        # H selects the angles, update per axis is independent
+        S = self.P[:2, :2] + np.eye(2) * self.r
+        K = self.P[:, :2] @ np.linalg.inv(S)
+        self.x = self.x + K @ (z - self.x[:2])
+        self.P = (np.eye(4) - K @ np.eye(2, 4)) @ self.P
+
+    def predict(self, t):
+        """Target (pan, tilt) extrapolated to time t"""
+        if self.t is None:
+            return None
+        x, _ = self._predict(max(t - self.t, 0.0))
+        return float(x[0]), float(x[1])
+
+    def _predict(self, dt):
+        F = np.eye(4)
+        F[0, 2] = F[1, 3] = dt
+        # Piecewise white acceleration noise
+        q = self.q * np.array([[dt ** 4 / 4, dt ** 3 / 2], [dt ** 3 / 2, dt ** 2]])
+        Q = np.zeros((4, 4))
+        Q[np.ix_([0, 2], [0, 2])] = q
+        Q[np.ix_([1, 3], [1, 3])] = q
+        return F @ self.x, F @ self.P @ F.T + Q